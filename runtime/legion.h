@@ -5843,6 +5843,26 @@ namespace Legion {
        * Return the local MPI rank ID for the current Legion runtime
        */
       int find_local_MPI_rank(void);
+    public:
+      //------------------------------------------------------------------------
+      // Runtime Statistics
+      //------------------------------------------------------------------------
+      /**
+       * Get a snapshot of the statistics that the runtime always collects
+       * on the local node unless it is run with -lg:no_stats. Each entry
+       * is named '<category>.<kind>.<metric>' for the following categories:
+       *  - dependence_analysis: latency per operation kind
+       *  - mapper_call: latency per mapper call
+       *  - message: count and bytes per kind of message sent
+       *  - meta_task: issued, started, and queue depth per meta-task
+       *  - instance_failures: failed instance creations per memory
+       * Latencies are reported in nanoseconds as a count, total, maximum, 
+       * and approximate 50th and 99th percentiles. Kinds that have not
+       * been observed are omitted.
+       * @param stats map to be filled in with the current statistics
+       */
+      void get_runtime_statistics(
+                          std::map<std::string,unsigned long long> &stats);
     public:
       //------------------------------------------------------------------------
       // Semantic Information 
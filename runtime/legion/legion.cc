@@ -6428,6 +6428,14 @@ namespace Legion {
       return runtime->find_local_MPI_rank();
     }
 
+    //--------------------------------------------------------------------------
+    void Runtime::get_runtime_statistics(
+                               std::map<std::string,unsigned long long> &stats)
+    //--------------------------------------------------------------------------
+    {
+      runtime->get_runtime_statistics(stats);
+    }
+
     //--------------------------------------------------------------------------
     Mapping::MapperRuntime* Runtime::get_mapper_runtime(void)
     //--------------------------------------------------------------------------
@@ -580,6 +580,9 @@ typedef enum legion_error_t {
   ERROR_COPY_GATHER_REQUIREMENT = 553,
   ERROR_COPY_SCATTER_REQUIREMENT = 554,
   ERROR_MAPPER_SYNCHRONIZATION = 555,
+  ERROR_INVALID_STATISTICS_FILE = 556,
+  ERROR_INVALID_PROFILER_COUNTERS = 557,
+  ERROR_CORRUPT_COMPRESSED_MESSAGE = 558,
   
 
   LEGION_WARNING_FUTURE_NONLEAF = 1000,
@@ -999,7 +999,8 @@ namespace Legion {
                         encode_instance_did(did, external_instance), 
                         owner_space, node, inst, instance_domain, 
                         own, register_now), use_event(u_event),
-                        read_only_mapping_reservation(read_only_reservation)
+                        read_only_mapping_reservation(read_only_reservation),
+                        zero_pristine(false)
     //--------------------------------------------------------------------------
     {
       if (!is_owner())
@@ -1201,6 +1202,9 @@ namespace Legion {
 #ifdef DEBUG_LEGION
       assert(is_owner());
 #endif
+      // We can't see users registered on other nodes so we can no
+      // longer vouch for the contents of the instance being zero
+      clear_zero_pristine();
       Serializer rez;
       {
         RezCheck z(rez);
@@ -2073,14 +2077,19 @@ namespace Legion {
             // Now we can make the manager
             Reservation read_only_reservation = 
               Reservation::create_reservation();
-            result = new InstanceManager(forest, did, local_space,
-                                         memory_manager,
+            InstanceManager *manager = new InstanceManager(forest, did,
+                                         local_space, memory_manager,
                                          instance, instance_domain, 
                                          own_domain, ancestor, layout, 
                                          pointer_constraint, 
                                          true/*register now*/, ready,
                                          false/*external instance*/,
                                          read_only_reservation);
+            // If Realm gave us storage that is already all zeroes then
+            // we can skip any zero fills until somebody writes to it
+            if (instance.is_zero_initialized())
+              manager->mark_zero_pristine();
+            result = manager;
             break;
           }
         case REDUCTION_FOLD_SPECIALIZE:
@@ -2109,6 +2118,26 @@ namespace Legion {
             // that we want Legion Spy to see
             void *fill_buffer = malloc(reduction_op->sizeof_rhs);
             reduction_op->init(fill_buffer, 1);
+            // If the identity is all zeroes and Realm gave us storage
+            // that is already zero then there is nothing to fill
+            if (instance.is_zero_initialized())
+            {
+              bool zero_identity = true;
+              const char *bytes = (const char*)fill_buffer;
+              for (size_t idx = 0; idx < reduction_op->sizeof_rhs; idx++)
+              {
+                if (bytes[idx] == 0)
+                  continue;
+                zero_identity = false;
+                break;
+              }
+              if (zero_identity)
+              {
+                free(fill_buffer);
+                Runtime::trigger_event(filled_and_ready, ready);
+                break;
+              }
+            }
             std::vector<CopySrcDstField> dsts;
             {
               const std::vector<FieldID> &fill_fields = 
@@ -273,6 +273,12 @@ namespace Legion {
       virtual ApEvent get_use_event(void) const { return use_event; }
       inline Reservation get_read_only_mapping_reservation(void) const
         { return read_only_mapping_reservation; }
+    public:
+      // An instance is zero-pristine while nothing has been written to the
+      // zeroed storage Realm gave us, so fills of zeroes can be skipped
+      inline bool is_zero_pristine(void) const { return zero_pristine; }
+      inline void mark_zero_pristine(void) { zero_pristine = true; }
+      inline void clear_zero_pristine(void) { zero_pristine = false; }
     public:
       virtual InstanceView* create_instance_top_view(InnerContext *context,
                                             AddressSpaceID logical_owner);
@@ -297,6 +303,7 @@ namespace Legion {
       const ApEvent use_event;
     protected:
       Reservation read_only_mapping_reservation;
+      volatile bool zero_pristine;
     };
 
     /**
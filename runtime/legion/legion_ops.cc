@@ -363,10 +363,23 @@ namespace Legion {
         if (wait_on.exists() && !wait_on.has_triggered())
           wait_on.wait();
       }
-      // Always wrap this call with calls to begin/end dependence analysis
+      if (runtime->statistics == NULL)
+      {
+        // Always wrap this call with calls to begin/end dependence analysis
+        begin_dependence_analysis();
+        trigger_dependence_analysis();
+        end_dependence_analysis();
+        return;
+      }
+      // Get the kind now as the operation can be recycled once it is done
+      const OpKind kind = get_operation_kind();
+      const unsigned long long start = 
+        Realm::Clock::current_time_in_nanoseconds();
       begin_dependence_analysis();
       trigger_dependence_analysis();
       end_dependence_analysis();
+      runtime->statistics->record_dependence_analysis(kind,
+          Realm::Clock::current_time_in_nanoseconds() - start);
     }
 
     //--------------------------------------------------------------------------
@@ -22,6 +22,7 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <ctype.h>
 
 namespace Legion {
   namespace Internal {
@@ -31,6 +32,8 @@ namespace Legion {
     // Keep a thread-local profiler instance so we can always
     // be thread safe no matter what Realm decides to do 
     __thread LegionProfInstance *thread_local_profiling_instance = NULL;
+    // Same thing for the block of runtime statistics counters
+    __thread LegionStatistics::ThreadCounters *thread_local_statistics = NULL;
 
     //--------------------------------------------------------------------------
     LegionProfMarker::LegionProfMarker(const char* _name)
@@ -60,14 +63,14 @@ namespace Legion {
 
     //--------------------------------------------------------------------------
     LegionProfInstance::LegionProfInstance(LegionProfiler *own)
-      : owner(own)
+      : owner(own), footprint(0)
     //--------------------------------------------------------------------------
     {
     }
 
     //--------------------------------------------------------------------------
     LegionProfInstance::LegionProfInstance(const LegionProfInstance &rhs)
-      : owner(rhs.owner)
+      : owner(rhs.owner), footprint(0)
     //--------------------------------------------------------------------------
     {
       // should never be called
@@ -190,6 +193,71 @@ namespace Legion {
       owner->update_footprint(diff, this);
     }
 
+    //--------------------------------------------------------------------------
+    void LegionProfInstance::process_task_counters(
+            TaskID task_id, VariantID variant_id, UniqueID op_id,
+            const Realm::ProfilingResponse &response,
+            const Realm::ProfilingMeasurements::OperationTimeline &timeline,
+            const Realm::ProfilingMeasurements::OperationProcessorUsage &usage)
+    //--------------------------------------------------------------------------
+    {
+      // Realm only reports the measurements that it was able to count
+      // so anything missing is left as -1 for the tools
+      Realm::ProfilingMeasurements::IPCPerfCounters ipc;
+      Realm::ProfilingMeasurements::L1ICachePerfCounters l1i;
+      Realm::ProfilingMeasurements::L1DCachePerfCounters l1d;
+      Realm::ProfilingMeasurements::L2CachePerfCounters l2;
+      Realm::ProfilingMeasurements::L3CachePerfCounters l3;
+      Realm::ProfilingMeasurements::TLBPerfCounters tlb;
+      Realm::ProfilingMeasurements::BranchPredictionPerfCounters branch;
+      const bool has_ipc = response.get_measurement<
+        Realm::ProfilingMeasurements::IPCPerfCounters>(ipc);
+      const bool has_l1i = response.get_measurement<
+        Realm::ProfilingMeasurements::L1ICachePerfCounters>(l1i);
+      const bool has_l1d = response.get_measurement<
+        Realm::ProfilingMeasurements::L1DCachePerfCounters>(l1d);
+      const bool has_l2 = response.get_measurement<
+        Realm::ProfilingMeasurements::L2CachePerfCounters>(l2);
+      const bool has_l3 = response.get_measurement<
+        Realm::ProfilingMeasurements::L3CachePerfCounters>(l3);
+      const bool has_tlb = response.get_measurement<
+        Realm::ProfilingMeasurements::TLBPerfCounters>(tlb);
+      const bool has_branch = response.get_measurement<
+        Realm::ProfilingMeasurements::BranchPredictionPerfCounters>(branch);
+      // Nothing to record if the hardware gave us nothing
+      if (!has_ipc && !has_l1i && !has_l1d && !has_l2 && !has_l3 &&
+          !has_tlb && !has_branch)
+        return;
+      task_perf_counters.push_back(TaskPerfCounters());
+      TaskPerfCounters &info = task_perf_counters.back();
+      info.op_id = op_id;
+      info.task_id = task_id;
+      info.variant_id = variant_id;
+      info.proc_id = usage.proc.id;
+      info.start = timeline.start_time;
+      info.stop = timeline.complete_time;
+      info.instructions = has_ipc ? ipc.total_insts : -1;
+      info.cycles = has_ipc ? ipc.total_cycles : -1;
+      info.fp_instructions = has_ipc ? ipc.fp_insts : -1;
+      info.load_instructions = has_ipc ? ipc.ld_insts : -1;
+      info.store_instructions = has_ipc ? ipc.st_insts : -1;
+      info.branch_instructions = has_ipc ? ipc.br_insts : -1;
+      info.l1i_accesses = has_l1i ? l1i.accesses : -1;
+      info.l1i_misses = has_l1i ? l1i.misses : -1;
+      info.l1d_accesses = has_l1d ? l1d.accesses : -1;
+      info.l1d_misses = has_l1d ? l1d.misses : -1;
+      info.l2_accesses = has_l2 ? l2.accesses : -1;
+      info.l2_misses = has_l2 ? l2.misses : -1;
+      info.l3_accesses = has_l3 ? l3.accesses : -1;
+      info.l3_misses = has_l3 ? l3.misses : -1;
+      info.itlb_misses = has_tlb ? tlb.inst_misses : -1;
+      info.dtlb_misses = has_tlb ? tlb.data_misses : -1;
+      info.branches = has_branch ? branch.total_branches : -1;
+      info.taken_branches = has_branch ? branch.taken_branches : -1;
+      info.branch_mispredictions = has_branch ? branch.mispredictions : -1;
+      owner->update_footprint(sizeof(TaskPerfCounters), this);
+    }
+
     //--------------------------------------------------------------------------
     void LegionProfInstance::process_meta(size_t id, UniqueID op_id,
             const Realm::ProfilingMeasurements::OperationTimeline &timeline,
@@ -468,6 +536,11 @@ namespace Legion {
           serializer->serialize(*wit, *it);
         }
       }
+      for (std::deque<TaskPerfCounters>::const_iterator it = 
+            task_perf_counters.begin(); it != task_perf_counters.end(); it++)
+      {
+        serializer->serialize(*it);
+      }
       for (std::deque<MetaInfo>::const_iterator it = meta_infos.begin();
             it != meta_infos.end(); it++)
       {
@@ -535,6 +608,7 @@ namespace Legion {
       operation_instances.clear();
       multi_tasks.clear();
       task_infos.clear();
+      task_perf_counters.clear();
       meta_infos.clear();
       copy_infos.clear();
       inst_create_infos.clear();
@@ -622,6 +696,16 @@ namespace Legion {
         if (t_curr >= t_stop)
           return diff;
       }
+      while (!task_perf_counters.empty())
+      {
+        TaskPerfCounters &front = task_perf_counters.front();
+        serializer->serialize(front);
+        diff += sizeof(front);
+        task_perf_counters.pop_front();
+        const long long t_curr = Realm::Clock::current_time_in_microseconds();
+        if (t_curr >= t_stop)
+          return diff;
+      }
       while (!meta_infos.empty())
       {
         MetaInfo &front = meta_infos.front();
@@ -743,10 +827,14 @@ namespace Legion {
                                    const char *prof_logfile,
                                    const size_t total_runtime_instances,
                                    const size_t footprint_threshold,
-                                   const size_t target_latency)
+                                   const size_t target_latency,
+                                   const char *counter_tasks)
       : runtime(rt), done_event(Runtime::create_rt_user_event()), 
         output_footprint_threshold(footprint_threshold), 
+        output_stream_threshold(std::max<size_t>(64 << 10,
+              std::min<size_t>(4 << 20, footprint_threshold / 64))),
         output_target_latency(target_latency), target_proc(target), 
+        all_counter_tasks(false),
 #ifndef DEBUG_LEGION
         total_outstanding_requests(1/*start with guard*/),
 #endif
@@ -756,6 +844,12 @@ namespace Legion {
 #ifdef DEBUG_LEGION
       assert(target_proc.exists());
 #endif
+      for (unsigned idx = 0; idx < LAST_SEND_KIND; idx++)
+      {
+        message_counts[idx] = 0;
+        message_bytes[idx] = 0;
+        message_wire_bytes[idx] = 0;
+      }
       if (!strcmp(serializer_type, "binary")) 
       {
         if (prof_logfile == NULL) 
@@ -796,6 +890,30 @@ namespace Legion {
         REPORT_LEGION_ERROR(ERROR_INVALID_PROFILER_SERIALIZER,
                 "Invalid serializer (%s), must be 'binary' "
                 "or 'ascii'\n", serializer_type)
+      // Parse the comma separated list of task IDs (or 'all') for which
+      // to request hardware performance counters
+      if (counter_tasks != NULL)
+      {
+        std::stringstream ss(counter_tasks);
+        std::string token;
+        while (std::getline(ss, token, ','))
+        {
+          if (token.empty())
+            continue;
+          if (token == "all")
+          {
+            all_counter_tasks = true;
+            continue;
+          }
+          char *end = NULL;
+          const unsigned long tid = strtoul(token.c_str(), &end, 10);
+          if ((end == NULL) || (*end != '\0'))
+            REPORT_LEGION_ERROR(ERROR_INVALID_PROFILER_COUNTERS,
+                "Invalid task ID '%s' for -lg:prof_counters, must be a "
+                "comma separated list of task IDs or 'all'", token.c_str())
+          counter_task_ids.insert(tid);
+        }
+      }
 
       for (unsigned idx = 0; idx < num_meta_tasks; idx++)
       {
@@ -841,8 +959,8 @@ namespace Legion {
     //--------------------------------------------------------------------------
     LegionProfiler::LegionProfiler(const LegionProfiler &rhs)
       : runtime(NULL), done_event(RtUserEvent::NO_RT_USER_EVENT),
-        output_footprint_threshold(0), output_target_latency(0), 
-        target_proc(rhs.target_proc)
+        output_footprint_threshold(0), output_stream_threshold(0),
+        output_target_latency(0), target_proc(rhs.target_proc)
     //--------------------------------------------------------------------------
     {
       // should never be called
@@ -942,6 +1060,8 @@ namespace Legion {
                 Realm::ProfilingMeasurements::OperationProcessorUsage>();
       req.add_measurement<
                 Realm::ProfilingMeasurements::OperationEventWaits>();
+      if (wants_perf_counters(tid))
+        add_perf_counter_measurements(req);
     }
 
     //--------------------------------------------------------------------------
@@ -1097,6 +1217,8 @@ namespace Legion {
                 Realm::ProfilingMeasurements::OperationProcessorUsage>();
       req.add_measurement<
                 Realm::ProfilingMeasurements::OperationEventWaits>();
+      if (wants_perf_counters(tid))
+        add_perf_counter_measurements(req);
     }
 
     //--------------------------------------------------------------------------
@@ -1211,6 +1333,29 @@ namespace Legion {
                   Realm::ProfilingMeasurements::OperationTimeline>();
     }
 
+    //--------------------------------------------------------------------------
+    void LegionProfiler::add_perf_counter_measurements(
+                                          Realm::ProfilingRequest &req) const
+    //--------------------------------------------------------------------------
+    {
+      // Realm counts these around the task body on the thread running
+      // it and leaves out anything the hardware or the kernel won't count
+      req.add_measurement<
+                Realm::ProfilingMeasurements::IPCPerfCounters>();
+      req.add_measurement<
+                Realm::ProfilingMeasurements::L1ICachePerfCounters>();
+      req.add_measurement<
+                Realm::ProfilingMeasurements::L1DCachePerfCounters>();
+      req.add_measurement<
+                Realm::ProfilingMeasurements::L2CachePerfCounters>();
+      req.add_measurement<
+                Realm::ProfilingMeasurements::L3CachePerfCounters>();
+      req.add_measurement<
+                Realm::ProfilingMeasurements::TLBPerfCounters>();
+      req.add_measurement<
+                Realm::ProfilingMeasurements::BranchPredictionPerfCounters>();
+    }
+
     //--------------------------------------------------------------------------
     void LegionProfiler::handle_profiling_response(
                                        const Realm::ProfilingResponse &response)
@@ -1246,8 +1391,14 @@ namespace Legion {
                   Realm::ProfilingMeasurements::OperationEventWaits>(waits);
             // Ignore anything that was predicated false for now
             if (has_usage)
+            {
               thread_local_profiling_instance->process_task(info->id, 
                   info->id2, info->op_id, timeline, usage, waits);
+              if (wants_perf_counters(info->id))
+                thread_local_profiling_instance->process_task_counters(
+                    info->id, info->id2, info->op_id, response, 
+                    timeline, usage);
+            }
             break;
           }
         case LEGION_PROF_META:
@@ -1404,6 +1555,18 @@ namespace Legion {
             instances.begin(); it != instances.end(); it++) {
         (*it)->dump_state(serializer);
       }  
+      for (unsigned idx = 0; idx < LAST_SEND_KIND; idx++)
+      {
+        if (message_counts[idx] == 0)
+          continue;
+        LegionProfInstance::MessageSizeInfo info;
+        info.kind = (MessageKind)idx;
+        info.count = message_counts[idx];
+        info.bytes = message_bytes[idx];
+        info.wire_bytes = message_wire_bytes[idx];
+        info.node = runtime->address_space;
+        serializer->serialize(info);
+      }
     }
 
     //--------------------------------------------------------------------------
@@ -1443,6 +1606,17 @@ namespace Legion {
                                                       start, stop);
     }
 
+    //--------------------------------------------------------------------------
+    void LegionProfiler::record_message_size(MessageKind kind, size_t bytes,
+                                             size_t wire_bytes)
+    //--------------------------------------------------------------------------
+    {
+      __sync_fetch_and_add(&message_counts[kind], 1ULL);
+      __sync_fetch_and_add(&message_bytes[kind], (unsigned long long)bytes);
+      __sync_fetch_and_add(&message_wire_bytes[kind], 
+                           (unsigned long long)wire_bytes);
+    }
+
     //--------------------------------------------------------------------------
     void LegionProfiler::record_mapper_call_kinds(const char *const *const
                                mapper_call_names, unsigned int num_mapper_calls)
@@ -1556,7 +1730,18 @@ namespace Legion {
     void LegionProfiler::update_footprint(size_t diff, LegionProfInstance *inst)
     //--------------------------------------------------------------------------
     {
+      const size_t local = inst->update_footprint(diff, 0);
       size_t footprint = __sync_add_and_fetch(&total_memory_footprint, diff);
+      // Normally a thread's records are handed off to be written in the
+      // background once there are enough of them, but if the background
+      // writes cannot keep up we fall back to having this thread do some
+      // of the writing itself so the memory usage stays bounded
+      if ((footprint <= output_footprint_threshold) &&
+          (local >= output_stream_threshold))
+      {
+        retire_thread_local_profiling_instance(inst);
+        return;
+      }
       if (footprint > output_footprint_threshold)
       {
         // An important bit of logic here, if we're over the threshold then
@@ -1579,6 +1764,7 @@ namespace Legion {
         }
         else
           diff = inst->dump_inter(serializer, over_scale);
+        inst->update_footprint(0, diff);
 #ifdef DEBUG_LEGION
 #ifndef NDEBUG
         footprint = 
@@ -1601,6 +1787,69 @@ namespace Legion {
       instances.push_back(thread_local_profiling_instance);
     }
 
+    //--------------------------------------------------------------------------
+    void LegionProfiler::retire_thread_local_profiling_instance(
+                                                       LegionProfInstance *inst)
+    //--------------------------------------------------------------------------
+    {
+#ifdef DEBUG_LEGION
+      assert(inst == thread_local_profiling_instance);
+#endif
+      // Give this thread a fresh instance and hand the full one off
+      // to a meta-task which will write it out and delete it
+      thread_local_profiling_instance = new LegionProfInstance(this);
+      {
+        AutoLock p_lock(profiler_lock);
+        for (std::vector<LegionProfInstance*>::iterator it = 
+              instances.begin(); it != instances.end(); it++)
+        {
+          if ((*it) != inst)
+            continue;
+          instances.erase(it);
+          break;
+        }
+        instances.push_back(thread_local_profiling_instance);
+      }
+      // Finalize has to wait for the write to be done
+#ifdef DEBUG_LEGION
+      increment_total_outstanding_requests(LEGION_PROF_META);
+#else
+      increment_total_outstanding_requests();
+#endif
+      ProfilerDumpArgs args(this, inst);
+      runtime->issue_runtime_meta_task(args, LG_LOW_PRIORITY);
+    }
+
+    //--------------------------------------------------------------------------
+    /*static*/ void LegionProfiler::handle_dump(const void *args)
+    //--------------------------------------------------------------------------
+    {
+      const ProfilerDumpArgs *dargs = (const ProfilerDumpArgs*)args;
+      dargs->profiler->dump_instance(dargs->instance);
+    }
+
+    //--------------------------------------------------------------------------
+    void LegionProfiler::dump_instance(LegionProfInstance *inst)
+    //--------------------------------------------------------------------------
+    {
+      const size_t diff = inst->get_footprint();
+      if (!serializer->is_thread_safe())
+      {
+        // Need a lock to protect the serializer
+        AutoLock p_lock(profiler_lock);
+        inst->dump_state(serializer);
+      }
+      else
+        inst->dump_state(serializer);
+      delete inst;
+      __sync_fetch_and_sub(&total_memory_footprint, diff);
+#ifdef DEBUG_LEGION
+      decrement_total_outstanding_requests(LEGION_PROF_META);
+#else
+      decrement_total_outstanding_requests();
+#endif
+    }
+
     //--------------------------------------------------------------------------
     DetailedProfiler::DetailedProfiler(Runtime *runtime, RuntimeCallKind call)
       : profiler(runtime->profiler), call_kind(call), start_time(0)
@@ -1640,6 +1889,395 @@ namespace Legion {
       return *this;
     }
 
+    //--------------------------------------------------------------------------
+    LegionStatistics::LatencyHistogram::LatencyHistogram(void)
+      : count(0), total(0), maximum(0)
+    //--------------------------------------------------------------------------
+    {
+      for (unsigned idx = 0; idx < NUM_LATENCY_BUCKETS; idx++)
+        buckets[idx] = 0;
+    }
+
+    //--------------------------------------------------------------------------
+    void LegionStatistics::LatencyHistogram::record(unsigned long long ns)
+    //--------------------------------------------------------------------------
+    {
+      count++;
+      total += ns;
+      if (ns > maximum)
+        maximum = ns;
+      // Bucket i holds latencies in [2^i, 2^(i+1)) with zero in bucket 0
+      unsigned bucket = (ns == 0) ? 0 : (63 - __builtin_clzll(ns));
+      if (bucket >= NUM_LATENCY_BUCKETS)
+        bucket = NUM_LATENCY_BUCKETS - 1;
+      buckets[bucket]++;
+    }
+
+    //--------------------------------------------------------------------------
+    void LegionStatistics::LatencyHistogram::merge(const LatencyHistogram &rhs)
+    //--------------------------------------------------------------------------
+    {
+      count += rhs.count;
+      total += rhs.total;
+      if (rhs.maximum > maximum)
+        maximum = rhs.maximum;
+      for (unsigned idx = 0; idx < NUM_LATENCY_BUCKETS; idx++)
+        buckets[idx] += rhs.buckets[idx];
+    }
+
+    //--------------------------------------------------------------------------
+    unsigned long long LegionStatistics::LatencyHistogram::quantile(
+                                                             double q) const
+    //--------------------------------------------------------------------------
+    {
+      const unsigned long long target = 
+        (unsigned long long)(q * count + 0.5);
+      unsigned long long seen = 0;
+      for (unsigned idx = 0; idx < NUM_LATENCY_BUCKETS; idx++)
+      {
+        seen += buckets[idx];
+        if ((seen > 0) && (seen >= target))
+          return std::min(maximum, (2ULL << idx) - 1);
+      }
+      return maximum;
+    }
+
+    //--------------------------------------------------------------------------
+    LegionStatistics::ThreadCounters::ThreadCounters(LegionStatistics *own,
+                                                     unsigned num_op_kinds)
+      : owner(own), dependence_analysis(new LatencyHistogram[num_op_kinds])
+    //--------------------------------------------------------------------------
+    {
+      for (unsigned idx = 0; idx < LAST_SEND_KIND; idx++)
+      {
+        message_counts[idx] = 0;
+        message_bytes[idx] = 0;
+      }
+      for (unsigned idx = 0; idx < LG_LAST_TASK_ID; idx++)
+      {
+        meta_tasks_issued[idx] = 0;
+        meta_tasks_started[idx] = 0;
+      }
+    }
+
+    //--------------------------------------------------------------------------
+    LegionStatistics::ThreadCounters::ThreadCounters(const ThreadCounters &rhs)
+      : owner(NULL), dependence_analysis(NULL)
+    //--------------------------------------------------------------------------
+    {
+      // should never be called
+      assert(false);
+    }
+
+    //--------------------------------------------------------------------------
+    LegionStatistics::ThreadCounters::~ThreadCounters(void)
+    //--------------------------------------------------------------------------
+    {
+      delete [] dependence_analysis;
+    }
+
+    //--------------------------------------------------------------------------
+    LegionStatistics::ThreadCounters& 
+      LegionStatistics::ThreadCounters::operator=(const ThreadCounters &rhs)
+    //--------------------------------------------------------------------------
+    {
+      // should never be called
+      assert(false);
+      return *this;
+    }
+
+    //--------------------------------------------------------------------------
+    LegionStatistics::LegionStatistics(Runtime *rt,
+                       const char *const *const meta_task_descriptions,
+                       unsigned num_operation_kinds,
+                       const char *const *const operation_kind_descriptions,
+                       const char *const *const message_descriptions,
+                       const char *const *const mapper_names,
+                       const char *stats_logfile, unsigned dump_interval_ms)
+      : runtime(rt), dump_interval((stats_logfile == NULL) ? 0 :
+          (unsigned long long)dump_interval_ms * 1000000ULL),
+        meta_task_names(meta_task_descriptions, 
+                        meta_task_descriptions + LG_LAST_TASK_ID),
+        op_kind_names(operation_kind_descriptions,
+                      operation_kind_descriptions + num_operation_kinds),
+        message_names(message_descriptions,
+                      message_descriptions + LAST_SEND_KIND),
+        mapper_call_names(mapper_names, mapper_names + LAST_MAPPER_CALL),
+        dump_file(NULL), next_dump(0)
+    //--------------------------------------------------------------------------
+    {
+      if (stats_logfile != NULL)
+      {
+        // Same convention as the profiler: '%' becomes the node number
+        std::string filename(stats_logfile);
+        size_t pct = filename.find_first_of('%', 0);
+        if (pct != std::string::npos)
+        {
+          std::stringstream ss;
+          ss << filename.substr(0, pct) << runtime->address_space <<
+                filename.substr(pct + 1);
+          filename = ss.str();
+        }
+        else if (runtime->total_address_spaces > 1)
+          REPORT_LEGION_ERROR(ERROR_INVALID_STATISTICS_FILE,
+              "ERROR: The statistics file name must contain '%%' "
+              "which will be replaced with the node id\n")
+        dump_file = fopen(filename.c_str(), "w");
+        if (dump_file == NULL)
+          REPORT_LEGION_ERROR(ERROR_INVALID_STATISTICS_FILE,
+              "ERROR: Unable to open statistics file %s", filename.c_str())
+        if (dump_interval > 0)
+          next_dump = Realm::Clock::current_time_in_nanoseconds() + 
+                      dump_interval;
+      }
+    }
+
+    //--------------------------------------------------------------------------
+    LegionStatistics::LegionStatistics(const LegionStatistics &rhs)
+      : runtime(NULL), dump_interval(0)
+    //--------------------------------------------------------------------------
+    {
+      // should never be called
+      assert(false);
+    }
+
+    //--------------------------------------------------------------------------
+    LegionStatistics::~LegionStatistics(void)
+    //--------------------------------------------------------------------------
+    {
+      if (dump_file != NULL)
+        fclose(dump_file);
+      // Threads might still point at their counters, but they will 
+      // make new ones if they are ever used with another runtime
+      for (std::vector<ThreadCounters*>::const_iterator it = 
+            counters.begin(); it != counters.end(); it++)
+        delete (*it);
+    }
+
+    //--------------------------------------------------------------------------
+    LegionStatistics& LegionStatistics::operator=(const LegionStatistics &rhs)
+    //--------------------------------------------------------------------------
+    {
+      // should never be called
+      assert(false);
+      return *this;
+    }
+
+    //--------------------------------------------------------------------------
+    LegionStatistics::ThreadCounters* LegionStatistics::get_thread_counters(
+                                                                        void)
+    //--------------------------------------------------------------------------
+    {
+      if ((thread_local_statistics != NULL) && 
+          (thread_local_statistics->owner == this))
+        return thread_local_statistics;
+      ThreadCounters *result = new ThreadCounters(this, op_kind_names.size());
+      {
+        AutoLock s_lock(stats_lock);
+        counters.push_back(result);
+      }
+      thread_local_statistics = result;
+      return result;
+    }
+
+    //--------------------------------------------------------------------------
+    void LegionStatistics::record_dependence_analysis(unsigned op_kind,
+                                                      unsigned long long ns)
+    //--------------------------------------------------------------------------
+    {
+#ifdef DEBUG_LEGION
+      assert(op_kind < op_kind_names.size());
+#endif
+      get_thread_counters()->dependence_analysis[op_kind].record(ns);
+    }
+
+    //--------------------------------------------------------------------------
+    void LegionStatistics::record_mapper_call(MappingCallKind kind,
+                                              unsigned long long ns)
+    //--------------------------------------------------------------------------
+    {
+      get_thread_counters()->mapper_calls[kind].record(ns);
+    }
+
+    //--------------------------------------------------------------------------
+    void LegionStatistics::record_message(MessageKind kind, size_t bytes)
+    //--------------------------------------------------------------------------
+    {
+      ThreadCounters *local = get_thread_counters();
+      local->message_counts[kind]++;
+      local->message_bytes[kind] += bytes;
+    }
+
+    //--------------------------------------------------------------------------
+    void LegionStatistics::record_meta_task_issued(LgTaskID tid)
+    //--------------------------------------------------------------------------
+    {
+      get_thread_counters()->meta_tasks_issued[tid]++;
+    }
+
+    //--------------------------------------------------------------------------
+    void LegionStatistics::record_meta_task_started(LgTaskID tid)
+    //--------------------------------------------------------------------------
+    {
+      get_thread_counters()->meta_tasks_started[tid]++;
+    }
+
+    //--------------------------------------------------------------------------
+    void LegionStatistics::record_instance_failure(Memory memory)
+    //--------------------------------------------------------------------------
+    {
+      AutoLock s_lock(stats_lock);
+      instance_failures[memory]++;
+    }
+
+    //--------------------------------------------------------------------------
+    static std::string statistics_name(const char *category, const char *kind,
+                                       const char *metric)
+    //--------------------------------------------------------------------------
+    {
+      std::string result(category);
+      result += '.';
+      for (const char *c = kind; *c != '\0'; c++)
+        result += isalnum(*c) ? *c : '_';
+      result += '.';
+      result += metric;
+      return result;
+    }
+
+    //--------------------------------------------------------------------------
+    static void snapshot_histogram(std::map<std::string,unsigned long long> &s,
+                                   const char *category, const char *kind,
+                       const LegionStatistics::LatencyHistogram &histogram)
+    //--------------------------------------------------------------------------
+    {
+      if (histogram.count == 0)
+        return;
+      s[statistics_name(category, kind, "count")] = histogram.count;
+      s[statistics_name(category, kind, "total_ns")] = histogram.total;
+      s[statistics_name(category, kind, "max_ns")] = histogram.maximum;
+      s[statistics_name(category, kind, "p50_ns")] = histogram.quantile(0.5);
+      s[statistics_name(category, kind, "p99_ns")] = histogram.quantile(0.99);
+    }
+
+    //--------------------------------------------------------------------------
+    void LegionStatistics::snapshot(
+                                  std::map<std::string,unsigned long long> &s)
+    //--------------------------------------------------------------------------
+    {
+      std::vector<LatencyHistogram> dependence_analysis(op_kind_names.size());
+      std::vector<LatencyHistogram> mapper_calls(LAST_MAPPER_CALL);
+      std::vector<unsigned long long> message_counts(LAST_SEND_KIND, 0);
+      std::vector<unsigned long long> message_bytes(LAST_SEND_KIND, 0);
+      std::vector<unsigned long long> meta_issued(LG_LAST_TASK_ID, 0);
+      std::vector<unsigned long long> meta_started(LG_LAST_TASK_ID, 0);
+      std::map<Memory,unsigned long long> failures;
+      {
+        // The owning threads keep updating their counters while we read
+        // them so the snapshot is only approximately consistent
+        AutoLock s_lock(stats_lock);
+        for (std::vector<ThreadCounters*>::const_iterator it = 
+              counters.begin(); it != counters.end(); it++)
+        {
+          const ThreadCounters *local = *it;
+          for (unsigned idx = 0; idx < op_kind_names.size(); idx++)
+            dependence_analysis[idx].merge(local->dependence_analysis[idx]);
+          for (unsigned idx = 0; idx < LAST_MAPPER_CALL; idx++)
+            mapper_calls[idx].merge(local->mapper_calls[idx]);
+          for (unsigned idx = 0; idx < LAST_SEND_KIND; idx++)
+          {
+            message_counts[idx] += local->message_counts[idx];
+            message_bytes[idx] += local->message_bytes[idx];
+          }
+          for (unsigned idx = 0; idx < LG_LAST_TASK_ID; idx++)
+          {
+            meta_issued[idx] += local->meta_tasks_issued[idx];
+            meta_started[idx] += local->meta_tasks_started[idx];
+          }
+        }
+        failures = instance_failures;
+      }
+      for (unsigned idx = 0; idx < op_kind_names.size(); idx++)
+        snapshot_histogram(s, "dependence_analysis", op_kind_names[idx],
+                           dependence_analysis[idx]);
+      for (unsigned idx = 0; idx < LAST_MAPPER_CALL; idx++)
+        snapshot_histogram(s, "mapper_call", mapper_call_names[idx],
+                           mapper_calls[idx]);
+      for (unsigned idx = 0; idx < LAST_SEND_KIND; idx++)
+      {
+        if (message_counts[idx] == 0)
+          continue;
+        s[statistics_name("message", message_names[idx], "count")] = 
+          message_counts[idx];
+        s[statistics_name("message", message_names[idx], "bytes")] = 
+          message_bytes[idx];
+      }
+      for (unsigned idx = 0; idx < LG_LAST_TASK_ID; idx++)
+      {
+        if (meta_issued[idx] == 0)
+          continue;
+        s[statistics_name("meta_task", meta_task_names[idx], "issued")] = 
+          meta_issued[idx];
+        s[statistics_name("meta_task", meta_task_names[idx], "started")] = 
+          meta_started[idx];
+        // Tasks that have been issued but not started yet, the counts
+        // are read at slightly different times so don't let it go negative
+        s[statistics_name("meta_task", meta_task_names[idx], "queue_depth")] =
+          (meta_issued[idx] > meta_started[idx]) ? 
+            (meta_issued[idx] - meta_started[idx]) : 0;
+      }
+      for (std::map<Memory,unsigned long long>::const_iterator it = 
+            failures.begin(); it != failures.end(); it++)
+      {
+        char memory_name[32];
+        snprintf(memory_name, sizeof(memory_name), "0x" IDFMT, 
+                 it->first.id);
+        s[statistics_name("instance_failures", memory_name, "count")] =
+          it->second;
+      }
+    }
+
+    //--------------------------------------------------------------------------
+    void LegionStatistics::periodic_dump(void)
+    //--------------------------------------------------------------------------
+    {
+      const unsigned long long current = next_dump;
+      const unsigned long long now = 
+        Realm::Clock::current_time_in_nanoseconds();
+      if (now < current)
+        return;
+      // Only one thread gets to do the dump for each interval
+      if (!__sync_bool_compare_and_swap(&next_dump, current, 
+                                        now + dump_interval))
+        return;
+      dump("periodic");
+    }
+
+    //--------------------------------------------------------------------------
+    void LegionStatistics::finalize(void)
+    //--------------------------------------------------------------------------
+    {
+      if (dump_file != NULL)
+        dump("final");
+    }
+
+    //--------------------------------------------------------------------------
+    void LegionStatistics::dump(const char *reason)
+    //--------------------------------------------------------------------------
+    {
+      std::map<std::string,unsigned long long> stats;
+      snapshot(stats);
+      const unsigned long long now = 
+        Realm::Clock::current_time_in_nanoseconds();
+      // Reuse the lock to keep dumps from different threads apart
+      AutoLock s_lock(stats_lock);
+      fprintf(dump_file, "# %s statistics for node %d at %llu us\n", reason,
+              runtime->address_space, now / 1000);
+      for (std::map<std::string,unsigned long long>::const_iterator it = 
+            stats.begin(); it != stats.end(); it++)
+        fprintf(dump_file, "%s %llu\n", it->first.c_str(), it->second);
+      fflush(dump_file);
+    }
+
   }; // namespace Internal
 }; // namespace Legion
 
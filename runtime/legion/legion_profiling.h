@@ -19,9 +19,12 @@
 #include "realm.h"
 #include "legion/legion_types.h"
 #include "legion/legion_utilities.h"
+#include "legion/legion_profiling_format.h"
 #include "realm/profiling.h"
 
 #include <assert.h>
+#include <stdio.h>
+#include <set>
 #include <deque>
 #include <algorithm>
 #include <sstream>
@@ -142,6 +145,17 @@ namespace Legion {
         timestamp_t create, ready, start, stop;
         std::deque<WaitInfo> wait_intervals;
       };
+      struct TaskPerfCounters {
+      public:
+        UniqueID op_id;
+        TaskID task_id;
+        VariantID variant_id;
+        ProcID proc_id;
+        timestamp_t start, stop;
+#define LEGION_PROF_PERF_COUNTER_FIELD(name) long long name;
+        LEGION_PROF_PERF_COUNTERS(LEGION_PROF_PERF_COUNTER_FIELD)
+#undef LEGION_PROF_PERF_COUNTER_FIELD
+      };
       struct MetaInfo {
       public:
         UniqueID op_id;
@@ -194,6 +208,12 @@ namespace Legion {
         timestamp_t start, stop;
         ProcID proc_id;
       };
+      struct MessageSizeInfo {
+      public:
+        MessageKind kind;
+        unsigned long long count, bytes, wire_bytes;
+        AddressSpaceID node;
+      };
       struct MapperCallInfo {
       public:
         MappingCallKind kind;
@@ -234,6 +254,10 @@ namespace Legion {
             const Realm::ProfilingMeasurements::OperationTimeline &timeline,
             const Realm::ProfilingMeasurements::OperationProcessorUsage &usage,
             const Realm::ProfilingMeasurements::OperationEventWaits &waits);
+      void process_task_counters(TaskID task_id, VariantID variant_id,
+            UniqueID op_id, const Realm::ProfilingResponse &response,
+            const Realm::ProfilingMeasurements::OperationTimeline &timeline,
+            const Realm::ProfilingMeasurements::OperationProcessorUsage &usage);
       void process_meta(size_t id, UniqueID op_id,
             const Realm::ProfilingMeasurements::OperationTimeline &timeline,
             const Realm::ProfilingMeasurements::OperationProcessorUsage &usage,
@@ -272,8 +296,14 @@ namespace Legion {
     public:
       void dump_state(LegionProfSerializer *serializer);
       size_t dump_inter(LegionProfSerializer *serializer, const double over);
+    public:
+      // Bytes recorded by this instance and not yet dumped
+      inline size_t update_footprint(size_t add, size_t sub)
+        { footprint = footprint + add - sub; return footprint; }
+      inline size_t get_footprint(void) const { return footprint; }
     private:
       LegionProfiler *const owner;
+      size_t footprint;
       std::deque<TaskKind>          task_kinds;
       std::deque<TaskVariant>       task_variants;
       std::deque<OperationInstance> operation_instances;
@@ -281,6 +311,7 @@ namespace Legion {
       std::deque<SliceOwner>        slice_owners;
     private:
       std::deque<TaskInfo> task_infos;
+      std::deque<TaskPerfCounters> task_perf_counters;
       std::deque<MetaInfo> meta_infos;
       std::deque<CopyInfo> copy_infos;
       std::deque<FillInfo> fill_infos;
@@ -310,6 +341,16 @@ namespace Legion {
         LEGION_PROF_PARTITION,
         LEGION_PROF_LAST,
       };
+      struct ProfilerDumpArgs : public LgTaskArgs<ProfilerDumpArgs> {
+      public:
+        static const LgTaskID TASK_ID = LG_PROFILER_DUMP_TASK_ID;
+      public:
+        ProfilerDumpArgs(LegionProfiler *p, LegionProfInstance *i)
+          : LgTaskArgs<ProfilerDumpArgs>(0), profiler(p), instance(i) { }
+      public:
+        LegionProfiler *const profiler;
+        LegionProfInstance *const instance;
+      };
       struct ProfilingInfo : public ProfilingResponseBase {
       public:
         ProfilingInfo(LegionProfiler *p, ProfilingKind k)
@@ -331,7 +372,8 @@ namespace Legion {
                      const char *prof_logname,
                      const size_t total_runtime_instances,
                      const size_t footprint_threshold,
-                     const size_t target_latency);
+                     const size_t target_latency,
+                     const char *counter_tasks);
       LegionProfiler(const LegionProfiler &rhs);
       virtual ~LegionProfiler(void);
     public:
@@ -379,6 +421,13 @@ namespace Legion {
                             UniqueID uid);
       void add_partition_request(Realm::ProfilingRequestSet &requests,
                                  UniqueID uid, DepPartOpKind part_op);
+    public:
+      // Whether hardware counters were requested with -lg:prof_counters
+      inline bool wants_perf_counters(TaskID tid) const
+        { return (all_counter_tasks || 
+                  (counter_task_ids.find(tid) != counter_task_ids.end())); }
+    protected:
+      void add_perf_counter_measurements(Realm::ProfilingRequest &req) const;
     public:
       // Process low-level runtime profiling results
       virtual void handle_profiling_response(
@@ -394,6 +443,9 @@ namespace Legion {
                                 unsigned int num_message_kinds);
       void record_message(MessageKind kind, timestamp_t start,
                           timestamp_t stop);
+      // Size of a message before and after any compression
+      void record_message_size(MessageKind kind, size_t bytes, 
+                               size_t wire_bytes);
     public:
       void record_mapper_call_kinds(const char *const *const mapper_call_names,
                                     unsigned int num_mapper_call_kinds);
@@ -416,18 +468,28 @@ namespace Legion {
 #endif
     public:
       void update_footprint(size_t diff, LegionProfInstance *inst);
+      static void handle_dump(const void *args);
     private:
       void create_thread_local_profiling_instance(void);
+      void retire_thread_local_profiling_instance(LegionProfInstance *inst);
+      void dump_instance(LegionProfInstance *inst);
     public:
       Runtime *const runtime;
       // Event to trigger once the profiling is actually done
       const RtUserEvent done_event;
       // Size in bytes of the footprint before we start dumping
       const size_t output_footprint_threshold;
+      // Size in bytes of a thread's records before they get handed
+      // off to be written out in the background
+      const size_t output_stream_threshold;
       // The goal size in microseconds of the output tasks
       const long long output_target_latency;
       // Target processor on which to launch jobs
       const Processor target_proc;
+    private:
+      // Tasks for which to collect hardware performance counters
+      bool all_counter_tasks;
+      std::set<TaskID> counter_task_ids;
     private:
       LegionProfSerializer* serializer;
       mutable LocalLock profiler_lock;
@@ -440,6 +502,11 @@ namespace Legion {
     private:
       // For knowing when we need to start dumping early
       size_t total_memory_footprint;
+    private:
+      // Per-kind totals of sent messages, updated atomically
+      unsigned long long message_counts[LAST_SEND_KIND];
+      unsigned long long message_bytes[LAST_SEND_KIND];
+      unsigned long long message_wire_bytes[LAST_SEND_KIND];
     };
 
     class DetailedProfiler {
@@ -455,6 +522,102 @@ namespace Legion {
       timestamp_t start_time;
     };
 
+
+    /**
+     * \class LegionStatistics
+     * Always-on counters and latency histograms for the runtime. Each
+     * thread updates its own block of counters without synchronization
+     * and the blocks are only summed when a snapshot is requested, either
+     * through Runtime::get_runtime_statistics or for a periodic dump to
+     * the file given by -lg:stats_file. The names of the different kinds
+     * come from the same tables that are given to the profiler.
+     */
+    class LegionStatistics {
+    public:
+      // Latencies are bucketed by powers of two of nanoseconds
+      static const unsigned NUM_LATENCY_BUCKETS = 32;
+      struct LatencyHistogram {
+      public:
+        LatencyHistogram(void);
+      public:
+        void record(unsigned long long nanoseconds);
+        void merge(const LatencyHistogram &rhs);
+        // Upper bound of the bucket containing the given quantile
+        unsigned long long quantile(double q) const;
+      public:
+        unsigned long long count, total, maximum;
+        unsigned long long buckets[NUM_LATENCY_BUCKETS];
+      };
+      struct ThreadCounters {
+      public:
+        ThreadCounters(LegionStatistics *owner, unsigned num_op_kinds);
+        ThreadCounters(const ThreadCounters &rhs);
+        ~ThreadCounters(void);
+      public:
+        ThreadCounters& operator=(const ThreadCounters &rhs);
+      public:
+        LegionStatistics *const owner;
+        LatencyHistogram *const dependence_analysis;
+        LatencyHistogram mapper_calls[LAST_MAPPER_CALL];
+        unsigned long long message_counts[LAST_SEND_KIND];
+        unsigned long long message_bytes[LAST_SEND_KIND];
+        unsigned long long meta_tasks_issued[LG_LAST_TASK_ID];
+        unsigned long long meta_tasks_started[LG_LAST_TASK_ID];
+      };
+    public:
+      LegionStatistics(Runtime *rt, 
+                       const char *const *const meta_task_descriptions,
+                       unsigned num_operation_kinds,
+                       const char *const *const operation_kind_descriptions,
+                       const char *const *const message_descriptions,
+                       const char *const *const mapper_call_names,
+                       const char *stats_logfile,
+                       unsigned dump_interval_ms);
+      LegionStatistics(const LegionStatistics &rhs);
+      ~LegionStatistics(void);
+    public:
+      LegionStatistics& operator=(const LegionStatistics &rhs);
+    public:
+      void record_dependence_analysis(unsigned op_kind, 
+                                      unsigned long long nanoseconds);
+      void record_mapper_call(MappingCallKind kind,
+                              unsigned long long nanoseconds);
+      void record_message(MessageKind kind, size_t bytes);
+      void record_meta_task_issued(LgTaskID tid);
+      void record_meta_task_started(LgTaskID tid);
+      void record_instance_failure(Memory memory);
+    public:
+      // Sum the counters of all threads into named values
+      void snapshot(std::map<std::string,unsigned long long> &stats);
+      // Cheap check for whether a periodic dump is due
+      inline void poll_periodic_dump(void)
+        { if ((dump_interval > 0) && 
+              ((unsigned long long)
+                Realm::Clock::current_time_in_nanoseconds() >= next_dump))
+            periodic_dump(); }
+      void finalize(void);
+    private:
+      ThreadCounters* get_thread_counters(void);
+      void periodic_dump(void);
+      void dump(const char *reason);
+    public:
+      Runtime *const runtime;
+      // In nanoseconds, zero for no periodic dumps
+      const unsigned long long dump_interval;
+    private:
+      const std::vector<const char*> meta_task_names;
+      const std::vector<const char*> op_kind_names;
+      const std::vector<const char*> message_names;
+      const std::vector<const char*> mapper_call_names;
+      FILE *dump_file;
+      unsigned long long next_dump;
+    private:
+      mutable LocalLock stats_lock;
+      std::vector<ThreadCounters*> counters;
+      // Failures are rare so these can just go under the lock
+      std::map<Memory,unsigned long long> instance_failures;
+    };
+
   }; // namespace Internal
 }; // namespace Legion
 
@@ -0,0 +1,137 @@
+/* Copyright 2018 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __LEGION_PROFILING_FORMAT_H__
+#define __LEGION_PROFILING_FORMAT_H__
+
+#include <stddef.h>
+
+// This file describes the layout of binary Legion Prof logs. It is shared
+// between the serializer in the runtime and the native analysis tool in
+// tools/legion_prof_analyze.cc so it must not depend on anything else
+// from the runtime. The fields of each record are described by the
+// preamble at the start of each log file.
+
+#define LEGION_PROF_BINARY_VERSION      "2.0"
+#define LEGION_PROF_BINARY_FILETYPE     \
+  "FileType: BinaryLegionProf v: " LEGION_PROF_BINARY_VERSION
+
+// The names in the preamble for each kind of record, the IDs of records
+// are their position in this list
+#define LEGION_PROF_RECORD_KINDS(__op__)                 \
+  __op__(MESSAGE_DESC_ID,        "MessageDesc")          \
+  __op__(MAPPER_CALL_DESC_ID,    "MapperCallDesc")       \
+  __op__(RUNTIME_CALL_DESC_ID,   "RuntimeCallDesc")      \
+  __op__(META_DESC_ID,           "MetaDesc")             \
+  __op__(OP_DESC_ID,             "OpDesc")               \
+  __op__(PROC_DESC_ID,           "ProcDesc")             \
+  __op__(MEM_DESC_ID,            "MemDesc")              \
+  __op__(TASK_KIND_ID,           "TaskKind")             \
+  __op__(TASK_VARIANT_ID,        "TaskVariant")          \
+  __op__(OPERATION_INSTANCE_ID,  "OperationInstance")    \
+  __op__(MULTI_TASK_ID,          "MultiTask")            \
+  __op__(SLICE_OWNER_ID,         "SliceOwner")           \
+  __op__(TASK_WAIT_INFO_ID,      "TaskWaitInfo")         \
+  __op__(META_WAIT_INFO_ID,      "MetaWaitInfo")         \
+  __op__(TASK_INFO_ID,           "TaskInfo")             \
+  __op__(META_INFO_ID,           "MetaInfo")             \
+  __op__(COPY_INFO_ID,           "CopyInfo")             \
+  __op__(FILL_INFO_ID,           "FillInfo")             \
+  __op__(INST_CREATE_INFO_ID,    "InstCreateInfo")       \
+  __op__(INST_USAGE_INFO_ID,     "InstUsageInfo")        \
+  __op__(INST_TIMELINE_INFO_ID,  "InstTimelineInfo")     \
+  __op__(PARTITION_INFO_ID,      "PartitionInfo")        \
+  __op__(MESSAGE_INFO_ID,        "MessageInfo")          \
+  __op__(MAPPER_CALL_INFO_ID,    "MapperCallInfo")       \
+  __op__(RUNTIME_CALL_INFO_ID,   "RuntimeCallInfo")      \
+  __op__(MESSAGE_SIZE_INFO_ID,   "MessageSizeInfo")      \
+  __op__(PROFTASK_INFO_ID,       "ProfTaskInfo")         \
+  __op__(TASK_PERF_COUNTERS_ID,  "TaskPerfCounters")
+
+// The hardware counters in each TaskPerfCounters record after its op_id,
+// task_id, variant_id, proc_id, start and stop. They are signed 64-bit
+// values that are -1 when the counter wasn't available on the processor.
+// These come from Realm's IPC, cache, TLB and branch prediction counter
+// measurements, see legion_serializer.py for the Python copy of this list.
+#define LEGION_PROF_PERF_COUNTERS(__op__)        \
+  __op__(instructions)                           \
+  __op__(cycles)                                 \
+  __op__(fp_instructions)                        \
+  __op__(load_instructions)                      \
+  __op__(store_instructions)                     \
+  __op__(branch_instructions)                    \
+  __op__(l1i_accesses)                           \
+  __op__(l1i_misses)                             \
+  __op__(l1d_accesses)                           \
+  __op__(l1d_misses)                             \
+  __op__(l2_accesses)                            \
+  __op__(l2_misses)                              \
+  __op__(l3_accesses)                            \
+  __op__(l3_misses)                              \
+  __op__(itlb_misses)                            \
+  __op__(dtlb_misses)                            \
+  __op__(branches)                               \
+  __op__(taken_branches)                         \
+  __op__(branch_mispredictions)
+
+namespace Legion {
+  namespace Internal {
+
+    enum LegionProfInstanceIDs {
+#define LEGION_PROF_RECORD_ID(id, name) id,
+      LEGION_PROF_RECORD_KINDS(LEGION_PROF_RECORD_ID)
+#undef LEGION_PROF_RECORD_ID
+      LAST_LEGION_PROF_RECORD_ID
+    };
+
+    static const char *const legion_prof_record_names[] = {
+#define LEGION_PROF_RECORD_NAME(id, name) name,
+      LEGION_PROF_RECORD_KINDS(LEGION_PROF_RECORD_NAME)
+#undef LEGION_PROF_RECORD_NAME
+    };
+
+    // After the preamble the records are stored in chunks, each of
+    // which starts with a header:
+    //
+    //  <magic:u32> <flags:u32> <raw_size:u64> <stored_size:u64>
+    //  <start:u64> <stop:u64>
+    //
+    // followed by stored_size bytes of records which are zlib compressed
+    // if the LEGION_PROF_CHUNK_COMPRESSED flag is set. Start and stop
+    // bound the times of the timed records in the chunk (start > stop if
+    // there are none). The file ends with an index of the chunks:
+    //
+    //  <magic:u32> <count:u32>
+    //  (<offset:u64> <flags:u32> <start:u64> <stop:u64>)*
+    //  <index_offset:u64> <magic:u32>
+    //
+    // Each record in a chunk is an int record ID followed by its fields.
+    static const unsigned LEGION_PROF_CHUNK_MAGIC = 0x4b43504c; // "LPCK"
+    static const unsigned LEGION_PROF_INDEX_MAGIC = 0x5849504c; // "LPIX"
+    static const unsigned LEGION_PROF_CHUNK_COMPRESSED = 0x1;
+    // Set on chunks holding records without times (descriptions, kinds,
+    // etc.) which readers must load regardless of any time window. The
+    // binary serializer never mixes these with timed records in a chunk,
+    // but readers should not rely on that.
+    static const unsigned LEGION_PROF_CHUNK_METADATA = 0x2;
+    static const size_t LEGION_PROF_CHUNK_HEADER_SIZE =
+      2 * sizeof(unsigned) + 4 * sizeof(unsigned long long);
+    static const size_t LEGION_PROF_INDEX_ENTRY_SIZE =
+      sizeof(unsigned) + 3 * sizeof(unsigned long long);
+
+  }; // namespace Internal
+}; // namespace Legion
+
+#endif // __LEGION_PROFILING_FORMAT_H__
@@ -16,15 +16,94 @@ namespace Legion {
 
     //--------------------------------------------------------------------------
     LegionProfBinarySerializer::LegionProfBinarySerializer(std::string filename)
+      : timed_chunk(false/*metadata*/), metadata_chunk(true/*metadata*/),
+        current(&timed_chunk)
     //--------------------------------------------------------------------------
     {
-      f = lp_fopen(filename, "wb");
+      f = fopen(filename.c_str(), "wb");
       if (!f)
         REPORT_LEGION_ERROR(ERROR_INVALID_PROFILER_FILE,
             "Unable to open legion logfile %s for writing!", filename.c_str())
+      timed_chunk.data.reserve(CHUNK_SIZE + 4096);
+      metadata_chunk.data.reserve(CHUNK_SIZE + 4096);
       writePreamble();
     }
 
+    //--------------------------------------------------------------------------
+    void LegionProfBinarySerializer::begin_record(int ID, bool timed)
+    //--------------------------------------------------------------------------
+    {
+      current = timed ? &timed_chunk : &metadata_chunk;
+      // Chunks only ever hold whole records
+      if (current->data.size() >= CHUNK_SIZE)
+        flush_chunk(*current);
+      append(&ID, sizeof(ID));
+    }
+
+    //--------------------------------------------------------------------------
+    void LegionProfBinarySerializer::flush_chunk(Chunk &chunk)
+    //--------------------------------------------------------------------------
+    {
+      if (chunk.data.empty())
+        return;
+      unsigned flags = chunk.metadata ? LEGION_PROF_CHUNK_METADATA : 0;
+      const char *data = &chunk.data[0];
+      unsigned long long raw_size = chunk.data.size();
+      unsigned long long stored_size = raw_size;
+#ifdef USE_ZLIB
+      uLongf compressed_size = compressBound(raw_size);
+      if (compressed.size() < compressed_size)
+        compressed.resize(compressed_size);
+      if ((compress2((Bytef*)&compressed[0], &compressed_size,
+              (const Bytef*)data, raw_size, Z_BEST_SPEED) == Z_OK) &&
+          (compressed_size < raw_size))
+      {
+        flags |= LEGION_PROF_CHUNK_COMPRESSED;
+        data = &compressed[0];
+        stored_size = compressed_size;
+      }
+#endif
+      ChunkIndexEntry entry;
+      entry.offset = ftell(f);
+      entry.flags = flags;
+      entry.start = chunk.start;
+      entry.stop = chunk.stop;
+      chunk_index.push_back(entry);
+      fwrite(&LEGION_PROF_CHUNK_MAGIC, sizeof(LEGION_PROF_CHUNK_MAGIC), 1, f);
+      fwrite(&flags, sizeof(flags), 1, f);
+      fwrite(&raw_size, sizeof(raw_size), 1, f);
+      fwrite(&stored_size, sizeof(stored_size), 1, f);
+      fwrite(&chunk.start, sizeof(chunk.start), 1, f);
+      fwrite(&chunk.stop, sizeof(chunk.stop), 1, f);
+      fwrite(data, stored_size, 1, f);
+      chunk.data.clear();
+      chunk.start = ~0ULL;
+      chunk.stop = 0;
+    }
+
+    //--------------------------------------------------------------------------
+    void LegionProfBinarySerializer::write_index(void)
+    //--------------------------------------------------------------------------
+    {
+      // The index goes last followed by its own offset so readers can 
+      // find it by seeking to the end of the file, if it is missing 
+      // because the run died then they can still walk the chunks
+      unsigned long long index_offset = ftell(f);
+      unsigned count = chunk_index.size();
+      fwrite(&LEGION_PROF_INDEX_MAGIC, sizeof(LEGION_PROF_INDEX_MAGIC), 1, f);
+      fwrite(&count, sizeof(count), 1, f);
+      for (std::vector<ChunkIndexEntry>::const_iterator it = 
+            chunk_index.begin(); it != chunk_index.end(); it++)
+      {
+        fwrite(&(it->offset), sizeof(it->offset), 1, f);
+        fwrite(&(it->flags), sizeof(it->flags), 1, f);
+        fwrite(&(it->start), sizeof(it->start), 1, f);
+        fwrite(&(it->stop), sizeof(it->stop), 1, f);
+      }
+      fwrite(&index_offset, sizeof(index_offset), 1, f);
+      fwrite(&LEGION_PROF_INDEX_MAGIC, sizeof(LEGION_PROF_INDEX_MAGIC), 1, f);
+    }
+
     // Every legion prof instance that you want to serialize must be written 
     // in the preamble. The preamble defines the format that we'll use for 
     // the serialization.
@@ -37,93 +116,94 @@ namespace Legion {
     // This can easily be parsed using a regex parser
     //
     // The end of the preamble is indicated by an empty line. After this 
-    // empty line, the file will contain binary data
+    // empty line, the file will contain binary data as a sequence of chunks
+    // as described in legion_profiling_format.h.
     
     //--------------------------------------------------------------------------
     void LegionProfBinarySerializer::writePreamble() 
     //--------------------------------------------------------------------------
     {
       std::stringstream ss;
-      ss << "FileType: BinaryLegionProf v: 1.0" << std::endl;
+      ss << LEGION_PROF_BINARY_FILETYPE << std::endl;
 
       std::string delim = ", ";
 
-      ss << "MessageDesc {" 
+      ss << legion_prof_record_names[MESSAGE_DESC_ID] << " {"
          << "id:" << MESSAGE_DESC_ID                << delim
          << "kind:unsigned:"     << sizeof(unsigned) << delim
          << "name:string:" << "-1"
          << "}" << std::endl;
 
-      ss << "MapperCallDesc {" 
+      ss << legion_prof_record_names[MAPPER_CALL_DESC_ID] << " {"
          << "id:" << MAPPER_CALL_DESC_ID            << delim
          << "kind:unsigned:"     << sizeof(unsigned) << delim
          << "name:string:" << "-1"
          << "}" << std::endl;
 
-      ss << "RuntimeCallDesc {" 
+      ss << legion_prof_record_names[RUNTIME_CALL_DESC_ID] << " {"
          << "id:" << RUNTIME_CALL_DESC_ID           << delim
          << "kind:unsigned:"     << sizeof(unsigned) << delim
          << "name:string:" << "-1"
          << "}" << std::endl;
 
-      ss << "MetaDesc {" 
+      ss << legion_prof_record_names[META_DESC_ID] << " {"
          << "id:" << META_DESC_ID                   << delim
          << "kind:unsigned:"     << sizeof(unsigned) << delim
          << "name:string:" << "-1"
          << "}" << std::endl;
 
-      ss << "OpDesc {" 
+      ss << legion_prof_record_names[OP_DESC_ID] << " {"
          << "id:" << OP_DESC_ID                   << delim
          << "kind:unsigned:"   << sizeof(unsigned) << delim
          << "name:string:" << "-1"
          << "}" << std::endl;
 
-      ss << "ProcDesc {" 
+      ss << legion_prof_record_names[PROC_DESC_ID] << " {"
          << "id:" << PROC_DESC_ID                 << delim
          << "proc_id:ProcID:" << sizeof(ProcID)   << delim
          << "kind:ProcKind:"  << sizeof(ProcKind)
          << "}" << std::endl;
 
-      ss << "MemDesc {" 
+      ss << legion_prof_record_names[MEM_DESC_ID] << " {"
          << "id:" << MEM_DESC_ID                               << delim
          << "mem_id:MemID:"                << sizeof(MemID)    << delim
          << "kind:MemKind:"                << sizeof(MemKind)  << delim
          << "capacity:unsigned long long:" << sizeof(unsigned long long)
          << "}" << std::endl;
 
-      ss << "TaskKind {" 
+      ss << legion_prof_record_names[TASK_KIND_ID] << " {"
          << "id:" << TASK_KIND_ID                 << delim
          << "task_id:TaskID:"   << sizeof(TaskID) << delim
          << "name:string:"      << "-1"           << delim
          << "overwrite:bool:"   << sizeof(bool) 
          << "}" << std::endl;
 
-      ss << "TaskVariant {"
+      ss << legion_prof_record_names[TASK_VARIANT_ID] << " {"
          << "id:" << TASK_VARIANT_ID                     << delim
          << "task_id:TaskID:"       << sizeof(TaskID)    << delim
          << "variant_id:VariantID:" << sizeof(VariantID) << delim
          << "name:string:"          << "-1"
          << "}" << std::endl;
 
-      ss << "OperationInstance {"
+      ss << legion_prof_record_names[OPERATION_INSTANCE_ID] << " {"
          << "id:" << OPERATION_INSTANCE_ID        << delim
          << "op_id:UniqueID:" << sizeof(UniqueID) << delim
          << "kind:unsigned:"  << sizeof(unsigned)
          << "}" << std::endl;
 
-      ss << "MultiTask {"
+      ss << legion_prof_record_names[MULTI_TASK_ID] << " {"
          << "id:" << MULTI_TASK_ID                << delim
          << "op_id:UniqueID:" << sizeof(UniqueID) << delim
          << "task_id:TaskID:" << sizeof(TaskID)
          << "}" << std::endl;
 
-      ss << "SliceOwner {"
+      ss << legion_prof_record_names[SLICE_OWNER_ID] << " {"
          << "id:" << SLICE_OWNER_ID                   << delim
          << "parent_id:UniqueID:" << sizeof(UniqueID) << delim
          << "op_id:UniqueID:"     << sizeof(UniqueID)
          << "}" << std::endl;
 
-      ss << "TaskWaitInfo {"
+      ss << legion_prof_record_names[TASK_WAIT_INFO_ID] << " {"
          << "id:" << TASK_WAIT_INFO_ID                       << delim
          << "op_id:UniqueID:"         << sizeof(UniqueID)    << delim
          << "task_id:TaskID:"         << sizeof(TaskID)      << delim
@@ -133,7 +213,7 @@ namespace Legion {
          << "wait_end:timestamp_t:"   << sizeof(timestamp_t)
          << "}" << std::endl;
 
-      ss << "MetaWaitInfo {"
+      ss << legion_prof_record_names[META_WAIT_INFO_ID] << " {"
          << "id:" << META_WAIT_INFO_ID                       << delim
          << "op_id:UniqueID:"         << sizeof(UniqueID)    << delim
          << "lg_id:unsigned:"         << sizeof(unsigned)    << delim
@@ -142,7 +222,7 @@ namespace Legion {
          << "wait_end:timestamp_t:"   << sizeof(timestamp_t)
          << "}" << std::endl;
 
-      ss << "TaskInfo {"
+      ss << legion_prof_record_names[TASK_INFO_ID] << " {"
          << "id:" << TASK_INFO_ID                         << delim
          << "op_id:UniqueID:"      << sizeof(UniqueID)    << delim
          << "task_id:TaskID:"      << sizeof(TaskID)      << delim
@@ -154,7 +234,21 @@ namespace Legion {
          << "stop:timestamp_t:"    << sizeof(timestamp_t)
          << "}" << std::endl;
 
-      ss << "MetaInfo {"
+      ss << legion_prof_record_names[TASK_PERF_COUNTERS_ID] << " {"
+         << "id:" << TASK_PERF_COUNTERS_ID                << delim
+         << "op_id:UniqueID:"      << sizeof(UniqueID)    << delim
+         << "task_id:TaskID:"      << sizeof(TaskID)      << delim
+         << "variant_id:UniqueID:" << sizeof(UniqueID)    << delim
+         << "proc_id:ProcID:"      << sizeof(ProcID)      << delim
+         << "start:timestamp_t:"   << sizeof(timestamp_t) << delim
+         << "stop:timestamp_t:"    << sizeof(timestamp_t);
+#define LEGION_PROF_PERF_COUNTER_PREAMBLE(name) \
+      ss << delim << #name ":long long:" << sizeof(long long);
+      LEGION_PROF_PERF_COUNTERS(LEGION_PROF_PERF_COUNTER_PREAMBLE)
+#undef LEGION_PROF_PERF_COUNTER_PREAMBLE
+      ss << "}" << std::endl;
+
+      ss << legion_prof_record_names[META_INFO_ID] << " {"
          << "id:" << META_INFO_ID                         << delim
          << "op_id:UniqueID:"     << sizeof(UniqueID)     << delim
          << "lg_id:unsigned:"     << sizeof(unsigned)     << delim
@@ -165,7 +259,7 @@ namespace Legion {
          << "stop:timestamp_t:"   << sizeof(timestamp_t)
          << "}" << std::endl;
 
-      ss << "CopyInfo {"
+      ss << legion_prof_record_names[COPY_INFO_ID] << " {"
          << "id:" << COPY_INFO_ID                                    << delim
          << "op_id:UniqueID:"          << sizeof(UniqueID)           << delim
          << "src:MemID:"               << sizeof(MemID)              << delim
@@ -177,7 +271,7 @@ namespace Legion {
          << "stop:timestamp_t:"        << sizeof(timestamp_t)
          << "}" << std::endl;
 
-      ss << "FillInfo {"
+      ss << legion_prof_record_names[FILL_INFO_ID] << " {"
          << "id:" << FILL_INFO_ID                        << delim
          << "op_id:UniqueID:"     << sizeof(UniqueID)    << delim
          << "dst:MemID:"          << sizeof(MemID)       << delim
@@ -187,14 +281,14 @@ namespace Legion {
          << "stop:timestamp_t:"   << sizeof(timestamp_t)
          << "}" << std::endl;
 
-      ss << "InstCreateInfo {"
+      ss << legion_prof_record_names[INST_CREATE_INFO_ID] << " {"
          << "id:" << INST_CREATE_INFO_ID                 << delim
          << "op_id:UniqueID:"     << sizeof(UniqueID)    << delim
          << "inst_id:InstID:"     << sizeof(InstID)      << delim
          << "create:timestamp_t:" << sizeof(timestamp_t)
          << "}" << std::endl;
 
-      ss << "InstUsageInfo {"
+      ss << legion_prof_record_names[INST_USAGE_INFO_ID] << " {"
          << "id:" << INST_USAGE_INFO_ID                    << delim
          << "op_id:UniqueID:"          << sizeof(UniqueID) << delim
          << "inst_id:InstID:"          << sizeof(InstID)   << delim
@@ -202,7 +296,7 @@ namespace Legion {
          << "size:unsigned long long:" << sizeof(unsigned long long)
          << "}" << std::endl;
 
-      ss << "InstTimelineInfo {"
+      ss << legion_prof_record_names[INST_TIMELINE_INFO_ID] << " {"
          << "id:" << INST_TIMELINE_INFO_ID                << delim
          << "op_id:UniqueID:"      << sizeof(UniqueID)    << delim
          << "inst_id:InstID:"      << sizeof(InstID)      << delim
@@ -210,7 +304,7 @@ namespace Legion {
          << "destroy:timestamp_t:" << sizeof(timestamp_t)
          << "}" << std::endl;
 
-      ss << "PartitionInfo {"
+      ss << legion_prof_record_names[PARTITION_INFO_ID] << " {"
          << "id:" << PARTITION_INFO_ID                          << delim
          << "op_id:UniqueID:"         << sizeof(UniqueID)       << delim
          << "part_op:DepPartOpKind:"  << sizeof(DepPartOpKind)  << delim
@@ -220,7 +314,7 @@ namespace Legion {
          << "stop:timestamp_t:"       << sizeof(timestamp_t)
          << "}" << std::endl;
 
-      ss << "MessageInfo {"
+      ss << legion_prof_record_names[MESSAGE_INFO_ID] << " {"
          << "id:" << MESSAGE_INFO_ID                           << delim
          << "kind:MessageKind:"  << sizeof(MessageKind)        << delim
          << "start:timestamp_t:" << sizeof(timestamp_t)        << delim
@@ -228,7 +322,7 @@ namespace Legion {
          << "proc_id:ProcID:"    << sizeof(ProcID)
          << "}" << std::endl;
 
-      ss << "MapperCallInfo {"
+      ss << legion_prof_record_names[MAPPER_CALL_INFO_ID] << " {"
          << "id:" << MAPPER_CALL_INFO_ID                          << delim
          << "kind:MappingCallKind:" << sizeof(MappingCallKind)    << delim
          << "op_id:UniqueID:"       << sizeof(UniqueID)           << delim
@@ -237,7 +331,7 @@ namespace Legion {
          << "proc_id:ProcID:"       << sizeof(ProcID)
          << "}" << std::endl;
 
-      ss << "RuntimeCallInfo {"
+      ss << legion_prof_record_names[RUNTIME_CALL_INFO_ID] << " {"
          << "id:" << RUNTIME_CALL_INFO_ID                      << delim
          << "kind:RuntimeCallKind:" << sizeof(RuntimeCallKind) << delim
          << "start:timestamp_t:"    << sizeof(timestamp_t)     << delim
@@ -245,8 +339,20 @@ namespace Legion {
          << "proc_id:ProcID:"       << sizeof(ProcID)
          << "}" << std::endl;
 
+      ss << legion_prof_record_names[MESSAGE_SIZE_INFO_ID] << " {"
+         << "id:" << MESSAGE_SIZE_INFO_ID                         << delim
+         << "kind:MessageKind:"     << sizeof(MessageKind)        << delim
+         << "count:unsigned long long:"      
+                                    << sizeof(unsigned long long) << delim
+         << "bytes:unsigned long long:"      
+                                    << sizeof(unsigned long long) << delim
+         << "wire_bytes:unsigned long long:" 
+                                    << sizeof(unsigned long long) << delim
+         << "node:unsigned:"        << sizeof(AddressSpaceID)
+         << "}" << std::endl;
+
 #ifdef LEGION_PROF_SELF_PROFILE
-      ss << "ProfTaskInfo {"
+      ss << legion_prof_record_names[PROFTASK_INFO_ID] << " {"
          << "id:" << PROFTASK_INFO_ID                        << delim
          << "proc_id:ProcID:"         << sizeof(ProcID)      << delim
          << "op_id:UniqueID:"         << sizeof(UniqueID)    << delim
@@ -259,7 +365,7 @@ namespace Legion {
       ss << std::endl;
       std::string preamble = ss.str();
 
-      lp_fwrite(f, preamble.c_str(), strlen(preamble.c_str()));
+      fwrite(preamble.c_str(), preamble.size(), 1, f);
     }
 
 
@@ -269,10 +375,9 @@ namespace Legion {
     //--------------------------------------------------------------------------
     {
       // XXX: For now, we will assume little endian
-      int ID = MESSAGE_DESC_ID;
-      lp_fwrite(f, (char*)&ID, sizeof(ID));
-      lp_fwrite(f, (char*)&(message_desc.kind), sizeof(message_desc.kind));
-      lp_fwrite(f, message_desc.name, strlen(message_desc.name) + 1);
+      begin_record(MESSAGE_DESC_ID);
+      append((char*)&(message_desc.kind), sizeof(message_desc.kind));
+      append(message_desc.name, strlen(message_desc.name) + 1);
     }
 
     //--------------------------------------------------------------------------
@@ -280,10 +385,9 @@ namespace Legion {
                          const LegionProfDesc::MapperCallDesc &mapper_call_desc)
     //--------------------------------------------------------------------------
     {
-      int ID = MAPPER_CALL_DESC_ID;
-      lp_fwrite(f, (char*)&ID, sizeof(ID));
-      lp_fwrite(f, (char*)&(mapper_call_desc.kind), sizeof(mapper_call_desc.kind));
-      lp_fwrite(f, mapper_call_desc.name, strlen(mapper_call_desc.name) + 1);
+      begin_record(MAPPER_CALL_DESC_ID);
+      append((char*)&(mapper_call_desc.kind), sizeof(mapper_call_desc.kind));
+      append(mapper_call_desc.name, strlen(mapper_call_desc.name) + 1);
     }
 
     //--------------------------------------------------------------------------
@@ -291,11 +395,10 @@ namespace Legion {
                        const LegionProfDesc::RuntimeCallDesc &runtime_call_desc)
     //--------------------------------------------------------------------------
     {
-      int ID = RUNTIME_CALL_DESC_ID;
-      lp_fwrite(f, (char*)&ID, sizeof(ID));
-      lp_fwrite(f, (char*)&(runtime_call_desc.kind), 
+      begin_record(RUNTIME_CALL_DESC_ID);
+      append((char*)&(runtime_call_desc.kind), 
                 sizeof(runtime_call_desc.kind));
-      lp_fwrite(f, runtime_call_desc.name, strlen(runtime_call_desc.name) + 1);
+      append(runtime_call_desc.name, strlen(runtime_call_desc.name) + 1);
     }
 
     //--------------------------------------------------------------------------
@@ -303,10 +406,9 @@ namespace Legion {
                                       const LegionProfDesc::MetaDesc& meta_desc)
     //--------------------------------------------------------------------------
     {
-      int ID = META_DESC_ID;
-      lp_fwrite(f, (char*)&ID, sizeof(ID));
-      lp_fwrite(f, (char*)&(meta_desc.kind), sizeof(meta_desc.kind));
-      lp_fwrite(f, meta_desc.name, strlen(meta_desc.name) + 1);
+      begin_record(META_DESC_ID);
+      append((char*)&(meta_desc.kind), sizeof(meta_desc.kind));
+      append(meta_desc.name, strlen(meta_desc.name) + 1);
     }
 
     //--------------------------------------------------------------------------
@@ -314,10 +416,9 @@ namespace Legion {
                                           const LegionProfDesc::OpDesc& op_desc)
     //--------------------------------------------------------------------------
     {
-      int ID = OP_DESC_ID;
-      lp_fwrite(f, (char*)&ID, sizeof(ID));
-      lp_fwrite(f, (char*)&(op_desc.kind), sizeof(op_desc.kind));
-      lp_fwrite(f, op_desc.name, strlen(op_desc.name) + 1);
+      begin_record(OP_DESC_ID);
+      append((char*)&(op_desc.kind), sizeof(op_desc.kind));
+      append(op_desc.name, strlen(op_desc.name) + 1);
     }
 
     //--------------------------------------------------------------------------
@@ -325,10 +426,9 @@ namespace Legion {
                                       const LegionProfDesc::ProcDesc& proc_desc)
     //--------------------------------------------------------------------------
     {
-      int ID = PROC_DESC_ID;
-      lp_fwrite(f, (char*)&ID, sizeof(ID));
-      lp_fwrite(f, (char*)&(proc_desc.proc_id), sizeof(proc_desc.proc_id));
-      lp_fwrite(f, (char*)&(proc_desc.kind),    sizeof(proc_desc.kind));
+      begin_record(PROC_DESC_ID);
+      append((char*)&(proc_desc.proc_id), sizeof(proc_desc.proc_id));
+      append((char*)&(proc_desc.kind),    sizeof(proc_desc.kind));
     }
 
     //--------------------------------------------------------------------------
@@ -336,11 +436,10 @@ namespace Legion {
                                         const LegionProfDesc::MemDesc& mem_desc)
     //--------------------------------------------------------------------------
     {
-      int ID = MEM_DESC_ID;
-      lp_fwrite(f, (char*)&ID, sizeof(ID));
-      lp_fwrite(f, (char*)&(mem_desc.mem_id),   sizeof(mem_desc.mem_id));
-      lp_fwrite(f, (char*)&(mem_desc.kind),     sizeof(mem_desc.kind));
-      lp_fwrite(f, (char*)&(mem_desc.capacity), sizeof(mem_desc.capacity));
+      begin_record(MEM_DESC_ID);
+      append((char*)&(mem_desc.mem_id),   sizeof(mem_desc.mem_id));
+      append((char*)&(mem_desc.kind),     sizeof(mem_desc.kind));
+      append((char*)&(mem_desc.capacity), sizeof(mem_desc.capacity));
     }
 
     // Serialize Methods
@@ -350,11 +449,10 @@ namespace Legion {
                                   const LegionProfInstance::TaskKind& task_kind)
     //--------------------------------------------------------------------------
     {
-      int ID = TASK_KIND_ID;
-      lp_fwrite(f, (char*)&ID, sizeof(ID));
-      lp_fwrite(f, (char*)&(task_kind.task_id), sizeof(task_kind.task_id));
-      lp_fwrite(f, task_kind.name, strlen(task_kind.name) + 1);
-      lp_fwrite(f, (char*)&(task_kind.overwrite), sizeof(task_kind.overwrite));
+      begin_record(TASK_KIND_ID);
+      append((char*)&(task_kind.task_id), sizeof(task_kind.task_id));
+      append(task_kind.name, strlen(task_kind.name) + 1);
+      append((char*)&(task_kind.overwrite), sizeof(task_kind.overwrite));
     }
 
     //--------------------------------------------------------------------------
@@ -362,12 +460,11 @@ namespace Legion {
                             const LegionProfInstance::TaskVariant& task_variant)
     //--------------------------------------------------------------------------
     {
-      int ID = TASK_VARIANT_ID;
-      lp_fwrite(f, (char*)&ID, sizeof(ID));
-      lp_fwrite(f, (char*)&(task_variant.task_id),sizeof(task_variant.task_id));
-      lp_fwrite(f, (char*)&(task_variant.variant_id), 
+      begin_record(TASK_VARIANT_ID);
+      append((char*)&(task_variant.task_id),sizeof(task_variant.task_id));
+      append((char*)&(task_variant.variant_id), 
                 sizeof(task_variant.variant_id));
-      lp_fwrite(f, task_variant.name, strlen(task_variant.name) + 1);
+      append(task_variant.name, strlen(task_variant.name) + 1);
     }
 
     //--------------------------------------------------------------------------
@@ -375,11 +472,10 @@ namespace Legion {
                 const LegionProfInstance::OperationInstance& operation_instance)
     //--------------------------------------------------------------------------
     {
-      int ID = OPERATION_INSTANCE_ID;
-      lp_fwrite(f, (char*)&ID, sizeof(ID));
-      lp_fwrite(f, (char*)&(operation_instance.op_id), 
+      begin_record(OPERATION_INSTANCE_ID);
+      append((char*)&(operation_instance.op_id), 
                 sizeof(operation_instance.op_id));
-      lp_fwrite(f, (char*)&(operation_instance.kind),
+      append((char*)&(operation_instance.kind),
                 sizeof(operation_instance.kind));
     }
 
@@ -388,10 +484,9 @@ namespace Legion {
                                 const LegionProfInstance::MultiTask& multi_task)
     //--------------------------------------------------------------------------
     {
-      int ID = MULTI_TASK_ID;
-      lp_fwrite(f, (char*)&ID, sizeof(ID));
-      lp_fwrite(f, (char*)&(multi_task.op_id),   sizeof(multi_task.op_id));
-      lp_fwrite(f, (char*)&(multi_task.task_id), sizeof(multi_task.task_id));
+      begin_record(MULTI_TASK_ID);
+      append((char*)&(multi_task.op_id),   sizeof(multi_task.op_id));
+      append((char*)&(multi_task.task_id), sizeof(multi_task.task_id));
     }
 
     //--------------------------------------------------------------------------
@@ -399,11 +494,10 @@ namespace Legion {
                               const LegionProfInstance::SliceOwner& slice_owner)
     //--------------------------------------------------------------------------
     {
-      int ID = SLICE_OWNER_ID;
-      lp_fwrite(f, (char*)&ID, sizeof(ID));
-      lp_fwrite(f, (char*)&(slice_owner.parent_id), 
+      begin_record(SLICE_OWNER_ID);
+      append((char*)&(slice_owner.parent_id), 
                 sizeof(slice_owner.parent_id));
-      lp_fwrite(f, (char*)&(slice_owner.op_id), sizeof(slice_owner.op_id));
+      append((char*)&(slice_owner.op_id), sizeof(slice_owner.op_id));
     }
 
     //--------------------------------------------------------------------------
@@ -412,14 +506,14 @@ namespace Legion {
                                   const LegionProfInstance::TaskInfo& task_info)
     //--------------------------------------------------------------------------
     {
-      int ID = TASK_WAIT_INFO_ID;
-      lp_fwrite(f, (char*)&ID, sizeof(ID));
-      lp_fwrite(f, (char*)&(task_info.op_id),     sizeof(task_info.op_id));
-      lp_fwrite(f, (char*)&(task_info.task_id),   sizeof(task_info.task_id));
-      lp_fwrite(f, (char*)&(task_info.variant_id),sizeof(task_info.variant_id));
-      lp_fwrite(f, (char*)&(wait_info.wait_start),sizeof(wait_info.wait_start));
-      lp_fwrite(f, (char*)&(wait_info.wait_ready),sizeof(wait_info.wait_ready));
-      lp_fwrite(f, (char*)&(wait_info.wait_end),  sizeof(wait_info.wait_end));
+      begin_record(TASK_WAIT_INFO_ID, true/*timed*/);
+      note_time(wait_info.wait_start, wait_info.wait_end);
+      append((char*)&(task_info.op_id),     sizeof(task_info.op_id));
+      append((char*)&(task_info.task_id),   sizeof(task_info.task_id));
+      append((char*)&(task_info.variant_id),sizeof(task_info.variant_id));
+      append((char*)&(wait_info.wait_start),sizeof(wait_info.wait_start));
+      append((char*)&(wait_info.wait_ready),sizeof(wait_info.wait_ready));
+      append((char*)&(wait_info.wait_end),  sizeof(wait_info.wait_end));
     }
 
     //--------------------------------------------------------------------------
@@ -428,13 +522,13 @@ namespace Legion {
                                   const LegionProfInstance::MetaInfo& meta_info)
     //--------------------------------------------------------------------------
     {
-      int ID = META_WAIT_INFO_ID;
-      lp_fwrite(f, (char*)&ID, sizeof(ID));
-      lp_fwrite(f, (char*)&(meta_info.op_id),     sizeof(meta_info.op_id));
-      lp_fwrite(f, (char*)&(meta_info.lg_id),     sizeof(meta_info.lg_id));
-      lp_fwrite(f, (char*)&(wait_info.wait_start),sizeof(wait_info.wait_start));
-      lp_fwrite(f, (char*)&(wait_info.wait_ready),sizeof(wait_info.wait_ready));
-      lp_fwrite(f, (char*)&(wait_info.wait_end),  sizeof(wait_info.wait_end));
+      begin_record(META_WAIT_INFO_ID, true/*timed*/);
+      note_time(wait_info.wait_start, wait_info.wait_end);
+      append((char*)&(meta_info.op_id),     sizeof(meta_info.op_id));
+      append((char*)&(meta_info.lg_id),     sizeof(meta_info.lg_id));
+      append((char*)&(wait_info.wait_start),sizeof(wait_info.wait_start));
+      append((char*)&(wait_info.wait_ready),sizeof(wait_info.wait_ready));
+      append((char*)&(wait_info.wait_end),  sizeof(wait_info.wait_end));
     }
  
     //--------------------------------------------------------------------------
@@ -442,16 +536,36 @@ namespace Legion {
                                   const LegionProfInstance::TaskInfo& task_info)
     //--------------------------------------------------------------------------
     {
-      int ID = TASK_INFO_ID;
-      lp_fwrite(f, (char*)&ID, sizeof(ID));
-      lp_fwrite(f, (char*)&(task_info.op_id),     sizeof(task_info.op_id));
-      lp_fwrite(f, (char*)&(task_info.task_id),   sizeof(task_info.task_id));
-      lp_fwrite(f, (char*)&(task_info.variant_id),sizeof(task_info.variant_id));
-      lp_fwrite(f, (char*)&(task_info.proc_id),   sizeof(task_info.proc_id));
-      lp_fwrite(f, (char*)&(task_info.create),    sizeof(task_info.create));
-      lp_fwrite(f, (char*)&(task_info.ready),     sizeof(task_info.ready));
-      lp_fwrite(f, (char*)&(task_info.start),     sizeof(task_info.start));
-      lp_fwrite(f, (char*)&(task_info.stop),      sizeof(task_info.stop));
+      begin_record(TASK_INFO_ID, true/*timed*/);
+      note_time(task_info.start, task_info.stop);
+      append((char*)&(task_info.op_id),     sizeof(task_info.op_id));
+      append((char*)&(task_info.task_id),   sizeof(task_info.task_id));
+      append((char*)&(task_info.variant_id),sizeof(task_info.variant_id));
+      append((char*)&(task_info.proc_id),   sizeof(task_info.proc_id));
+      append((char*)&(task_info.create),    sizeof(task_info.create));
+      append((char*)&(task_info.ready),     sizeof(task_info.ready));
+      append((char*)&(task_info.start),     sizeof(task_info.start));
+      append((char*)&(task_info.stop),      sizeof(task_info.stop));
+    }
+
+    //--------------------------------------------------------------------------
+    void LegionProfBinarySerializer::serialize(
+                    const LegionProfInstance::TaskPerfCounters& perf_counters)
+    //--------------------------------------------------------------------------
+    {
+      begin_record(TASK_PERF_COUNTERS_ID, true/*timed*/);
+      note_time(perf_counters.start, perf_counters.stop);
+      append((char*)&(perf_counters.op_id),     sizeof(perf_counters.op_id));
+      append((char*)&(perf_counters.task_id),   sizeof(perf_counters.task_id));
+      append((char*)&(perf_counters.variant_id),
+                sizeof(perf_counters.variant_id));
+      append((char*)&(perf_counters.proc_id),   sizeof(perf_counters.proc_id));
+      append((char*)&(perf_counters.start),     sizeof(perf_counters.start));
+      append((char*)&(perf_counters.stop),      sizeof(perf_counters.stop));
+#define LEGION_PROF_PERF_COUNTER_APPEND(name) \
+      append((char*)&(perf_counters.name), sizeof(perf_counters.name));
+      LEGION_PROF_PERF_COUNTERS(LEGION_PROF_PERF_COUNTER_APPEND)
+#undef LEGION_PROF_PERF_COUNTER_APPEND
     }
 
     //--------------------------------------------------------------------------
@@ -459,15 +573,15 @@ namespace Legion {
                                   const LegionProfInstance::MetaInfo& meta_info)
     //--------------------------------------------------------------------------
     {
-      int ID = META_INFO_ID;
-      lp_fwrite(f, (char*)&ID, sizeof(ID));
-      lp_fwrite(f, (char*)&(meta_info.op_id),   sizeof(meta_info.op_id));
-      lp_fwrite(f, (char*)&(meta_info.lg_id),   sizeof(meta_info.lg_id));
-      lp_fwrite(f, (char*)&(meta_info.proc_id), sizeof(meta_info.proc_id));
-      lp_fwrite(f, (char*)&(meta_info.create),  sizeof(meta_info.create));
-      lp_fwrite(f, (char*)&(meta_info.ready),   sizeof(meta_info.ready));
-      lp_fwrite(f, (char*)&(meta_info.start),   sizeof(meta_info.start));
-      lp_fwrite(f, (char*)&(meta_info.stop),    sizeof(meta_info.stop));
+      begin_record(META_INFO_ID, true/*timed*/);
+      note_time(meta_info.start, meta_info.stop);
+      append((char*)&(meta_info.op_id),   sizeof(meta_info.op_id));
+      append((char*)&(meta_info.lg_id),   sizeof(meta_info.lg_id));
+      append((char*)&(meta_info.proc_id), sizeof(meta_info.proc_id));
+      append((char*)&(meta_info.create),  sizeof(meta_info.create));
+      append((char*)&(meta_info.ready),   sizeof(meta_info.ready));
+      append((char*)&(meta_info.start),   sizeof(meta_info.start));
+      append((char*)&(meta_info.stop),    sizeof(meta_info.stop));
     }
 
     //--------------------------------------------------------------------------
@@ -475,17 +589,17 @@ namespace Legion {
                                   const LegionProfInstance::CopyInfo& copy_info)
     //--------------------------------------------------------------------------
     {
-      int ID = COPY_INFO_ID;
-      lp_fwrite(f, (char*)&ID, sizeof(ID));
-
-      lp_fwrite(f, (char*)&(copy_info.op_id),  sizeof(copy_info.op_id));
-      lp_fwrite(f, (char*)&(copy_info.src),    sizeof(copy_info.src));
-      lp_fwrite(f, (char*)&(copy_info.dst),    sizeof(copy_info.dst));
-      lp_fwrite(f, (char*)&(copy_info.size),   sizeof(copy_info.size));
-      lp_fwrite(f, (char*)&(copy_info.create), sizeof(copy_info.create));
-      lp_fwrite(f, (char*)&(copy_info.ready),  sizeof(copy_info.ready));
-      lp_fwrite(f, (char*)&(copy_info.start),  sizeof(copy_info.start));
-      lp_fwrite(f, (char*)&(copy_info.stop),   sizeof(copy_info.stop));
+      begin_record(COPY_INFO_ID, true/*timed*/);
+      note_time(copy_info.start, copy_info.stop);
+
+      append((char*)&(copy_info.op_id),  sizeof(copy_info.op_id));
+      append((char*)&(copy_info.src),    sizeof(copy_info.src));
+      append((char*)&(copy_info.dst),    sizeof(copy_info.dst));
+      append((char*)&(copy_info.size),   sizeof(copy_info.size));
+      append((char*)&(copy_info.create), sizeof(copy_info.create));
+      append((char*)&(copy_info.ready),  sizeof(copy_info.ready));
+      append((char*)&(copy_info.start),  sizeof(copy_info.start));
+      append((char*)&(copy_info.stop),   sizeof(copy_info.stop));
     }
 
     //--------------------------------------------------------------------------
@@ -493,15 +607,15 @@ namespace Legion {
                                   const LegionProfInstance::FillInfo& fill_info)
     //--------------------------------------------------------------------------
     {
-      int ID = FILL_INFO_ID;
-      lp_fwrite(f, (char*)&ID, sizeof(ID));
-
-      lp_fwrite(f, (char*)&(fill_info.op_id),  sizeof(fill_info.op_id));
-      lp_fwrite(f, (char*)&(fill_info.dst),    sizeof(fill_info.dst));
-      lp_fwrite(f, (char*)&(fill_info.create), sizeof(fill_info.create));
-      lp_fwrite(f, (char*)&(fill_info.ready),  sizeof(fill_info.ready));
-      lp_fwrite(f, (char*)&(fill_info.start),  sizeof(fill_info.start));
-      lp_fwrite(f, (char*)&(fill_info.stop),   sizeof(fill_info.stop));
+      begin_record(FILL_INFO_ID, true/*timed*/);
+      note_time(fill_info.start, fill_info.stop);
+
+      append((char*)&(fill_info.op_id),  sizeof(fill_info.op_id));
+      append((char*)&(fill_info.dst),    sizeof(fill_info.dst));
+      append((char*)&(fill_info.create), sizeof(fill_info.create));
+      append((char*)&(fill_info.ready),  sizeof(fill_info.ready));
+      append((char*)&(fill_info.start),  sizeof(fill_info.start));
+      append((char*)&(fill_info.stop),   sizeof(fill_info.stop));
     }
 
     //--------------------------------------------------------------------------
@@ -509,13 +623,12 @@ namespace Legion {
                      const LegionProfInstance::InstCreateInfo& inst_create_info)
     //--------------------------------------------------------------------------
     {
-      int ID = INST_CREATE_INFO_ID;
-      lp_fwrite(f, (char*)&ID, sizeof(ID));
-      lp_fwrite(f, (char*)&(inst_create_info.op_id),   
+      begin_record(INST_CREATE_INFO_ID);
+      append((char*)&(inst_create_info.op_id),   
                 sizeof(inst_create_info.op_id));
-      lp_fwrite(f, (char*)&(inst_create_info.inst_id), 
+      append((char*)&(inst_create_info.inst_id), 
                 sizeof(inst_create_info.inst_id));
-      lp_fwrite(f, (char*)&(inst_create_info.create),  
+      append((char*)&(inst_create_info.create),  
                 sizeof(inst_create_info.create));
     }
 
@@ -524,15 +637,14 @@ namespace Legion {
                        const LegionProfInstance::InstUsageInfo& inst_usage_info)
     //--------------------------------------------------------------------------
     {
-      int ID = INST_USAGE_INFO_ID;
-      lp_fwrite(f, (char*)&ID, sizeof(ID));
-      lp_fwrite(f, (char*)&(inst_usage_info.op_id),   
+      begin_record(INST_USAGE_INFO_ID);
+      append((char*)&(inst_usage_info.op_id),   
                 sizeof(inst_usage_info.op_id));
-      lp_fwrite(f, (char*)&(inst_usage_info.inst_id), 
+      append((char*)&(inst_usage_info.inst_id), 
                 sizeof(inst_usage_info.inst_id));
-      lp_fwrite(f, (char*)&(inst_usage_info.mem_id),  
+      append((char*)&(inst_usage_info.mem_id),  
                 sizeof(inst_usage_info.mem_id));
-      lp_fwrite(f, (char*)&(inst_usage_info.size),    
+      append((char*)&(inst_usage_info.size),    
                 sizeof(inst_usage_info.size));
     }
 
@@ -541,15 +653,15 @@ namespace Legion {
                  const LegionProfInstance::InstTimelineInfo& inst_timeline_info)
     //--------------------------------------------------------------------------
     {
-      int ID = INST_TIMELINE_INFO_ID;
-      lp_fwrite(f, (char*)&ID, sizeof(ID));
-      lp_fwrite(f, (char*)&(inst_timeline_info.op_id),   
+      begin_record(INST_TIMELINE_INFO_ID, true/*timed*/);
+      note_time(inst_timeline_info.create, inst_timeline_info.destroy);
+      append((char*)&(inst_timeline_info.op_id),   
                 sizeof(inst_timeline_info.op_id));
-      lp_fwrite(f, (char*)&(inst_timeline_info.inst_id), 
+      append((char*)&(inst_timeline_info.inst_id), 
                 sizeof(inst_timeline_info.inst_id));
-      lp_fwrite(f, (char*)&(inst_timeline_info.create),  
+      append((char*)&(inst_timeline_info.create),  
                 sizeof(inst_timeline_info.create));
-      lp_fwrite(f, (char*)&(inst_timeline_info.destroy), 
+      append((char*)&(inst_timeline_info.destroy), 
                 sizeof(inst_timeline_info.destroy));
     }
 
@@ -558,19 +670,19 @@ namespace Legion {
                         const LegionProfInstance::PartitionInfo& partition_info)
     //--------------------------------------------------------------------------
     {
-      int ID = PARTITION_INFO_ID;
-      lp_fwrite(f, (char*)&ID, sizeof(ID));
-      lp_fwrite(f, (char*)&(partition_info.op_id),
+      begin_record(PARTITION_INFO_ID, true/*timed*/);
+      note_time(partition_info.start, partition_info.stop);
+      append((char*)&(partition_info.op_id),
                 sizeof(partition_info.op_id));
-      lp_fwrite(f, (char*)&(partition_info.part_op),
+      append((char*)&(partition_info.part_op),
                 sizeof(partition_info.part_op));
-      lp_fwrite(f, (char*)&(partition_info.create),
+      append((char*)&(partition_info.create),
                 sizeof(partition_info.create));
-      lp_fwrite(f, (char*)&(partition_info.ready),
+      append((char*)&(partition_info.ready),
                 sizeof(partition_info.ready));
-      lp_fwrite(f, (char*)&(partition_info.start),
+      append((char*)&(partition_info.start),
                 sizeof(partition_info.start));
-      lp_fwrite(f, (char*)&(partition_info.stop),
+      append((char*)&(partition_info.stop),
                 sizeof(partition_info.stop));
     }
 
@@ -579,12 +691,12 @@ namespace Legion {
                             const LegionProfInstance::MessageInfo& message_info)
     //--------------------------------------------------------------------------
     {
-      int ID = MESSAGE_INFO_ID;
-      lp_fwrite(f, (char*)&ID, sizeof(ID));
-      lp_fwrite(f, (char*)&(message_info.kind),   sizeof(message_info.kind));
-      lp_fwrite(f, (char*)&(message_info.start),  sizeof(message_info.start));
-      lp_fwrite(f, (char*)&(message_info.stop),   sizeof(message_info.stop));
-      lp_fwrite(f, (char*)&(message_info.proc_id),sizeof(message_info.proc_id));
+      begin_record(MESSAGE_INFO_ID, true/*timed*/);
+      note_time(message_info.start, message_info.stop);
+      append((char*)&(message_info.kind),   sizeof(message_info.kind));
+      append((char*)&(message_info.start),  sizeof(message_info.start));
+      append((char*)&(message_info.stop),   sizeof(message_info.stop));
+      append((char*)&(message_info.proc_id),sizeof(message_info.proc_id));
     }
 
     //--------------------------------------------------------------------------
@@ -592,17 +704,17 @@ namespace Legion {
                      const LegionProfInstance::MapperCallInfo& mapper_call_info)
     //--------------------------------------------------------------------------
     {
-      int ID = MAPPER_CALL_INFO_ID;
-      lp_fwrite(f, (char*)&ID, sizeof(ID));
-      lp_fwrite(f, (char*)&(mapper_call_info.kind),    
+      begin_record(MAPPER_CALL_INFO_ID, true/*timed*/);
+      note_time(mapper_call_info.start, mapper_call_info.stop);
+      append((char*)&(mapper_call_info.kind),    
                 sizeof(mapper_call_info.kind));
-      lp_fwrite(f, (char*)&(mapper_call_info.op_id),   
+      append((char*)&(mapper_call_info.op_id),   
                 sizeof(mapper_call_info.op_id));
-      lp_fwrite(f, (char*)&(mapper_call_info.start),   
+      append((char*)&(mapper_call_info.start),   
                 sizeof(mapper_call_info.start));
-      lp_fwrite(f, (char*)&(mapper_call_info.stop),    
+      append((char*)&(mapper_call_info.stop),    
                 sizeof(mapper_call_info.stop));
-      lp_fwrite(f, (char*)&(mapper_call_info.proc_id), 
+      append((char*)&(mapper_call_info.proc_id), 
                 sizeof(mapper_call_info.proc_id));
     }
 
@@ -611,31 +723,49 @@ namespace Legion {
                    const LegionProfInstance::RuntimeCallInfo& runtime_call_info)
     //--------------------------------------------------------------------------
     {
-      int ID = RUNTIME_CALL_INFO_ID;
-      lp_fwrite(f, (char*)&ID, sizeof(ID));
-      lp_fwrite(f, (char*)&(runtime_call_info.kind),    
+      begin_record(RUNTIME_CALL_INFO_ID, true/*timed*/);
+      note_time(runtime_call_info.start, runtime_call_info.stop);
+      append((char*)&(runtime_call_info.kind),    
                 sizeof(runtime_call_info.kind));
-      lp_fwrite(f, (char*)&(runtime_call_info.start),   
+      append((char*)&(runtime_call_info.start),   
                 sizeof(runtime_call_info.start));
-      lp_fwrite(f, (char*)&(runtime_call_info.stop),    
+      append((char*)&(runtime_call_info.stop),    
                 sizeof(runtime_call_info.stop));
-      lp_fwrite(f, (char*)&(runtime_call_info.proc_id), 
+      append((char*)&(runtime_call_info.proc_id), 
                 sizeof(runtime_call_info.proc_id));
     }
 
+    //--------------------------------------------------------------------------
+    void LegionProfBinarySerializer::serialize(
+                   const LegionProfInstance::MessageSizeInfo& message_size_info)
+    //--------------------------------------------------------------------------
+    {
+      begin_record(MESSAGE_SIZE_INFO_ID);
+      append((char*)&(message_size_info.kind),
+                sizeof(message_size_info.kind));
+      append((char*)&(message_size_info.count),
+                sizeof(message_size_info.count));
+      append((char*)&(message_size_info.bytes),
+                sizeof(message_size_info.bytes));
+      append((char*)&(message_size_info.wire_bytes),
+                sizeof(message_size_info.wire_bytes));
+      append((char*)&(message_size_info.node),
+                sizeof(message_size_info.node));
+    }
+
 #ifdef LEGION_PROF_SELF_PROFILE
     //--------------------------------------------------------------------------
     void LegionProfBinarySerializer::serialize(
                           const LegionProfInstance::ProfTaskInfo& proftask_info)
     //--------------------------------------------------------------------------
     {
-      int ID = PROFTASK_INFO_ID;
-      lp_fwrite(f, (char*)&ID, sizeof(ID));
-      lp_fwrite(f, (char*)&(proftask_info.proc_id), 
+      begin_record(PROFTASK_INFO_ID, true/*timed*/);
+      note_time(proftask_info.start, proftask_info.stop);
+      append((char*)&(proftask_info.proc_id), 
                 sizeof(proftask_info.proc_id));
-      lp_fwrite(f, (char*)&(proftask_info.op_id), sizeof(proftask_info.op_id));
-      lp_fwrite(f, (char*)&(proftask_info.start), sizeof(proftask_info.start));
-      lp_fwrite(f, (char*)&(proftask_info.stop),  sizeof(proftask_info.stop));
+      append((char*)&(proftask_info.op_id), sizeof(proftask_info.op_id));
+      append((char*)&(proftask_info.start), sizeof(proftask_info.start));
+      append((char*)&(proftask_info.stop),  sizeof(proftask_info.stop));
     }
 #endif
 
@@ -643,8 +773,10 @@ namespace Legion {
     LegionProfBinarySerializer::~LegionProfBinarySerializer()
     //--------------------------------------------------------------------------
     {
-      lp_fflush(f, Z_FULL_FLUSH);
-      lp_fclose(f);
+      flush_chunk(metadata_chunk);
+      flush_chunk(timed_chunk);
+      write_index();
+      fclose(f);
     }
 
 
@@ -797,6 +929,23 @@ namespace Legion {
                      task_info.start, task_info.stop);
     }
 
+    //--------------------------------------------------------------------------
+    void LegionProfASCIISerializer::serialize(
+                    const LegionProfInstance::TaskPerfCounters& perf_counters)
+    //--------------------------------------------------------------------------
+    {
+#define LEGION_PROF_PERF_COUNTER_FORMAT(name) " %lld"
+#define LEGION_PROF_PERF_COUNTER_ARG(name) , perf_counters.name
+      log_prof.print("Prof Task Perf Counters %llu %u %lu " IDFMT " %llu %llu"
+                     LEGION_PROF_PERF_COUNTERS(LEGION_PROF_PERF_COUNTER_FORMAT),
+                     perf_counters.op_id, perf_counters.task_id, 
+                     perf_counters.variant_id, perf_counters.proc_id, 
+                     perf_counters.start, perf_counters.stop
+                     LEGION_PROF_PERF_COUNTERS(LEGION_PROF_PERF_COUNTER_ARG));
+#undef LEGION_PROF_PERF_COUNTER_FORMAT
+#undef LEGION_PROF_PERF_COUNTER_ARG
+    }
+
     //--------------------------------------------------------------------------
     void LegionProfASCIISerializer::serialize(
                                   const LegionProfInstance::MetaInfo& meta_info)
@@ -899,6 +1048,17 @@ namespace Legion {
                      runtime_call_info.start, runtime_call_info.stop);
     }
 
+    //--------------------------------------------------------------------------
+    void LegionProfASCIISerializer::serialize(
+                   const LegionProfInstance::MessageSizeInfo& message_size_info)
+    //--------------------------------------------------------------------------
+    {
+      log_prof.print("Prof Message Size Info %u %llu %llu %llu %u",
+                     message_size_info.kind, message_size_info.count,
+                     message_size_info.bytes, message_size_info.wire_bytes,
+                     message_size_info.node);
+    }
+
 #ifdef LEGION_PROF_SELF_PROFILE
     //--------------------------------------------------------------------------
     void LegionProfASCIISerializer::serialize(
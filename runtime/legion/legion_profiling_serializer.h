@@ -16,22 +16,13 @@
 #define __LEGION_PROFILING_SERIALIZER_H__
 
 #include <string>
+#include <vector>
 #include <stdio.h>
 #include "legion/legion_profiling.h"
+#include "legion/legion_profiling_format.h"
 
 #ifdef USE_ZLIB
 #include <zlib.h>
-// lp_fopen expects filename to be a std::string
-#define lp_fopen(filename, mode)      gzopen(filename.c_str(),mode)
-#define lp_fwrite(f, data, num_bytes) gzwrite(f,data,num_bytes)
-#define lp_fflush(f, mode)            gzflush(f,mode)
-#define lp_fclose(f)                  gzclose(f)
-#else
-// lp_fopen expects filename to be a std::string
-#define lp_fopen(filename, mode)      fopen(filename.c_str(),mode)
-#define lp_fwrite(f, data, num_bytes) fwrite(data,num_bytes,1,f)
-#define lp_fflush(f, mode)            fflush(f)
-#define lp_fclose(f)                  fclose(f)
 #endif
 
 namespace Legion {
@@ -60,6 +51,7 @@ namespace Legion {
       virtual void serialize(const LegionProfInstance::WaitInfo, 
                              const LegionProfInstance::MetaInfo&) = 0;
       virtual void serialize(const LegionProfInstance::TaskInfo&) = 0;
+      virtual void serialize(const LegionProfInstance::TaskPerfCounters&) = 0;
       virtual void serialize(const LegionProfInstance::MetaInfo&) = 0;
       virtual void serialize(const LegionProfInstance::CopyInfo&) = 0;
       virtual void serialize(const LegionProfInstance::FillInfo&) = 0;
@@ -70,6 +62,7 @@ namespace Legion {
       virtual void serialize(const LegionProfInstance::MessageInfo&) = 0;
       virtual void serialize(const LegionProfInstance::MapperCallInfo&) = 0;
       virtual void serialize(const LegionProfInstance::RuntimeCallInfo&) = 0;
+      virtual void serialize(const LegionProfInstance::MessageSizeInfo&) = 0;
 #ifdef LEGION_PROF_SELF_PROFILE
       virtual void serialize(const LegionProfInstance::ProfTaskInfo&) = 0;
 #endif
@@ -102,6 +95,7 @@ namespace Legion {
       void serialize(const LegionProfInstance::WaitInfo, 
                      const LegionProfInstance::MetaInfo&);
       void serialize(const LegionProfInstance::TaskInfo&);
+      void serialize(const LegionProfInstance::TaskPerfCounters&);
       void serialize(const LegionProfInstance::MetaInfo&);
       void serialize(const LegionProfInstance::CopyInfo&);
       void serialize(const LegionProfInstance::FillInfo&);
@@ -112,45 +106,47 @@ namespace Legion {
       void serialize(const LegionProfInstance::MessageInfo&);
       void serialize(const LegionProfInstance::MapperCallInfo&);
       void serialize(const LegionProfInstance::RuntimeCallInfo&);
+      void serialize(const LegionProfInstance::MessageSizeInfo&);
 #ifdef LEGION_PROF_SELF_PROFILE
       void serialize(const LegionProfInstance::ProfTaskInfo&);
 #endif
     private:
-#ifdef USE_ZLIB
-      gzFile f;
-#else
+      // Records are gathered into chunks which are compressed when zlib
+      // is available and written out with the range of times they cover.
+      // Timed and untimed records go into separate chunks so that readers
+      // looking at a window of time can skip whole timed chunks.
+      struct Chunk {
+      public:
+        Chunk(bool meta)
+          : start(~0ULL), stop(0), metadata(meta) { }
+      public:
+        std::vector<char> data;
+        timestamp_t start, stop;
+        const bool metadata;
+      };
+      inline void append(const void *data, size_t size)
+        { const char *ptr = (const char*)data;
+          current->data.insert(current->data.end(), ptr, ptr + size); }
+      inline void note_time(timestamp_t start, timestamp_t stop)
+        { if (start < current->start) current->start = start;
+          if (stop > current->stop) current->stop = stop; }
+      void begin_record(int ID, bool timed = false);
+      void flush_chunk(Chunk &chunk);
+      void write_index(void);
+    private:
+      static const size_t CHUNK_SIZE = 1 << 20;
+      struct ChunkIndexEntry {
+        unsigned long long offset;
+        unsigned flags;
+        timestamp_t start, stop;
+      };
       FILE *f;
+      Chunk timed_chunk, metadata_chunk;
+      Chunk *current;
+      std::vector<ChunkIndexEntry> chunk_index;
+#ifdef USE_ZLIB
+      std::vector<char> compressed;
 #endif
-      enum LegionProfInstanceIDs {
-        MESSAGE_DESC_ID,
-        MAPPER_CALL_DESC_ID,
-        RUNTIME_CALL_DESC_ID,
-        META_DESC_ID,
-        OP_DESC_ID,
-        PROC_DESC_ID,
-        MEM_DESC_ID,
-        TASK_KIND_ID,
-        TASK_VARIANT_ID,
-        OPERATION_INSTANCE_ID,
-        MULTI_TASK_ID,
-        SLICE_OWNER_ID,
-        TASK_WAIT_INFO_ID,
-        META_WAIT_INFO_ID,
-        TASK_INFO_ID,
-        META_INFO_ID,
-        COPY_INFO_ID,
-        FILL_INFO_ID,
-        INST_CREATE_INFO_ID,
-        INST_USAGE_INFO_ID,
-        INST_TIMELINE_INFO_ID,
-        PARTITION_INFO_ID,
-        MESSAGE_INFO_ID,
-        MAPPER_CALL_INFO_ID,
-        RUNTIME_CALL_INFO_ID,
-#ifdef LEGION_PROF_SELF_PROFILE
-        PROFTASK_INFO_ID
-#endif
-      };
     };
 
     // This is the Old ASCII Serializer
@@ -178,6 +174,7 @@ namespace Legion {
       void serialize(const LegionProfInstance::WaitInfo, 
                      const LegionProfInstance::MetaInfo&);
       void serialize(const LegionProfInstance::TaskInfo&);
+      void serialize(const LegionProfInstance::TaskPerfCounters&);
       void serialize(const LegionProfInstance::MetaInfo&);
       void serialize(const LegionProfInstance::CopyInfo&);
       void serialize(const LegionProfInstance::FillInfo&);
@@ -188,6 +185,7 @@ namespace Legion {
       void serialize(const LegionProfInstance::MessageInfo&);
       void serialize(const LegionProfInstance::MapperCallInfo&);
       void serialize(const LegionProfInstance::RuntimeCallInfo&);
+      void serialize(const LegionProfInstance::MessageSizeInfo&);
 #ifdef LEGION_PROF_SELF_PROFILE
       void serialize(const LegionProfInstance::ProfTaskInfo&);
 #endif
@@ -337,6 +337,8 @@ namespace Legion {
       LG_REMOTE_PHYSICAL_RESPONSE_TASK_ID,
       LG_REPLAY_SLICE_ID,
       LG_DELETE_TEMPLATE_ID,
+      LG_DEFER_CHANNEL_FLUSH_TASK_ID,
+      LG_PROFILER_DUMP_TASK_ID,
       LG_MESSAGE_ID, // These two must be the last two
       LG_RETRY_SHUTDOWN_TASK_ID,
       LG_LAST_TASK_ID, // This one should always be last
@@ -424,6 +426,8 @@ namespace Legion {
         "Remote Physical Context Response",                       \
         "Replay Physical Trace",                                  \
         "Delete Physical Template",                               \
+        "Deferred Channel Flush",                                 \
+        "Profiler Dump",                                          \
         "Remote Message",                                         \
         "Retry Shutdown",                                         \
       };
@@ -1478,6 +1482,7 @@ namespace Legion {
     // legion_profiling.h
     class LegionProfiler;
     class LegionProfInstance;
+    class LegionStatistics;
 
     // mapper_manager.h
     class MappingCallInfo;
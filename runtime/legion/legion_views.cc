@@ -835,6 +835,8 @@ namespace Legion {
                                          PhysicalTraceInfo &trace_info)
     //--------------------------------------------------------------------------
     {
+      // Any user may write to the instance
+      manager->clear_zero_pristine();
       RegionUsage usage;
       usage.redop = redop;
       usage.prop = EXCLUSIVE;
@@ -1233,6 +1235,8 @@ namespace Legion {
                                     PhysicalTraceInfo &trace_info)
     //--------------------------------------------------------------------------
     {
+      // Any user may write to the instance
+      manager->clear_zero_pristine();
       UniqueID op_id = op->get_unique_op_id();
       bool need_version_update = false;
       if (IS_WRITE(usage))
@@ -1420,6 +1424,8 @@ namespace Legion {
                                              bool update_versions/*=true*/)
     //--------------------------------------------------------------------------
     {
+      // Any user may write to the instance
+      manager->clear_zero_pristine();
       std::set<ApEvent> wait_on_events;
       ApEvent start_use_event = manager->get_use_event();
       if (start_use_event.exists())
@@ -1537,6 +1543,8 @@ namespace Legion {
                                             const unsigned index)
     //--------------------------------------------------------------------------
     {
+      // Any user may write to the instance
+      manager->clear_zero_pristine();
 #ifdef DEBUG_LEGION
       assert(logical_node->is_region());
 #endif
@@ -6949,6 +6957,12 @@ namespace Legion {
                                          PhysicalTraceInfo &trace_info)
     //--------------------------------------------------------------------------
     {
+      // If the destination still holds the zeroes that Realm allocated it
+      // with then filling it with zeroes has nothing to do, and since we
+      // don't register a user the instance stays pristine for later fills
+      if (!trace_info.recording && !restrict_info.has_restrictions() &&
+          dst->manager->is_zero_pristine() && value->is_zero())
+        return;
       LegionMap<ApEvent,FieldMask>::aligned preconditions;
       // We know we're going to write all these fields so we can filter
       dst->find_copy_preconditions(0/*redop*/, false/*reading*/,
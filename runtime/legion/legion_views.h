@@ -1465,6 +1465,15 @@ namespace Legion {
       public:
         FillViewValue& operator=(const FillViewValue &rhs)
         { assert(false); return *this; }
+      public:
+        inline bool is_zero(void) const
+        {
+          const char *bytes = (const char*)value;
+          for (size_t idx = 0; idx < value_size; idx++)
+            if (bytes[idx] != 0)
+              return false;
+          return true;
+        }
       public:
         const void *const value;
         const size_t value_size;
@@ -47,7 +47,8 @@ namespace Legion {
     MapperManager::MapperManager(Runtime *rt, Mapping::Mapper *mp, 
                                  MapperID mid, Processor p)
       : runtime(rt), mapper(mp), mapper_id(mid), processor(p),
-        profile_mapper(runtime->profiler != NULL)
+        profile_mapper((runtime->profiler != NULL) || 
+                       (runtime->statistics != NULL))
     //--------------------------------------------------------------------------
     {
     }
@@ -3106,10 +3107,14 @@ namespace Legion {
         free_call_info(info, false/*need lock*/);
         return;
       }
-      if (profile_mapper)
+      if (runtime->profiler != NULL)
         runtime->profiler->record_mapper_call(info->kind, 
             (info->operation == NULL) ? 0 : info->operation->get_unique_op_id(),
             info->start_time, info->stop_time); 
+      if ((runtime->statistics != NULL) && 
+          (info->stop_time >= info->start_time))
+        runtime->statistics->record_mapper_call(info->kind,
+            info->stop_time - info->start_time);
       info->resume = RtUserEvent::NO_RT_USER_EVENT;
       info->operation = NULL;
       info->acquired_instances = NULL;
@@ -528,6 +528,7 @@ namespace Legion {
       Mapping::Mapper *const mapper;
       const MapperID mapper_id;
       const Processor processor;
+      // Time mapper calls for the profiler and/or the runtime statistics
       const bool profile_mapper;
     protected:
       mutable LocalLock mapper_lock;
@@ -43,6 +43,7 @@
 #include "mappers/test_mapper.h"
 #include "mappers/replay_mapper.h"
 #include "mappers/debug_mapper.h"
+#include "mappers/schedule_mapper.h"
 
 #include <unistd.h> // sleep for warnings
 
@@ -5142,6 +5143,8 @@ namespace Legion {
           return result;
       }
       // If we made it here well then we failed 
+      if (runtime->statistics != NULL)
+        runtime->statistics->record_instance_failure(memory);
       return NULL;
     }
 
@@ -5365,6 +5368,166 @@ namespace Legion {
       return RtEvent::NO_RT_EVENT;
     }
 
+    /////////////////////////////////////////////////////////////
+    // Message Compression 
+    /////////////////////////////////////////////////////////////
+
+    // A small LZ77 compressor using the LZ4 block format: each sequence
+    // is a token (literal length in the high nibble, match length minus
+    // four in the low nibble, 15 meaning more length bytes follow), the
+    // literals, and a two byte little-endian match offset. The final
+    // sequence has literals only. It favors speed over ratio since it
+    // sits on the message sending path.
+    static const unsigned LZ_MIN_MATCH = 4;
+    static const unsigned LZ_HASH_BITS = 12;
+    static const size_t LZ_MAX_OFFSET = 65535;
+    // Smaller payloads are never compressed, this also leaves room for
+    // the size prefix and the compressor's worst case slack
+    static const size_t LZ_MIN_INPUT = 64;
+
+    //--------------------------------------------------------------------------
+    static inline unsigned lz_hash(const char *ptr)
+    //--------------------------------------------------------------------------
+    {
+      uint32_t v;
+      memcpy(&v, ptr, sizeof(v));
+      return (v * 2654435761U) >> (32 - LZ_HASH_BITS);
+    }
+
+    //--------------------------------------------------------------------------
+    static inline char* lz_write_length(char *out, size_t length)
+    //--------------------------------------------------------------------------
+    {
+      while (length >= 255)
+      {
+        *out++ = (char)255;
+        length -= 255;
+      }
+      *out++ = (char)length;
+      return out;
+    }
+
+    //--------------------------------------------------------------------------
+    static size_t lz_compress(const char *src, size_t size, 
+                              char *dst, size_t capacity)
+    //--------------------------------------------------------------------------
+    {
+      // Worst case for a sequence of literals is one length byte per
+      // 255 literals plus the token, so give up before that can overflow
+      const size_t limit = (capacity > 16) ? (capacity - 16) : 0;
+      size_t table[1 << LZ_HASH_BITS];
+      for (unsigned idx = 0; idx < (1U << LZ_HASH_BITS); idx++)
+        table[idx] = size; // invalid position
+      char *out = dst;
+      size_t anchor = 0, pos = 0;
+      while ((pos + LZ_MIN_MATCH) <= size)
+      {
+        const unsigned h = lz_hash(src + pos);
+        const size_t candidate = table[h];
+        table[h] = pos;
+        if ((candidate >= size) || ((pos - candidate) > LZ_MAX_OFFSET) ||
+            (memcmp(src + candidate, src + pos, LZ_MIN_MATCH) != 0))
+        {
+          pos++;
+          continue;
+        }
+        size_t match = LZ_MIN_MATCH;
+        while (((pos + match) < size) && 
+               (src[candidate + match] == src[pos + match]))
+          match++;
+        const size_t literals = pos - anchor;
+        if ((size_t)(out - dst) + literals + (literals / 255) + 
+            (match / 255) + 8 > limit)
+          return 0;
+        char *token = out++;
+        const size_t match_code = match - LZ_MIN_MATCH;
+        *token = (char)(((literals < 15) ? literals : 15) << 4 |
+                        ((match_code < 15) ? match_code : 15));
+        if (literals >= 15)
+          out = lz_write_length(out, literals - 15);
+        memcpy(out, src + anchor, literals);
+        out += literals;
+        const size_t offset = pos - candidate;
+        *out++ = (char)(offset & 0xff);
+        *out++ = (char)(offset >> 8);
+        if (match_code >= 15)
+          out = lz_write_length(out, match_code - 15);
+        pos += match;
+        anchor = pos;
+      }
+      // The rest of the input goes out as literals
+      const size_t literals = size - anchor;
+      if ((size_t)(out - dst) + literals + (literals / 255) + 2 > limit)
+        return 0;
+      *out++ = (char)(((literals < 15) ? literals : 15) << 4);
+      if (literals >= 15)
+        out = lz_write_length(out, literals - 15);
+      memcpy(out, src + anchor, literals);
+      out += literals;
+      return (out - dst);
+    }
+
+    //--------------------------------------------------------------------------
+    static bool lz_decompress(const char *src, size_t size, 
+                              char *dst, size_t expected)
+    //--------------------------------------------------------------------------
+    {
+      // Returns false rather than reading or writing out of bounds
+      // if the input is not a well formed block of the expected size
+      const unsigned char *in = (const unsigned char*)src;
+      const unsigned char *const end = in + size;
+      char *out = dst;
+      char *const out_end = dst + expected;
+      while (in < end)
+      {
+        const unsigned token = *in++;
+        size_t literals = token >> 4;
+        if (literals == 15)
+        {
+          unsigned char more;
+          do {
+            if (in == end)
+              return false;
+            more = *in++;
+            literals += more;
+          } while (more == 255);
+        }
+        if ((literals > (size_t)(end - in)) || 
+            (literals > (size_t)(out_end - out)))
+          return false;
+        memcpy(out, in, literals);
+        out += literals;
+        in += literals;
+        if (in == end)
+          break;
+        if ((end - in) < 2)
+          return false;
+        const size_t offset = in[0] | (in[1] << 8);
+        in += 2;
+        size_t match = (token & 0xf);
+        if (match == 15)
+        {
+          unsigned char more;
+          do {
+            if (in == end)
+              return false;
+            more = *in++;
+            match += more;
+          } while (more == 255);
+        }
+        match += LZ_MIN_MATCH;
+        if ((offset == 0) || ((size_t)(out - dst) < offset) ||
+            (match > (size_t)(out_end - out)))
+          return false;
+        // Matches may overlap their own output so copy bytewise
+        const char *from = out - offset;
+        for (size_t idx = 0; idx < match; idx++)
+          out[idx] = from[idx];
+        out += match;
+      }
+      return (out == out_end);
+    }
+
     /////////////////////////////////////////////////////////////
     // Virtual Channel 
     /////////////////////////////////////////////////////////////
@@ -5372,9 +5535,12 @@ namespace Legion {
     //--------------------------------------------------------------------------
     VirtualChannel::VirtualChannel(VirtualChannelKind kind, 
         AddressSpaceID local_address_space, 
-        size_t max_message_size, LegionProfiler *prof)
+        size_t max_message_size, LegionProfiler *prof,
+        bool coal, size_t compress_threshold)
       : sending_buffer((char*)malloc(max_message_size)), 
-        sending_buffer_size(max_message_size), 
+        sending_buffer_size(max_message_size), coalesce(coal),
+        flush_pending(false), pending_response(false),
+        compression_threshold(compress_threshold),
         observed_recent(true), profiler(prof)
     //--------------------------------------------------------------------------
     //
@@ -5413,7 +5579,8 @@ namespace Legion {
 
     //--------------------------------------------------------------------------
     VirtualChannel::VirtualChannel(const VirtualChannel &rhs)
-      : sending_buffer(NULL), sending_buffer_size(0), profiler(NULL)
+      : sending_buffer(NULL), sending_buffer_size(0), coalesce(false),
+        compression_threshold(0), profiler(NULL)
     //--------------------------------------------------------------------------
     {
       // should never be called
@@ -5440,10 +5607,38 @@ namespace Legion {
       // including the overhead for the message: kind and size
       size_t buffer_size = rez.get_used_bytes();
       const char *buffer = (const char*)rez.get_buffer();
+      const size_t raw_size = buffer_size;
       const size_t header_size = 
         sizeof(k) + sizeof(implicit_provenance) + sizeof(buffer_size);
       // Need to hold the lock when manipulating the buffer
       AutoLock s_lock(send_lock);
+      // Large payloads get compressed if that actually saves something,
+      // in which case the original size goes in front of the payload
+      bool compressed = false;
+      if ((compression_threshold > 0) && 
+          (buffer_size >= compression_threshold) &&
+          (buffer_size > LZ_MIN_INPUT))
+      {
+        const size_t limit = buffer_size - (buffer_size / 8);
+        if (compression_buffer.size() < limit)
+          compression_buffer.resize(limit);
+        const size_t result = lz_compress(buffer, buffer_size,
+            &compression_buffer[0] + sizeof(raw_size), 
+            limit - sizeof(raw_size));
+        if (result > 0)
+        {
+          memcpy(&compression_buffer[0], &raw_size, sizeof(raw_size));
+          buffer = &compression_buffer[0];
+          buffer_size = result + sizeof(raw_size);
+          compressed = true;
+        }
+      }
+      if (profiler != NULL)
+        profiler->record_message_size(k, raw_size, buffer_size);
+      if (runtime->statistics != NULL)
+        runtime->statistics->record_message(k, buffer_size);
+      const size_t size_field = compressed ? 
+        (buffer_size | COMPRESSED_MESSAGE_BIT) : buffer_size;
       if ((sending_index+header_size+buffer_size) > sending_buffer_size)
       {
         // Make sure we can at least get the meta-data into the buffer
@@ -5456,7 +5651,7 @@ namespace Legion {
         sending_index += sizeof(k);
         *((UniqueID*)(sending_buffer+sending_index)) = implicit_provenance;
         sending_index += sizeof(implicit_provenance);
-        *((size_t*)(sending_buffer+sending_index)) = buffer_size;
+        *((size_t*)(sending_buffer+sending_index)) = size_field;
         sending_index += sizeof(buffer_size);
         while (buffer_size > 0)
         {
@@ -5485,14 +5680,51 @@ namespace Legion {
         sending_index += sizeof(k);
         *((UniqueID*)(sending_buffer+sending_index)) = implicit_provenance;
         sending_index += sizeof(implicit_provenance);
-        *((size_t*)(sending_buffer+sending_index)) = buffer_size;
+        *((size_t*)(sending_buffer+sending_index)) = size_field;
         sending_index += sizeof(buffer_size);
         // Then copy over the buffer
         memcpy(sending_buffer+sending_index,buffer,buffer_size); 
         sending_index += buffer_size;
       }
       if (flush)
-        send_message(true/*complete*/, runtime, target, response, shutdown);
+      {
+        // If coalescing and the last message we sent has not been handled
+        // yet, then this one could not be handled before it anyway, so
+        // hold on to it and send everything that accumulates once that 
+        // one is done, unless the buffer is already getting full
+        if (coalesce && !shutdown && (packaged_messages > 0) &&
+            (sending_index < (sending_buffer_size / 2)) &&
+            !last_message_event.has_triggered())
+        {
+          if (response)
+            pending_response = true;
+          if (!flush_pending)
+          {
+            flush_pending = true;
+            DeferredFlushArgs args(this, runtime, target);
+            runtime->issue_runtime_meta_task(args, 
+                LG_LATENCY_MESSAGE_PRIORITY, last_message_event);
+          }
+        }
+        else
+          send_message(true/*complete*/, runtime, target, 
+                       response || pending_response, shutdown);
+      }
+    }
+
+    //--------------------------------------------------------------------------
+    /*static*/ void VirtualChannel::handle_deferred_flush(const void *args)
+    //--------------------------------------------------------------------------
+    {
+      const DeferredFlushArgs *fargs = (const DeferredFlushArgs*)args;
+      VirtualChannel *channel = fargs->channel;
+      AutoLock s_lock(channel->send_lock);
+      channel->flush_pending = false;
+      // Might have already gone out because the buffer filled up
+      // or because of a flush that could not be deferred
+      if (channel->packaged_messages > 0)
+        channel->send_message(true/*complete*/, fargs->runtime, fargs->target,
+                      channel->pending_response, false/*shutdown*/);
     }
 
     //--------------------------------------------------------------------------
@@ -5539,6 +5771,7 @@ namespace Legion {
                 LG_LATENCY_RESPONSE_PRIORITY : LG_LATENCY_MESSAGE_PRIORITY));
       // Reset the state of the buffer
       sending_index = base_size + sizeof(header) + sizeof(unsigned);
+      pending_response = false;
       if (partial)
         header = PARTIAL_MESSAGE;
       else
@@ -5671,14 +5904,38 @@ namespace Legion {
         size_t message_size = *((const size_t*)args);
         args += sizeof(message_size);
         arglen -= sizeof(message_size);
+        const bool compressed = 
+          ((message_size & COMPRESSED_MESSAGE_BIT) != 0);
+        message_size &= ~COMPRESSED_MESSAGE_BIT;
 #ifdef DEBUG_LEGION
         if (idx == (num_messages-1))
           assert(message_size == arglen);
 #endif
         if (profiler != NULL)
           start = Realm::Clock::current_time_in_nanoseconds();
+        // Expand compressed payloads before handing them off
+        const char *payload = args;
+        size_t payload_size = message_size;
+        char *expanded = NULL;
+        if (compressed)
+        {
+          if (message_size >= sizeof(payload_size))
+          {
+            memcpy(&payload_size, args, sizeof(payload_size));
+            expanded = (char*)malloc(payload_size);
+          }
+          if ((expanded == NULL) ||
+              !lz_decompress(args + sizeof(payload_size), 
+                             message_size - sizeof(payload_size),
+                             expanded, payload_size))
+            REPORT_LEGION_ERROR(ERROR_CORRUPT_COMPRESSED_MESSAGE,
+                "Received a corrupt compressed message of kind %d "
+                "(%zu bytes, %zu bytes expanded)", kind, message_size,
+                payload_size)
+          payload = expanded;
+        }
         // Build the deserializer
-        Deserializer derez(args,message_size);
+        Deserializer derez(payload,payload_size);
         switch (kind)
         {
           case TASK_MESSAGE:
@@ -6418,6 +6675,8 @@ namespace Legion {
           stop = Realm::Clock::current_time_in_nanoseconds();
           profiler->record_message(kind, start, stop);
         }
+        if (expanded != NULL)
+          free(expanded);
         // Update the args and arglen
         args += message_size;
         arglen -= message_size;
@@ -6499,8 +6758,14 @@ namespace Legion {
       // Initialize our virtual channels 
       for (unsigned idx = 0; idx < MAX_NUM_VIRTUAL_CHANNELS; idx++)
       {
+        // Only the channels carrying many small, latency-tolerant
+        // messages coalesce flushes
+        const bool coalesce = !rt->no_message_coalescing &&
+          ((idx == ANALYSIS_VIRTUAL_CHANNEL) || 
+           (idx == UPDATE_VIRTUAL_CHANNEL));
         new (channels+idx) VirtualChannel((VirtualChannelKind)idx,
-            rt->address_space, max_message_size, runtime->profiler);
+            rt->address_space, max_message_size, runtime->profiler,
+            coalesce, rt->message_compression_threshold);
       }
     }
 
@@ -8813,7 +9078,8 @@ namespace Legion {
         mapper_runtime(new Legion::Mapping::MapperRuntime()),
         machine(m), address_space(unique), 
         total_address_spaces(address_spaces.size()),
-        runtime_stride(address_spaces.size()), profiler(NULL),
+        runtime_stride(address_spaces.size()), profiler(NULL), 
+        statistics(NULL),
         forest(new RegionTreeForest(this)), virtual_manager(NULL), 
         num_utility_procs(local_utilities.empty() ? locals.size() : 
                           local_utilities.size()), input_args(args),
@@ -8822,6 +9088,7 @@ namespace Legion {
         initial_tasks_to_schedule(config.initial_tasks_to_schedule),
         initial_meta_task_vector_width(config.initial_meta_task_vector_width),
         max_message_size(config.max_message_size),
+        message_compression_threshold(config.message_compression_threshold),
         gc_epoch_size(config.gc_epoch_size),
         max_local_fields(config.max_local_fields),
         max_replay_parallelism(config.max_replay_parallelism),
@@ -8831,6 +9098,7 @@ namespace Legion {
         no_physical_tracing(config.no_physical_tracing),
         no_trace_optimization(config.no_trace_optimization),
         no_fence_elision(config.no_fence_elision),
+        no_message_coalescing(config.no_message_coalescing),
         replay_on_cpus(config.replay_on_cpus),
         verify_disjointness(config.verify_disjointness),
         runtime_warnings(config.runtime_warnings),
@@ -8849,6 +9117,7 @@ namespace Legion {
         enable_test_mapper(config.enable_test_mapper),
         legion_ldb_enabled(config.legion_ldb_enabled),
         replay_file(config.replay_file),
+        schedule_file(config.schedule_file),
 #ifdef DEBUG_LEGION
         logging_region_tree_state(config.logging_region_tree_state),
         verbose_logging(config.verbose_logging),
@@ -8956,6 +9225,10 @@ namespace Legion {
       // Initialize our profiling instance
       if (address_space < num_profiling_nodes)
         initialize_legion_prof(config);
+      // The statistics counters are kept per thread which does not work
+      // when threads are shared between separate runtime instances
+      if (!config.no_statistics && !separate_runtime_instances)
+        initialize_legion_stats(config);
       // Pull in any static registrations that were done
       register_static_variants();
       register_static_constraints();
@@ -9007,13 +9280,14 @@ namespace Legion {
     Runtime::Runtime(const Runtime &rhs)
       : external(NULL), mapper_runtime(NULL), machine(rhs.machine), 
         address_space(0), total_address_spaces(0), runtime_stride(0), 
-        profiler(NULL), forest(NULL), 
+        profiler(NULL), statistics(NULL), forest(NULL), 
         num_utility_procs(rhs.num_utility_procs), input_args(rhs.input_args),
         initial_task_window_size(rhs.initial_task_window_size),
         initial_task_window_hysteresis(rhs.initial_task_window_hysteresis),
         initial_tasks_to_schedule(rhs.initial_tasks_to_schedule),
         initial_meta_task_vector_width(rhs.initial_meta_task_vector_width),
         max_message_size(rhs.max_message_size),
+        message_compression_threshold(rhs.message_compression_threshold),
         gc_epoch_size(rhs.gc_epoch_size), 
         max_local_fields(rhs.max_local_fields),
         max_replay_parallelism(rhs.max_replay_parallelism),
@@ -9023,6 +9297,7 @@ namespace Legion {
         no_physical_tracing(rhs.no_physical_tracing),
         no_trace_optimization(rhs.no_trace_optimization),
         no_fence_elision(rhs.no_fence_elision),
+        no_message_coalescing(rhs.no_message_coalescing),
         replay_on_cpus(rhs.replay_on_cpus),
         verify_disjointness(rhs.verify_disjointness),
         runtime_warnings(rhs.runtime_warnings),
@@ -9037,6 +9312,7 @@ namespace Legion {
         enable_test_mapper(rhs.enable_test_mapper),
         legion_ldb_enabled(rhs.legion_ldb_enabled),
         replay_file(rhs.replay_file),
+        schedule_file(rhs.schedule_file),
 #ifdef DEBUG_LEGION
         logging_region_tree_state(rhs.logging_region_tree_state),
         verbose_logging(rhs.verbose_logging),
@@ -9077,6 +9353,11 @@ namespace Legion {
         delete profiler;
         profiler = NULL;
       }
+      if (statistics != NULL)
+      {
+        delete statistics;
+        statistics = NULL;
+      }
       delete forest;
       delete external;
       delete mapper_runtime;
@@ -9499,7 +9780,8 @@ namespace Legion {
                                     config.prof_logfile,
                                     total_address_spaces,
                                     config.prof_footprint_threshold,
-                                    config.prof_target_latency);
+                                    config.prof_target_latency,
+                                    config.prof_counter_tasks);
       LG_MESSAGE_DESCRIPTIONS(lg_message_descriptions);
       profiler->record_message_kinds(lg_message_descriptions, LAST_SEND_KIND);
       MAPPER_CALL_NAMES(lg_mapper_calls);
@@ -9511,6 +9793,23 @@ namespace Legion {
 #endif
     }
 
+    //--------------------------------------------------------------------------
+    void Runtime::initialize_legion_stats(const LegionConfiguration &config)
+    //--------------------------------------------------------------------------
+    {
+      // Use the same names for everything as the profiler
+      LG_TASK_DESCRIPTIONS(lg_task_descriptions);
+      LG_MESSAGE_DESCRIPTIONS(lg_message_descriptions);
+      MAPPER_CALL_NAMES(lg_mapper_calls);
+      statistics = new LegionStatistics(this, lg_task_descriptions,
+                                        Operation::LAST_OP_KIND,
+                                        Operation::op_names,
+                                        lg_message_descriptions,
+                                        lg_mapper_calls,
+                                        config.stats_logfile,
+                                        config.stats_interval);
+    }
+
     //--------------------------------------------------------------------------
     void Runtime::log_machine(Machine machine) const
     //--------------------------------------------------------------------------
@@ -9707,12 +10006,15 @@ namespace Legion {
         }
         else
         {
-          // Make default mappers for everyone
+          // Make default mappers for everyone, following a schedule
+          // from a previous run if we were given one
           for (std::map<Processor,ProcessorManager*>::const_iterator it = 
                 proc_managers.begin(); it != proc_managers.end(); it++)
           {
-            Mapper *mapper = 
-              new Mapping::DefaultMapper(mapper_runtime, machine, it->first);
+            Mapper *mapper = (schedule_file == NULL) ?
+              new Mapping::DefaultMapper(mapper_runtime, machine, it->first) :
+              new Mapping::ScheduleMapper(mapper_runtime, machine, it->first,
+                                          schedule_file);
             MapperManager *wrapper = wrap_mapper(this, mapper, 0, it->first);
             it->second->add_mapper(0, wrapper, false/*check*/, true/*owns*/);
           }
@@ -9902,6 +10204,8 @@ namespace Legion {
         it->second->finalize();
       if (profiler != NULL)
         profiler->finalize();
+      if (statistics != NULL)
+        statistics->finalize();
     }
     
     //--------------------------------------------------------------------------
@@ -12064,6 +12368,16 @@ namespace Legion {
       return mpi_rank;
     }
 
+    //--------------------------------------------------------------------------
+    void Runtime::get_runtime_statistics(
+                               std::map<std::string,unsigned long long> &stats)
+    //--------------------------------------------------------------------------
+    {
+      stats.clear();
+      if (statistics != NULL)
+        statistics->snapshot(stats);
+    }
+
     //--------------------------------------------------------------------------
     void Runtime::add_mapper(MapperID map_id, Mapper *mapper, Processor proc)
     //--------------------------------------------------------------------------
@@ -18751,6 +19065,7 @@ namespace Legion {
         BOOL_ARG("-lg:no_physical_tracing",config.no_physical_tracing);
         BOOL_ARG("-lg:no_trace_optimization",config.no_trace_optimization);
         BOOL_ARG("-lg:no_fence_elision",config.no_fence_elision);
+        BOOL_ARG("-lg:no_coalesce",config.no_message_coalescing);
         BOOL_ARG("-lg:replay_on_cpus",config.replay_on_cpus);
         BOOL_ARG("-lg:disjointness",config.verify_disjointness);
         INT_ARG("-lg:window", config.initial_task_window_size);
@@ -18758,6 +19073,7 @@ namespace Legion {
         INT_ARG("-lg:sched", config.initial_tasks_to_schedule);
         INT_ARG("-lg:vector", config.initial_meta_task_vector_width);
         INT_ARG("-lg:message",config.max_message_size);
+        INT_ARG("-lg:compress",config.message_compression_threshold);
         INT_ARG("-lg:epoch", config.gc_epoch_size);
         INT_ARG("-lg:local", config.max_local_fields);
         INT_ARG("-lg:parallel_replay", config.max_replay_parallelism);
@@ -18777,6 +19093,11 @@ namespace Legion {
           config.legion_ldb_enabled = true;
           continue;
         }
+        if (!strcmp(argv[i],"-lg:schedule"))
+        {
+          config.schedule_file = argv[++i];
+          continue;
+        }
 #ifdef DEBUG_LEGION
         BOOL_ARG("-lg:tree",config.logging_region_tree_state);
         BOOL_ARG("-lg:verbose",config.verbose_logging);
@@ -18815,6 +19136,18 @@ namespace Legion {
           continue;
         }
         INT_ARG("-lg:prof_latency",config.prof_target_latency);
+        if (!strcmp(argv[i],"-lg:prof_counters"))
+        {
+          config.prof_counter_tasks = argv[++i];
+          continue;
+        }
+        BOOL_ARG("-lg:no_stats",config.no_statistics);
+        if (!strcmp(argv[i],"-lg:stats_file"))
+        {
+          config.stats_logfile = argv[++i];
+          continue;
+        }
+        INT_ARG("-lg:stats_interval",config.stats_interval);
 
         BOOL_ARG("-lg:debug_ok",config.slow_config_ok);
         
@@ -19629,6 +19962,8 @@ namespace Legion {
       implicit_provenance = *((const UniqueID*)data);
       data += sizeof(implicit_provenance);
       arglen -= sizeof(implicit_provenance);
+      if ((tid < LG_MESSAGE_ID) && (runtime->statistics != NULL))
+        runtime->statistics->record_meta_task_started(tid);
       switch (tid)
       {
         case LG_SCHEDULER_ID:
@@ -20184,6 +20519,16 @@ namespace Legion {
             PhysicalTemplate::handle_delete_template(args);
             break;
           }
+        case LG_DEFER_CHANNEL_FLUSH_TASK_ID:
+          {
+            VirtualChannel::handle_deferred_flush(args);
+            break;
+          }
+        case LG_PROFILER_DUMP_TASK_ID:
+          {
+            LegionProfiler::handle_dump(args);
+            break;
+          }
         case LG_RETRY_SHUTDOWN_TASK_ID:
           {
             const ShutdownManager::RetryShutdownArgs *shutdown_args = 
@@ -20205,6 +20550,8 @@ namespace Legion {
 #ifdef DEBUG_SHUTDOWN_HANG
       __sync_fetch_and_add(&runtime->outstanding_counts[tid],-1);
 #endif
+      if (runtime->statistics != NULL)
+        runtime->statistics->poll_periodic_dump();
     }
 
     //--------------------------------------------------------------------------
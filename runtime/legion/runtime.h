@@ -876,9 +876,26 @@ namespace Legion {
         PARTIAL_MESSAGE,
         FINAL_MESSAGE,
       };
+      // Messages whose payload has been compressed have this bit
+      // set in their size field
+      static const size_t COMPRESSED_MESSAGE_BIT = 
+                                    ((size_t)1) << (8*sizeof(size_t) - 1);
+      struct DeferredFlushArgs : public LgTaskArgs<DeferredFlushArgs> {
+      public:
+        static const LgTaskID TASK_ID = LG_DEFER_CHANNEL_FLUSH_TASK_ID;
+      public:
+        DeferredFlushArgs(VirtualChannel *c, Runtime *rt, Processor t)
+          : LgTaskArgs<DeferredFlushArgs>(0), channel(c), 
+            runtime(rt), target(t) { }
+      public:
+        VirtualChannel *const channel;
+        Runtime *const runtime;
+        const Processor target;
+      };
     public:
       VirtualChannel(VirtualChannelKind kind,AddressSpaceID local_address_space,
-                     size_t max_message_size, LegionProfiler *profiler);
+                     size_t max_message_size, LegionProfiler *profiler,
+                     bool coalesce, size_t compression_threshold);
       VirtualChannel(const VirtualChannel &rhs);
       ~VirtualChannel(void);
     public:
@@ -890,6 +907,8 @@ namespace Legion {
       void process_message(const void *args, size_t arglen, 
                         Runtime *runtime, AddressSpaceID remote_address_space);
       void confirm_shutdown(ShutdownManager *shutdown_manager, bool phase_one);
+    public:
+      static void handle_deferred_flush(const void *args);
     private:
       void send_message(bool complete, Runtime *runtime, 
                         Processor target, bool response, bool shutdown);
@@ -907,6 +926,15 @@ namespace Legion {
       MessageHeader header;
       unsigned packaged_messages;
       bool partial;
+      // Nagle-style coalescing: while an earlier message on this channel
+      // is still being handled remotely, flushes are deferred until it 
+      // is done so that everything sent in the meantime goes together
+      const bool coalesce;
+      bool flush_pending;
+      bool pending_response;
+      // Payloads at least this large are compressed (0 disables)
+      const size_t compression_threshold;
+      std::vector<char> compression_buffer;
       // State for receiving messages
       // No lock for receiving messages since we know
       // that they are ordered
@@ -1439,6 +1467,7 @@ namespace Legion {
             initial_tasks_to_schedule(DEFAULT_MIN_TASKS_TO_SCHEDULE),
             initial_meta_task_vector_width(DEFAULT_META_TASK_VECTOR_WIDTH),
             max_message_size(DEFAULT_MAX_MESSAGE_SIZE),
+            message_compression_threshold(0),
             gc_epoch_size(DEFAULT_GC_EPOCH_SIZE),
             max_local_fields(DEFAULT_LOCAL_FIELDS),
             max_replay_parallelism(DEFAULT_MAX_REPLAY_PARALLELISM),
@@ -1448,6 +1477,7 @@ namespace Legion {
             no_physical_tracing(false),
             no_trace_optimization(false),
             no_fence_elision(false),
+            no_message_coalescing(false),
             replay_on_cpus(false),
             verify_disjointness(false),
             runtime_warnings(false),
@@ -1466,6 +1496,7 @@ namespace Legion {
             enable_test_mapper(false),
             legion_ldb_enabled(false),
             replay_file(NULL),
+            schedule_file(NULL),
             slow_config_ok(false),
 #ifdef DEBUG_LEGION
             logging_region_tree_state(false),
@@ -1478,7 +1509,11 @@ namespace Legion {
             serializer_type("binary"),
             prof_logfile(NULL),
             prof_footprint_threshold(128 << 20),
-            prof_target_latency(100) { }
+            prof_target_latency(100),
+            prof_counter_tasks(NULL),
+            no_statistics(false),
+            stats_logfile(NULL),
+            stats_interval(0) { }
       public:
         int delay_start;
         mutable int legion_collective_radix;
@@ -1491,6 +1526,7 @@ namespace Legion {
         unsigned initial_tasks_to_schedule;
         unsigned initial_meta_task_vector_width;
         unsigned max_message_size;
+        unsigned message_compression_threshold;
         unsigned gc_epoch_size;
         unsigned max_local_fields;
         unsigned max_replay_parallelism;
@@ -1501,6 +1537,7 @@ namespace Legion {
         bool no_physical_tracing;
         bool no_trace_optimization;
         bool no_fence_elision;
+        bool no_message_coalescing;
         bool replay_on_cpus;
         bool verify_disjointness;
         bool runtime_warnings;
@@ -1515,6 +1552,7 @@ namespace Legion {
         bool enable_test_mapper;
         bool legion_ldb_enabled;
         const char* replay_file;
+        const char* schedule_file;
         bool slow_config_ok;
 #ifdef DEBUG_LEGION
         bool logging_region_tree_state;
@@ -1529,6 +1567,11 @@ namespace Legion {
         const char *prof_logfile;
         size_t prof_footprint_threshold;
         size_t prof_target_latency;
+        const char *prof_counter_tasks;
+      public:
+        bool no_statistics;
+        const char *stats_logfile;
+        unsigned stats_interval;
       public:
         void configure_collective_settings(int total_spaces) const;
       };
@@ -1615,6 +1658,7 @@ namespace Legion {
       const unsigned total_address_spaces;
       const unsigned runtime_stride; // stride for uniqueness
       LegionProfiler *profiler;
+      LegionStatistics *statistics;
       RegionTreeForest *const forest;
       VirtualManager *virtual_manager;
       Processor utility_group;
@@ -1626,6 +1670,7 @@ namespace Legion {
       const unsigned initial_tasks_to_schedule;
       const unsigned initial_meta_task_vector_width;
       const unsigned max_message_size;
+      const unsigned message_compression_threshold;
       const unsigned gc_epoch_size;
       const unsigned max_local_fields;
       const unsigned max_replay_parallelism;
@@ -1636,6 +1681,7 @@ namespace Legion {
       const bool no_physical_tracing;
       const bool no_trace_optimization;
       const bool no_fence_elision;
+      const bool no_message_coalescing;
       const bool replay_on_cpus;
       const bool verify_disjointness;
       const bool runtime_warnings;
@@ -1650,6 +1696,7 @@ namespace Legion {
       const bool enable_test_mapper;
       const bool legion_ldb_enabled;
       const char*const replay_file;
+      const char*const schedule_file;
 #ifdef DEBUG_LEGION
       const bool logging_region_tree_state;
       const bool verbose_logging;
@@ -1671,6 +1718,7 @@ namespace Legion {
       void register_static_constraints(void);
       void register_static_projections(void);
       void initialize_legion_prof(const LegionConfiguration &config);
+      void initialize_legion_stats(const LegionConfiguration &config);
       void log_machine(Machine machine) const;
       void initialize_mappers(void);
       void initialize_virtual_manager(void);
@@ -2036,6 +2084,8 @@ namespace Legion {
       const std::map<int,AddressSpace>& find_forward_MPI_mapping(void);
       const std::map<AddressSpace,int>& find_reverse_MPI_mapping(void);
       int find_local_MPI_rank(void);
+      void get_runtime_statistics(
+                          std::map<std::string,unsigned long long> &stats);
     public:
       Mapping::MapperRuntime* get_mapper_runtime(void);
       MapperID generate_dynamic_mapper_id(void);
@@ -3236,6 +3286,8 @@ namespace Legion {
 #ifdef DEBUG_SHUTDOWN_HANG
       __sync_fetch_and_add(&outstanding_counts[T::TASK_ID],1);
 #endif
+      if ((T::TASK_ID < LG_MESSAGE_ID) && (statistics != NULL))
+        statistics->record_meta_task_issued(T::TASK_ID);
       if (!target.exists())
       {
         // If we don't have a processor to explicitly target, figure
@@ -0,0 +1,284 @@
+/* Copyright 2018 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mappers/schedule_mapper.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+namespace Legion {
+  namespace Mapping {
+
+    Logger log_schedule("schedule_mapper");
+
+    //--------------------------------------------------------------------------
+    /*static*/ const char* ScheduleMapper::create_schedule_name(Processor p)
+    //--------------------------------------------------------------------------
+    {
+      const size_t buffer_size = 64;
+      char *result = (char*)malloc(buffer_size*sizeof(char));
+      snprintf(result, buffer_size-1,
+                "Schedule Mapper on Processor " IDFMT "", p.id);
+      return result;
+    }
+
+    //--------------------------------------------------------------------------
+    ScheduleMapper::ScheduleMapper(MapperRuntime *rt, Machine m,
+                                   Processor local, const char *schedule_file,
+                                   const char *name)
+      : DefaultMapper(rt, m, local,
+                      (name == NULL) ? create_schedule_name(local) : name)
+    //--------------------------------------------------------------------------
+    {
+      if (!parse_schedule_file(schedule_file))
+      {
+        log_schedule.error("Schedule mapper failure. Unable to read "
+                           "schedule file %s.", schedule_file);
+        assert(false);
+      }
+      log_schedule.debug("Schedule mapper on processor " IDFMT " loaded "
+                         "%zu task schedules and %zu memory placements",
+                         local.id, task_schedules.size(),
+                         memory_placements.size());
+    }
+
+    //--------------------------------------------------------------------------
+    ScheduleMapper::ScheduleMapper(const ScheduleMapper &rhs)
+      : DefaultMapper(rhs.runtime, rhs.machine,
+                      rhs.local_proc, rhs.mapper_name)
+    //--------------------------------------------------------------------------
+    {
+      // should never be called
+      assert(false);
+    }
+
+    //--------------------------------------------------------------------------
+    ScheduleMapper::~ScheduleMapper(void)
+    //--------------------------------------------------------------------------
+    {
+    }
+
+    //--------------------------------------------------------------------------
+    ScheduleMapper& ScheduleMapper::operator=(const ScheduleMapper &rhs)
+    //--------------------------------------------------------------------------
+    {
+      // should never be called
+      assert(false);
+      return *this;
+    }
+
+    //--------------------------------------------------------------------------
+    bool ScheduleMapper::parse_schedule_file(const char *schedule_file)
+    //--------------------------------------------------------------------------
+    {
+      FILE *f = fopen(schedule_file, "r");
+      if (f == NULL)
+        return false;
+      char line[1024];
+      if ((fgets(line, sizeof(line), f) == NULL) ||
+          (strncmp(line, "LegionSchedule v1", 17) != 0))
+      {
+        log_schedule.error("Schedule mapper failure. %s is not a schedule "
+                           "file.", schedule_file);
+        fclose(f);
+        return false;
+      }
+      unsigned line_number = 1;
+      bool success = true;
+      while (fgets(line, sizeof(line), f) != NULL)
+      {
+        line_number++;
+        // Strip comments
+        char *comment = strchr(line, '#');
+        if (comment != NULL)
+          *comment = '\0';
+        char record[32], first[32], second[32], third[32];
+        int fields = sscanf(line, "%31s %31s %31s %31s",
+                            record, first, second, third);
+        if (fields <= 0)
+          continue;
+        if ((strcmp(record, "task") == 0) && (fields == 4))
+        {
+          char *task_end = NULL, *priority_end = NULL;
+          unsigned long task_id = strtoul(first, &task_end, 10);
+          long priority = strtol(third, &priority_end, 10);
+          TaskSchedule schedule;
+          if ((*task_end == '\0') && (*priority_end == '\0') &&
+              parse_processor_kind(second, schedule.kind))
+          {
+            if (!is_schedulable_kind(schedule.kind))
+            {
+              log_schedule.error("Schedule mapper failure. Line %u in "
+                                 "schedule file %s names %s which tasks "
+                                 "cannot be scheduled onto.", line_number,
+                                 schedule_file, second);
+              success = false;
+              continue;
+            }
+            schedule.priority = priority;
+            task_schedules[task_id] = schedule;
+            continue;
+          }
+        }
+        else if ((strcmp(record, "memory") == 0) && (fields == 3))
+        {
+          Processor::Kind proc_kind;
+          Memory::Kind mem_kind;
+          if (parse_processor_kind(first, proc_kind) &&
+              parse_memory_kind(second, mem_kind))
+          {
+            if (!is_schedulable_kind(proc_kind))
+            {
+              log_schedule.error("Schedule mapper failure. Line %u in "
+                                 "schedule file %s names %s which tasks "
+                                 "cannot be scheduled onto.", line_number,
+                                 schedule_file, first);
+              success = false;
+              continue;
+            }
+            memory_placements[proc_kind] = mem_kind;
+            continue;
+          }
+        }
+        log_schedule.error("Schedule mapper failure. Malformed line %u "
+                           "in schedule file %s.", line_number, schedule_file);
+        success = false;
+      }
+      fclose(f);
+      return success;
+    }
+
+    //--------------------------------------------------------------------------
+    /*static*/ bool ScheduleMapper::parse_processor_kind(const char *name,
+                                                      Processor::Kind &kind)
+    //--------------------------------------------------------------------------
+    {
+#define PROC_KIND_NAME(kind_name, desc) \
+      if (strcmp(#kind_name, name) == 0) \
+        { kind = Processor::kind_name; return true; }
+      REALM_PROCESSOR_KINDS(PROC_KIND_NAME)
+#undef PROC_KIND_NAME
+      return false;
+    }
+
+    //--------------------------------------------------------------------------
+    /*static*/ bool ScheduleMapper::is_schedulable_kind(Processor::Kind kind)
+    //--------------------------------------------------------------------------
+    {
+      // Utility processors only run the runtime's meta-tasks and processor
+      // groups are never chosen as the target of a single task
+      return ((kind != Processor::UTIL_PROC) &&
+              (kind != Processor::PROC_GROUP));
+    }
+
+    //--------------------------------------------------------------------------
+    /*static*/ bool ScheduleMapper::parse_memory_kind(const char *name,
+                                                   Memory::Kind &kind)
+    //--------------------------------------------------------------------------
+    {
+#define MEM_KIND_NAME(kind_name, desc) \
+      if (strcmp(#kind_name, name) == 0) \
+        { kind = Memory::kind_name; return true; }
+      REALM_MEMORY_KINDS(MEM_KIND_NAME)
+#undef MEM_KIND_NAME
+      return false;
+    }
+
+    //--------------------------------------------------------------------------
+    void ScheduleMapper::default_policy_rank_processor_kinds(MapperContext ctx,
+                        const Task &task, std::vector<Processor::Kind> &ranking)
+    //--------------------------------------------------------------------------
+    {
+      DefaultMapper::default_policy_rank_processor_kinds(ctx, task, ranking);
+      std::map<TaskID,TaskSchedule>::const_iterator finder =
+        task_schedules.find(task.task_id);
+      if (finder == task_schedules.end())
+        return;
+      // Try the scheduled kind first, if there are no processors of that
+      // kind here or no variant for it the default ranking still applies
+      std::vector<Processor::Kind>::iterator kind_finder =
+        std::find(ranking.begin(), ranking.end(), finder->second.kind);
+      if (kind_finder != ranking.end())
+        ranking.erase(kind_finder);
+      ranking.insert(ranking.begin(), finder->second.kind);
+    }
+
+    //--------------------------------------------------------------------------
+    TaskPriority ScheduleMapper::default_policy_select_task_priority(
+                                    MapperContext ctx, const Task &task)
+    //--------------------------------------------------------------------------
+    {
+      std::map<TaskID,TaskSchedule>::const_iterator finder =
+        task_schedules.find(task.task_id);
+      if (finder == task_schedules.end())
+        return DefaultMapper::default_policy_select_task_priority(ctx, task);
+      return finder->second.priority;
+    }
+
+    //--------------------------------------------------------------------------
+    Memory ScheduleMapper::default_policy_select_target_memory(
+                                                   MapperContext ctx,
+                                                   Processor target_proc,
+                                                   const RegionRequirement &req)
+    //--------------------------------------------------------------------------
+    {
+      // Explicit requests for RDMA memories take precedence
+      if ((req.tag & DefaultMapper::PREFER_RDMA_MEMORY) != 0)
+        return DefaultMapper::default_policy_select_target_memory(ctx,
+                                                          target_proc, req);
+      std::map<Processor,Memory>::const_iterator cached =
+        cached_schedule_memory.find(target_proc);
+      if (cached != cached_schedule_memory.end())
+        return cached->second;
+      Memory result = Memory::NO_MEMORY;
+      std::map<Processor::Kind,Memory::Kind>::const_iterator finder =
+        memory_placements.find(target_proc.kind());
+      if (finder != memory_placements.end())
+      {
+        // Pick the highest-bandwidth memory of the scheduled kind
+        Machine::MemoryQuery visible_memories(machine);
+        visible_memories.has_affinity_to(target_proc);
+        visible_memories.only_kind(finder->second);
+        unsigned best_bandwidth = 0;
+        std::vector<Machine::ProcessorMemoryAffinity> affinity(1);
+        for (Machine::MemoryQuery::iterator it = visible_memories.begin();
+              it != visible_memories.end(); it++)
+        {
+          affinity.clear();
+          machine.get_proc_mem_affinity(affinity, target_proc, *it,
+                                        false /*not just local affinities*/);
+          assert(affinity.size() == 1);
+          if (!result.exists() || (affinity[0].bandwidth > best_bandwidth))
+          {
+            result = *it;
+            best_bandwidth = affinity[0].bandwidth;
+          }
+        }
+        if (!result.exists())
+          log_schedule.warning("No memory of the scheduled kind is visible "
+                               "from processor " IDFMT ", falling back to "
+                               "the default memory", target_proc.id);
+      }
+      if (!result.exists())
+        result = DefaultMapper::default_policy_select_target_memory(ctx,
+                                                          target_proc, req);
+      cached_schedule_memory[target_proc] = result;
+      return result;
+    }
+
+  }; // namespace Mapping
+}; // namespace Legion
+
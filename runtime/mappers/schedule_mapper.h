@@ -0,0 +1,92 @@
+/* Copyright 2018 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef __SCHEDULE_MAPPER_H__
+#define __SCHEDULE_MAPPER_H__
+
+#include "legion.h"
+#include "mappers/default_mapper.h"
+
+#include <stdlib.h>
+#include <assert.h>
+
+namespace Legion {
+  namespace Mapping {
+
+    /**
+     * \class ScheduleMapper
+     * The schedule mapper replays a schedule computed offline from
+     * the Legion Prof logs of a previous run of the same application
+     * by tools/legion_prof_schedule.py. The schedule assigns each task
+     * ID a processor kind and a priority, and each processor kind a
+     * memory kind for placing instances. Anything the schedule does
+     * not mention is mapped the same way as the default mapper.
+     *
+     * Schedule files are plain text:
+     *   LegionSchedule v1
+     *   task <task id> <processor kind> <priority>
+     *   memory <processor kind> <memory kind>
+     * with kinds spelled as in realm_c.h (e.g. TOC_PROC, GPU_FB_MEM)
+     * and everything after a '#' ignored. Tasks cannot be scheduled
+     * onto UTIL_PROC or PROC_GROUP processors.
+     */
+    class ScheduleMapper : public DefaultMapper {
+    public:
+      struct TaskSchedule {
+      public:
+        TaskSchedule(void)
+          : kind(Processor::NO_KIND), priority(0) { }
+      public:
+        Processor::Kind kind;
+        TaskPriority priority;
+      };
+    public:
+      ScheduleMapper(MapperRuntime *rt, Machine machine, Processor local,
+                     const char *schedule_file,
+                     const char *mapper_name = NULL);
+      ScheduleMapper(const ScheduleMapper &rhs);
+      virtual ~ScheduleMapper(void);
+    public:
+      ScheduleMapper& operator=(const ScheduleMapper &rhs);
+    public:
+      static const char* create_schedule_name(Processor p);
+    protected: // default mapper policies that follow the schedule
+      virtual void default_policy_rank_processor_kinds(
+                                    MapperContext ctx, const Task &task,
+                                    std::vector<Processor::Kind> &ranking);
+      virtual TaskPriority default_policy_select_task_priority(
+                                    MapperContext ctx, const Task &task);
+      virtual Memory default_policy_select_target_memory(MapperContext ctx,
+                                    Processor target_proc,
+                                    const RegionRequirement &req);
+    protected:
+      bool parse_schedule_file(const char *schedule_file);
+      static bool parse_processor_kind(const char *name,
+                                       Processor::Kind &kind);
+      static bool is_schedulable_kind(Processor::Kind kind);
+      static bool parse_memory_kind(const char *name, Memory::Kind &kind);
+    protected:
+      std::map<TaskID,TaskSchedule> task_schedules;
+      std::map<Processor::Kind,Memory::Kind> memory_placements;
+      // Target memories chosen according to the memory placements
+      std::map<Processor,Memory> cached_schedule_memory;
+    };
+
+  }; // namespace Mapping
+}; // namespace Legion
+
+#endif // __SCHEDULE_MAPPER_H__
+
@@ -69,6 +69,8 @@ static const void *ignore_gasnet_warning2 __attribute__((unused)) = (void *)_gas
 #include "realm/threads.h"
 #include "realm/timers.h"
 #include "realm/logging.h"
+#include "realm/shm_transport.h"
+#include "realm/sampling.h"
 
 #define NO_DEBUG_AMREQUESTS
 
@@ -80,6 +82,15 @@ enum { MSGID_LONG_EXTENSION = 253,
 NodeID my_node_id = 0;
 NodeID max_node_id = 0;
 
+// message construction for transports that bypass GASNet handlers
+static IncomingMessageFactory incoming_message_factories[256];
+
+void add_incoming_message_factory(int msgid, IncomingMessageFactory factory)
+{
+  assert((msgid >= 0) && (msgid < 256));
+  incoming_message_factories[msgid] = factory;
+}
+
 // most of this file assumes the use of gasnet - stubs for a few entry
 //  points are defined at the bottom for the !USE_GASNET case
 #ifdef USE_GASNET
@@ -245,14 +256,39 @@ public:
   void handler_thread_loop(void);
 
 protected:
+  // the todo ring is a bounded multi-producer/multi-consumer queue - each
+  //  slot's sequence number says whether it is ready to be written or read
+  //  for a given lap around the ring
+  struct TodoSlot {
+    volatile unsigned seq;
+    int sender;
+  };
+
+  void todo_push(int sender);
+  bool todo_pop(int& sender);
+  bool todo_empty(void) const;
+  void wake_sleepers(void);
+
   int nodes;
-  int shutdown_flag;
-  IncomingMessage **heads;
-  IncomingMessage ***tails;
-  int *todo_list; // list of nodes with non-empty message lists
-  int todo_oldest, todo_newest;
+  volatile int shutdown_flag;
+  // each sender's pending messages form a lock-free stack (newest first) -
+  //  a handler thread takes the whole stack at once and reverses it, and
+  //  a sender is on the todo ring exactly when its stack is non-empty and
+  //  no handler has claimed it yet
+  IncomingMessage * volatile *pending;
+  TodoSlot *todo_ring;
+  unsigned todo_mask;
+  volatile unsigned todo_head, todo_tail;
+  // handler threads spin for a while before going to sleep - the mutex
+  //  and condvar are only used by sleepers and the threads that wake them
+  int spin_iterations;
+  volatile int num_sleepers;
   gasnet_hsl_t mutex;
   gasnett_cond_t condvar;
+  // per-message-type counts, merged from each handler thread as it exits
+  size_t handled_counts[256];
+  size_t batch_count, sleep_count;
+  long long start_time;
   Realm::CoreReservation *core_rsrv;
   std::vector<Realm::Thread *> handler_threads;
 };
@@ -357,6 +393,7 @@ struct OutgoingMessage {
   int payload_mode;
   void *dstptr;
   PayloadSource *payload_src;
+  PayloadCompletion *completion;
   int args[16];
 #ifdef DEBUG_MEM_REUSE
   int payload_num;
@@ -426,6 +463,25 @@ public:
 
 static SrcDataPool *srcdatapool = 0;
 
+// sampled gauges describing how outgoing payloads reach the network -
+//  created with the endpoints and never destroyed
+struct PayloadGauges {
+  PayloadGauges(void)
+    : spill_events("realm/amsg/spill events")
+    , pool_copy_bytes("realm/amsg/pool copy bytes")
+    , zero_copy_bytes("realm/amsg/zero copy bytes")
+  {}
+
+  // messages that could not get srcdatapool space right away
+  Realm::ProfilingGauges::EventCounter<long long> spill_events;
+  // payload bytes copied into the srcdatapool
+  Realm::ProfilingGauges::EventCounter<long long> pool_copy_bytes;
+  // payload bytes sent straight from the caller's buffer
+  Realm::ProfilingGauges::EventCounter<long long> zero_copy_bytes;
+};
+
+static PayloadGauges *payload_gauges = 0;
+
 size_t SrcDataPool::max_spill_bytes = 0;  // default = no limit
 size_t SrcDataPool::print_spill_threshold = 1 << 30;  // default = 1 GB
 size_t SrcDataPool::print_spill_step = 1 << 30;       // default = 1 GB
@@ -836,7 +892,7 @@ OutgoingMessage::OutgoingMessage(unsigned _msgid, unsigned _num_args,
 				 const void *_args)
   : msgid(_msgid), num_args(_num_args),
     payload(0), payload_size(0), payload_mode(PAYLOAD_NONE), dstptr(0),
-    payload_src(0)
+    payload_src(0), completion(0)
 {
   for(unsigned i = 0; i < _num_args; i++)
     args[i] = ((const int *)_args)[i];
@@ -874,6 +930,7 @@ static int num_lmbs = 2;
 static size_t lmb_size = 1 << 20; // 1 MB
 static bool force_long_messages = true;
 static int max_msgs_to_send = 8;
+static int handler_spin_iterations = 1000;
 
 // returns the largest payload that can be sent to a node (to a non-pinned
 //   address)
@@ -1018,16 +1075,28 @@ static DetailedMessageTiming detailed_message_timing;
 #endif
 
 IncomingMessageManager::IncomingMessageManager(int _nodes, Realm::CoreReservationSet& crs)
-  : nodes(_nodes), shutdown_flag(0)
+  : nodes(_nodes), shutdown_flag(0), spin_iterations(handler_spin_iterations)
+  , num_sleepers(0), batch_count(0), sleep_count(0), start_time(0)
 {
-  heads = new IncomingMessage *[nodes];
-  tails = new IncomingMessage **[nodes];
-  for(int i = 0; i < nodes; i++) {
-    heads[i] = 0;
-    tails[i] = 0;
+  pending = new IncomingMessage *[nodes];
+  for(int i = 0; i < nodes; i++)
+    pending[i] = 0;
+
+  // a sender is on the todo ring at most once, so 'nodes' entries suffice
+  unsigned todo_size = 2;
+  while(todo_size < (unsigned)nodes)
+    todo_size <<= 1;
+  todo_ring = new TodoSlot[todo_size];
+  for(unsigned i = 0; i < todo_size; i++) {
+    todo_ring[i].seq = i;
+    todo_ring[i].sender = -1;
   }
-  todo_list = new int[nodes + 1];  // an extra entry to distinguish full from empty
-  todo_oldest = todo_newest = 0;
+  todo_mask = todo_size - 1;
+  todo_head = todo_tail = 0;
+
+  for(int i = 0; i < 256; i++)
+    handled_counts[i] = 0;
+
   gasnet_hsl_init(&mutex);
   gasnett_cond_init(&condvar);
 
@@ -1037,9 +1106,68 @@ IncomingMessageManager::IncomingMessageManager(int _nodes, Realm::CoreReservatio
 
 IncomingMessageManager::~IncomingMessageManager(void)
 {
-  delete[] heads;
-  delete[] tails;
-  delete[] todo_list;
+  delete[] pending;
+  delete[] todo_ring;
+}
+
+void IncomingMessageManager::todo_push(int sender)
+{
+  unsigned pos = todo_tail;
+  TodoSlot *slot;
+  while(true) {
+    slot = &todo_ring[pos & todo_mask];
+    int diff = (int)(slot->seq - pos);
+    if(diff == 0) {
+      // slot is free for this lap - try to claim it
+      if(__sync_bool_compare_and_swap(&todo_tail, pos, pos + 1))
+	break;
+    } else
+      // should never fill up, since each sender appears at most once
+      assert(diff > 0);
+    pos = todo_tail;
+  }
+  slot->sender = sender;
+  __sync_synchronize();
+  slot->seq = pos + 1;
+}
+
+bool IncomingMessageManager::todo_pop(int& sender)
+{
+  unsigned pos = todo_head;
+  TodoSlot *slot;
+  while(true) {
+    slot = &todo_ring[pos & todo_mask];
+    int diff = (int)(slot->seq - (pos + 1));
+    if(diff == 0) {
+      if(__sync_bool_compare_and_swap(&todo_head, pos, pos + 1))
+	break;
+    } else if(diff < 0)
+      return false;  // empty (or the producer hasn't finished writing)
+    pos = todo_head;
+  }
+  __sync_synchronize();
+  sender = slot->sender;
+  __sync_synchronize();
+  slot->seq = pos + todo_mask + 1;
+  return true;
+}
+
+bool IncomingMessageManager::todo_empty(void) const
+{
+  return (todo_head == todo_tail);
+}
+
+void IncomingMessageManager::wake_sleepers(void)
+{
+  // a sleeper increments num_sleepers (while holding the mutex) before it
+  //  checks the todo ring, and we've updated the ring before looking here,
+  //  so one of us will see the other
+  __sync_synchronize();
+  if(num_sleepers > 0) {
+    gasnet_hsl_lock(&mutex);
+    gasnett_cond_signal(&condvar);
+    gasnet_hsl_unlock(&mutex);
+  }
 }
 
 void IncomingMessageManager::add_incoming_message(int sender, IncomingMessage *msg)
@@ -1047,29 +1175,23 @@ void IncomingMessageManager::add_incoming_message(int sender, IncomingMessage *m
 #ifdef DEBUG_INCOMING
   printf("adding incoming message from %d\n", sender);
 #endif
-  gasnet_hsl_lock(&mutex);
-  if(heads[sender]) {
-    // tack this on to the existing list
-    assert(tails[sender]);
-    *(tails[sender]) = msg;
-    tails[sender] = &(msg->next_msg);
-  } else {
-    // this starts a list, and the node needs to be added to the todo list
-    heads[sender] = msg;
-    tails[sender] = &(msg->next_msg);
-    todo_list[todo_newest] = sender;
-    todo_newest++;
-    if(todo_newest > nodes)
-      todo_newest = 0;
-    assert(todo_newest != todo_oldest);  // should never wrap around
-    gasnett_cond_broadcast(&condvar);  // wake up any sleepers
+  IncomingMessage *old_head;
+  do {
+    old_head = pending[sender];
+    msg->next_msg = old_head;
+  } while(!__sync_bool_compare_and_swap(&pending[sender], old_head, msg));
+
+  // if the stack was empty, this sender needs to be added to the todo list
+  if(!old_head) {
+    todo_push(sender);
+    wake_sleepers();
   }
-  gasnet_hsl_unlock(&mutex);
 }
 
 void IncomingMessageManager::start_handler_threads(int count, size_t stack_size)
 {
   handler_threads.resize(count);
+  start_time = Realm::Clock::current_time_in_nanoseconds();
 
   Realm::ThreadLaunchParameters tlp;
   tlp.set_stack_size(stack_size);
@@ -1097,43 +1219,77 @@ void IncomingMessageManager::shutdown(void)
     delete (*it);
   }
   handler_threads.clear();
+
+  // report message rates per handler
+  long long elapsed = Realm::Clock::current_time_in_nanoseconds() - start_time;
+  size_t total = 0;
+  for(int i = 0; i < 256; i++)
+    total += handled_counts[i];
+  if(total > 0) {
+    double secs = ((elapsed > 0) ? (elapsed * 1e-9) : 1.0);
+    log_amsg.info() << "handled " << total << " messages in " << batch_count
+		    << " batches (" << (total / secs) << "/s), handler sleeps = "
+		    << sleep_count;
+    for(int i = 0; i < 256; i++)
+      if(handled_counts[i] > 0)
+	log_amsg.info() << "  msgid " << i << ": count = " << handled_counts[i]
+			<< ", rate = " << (handled_counts[i] / secs) << "/s";
+  }
 }
 
 IncomingMessage *IncomingMessageManager::get_messages(int &sender, bool wait)
 {
-  gasnet_hsl_lock(&mutex);
-  while(todo_oldest == todo_newest) {
-    // todo list is empty
+  int spins = 0;
+  while(true) {
+    int s;
+    if(todo_pop(s)) {
+      // take everything this sender has queued and put it back in order
+      IncomingMessage *stack = __sync_lock_test_and_set(&pending[s],
+							(IncomingMessage *)0);
+      assert(stack != 0);
+      IncomingMessage *retval = 0;
+      while(stack) {
+	IncomingMessage *next = stack->next_msg;
+	stack->next_msg = retval;
+	retval = stack;
+	stack = next;
+      }
+      sender = s;
+#ifdef DEBUG_INCOMING
+      printf("handling incoming messages from %d\n", sender);
+#endif
+      return retval;
+    }
+
     if(shutdown_flag || !wait)
       break;
+
+    if(spins < spin_iterations) {
+      spins++;
+      continue;
+    }
+
+    // nothing showed up while spinning - go to sleep
 #ifdef DEBUG_INCOMING
     printf("incoming message list is empty - sleeping\n");
 #endif
-    gasnett_cond_wait(&condvar, &mutex.lock);
+    gasnet_hsl_lock(&mutex);
+    __sync_fetch_and_add(&num_sleepers, 1);
+    while(todo_empty() && !shutdown_flag) {
+      sleep_count++;
+      gasnett_cond_wait(&condvar, &mutex.lock);
+    }
+    __sync_fetch_and_sub(&num_sleepers, 1);
+    gasnet_hsl_unlock(&mutex);
+    spins = 0;
   }
-  IncomingMessage *retval;
-  if(todo_oldest == todo_newest) {
-    // still empty
-    sender = -1;
-    retval = 0;
-#ifdef DEBUG_INCOMING
-    printf("incoming message list is still empty!\n");
-#endif
-  } else {
-    // pop the oldest entry off the todo list
-    sender = todo_list[todo_oldest];
-    todo_oldest++;
-    if(todo_oldest > nodes)
-      todo_oldest = 0;
-    retval = heads[sender];
-    heads[sender] = 0;
-    tails[sender] = 0;
+
+  // still empty
+  sender = -1;
 #ifdef DEBUG_INCOMING
-    printf("handling incoming messages from %d\n", sender);
+  printf("incoming message list is still empty!\n");
 #endif
-  }
-  gasnet_hsl_unlock(&mutex);
-  return retval;
+  return 0;
 }    
 
 static IncomingMessageManager *incoming_message_manager = 0;
@@ -1152,6 +1308,12 @@ void IncomingMessageManager::handler_thread_loop(void)
   // messages enqueued in response to incoming messages can never be stalled
   ThreadLocal::always_allow_spilling = true;
 
+  // counted locally and merged at the end to avoid sharing cache lines
+  size_t counts[256];
+  for(int i = 0; i < 256; i++)
+    counts[i] = 0;
+  size_t batches = 0;
+
   while (true) {
     int sender = -1;
     IncomingMessage *current_msg = get_messages(sender);
@@ -1161,6 +1323,7 @@ void IncomingMessageManager::handler_thread_loop(void)
 #endif
       break;
     }
+    batches++;
 #ifdef DETAILED_MESSAGE_TIMING
     int count = 0;
 #endif
@@ -1171,6 +1334,7 @@ void IncomingMessageManager::handler_thread_loop(void)
       CurrentTime start_time;
 #endif
       current_msg->run_handler();
+      counts[current_msg->get_msgid() & 255]++;
 #ifdef DETAILED_MESSAGE_TIMING
       detailed_message_timing.record(timing_idx, 
 				     current_msg->get_peer(),
@@ -1184,6 +1348,12 @@ void IncomingMessageManager::handler_thread_loop(void)
       current_msg = next_msg;
     }
   }
+
+  gasnet_hsl_lock(&mutex);
+  for(int i = 0; i < 256; i++)
+    handled_counts[i] += counts[i];
+  batch_count += batches;
+  gasnet_hsl_unlock(&mutex);
 }
 
 class ActiveMessageEndpoint {
@@ -1870,6 +2040,14 @@ protected:
       gasnet_handlerarg_t srcptr_hi = ((uint64_t)(hdr->payload)) >> 32;
       hdr->args[message_id_start + 2] = srcptr_lo;
       hdr->args[message_id_start + 3] = srcptr_hi;
+    } else if(hdr->payload_mode == PAYLOAD_BORROW) {
+      // the receiver releases "srcptrs" once it has the whole payload - a
+      //  borrowed payload uses that to signal its completion, tagged with
+      //  the low bit to tell it apart from srcdatapool pointers
+      assert((((uintptr_t)(hdr->completion)) & 1) == 0);
+      uint64_t tagged = ((uint64_t)(hdr->completion)) | 1;
+      hdr->args[message_id_start + 2] = tagged & 0x0FFFFFFFFULL;
+      hdr->args[message_id_start + 3] = tagged >> 32;
     } else {
       hdr->args[message_id_start + 2] = 0;
       hdr->args[message_id_start + 3] = 0;
@@ -2110,6 +2288,16 @@ void OutgoingMessage::reserve_srcdata(void)
   //  just use it
   if((payload_mode == PAYLOAD_KEEPREG) && payload_src->get_contig_pointer()) {
     payload = payload_src->get_contig_pointer();
+    payload_gauges->zero_copy_bytes += payload_size;
+    return;
+  }
+
+  // a borrowed payload stays where it is until the completion is signalled
+  if(payload_mode == PAYLOAD_BORROW) {
+    payload = payload_src->get_contig_pointer();
+    delete payload_src;
+    payload_src = 0;
+    payload_gauges->zero_copy_bytes += payload_size;
     return;
   }
 
@@ -2156,6 +2344,7 @@ void OutgoingMessage::reserve_srcdata(void)
 
 	payload_mode = PAYLOAD_PENDING;
 	srcdatapool->add_pending(this, held_lock);
+	payload_gauges->spill_events += 1;
       }
     }
 
@@ -2164,6 +2353,7 @@ void OutgoingMessage::reserve_srcdata(void)
       payload_src->copy_data(srcptr);
       delete payload_src;
       payload_src = 0;
+      payload_gauges->pool_copy_bytes += payload_size;
     }
   } else {
     // no srcdatapool needed, but might still have to copy
@@ -2190,6 +2380,7 @@ void OutgoingMessage::assign_srcdata_pointer(void *ptr)
   assert(payload_mode == PAYLOAD_PENDING);
   assert(payload_src != 0);
   payload_src->copy_data(ptr);
+  payload_gauges->pool_copy_bytes += payload_size;
 
   bool was_using_spill = (payload_src->get_payload_mode() == PAYLOAD_FREE);
 
@@ -2403,6 +2594,54 @@ private:
 
 static EndpointManager *endpoint_manager;
 
+// co-located ranks exchange messages through shared memory when enabled
+static Realm::SharedMemoryTransport *shm_transport = 0;
+
+// an incoming shared memory message whose payload buffer we own
+class ShmIncomingMessage : public IncomingMessage {
+public:
+  ShmIncomingMessage(IncomingMessage *_inner, void *_buffer)
+    : inner(_inner), buffer(_buffer)
+  {}
+
+  virtual ~ShmIncomingMessage(void)
+  {
+    delete inner;
+    free(buffer);
+  }
+
+  virtual void run_handler(void) { inner->run_handler(); }
+
+  virtual int get_peer(void) { return inner->get_peer(); }
+  virtual int get_msgid(void) { return inner->get_msgid(); }
+  virtual size_t get_msgsize(void) { return inner->get_msgsize(); }
+
+protected:
+  IncomingMessage *inner;
+  void *buffer;
+};
+
+static void shm_deliver_message(NodeID sender, int msgid,
+				const void *args, size_t arg_size,
+				void *payload, size_t payload_size,
+				bool dstptr_used)
+{
+  IncomingMessageFactory factory = incoming_message_factories[msgid];
+  assert(factory != 0);
+  IncomingMessage *imsg = (*factory)(sender, args, arg_size,
+				     payload, payload_size);
+  if(payload && !dstptr_used)
+    imsg = new ShmIncomingMessage(imsg, payload);
+  record_message(sender, false);
+  enqueue_incoming(sender, imsg);
+}
+
+static void shm_barrier(void)
+{
+  gasnet_barrier_notify(0, GASNET_BARRIERFLAG_ANONYMOUS);
+  gasnet_barrier_wait(0, GASNET_BARRIERFLAG_ANONYMOUS);
+}
+
 static void handle_flip_req(gasnet_token_t token,
 		     int flip_buffer, int flip_count)
 {
@@ -2442,6 +2681,8 @@ void init_endpoints(int gasnet_mem_size_in_mb,
   size_t spillwarn_in_mb = 0;
   size_t spillstep_in_mb = 0;
   size_t spillstall_in_mb = 0;
+  bool use_shm = false;
+  size_t shm_ring_in_kb = 1024;
 
   Realm::CommandLineParser cp;
   cp.add_option_int("-ll:numlmbs", num_lmbs)
@@ -2451,7 +2692,10 @@ void init_endpoints(int gasnet_mem_size_in_mb,
     .add_option_int("-ll:maxsend", max_msgs_to_send)
     .add_option_int("-ll:spillwarn", spillwarn_in_mb)
     .add_option_int("-ll:spillstep", spillstep_in_mb)
-    .add_option_int("-ll:spillstall", spillstep_in_mb);
+    .add_option_int("-ll:spillstall", spillstep_in_mb)
+    .add_option_int("-ll:amspin", handler_spin_iterations)
+    .add_option_bool("-ll:shm", use_shm)
+    .add_option_int("-ll:shm_ring", shm_ring_in_kb);
 
   bool ok = cp.parse_command_line(cmdline);
   assert(ok);
@@ -2550,9 +2794,21 @@ void init_endpoints(int gasnet_mem_size_in_mb,
   if(srcdatapool_size > 0)
     srcdatapool = new SrcDataPool(srcdatapool_base, srcdatapool_size);
 #endif
+  payload_gauges = new PayloadGauges;
 
   endpoint_manager = new EndpointManager(gasnet_nodes(), crs);
 
+  // collective, so every rank has to agree on whether to do this - a rank
+  //  that fails to set up shared memory keeps the transport (with no local
+  //  peers) so that it still takes part in later collective calls
+  if(use_shm && (gasnet_nodes() > 1)) {
+    shm_transport = new Realm::SharedMemoryTransport;
+    shm_transport->init(Realm::SharedMemoryTransport::default_key(),
+			gasnet_mynode(), gasnet_nodes(),
+			shm_ring_in_kb << 10,
+			shm_deliver_message, shm_barrier);
+  }
+
   init_deferred_frees();
 }
 
@@ -2563,6 +2819,32 @@ void do_some_polling(void)
   endpoint_manager->push_messages(max_msgs_to_send);
 
   CHECK_GASNET( gasnet_AMPoll() );
+
+  if(shm_transport)
+    shm_transport->poll();
+}
+
+void polling_barrier(void)
+{
+  gasnet_barrier_notify(0, GASNET_BARRIERFLAG_ANONYMOUS);
+  if(!shm_transport) {
+    gasnet_barrier_wait(0, GASNET_BARRIERFLAG_ANONYMOUS);
+    return;
+  }
+  // gasnet makes progress on its own messages while it waits, but a peer
+  //  may also be blocked on a full ring until we drain it (with -ll:amsg 0
+  //  there's no polling thread to do that for us)
+  int status;
+  while((status = gasnet_barrier_try(0, GASNET_BARRIERFLAG_ANONYMOUS)) == GASNET_ERR_NOT_READY) {
+    CHECK_GASNET( gasnet_AMPoll() );
+    shm_transport->poll();
+  }
+  CHECK_GASNET(status);
+}
+
+Realm::SharedMemoryTransport *get_shm_transport(void)
+{
+  return shm_transport;
 }
 
 void EndpointManager::start_polling_threads(int count)
@@ -2624,6 +2906,9 @@ void EndpointManager::polling_worker_loop(void)
 
     CHECK_GASNET( gasnet_AMPoll() );
 
+    if(shm_transport)
+      shm_transport->poll();
+
 #ifdef TRACE_MESSAGES
     // see if it's time to write out another update
     int now = (int)(Realm::Clock::current_time());
@@ -2675,6 +2960,18 @@ void stop_activemsg_threads(void)
 
   // print final spill stats at a low logging level
   srcdatapool->print_spill_data(Realm::Logger::LEVEL_INFO);
+
+  // peers may still be finishing their own shutdown, so leave the rings
+  //  mapped (the kernel cleans up at exit) and just report what we did
+  if(shm_transport) {
+    Realm::SharedMemoryTransport::Stats stats;
+    shm_transport->get_stats(stats);
+    log_amsg.info() << "shm: node " << gasnet_mynode()
+		    << ": sent=" << stats.msgs_sent << " (" << stats.bytes_sent
+		    << " bytes, " << stats.fragments_sent << " fragments)"
+		    << " rcvd=" << stats.msgs_rcvd << " (" << stats.bytes_rcvd
+		    << " bytes) full_waits=" << stats.full_waits;
+  }
 }
 	
 void enqueue_message(NodeID target, int msgid,
@@ -2684,6 +2981,17 @@ void enqueue_message(NodeID target, int msgid,
 {
   assert((gasnet_node_t)target != gasnet_mynode());
 
+  if(shm_transport && shm_transport->is_local_peer(target)) {
+    struct iovec iov;
+    iov.iov_base = const_cast<void *>(payload);
+    iov.iov_len = ((payload_mode != PAYLOAD_NONE) ? payload_size : 0);
+    shm_transport->send(target, msgid, args, arg_size,
+			&iov, 1, iov.iov_len, dstptr);
+    if(payload_mode == PAYLOAD_FREE)
+      free(const_cast<void *>(payload));
+    return;
+  }
+
   OutgoingMessage *hdr = new OutgoingMessage(msgid, 
 					     (arg_size + sizeof(int) - 1) / sizeof(int),
 					     args);
@@ -2715,6 +3023,23 @@ void enqueue_message(NodeID target, int msgid,
 {
   assert((gasnet_node_t)target != gasnet_mynode());
 
+  if(shm_transport && shm_transport->is_local_peer(target)) {
+    if(payload_mode == PAYLOAD_NONE)
+      line_count = 0;
+    std::vector<struct iovec> iovs(line_count);
+    for(size_t i = 0; i < line_count; i++) {
+      iovs[i].iov_base = const_cast<char *>(static_cast<const char *>(payload) +
+					    i * line_stride);
+      iovs[i].iov_len = line_size;
+    }
+    shm_transport->send(target, msgid, args, arg_size,
+			(line_count ? &iovs[0] : 0), line_count,
+			line_size * line_count, dstptr);
+    if(payload_mode == PAYLOAD_FREE)
+      free(const_cast<void *>(payload));
+    return;
+  }
+
   OutgoingMessage *hdr = new OutgoingMessage(msgid, 
 					     (arg_size + sizeof(int) - 1) / sizeof(int),
 					     args);
@@ -2740,6 +3065,22 @@ void enqueue_message(NodeID target, int msgid,
 {
   assert((gasnet_node_t)target != gasnet_mynode());
 
+  if(shm_transport && shm_transport->is_local_peer(target)) {
+    std::vector<struct iovec> iovs;
+    if(payload_mode != PAYLOAD_NONE) {
+      iovs.resize(spans.size());
+      for(size_t i = 0; i < spans.size(); i++) {
+	iovs[i].iov_base = const_cast<void *>(spans[i].first);
+	iovs[i].iov_len = spans[i].second;
+      }
+    } else
+      payload_size = 0;
+    shm_transport->send(target, msgid, args, arg_size,
+			(iovs.empty() ? 0 : &iovs[0]), iovs.size(),
+			payload_size, dstptr);
+    return;
+  }
+
   OutgoingMessage *hdr = new OutgoingMessage(msgid, 
   					     (arg_size + sizeof(int) - 1) / sizeof(int),
   					     args);
@@ -2757,6 +3098,45 @@ void enqueue_message(NodeID target, int msgid,
   endpoint_manager->enqueue_message(target, hdr, true); // TODO: decide when OOO is ok?
 }
 
+void enqueue_message(NodeID target, int msgid,
+		     const void *args, size_t arg_size,
+		     const void *payload, size_t payload_size,
+		     PayloadCompletion *completion, void *dstptr)
+{
+  assert((gasnet_node_t)target != gasnet_mynode());
+  assert(completion != 0);
+
+  // the shared memory transport copies synchronously, so the payload is
+  //  free to be reused as soon as the send returns
+  if(shm_transport && shm_transport->is_local_peer(target)) {
+    struct iovec iov;
+    iov.iov_base = const_cast<void *>(payload);
+    iov.iov_len = payload_size;
+    shm_transport->send(target, msgid, args, arg_size,
+			&iov, 1, payload_size, dstptr);
+    completion->payload_sent();
+    return;
+  }
+
+  // nothing for the receiver to release for an empty payload
+  if(payload_size == 0) {
+    enqueue_message(target, msgid, args, arg_size,
+		    payload, 0, PAYLOAD_COPY, dstptr);
+    completion->payload_sent();
+    return;
+  }
+
+  OutgoingMessage *hdr = new OutgoingMessage(msgid, 
+					     (arg_size + sizeof(int) - 1) / sizeof(int),
+					     args);
+  hdr->completion = completion;
+  PayloadSource *payload_src = 
+    new ContiguousPayload((void *)payload, payload_size, PAYLOAD_BORROW);
+  hdr->set_payload(payload_src, payload_size, PAYLOAD_BORROW, dstptr);
+
+  endpoint_manager->enqueue_message(target, hdr, true); // TODO: decide when OOO is ok?
+}
+
 void handle_long_msgptr(NodeID source, const void *ptr)
 {
   assert((gasnet_node_t)source != gasnet_mynode());
@@ -2771,7 +3151,9 @@ void handle_long_msgptr(NodeID source, const void *ptr)
   uintptr_t srcptr = (((uint64_t)(uint32_t)arg1) << 32) | ((uint32_t)arg0);
   // We may get pointers which are zero because we had to send a reply
   // Just ignore them
-  if (srcptr != 0)
+  if ((srcptr & 1) != 0)
+    reinterpret_cast<PayloadCompletion *>(srcptr - 1)->payload_sent();
+  else if (srcptr != 0)
     srcdatapool->release_srcptr((void *)srcptr);
 #ifdef TRACE_MESSAGES
   gasnet_node_t src;
@@ -2931,11 +3313,29 @@ void enqueue_message(NodeID target, int msgid,
   assert(0 && "compiled without USE_GASNET - active messages not available!");
 }
 
+void enqueue_message(NodeID target, int msgid,
+		     const void *args, size_t arg_size,
+		     const void *payload, size_t payload_size,
+		     PayloadCompletion *completion, void *dstptr)
+{
+  assert(0 && "compiled without USE_GASNET - active messages not available!");
+}
+
 void do_some_polling(void)
 {
   assert(0 && "compiled without USE_GASNET - active messages not available!");
 }
 
+void polling_barrier(void)
+{
+  // only one node
+}
+
+Realm::SharedMemoryTransport *get_shm_transport(void)
+{
+  return 0;
+}
+
 size_t get_lmb_size(NodeID target_node)
 {
   return 0;
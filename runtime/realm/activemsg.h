@@ -23,6 +23,7 @@
 #include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <vector>
 #include <string>
 
@@ -106,6 +107,26 @@ enum { PAYLOAD_NONE, // no payload in packet
        PAYLOAD_PENDING, // payload needs to be copied, but hasn't yet
        PAYLOAD_KEEPREG, // use payload pointer, AND it's registered!
        PAYLOAD_EMPTY, // message can have payload, but this one is 0 bytes
+       PAYLOAD_BORROW, // use payload pointer until the completion is signalled
+};
+
+// a caller that can keep a payload alive until the network is done with it
+//  passes one of these (with PAYLOAD_BORROW) to skip the copy into the
+//  srcdatapool - payload_sent() is called exactly once, possibly from a
+//  network handler, so it must be quick and must not send messages
+class PayloadCompletion {
+public:
+  virtual ~PayloadCompletion(void) {}
+  virtual void payload_sent(void) = 0;
+};
+
+// frees a malloc'd payload once it has been sent, and then itself
+class FreePayloadCompletion : public PayloadCompletion {
+public:
+  FreePayloadCompletion(void *_payload) : payload(_payload) {}
+  virtual void payload_sent(void) { free(payload); delete this; }
+protected:
+  void *payload;
 };
 
 typedef std::pair<const void *, size_t> SpanListEntry;
@@ -113,6 +134,7 @@ typedef std::vector<SpanListEntry> SpanList;
 
 namespace Realm {
   class CoreReservationSet;
+  class SharedMemoryTransport;
 };
 
 // for uint64_t, int32_t
@@ -203,6 +225,14 @@ extern size_t get_lmb_size(NodeID target_node);
 //  to the caller rather than spinning
 extern void do_some_polling(void);
 
+// waits for every node to call this too, delivering incoming messages
+//  (including those that bypass GASNet) in the meantime
+extern void polling_barrier(void);
+
+// the transport for messages between nodes on the same host, or 0 if shared
+//  memory is not in use - either every node has one or none does
+extern Realm::SharedMemoryTransport *get_shm_transport(void);
+
 /* Necessary base structure for all medium and long active messages */
 struct BaseMedium {
   static const handlerarg_t MESSAGE_ID_MAGIC = 0x0bad0bad;
@@ -241,6 +271,13 @@ extern void enqueue_message(NodeID target, int msgid,
 			    const SpanList& spans, size_t payload_size,
 			    int payload_mode, void *dstptr = 0);
 
+// sends a contiguous payload without copying it - 'completion' is signalled
+//  once 'payload' may be reused
+extern void enqueue_message(NodeID target, int msgid,
+			    const void *args, size_t arg_size,
+			    const void *payload, size_t payload_size,
+			    PayloadCompletion *completion, void *dstptr = 0);
+
 class IncomingMessage; // defined below
 class IncomingMessageManager;
 
@@ -252,6 +289,14 @@ extern bool adjust_long_msgsize(NodeID source, void *&ptr, size_t &buffer_size,
 				int message_id, int chunks);
 extern void record_message(NodeID source, bool sent_reply);
 
+// builds an incoming message from raw arguments and payload for transports
+//  that don't go through GASNet handlers (e.g. shared memory) - registered
+//  automatically for every short and medium message type
+typedef IncomingMessage *(*IncomingMessageFactory)(NodeID sender,
+						   const void *args, size_t arg_size,
+						   const void *payload, size_t payload_size);
+extern void add_incoming_message_factory(int msgid, IncomingMessageFactory factory);
+
 #ifdef REALM_PROFILE_AM_HANDLERS
 // have to define this two different ways because we can't put ifdefs in the macros below
 extern void record_activemsg_profiling(int msgid,
@@ -521,6 +566,26 @@ struct MessageRawArgs<MSGTYPE, MSGID, SHORT_HNDL_PTR, MED_HNDL_PTR, n> { \
     } else \
       record_message(src, false);				\
   } \
+\
+  static IncomingMessage *create_short(NodeID src, \
+                                       const void *args, size_t arg_size, \
+                                       const void *payload, size_t payload_size) \
+  { \
+    ISHORT *imsg = new ISHORT(src); \
+    assert(arg_size <= sizeof(imsg->u)); \
+    memcpy(&imsg->u, args, arg_size); \
+    return imsg; \
+  } \
+\
+  static IncomingMessage *create_medium(NodeID src, \
+                                        const void *args, size_t arg_size, \
+                                        const void *payload, size_t payload_size) \
+  { \
+    IMED *imsg = new IMED(src, payload, payload_size); \
+    assert(arg_size <= sizeof(imsg->u)); \
+    memcpy(&imsg->u, args, arg_size); \
+    return imsg; \
+  } \
 };
 
 // all messages are at least 8 bytes - no RAW_ARGS(1)
@@ -567,6 +632,7 @@ class ActiveMessageShortNoReply {
   {
     assert(sizeof(MessageRawArgsType) <= 64);  // max of 16 4-byte args
     add_handler_entry(MSGID, reinterpret_cast<void (*)()>(MessageRawArgsType::handler_short));
+    add_incoming_message_factory(MSGID, MessageRawArgsType::create_short);
 #ifdef ACTIVE_MESSAGE_TRACE
     record_am_handler(MSGID, description);
 #endif
@@ -606,10 +672,20 @@ class ActiveMessageMediumNoReply {
 		    spans, datalen, payload_mode, dstptr);
   }
 
+  static void request(NodeID dest, /*const*/ MSGTYPE &args, 
+                      const void *data, size_t datalen,
+		      PayloadCompletion *completion, void *dstptr = 0)
+  {
+    args.set_magic();
+    enqueue_message(dest, MSGID, &args, sizeof(MSGTYPE),
+		    data, datalen, completion, dstptr);
+  }
+
   static void add_handler_entries(const char *description)
   {
     assert(sizeof(MessageRawArgsType) <= 64);  // max of 16 4-byte args
     add_handler_entry(MSGID, reinterpret_cast<void (*)()>(MessageRawArgsType::handler_medium));
+    add_incoming_message_factory(MSGID, MessageRawArgsType::create_medium);
 #ifdef ACTIVE_MESSAGE_TRACE
     record_am_handler(MSGID, description);
 #endif
@@ -801,6 +877,13 @@ public:
   {
     assert(0 && "compiled without USE_GASNET - active messages not available!");
   }
+
+  static void request(gasnet_node_t dest, /*const*/ MSGTYPE &args, 
+                      const void *data, size_t datalen,
+		      PayloadCompletion *completion, void *dstptr = 0)
+  {
+    assert(0 && "compiled without USE_GASNET - active messages not available!");
+  }
 };
 
 template <class T> struct HandlerReplyFuture {
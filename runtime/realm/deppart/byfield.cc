@@ -22,6 +22,8 @@
 #include "realm/deppart/inst_helper.h"
 #include "realm/logging.h"
 
+#include <algorithm>
+
 namespace Realm {
 
   extern Logger log_part;
@@ -53,6 +55,77 @@ namespace Realm {
     return e;
   }
 
+  template <int N, typename T>
+  template <typename FT>
+  Event IndexSpace<N,T>::update_subspaces_by_field(const std::vector<FieldDataDescriptor<IndexSpace<N,T>,FT> >& field_data,
+						    const std::vector<FT>& colors,
+						    const std::vector<IndexSpace<N,T> >& prev_subspaces,
+						    const IndexSpace<N,T>& dirty,
+						    const std::vector<FT>& changed_colors,
+						    std::vector<IndexSpace<N,T> >& subspaces,
+						    const ProfilingRequestSet &reqs,
+						    Event wait_on /*= Event::NO_EVENT*/) const
+  {
+    // output vector should start out empty
+    assert(subspaces.empty());
+    assert(prev_subspaces.size() == colors.size());
+
+    // record the start time of the potentially-inline operation if any
+    //  profiling has been requested
+    long long inline_start_time = reqs.empty() ? 0 : Clock::current_time_in_nanoseconds();
+
+    // colors that no dirty point had or has keep their previous subspaces -
+    //  only the rest need to be recomputed
+    subspaces = prev_subspaces;
+    std::vector<size_t> dirty_idxs;
+    std::vector<FT> dirty_colors;
+    std::vector<IndexSpace<N,T> > dirty_prevs;
+    if(!dirty.empty())
+      for(size_t i = 0; i < colors.size(); i++)
+	if(std::find(changed_colors.begin(), changed_colors.end(),
+		     colors[i]) != changed_colors.end()) {
+	  dirty_idxs.push_back(i);
+	  dirty_colors.push_back(colors[i]);
+	  dirty_prevs.push_back(prev_subspaces[i]);
+	}
+
+    // nothing changed, so the previous partition is still correct
+    if(dirty_idxs.empty()) {
+      PartitioningOperation::do_inline_profiling(reqs, inline_start_time);
+      return wait_on;
+    }
+
+    // re-evaluate the field only for the dirty points - using the dirty space
+    //  as the parent keeps the microops from scanning anything outside it
+    std::vector<IndexSpace<N,T> > changed;
+    Event e1 = dirty.create_subspaces_by_field(field_data, dirty_colors, changed,
+					       ProfilingRequestSet(), wait_on);
+
+    // strip the dirty points from the previous subspaces
+    std::vector<IndexSpace<N,T> > kept;
+    Event e2 = compute_differences(dirty_prevs, dirty, kept,
+				   ProfilingRequestSet(), wait_on);
+
+    std::vector<IndexSpace<N,T> > updated;
+    Event e = compute_unions(kept, changed, updated, reqs,
+			     Event::merge_events(e1, e2));
+
+    // the intermediate spaces are not needed once the unions are computed,
+    //  unless the union just passed one of them through
+    for(size_t j = 0; j < dirty_idxs.size(); j++) {
+      size_t i = dirty_idxs[j];
+      subspaces[i] = updated[j];
+      log_dpops.info() << "byfield(update): " << *this << ", " << colors[i] << " dirty=" << dirty << " prev=" << prev_subspaces[i] << " -> " << subspaces[i] << " (" << e << ")";
+      if(changed[j].sparsity != updated[j].sparsity)
+	changed[j].destroy(e);
+      if((kept[j].sparsity != prev_subspaces[i].sparsity) &&
+	 (kept[j].sparsity != updated[j].sparsity))
+	kept[j].destroy(e);
+    }
+
+    return e;
+  }
+
 
   ////////////////////////////////////////////////////////////////////////
   //
@@ -331,6 +404,14 @@ namespace Realm {
   template class ByFieldOperation<N,T,F>; \
   template ByFieldMicroOp<N,T,F>::ByFieldMicroOp(NodeID, AsyncMicroOp *, Serialization::FixedBufferDeserializer&); \
   template Event IndexSpace<N,T>::create_subspaces_by_field(const std::vector<FieldDataDescriptor<IndexSpace<N,T>,F> >&, \
+							     const std::vector<F>&, \
+							     std::vector<IndexSpace<N,T> >&, \
+							     const ProfilingRequestSet &, \
+							     Event) const; \
+  template Event IndexSpace<N,T>::update_subspaces_by_field(const std::vector<FieldDataDescriptor<IndexSpace<N,T>,F> >&, \
+							     const std::vector<F>&, \
+							     const std::vector<IndexSpace<N,T> >&, \
+							     const IndexSpace<N,T>&, \
 							     const std::vector<F>&, \
 							     std::vector<IndexSpace<N,T> >&, \
 							     const ProfilingRequestSet &, \
@@ -154,7 +154,7 @@ namespace Realm {
 
   template <int N, typename T>
   SparsityMapPublicImpl<N,T>::SparsityMapPublicImpl(void)
-    : entries_valid(false), approx_valid(false)
+    : entries_valid(false), approx_valid(false), shared_entries(0)
   {}
 
   // call actual implementation - inlining makes this cheaper than a virtual method
@@ -166,13 +166,107 @@ namespace Realm {
   }
 
 
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class SparsityMapInternTable<N,T>
+
+  template <int N, typename T>
+  static bool same_entries(const std::vector<SparsityMapEntry<N,T> >& a,
+			   const std::vector<SparsityMapEntry<N,T> >& b)
+  {
+    if(a.size() != b.size())
+      return false;
+    for(size_t i = 0; i < a.size(); i++)
+      if((a[i].bounds != b[i].bounds) ||
+	 (a[i].sparsity != b[i].sparsity) ||
+	 (a[i].bitmap != b[i].bitmap))
+	return false;
+    return true;
+  }
+
+  template <int N, typename T>
+  typename SparsityMapInternTable<N,T>::SharedEntries *SparsityMapInternTable<N,T>::intern(std::vector<SparsityMapEntry<N,T> >& entries,
+											   unsigned long long hash)
+  {
+    AutoHSLLock al(mutex);
+
+    std::pair<typename std::multimap<unsigned long long, SharedEntries *>::const_iterator,
+	      typename std::multimap<unsigned long long, SharedEntries *>::const_iterator> range = table.equal_range(hash);
+    for(typename std::multimap<unsigned long long, SharedEntries *>::const_iterator it = range.first;
+	it != range.second;
+	++it)
+      if(same_entries(it->second->entries, entries))
+	return it->second;
+
+    // first time we've seen these contents - take them over
+    SharedEntries *shared = new SharedEntries;
+    shared->hash = hash;
+    shared->entries.swap(entries);
+    table.insert(std::make_pair(hash, shared));
+    return shared;
+  }
+
+  template <int N, typename T>
+  typename SparsityMapInternTable<N,T>::SharedEntries *SparsityMapInternTable<N,T>::lookup(unsigned long long hash,
+											   size_t count)
+  {
+    AutoHSLLock al(mutex);
+
+    // a hash collision between two entry lists of the same length is not an error,
+    //  but makes the hash useless as a name for either of them
+    SharedEntries *found = 0;
+    std::pair<typename std::multimap<unsigned long long, SharedEntries *>::const_iterator,
+	      typename std::multimap<unsigned long long, SharedEntries *>::const_iterator> range = table.equal_range(hash);
+    for(typename std::multimap<unsigned long long, SharedEntries *>::const_iterator it = range.first;
+	it != range.second;
+	++it)
+      if(it->second->entries.size() == count) {
+	if(found)
+	  return 0;
+	found = it->second;
+      }
+    return found;
+  }
+
+  template <int N, typename T>
+  bool SparsityMapInternTable<N,T>::add_holder(SharedEntries *shared, NodeID node)
+  {
+    AutoHSLLock al(mutex);
+
+    if(shared->known_holders.contains(node))
+      return true;
+    shared->known_holders.add(node);
+    return false;
+  }
+
+  template <int N, typename T>
+  /*static*/ unsigned long long SparsityMapInternTable<N,T>::compute_hash(const std::vector<SparsityMapEntry<N,T> >& entries)
+  {
+    // FNV-1a over the bounds of every entry
+    unsigned long long h = 0xcbf29ce484222325ULL;
+    for(typename std::vector<SparsityMapEntry<N,T> >::const_iterator it = entries.begin();
+	it != entries.end();
+	++it) {
+      const unsigned char *p = reinterpret_cast<const unsigned char *>(&(it->bounds));
+      for(size_t i = 0; i < sizeof(Rect<N,T>); i++) {
+	h ^= p[i];
+	h *= 0x100000001b3ULL;
+      }
+    }
+    return h;
+  }
+
+
   ////////////////////////////////////////////////////////////////////////
   //
   // class SparsityMapImpl<N,T>
 
+  template <int N, typename T>
+  /*static*/ SparsityMapInternTable<N,T> SparsityMapImpl<N,T>::intern_table;
+
   template <int N, typename T>
   SparsityMapImpl<N,T>::SparsityMapImpl(SparsityMap<N,T> _me)
-    : me(_me), remaining_contributor_count(0)
+    : me(_me), interned(0), remaining_contributor_count(0)
     , precise_requested(false), approx_requested(false)
     , precise_ready_event(Event::NO_EVENT), approx_ready_event(Event::NO_EVENT)
     , sizeof_precise(0)
@@ -477,6 +571,26 @@ namespace Realm {
     }
   }
 
+  template <int N, typename T>
+  bool SparsityMapImpl<N,T>::contribute_interned(unsigned long long hash, size_t count)
+  {
+    // only remote copies are ever filled in this way
+    assert(ID(me).sparsity.creator_node != my_node_id);
+    assert(precise_requested);
+
+    typename SparsityMapInternTable<N,T>::SharedEntries *shared = intern_table.lookup(hash, count);
+    if(!shared)
+      return false;
+
+    {
+      AutoHSLLock al(mutex);
+      assert(this->entries.empty() && !interned);
+      interned = shared;
+    }
+    finalize();
+    return true;
+  }
+
   // adds a microop as a waiter for valid sparsity map data - returns true
   //  if the uop is added to the list (i.e. will be getting a callback at some point),
   //  or false if the sparsity map became valid before this call (i.e. no callback)
@@ -529,7 +643,8 @@ namespace Realm {
   }
 
   template <int N, typename T>
-  void SparsityMapImpl<N,T>::remote_data_request(NodeID requestor, bool send_precise, bool send_approx)
+  void SparsityMapImpl<N,T>::remote_data_request(NodeID requestor, bool send_precise, bool send_approx,
+						 bool allow_by_hash)
   {
     // first sanity check - we should be the owner of the data
     assert(ID(me).sparsity.creator_node == my_node_id);
@@ -559,12 +674,13 @@ namespace Realm {
     }
 
     if(reply_approx || reply_precise)
-      remote_data_reply(requestor, reply_precise, reply_approx);
+      remote_data_reply(requestor, reply_precise, reply_approx, allow_by_hash);
   }
 
   
   template <int N, typename T>
-  void SparsityMapImpl<N,T>::remote_data_reply(NodeID requestor, bool reply_precise, bool reply_approx)
+  void SparsityMapImpl<N,T>::remote_data_reply(NodeID requestor, bool reply_precise, bool reply_approx,
+					       bool allow_by_hash /*= true*/)
   {
     if(reply_approx) {
       // TODO
@@ -572,15 +688,28 @@ namespace Realm {
     }
 
     if(reply_precise) {
+      // if the requestor has already been sent these contents (for this or any
+      //  other sparsity map), the hash is enough for it to find its copy
+      if(interned && intern_table.add_holder(interned, requestor) && allow_by_hash) {
+	log_part.info() << "sending interned data: sparsity=" << me << " target=" << requestor
+			<< " hash=" << std::hex << interned->hash << std::dec;
+	RemoteSparsityContribMessage::send_interned<N,T>(requestor, me, interned->hash,
+							 interned->entries.size());
+	return;
+      }
+
       log_part.info() << "sending precise data: sparsity=" << me << " target=" << requestor;
       
       int seq_id = fragment_assembler.get_sequence_id();
       int seq_count = 0;
 
       // scan the entry list, sending bitmaps first and making a list of rects
+      const std::vector<SparsityMapEntry<N,T> >& entries = (interned ?
+							      interned->entries :
+							      this->entries);
       std::vector<Rect<N,T> > rects;
-      for(typename std::vector<SparsityMapEntry<N,T> >::const_iterator it = this->entries.begin();
-	  it != this->entries.end();
+      for(typename std::vector<SparsityMapEntry<N,T> >::const_iterator it = entries.begin();
+	  it != entries.end();
 	  it++) {
 	if(it->bitmap) {
 	  // TODO: send bitmap
@@ -619,6 +748,17 @@ namespace Realm {
     return lhs.bounds.lo.x < rhs.bounds.lo.x;
   }
 
+  template <int N, typename T>
+  static inline bool non_overlapping_bounds_nd_comp(const SparsityMapEntry<N,T>& lhs,
+						    const SparsityMapEntry<N,T>& rhs)
+  {
+    // non-overlapping rectangles are totally ordered by their lo points
+    for(int i = N - 1; i >= 0; i--)
+      if(lhs.bounds.lo[i] != rhs.bounds.lo[i])
+	return lhs.bounds.lo[i] < rhs.bounds.lo[i];
+    return false;
+  }
+
   template <int N, typename T>
   static void compute_approximation(const std::vector<SparsityMapEntry<N,T> >& entries,
 				    std::vector<Rect<N,T> >& approx_rects,
@@ -714,22 +854,49 @@ namespace Realm {
       std::sort(this->entries.begin(), this->entries.end(), non_overlapping_bounds_1d_comp<N,T>);
       for(size_t i = 1; i < this->entries.size(); i++)
 	assert(this->entries[i-1].bounds.hi.x < (this->entries[i].bounds.lo.x - 1));
+    } else {
+      // order doesn't matter for N>1, but a canonical order lets maps built from
+      //  contributions that arrived in different orders be interned together
+      std::sort(this->entries.begin(), this->entries.end(), non_overlapping_bounds_nd_comp<N,T>);
     }
 
+    // move the entries into the intern table, sharing an existing copy if there
+    //  is one with the same contents (this is already done for remote copies
+    //  that were filled in by hash)
+    if(!interned) {
+      bool all_dense = true;
+      for(size_t i = 0; i < this->entries.size(); i++)
+	if(this->entries[i].sparsity.exists() || (this->entries[i].bitmap != 0)) {
+	  all_dense = false;
+	  break;
+	}
+      if(all_dense) {
+	unsigned long long hash = SparsityMapInternTable<N,T>::compute_hash(this->entries);
+	interned = intern_table.intern(this->entries, hash);
+	// if the contents were already present, our copy is no longer needed
+	std::vector<SparsityMapEntry<N,T> >().swap(this->entries);
+      }
+    }
+    if(interned)
+      this->shared_entries = &(interned->entries);
+    const std::vector<SparsityMapEntry<N,T> >& entries = (interned ?
+							    interned->entries :
+							    this->entries);
+
     // now that we've got our entries nice and tidy, build a bounded approximation of them
     if(true /*ID(me).sparsity.creator_node == my_node_id*/) {
       assert(!this->approx_valid);
-      compute_approximation(this->entries, this->approx_rects, DeppartConfig::cfg_max_rects_in_approximation);
+      compute_approximation(entries, this->approx_rects, DeppartConfig::cfg_max_rects_in_approximation);
       this->approx_valid = true;
     }
 
 #ifdef DEBUG_PARTITIONING
-    std::cout << "finalizing " << this << ", " << this->entries.size() << " entries" << std::endl;
-    for(size_t i = 0; i < this->entries.size(); i++)
+    std::cout << "finalizing " << this << ", " << entries.size() << " entries" << std::endl;
+    for(size_t i = 0; i < entries.size(); i++)
       std::cout << "  [" << i
-		<< "]: bounds=" << this->entries[i].bounds
-		<< " sparsity=" << this->entries[i].sparsity
-		<< " bitmap=" << this->entries[i].bitmap
+		<< "]: bounds=" << entries[i].bounds
+		<< " sparsity=" << entries[i].sparsity
+		<< " bitmap=" << entries[i].bitmap
 		<< std::endl;
 #endif
 
@@ -854,6 +1021,19 @@ namespace Realm {
     SparsityMap<NT::N,T> sparsity;
     sparsity.id = args->sparsity_id;
 
+    if(args->by_hash) {
+      log_part.info() << "received interned contribution: sparsity=" << sparsity
+		      << " hash=" << std::hex << args->content_hash << std::dec;
+      // if we no longer (or never did) have a copy, ask for the actual entries
+      if(!SparsityMapImpl<NT::N,T>::lookup(sparsity)->contribute_interned(args->content_hash,
+									  args->entry_count))
+	RemoteSparsityRequestMessage::send_request<NT::N,T>(args->sender, sparsity,
+							    true /*precise*/,
+							    false /*!approx*/,
+							    false /*!allow_by_hash*/);
+      return;
+    }
+
     log_part.info() << "received remote contribution: sparsity=" << sparsity << " len=" << datalen;
     size_t count = datalen / sizeof(Rect<NT::N,T>);
     assert((datalen % sizeof(Rect<NT::N,T>)) == 0);
@@ -886,11 +1066,34 @@ namespace Realm {
     args.sparsity_id = sparsity.id;
     args.sequence_id = sequence_id;
     args.sequence_count = sequence_count;
+    args.by_hash = false;
+    args.content_hash = 0;
+    args.entry_count = count;
 
     Message::request(target, args, rects, count * sizeof(Rect<N,T>),
 		     PAYLOAD_COPY);
   }
 
+  template <int N, typename T>
+  /*static*/ void RemoteSparsityContribMessage::send_interned(NodeID target,
+							      SparsityMap<N,T> sparsity,
+							      unsigned long long hash,
+							      size_t count)
+  {
+    RequestArgs args;
+
+    args.sender = my_node_id;
+    args.type_tag = NT_TemplateHelper::encode_tag<N,T>();
+    args.sparsity_id = sparsity.id;
+    args.sequence_id = 0;
+    args.sequence_count = 1;
+    args.by_hash = true;
+    args.content_hash = hash;
+    args.entry_count = count;
+
+    Message::request(target, args, 0, 0, PAYLOAD_NONE);
+  }
+
 
   ////////////////////////////////////////////////////////////////////////
   //
@@ -903,7 +1106,8 @@ namespace Realm {
     sparsity.id = args->sparsity_id;
 
     log_part.info() << "received sparsity request: sparsity=" << sparsity << " precise=" << args->send_precise << " approx=" << args->send_approx;
-    SparsityMapImpl<NT::N,T>::lookup(sparsity)->remote_data_request(args->sender, args->send_precise, args->send_approx);
+    SparsityMapImpl<NT::N,T>::lookup(sparsity)->remote_data_request(args->sender, args->send_precise, args->send_approx,
+								    args->allow_by_hash);
   }
 
   /*static*/ void RemoteSparsityRequestMessage::handle_request(RequestArgs args)
@@ -915,7 +1119,8 @@ namespace Realm {
   /*static*/ void RemoteSparsityRequestMessage::send_request(NodeID target,
 							     SparsityMap<N,T> sparsity,
 							     bool send_precise,
-							     bool send_approx)
+							     bool send_approx,
+							     bool allow_by_hash /*= true*/)
   {
     RequestArgs args;
 
@@ -924,6 +1129,7 @@ namespace Realm {
     args.sparsity_id = sparsity.id;
     args.send_precise = send_precise;
     args.send_approx = send_approx;
+    args.allow_by_hash = allow_by_hash;
 
     Message::request(target, args);
   }
@@ -29,6 +29,38 @@ namespace Realm {
 
   class PartitioningMicroOp;
 
+  // content-hashed storage for the entry lists of finalized sparsity maps - maps
+  //  with identical contents share a single copy, and a node that is known to
+  //  already hold a copy can be sent just the hash instead of the entries
+  template <int N, typename T>
+  class SparsityMapInternTable {
+  public:
+    struct SharedEntries {
+      unsigned long long hash;
+      std::vector<SparsityMapEntry<N,T> > entries;
+      NodeSet known_holders;  // remote nodes that have been sent these contents
+    };
+
+    // returns the shared copy whose contents match 'entries', creating one if
+    //  needed (in which case the contents of 'entries' are moved into it)
+    SharedEntries *intern(std::vector<SparsityMapEntry<N,T> >& entries,
+			  unsigned long long hash);
+
+    // returns the shared copy with the given hash and entry count, or null if
+    //  there is not exactly one such copy
+    SharedEntries *lookup(unsigned long long hash, size_t count);
+
+    // remembers that 'node' holds the contents of 'shared', returning whether
+    //  it was already known to
+    bool add_holder(SharedEntries *shared, NodeID node);
+
+    static unsigned long long compute_hash(const std::vector<SparsityMapEntry<N,T> >& entries);
+
+  protected:
+    GASNetHSL mutex;
+    std::multimap<unsigned long long, SharedEntries *> table;
+  };
+
   template <int N, typename T>
   class SparsityMapImpl : public SparsityMapPublicImpl<N,T> {
   public:
@@ -50,19 +82,28 @@ namespace Realm {
     void contribute_nothing(void);
     void contribute_dense_rect_list(const std::vector<Rect<N,T> >& rects);
     void contribute_raw_rects(const Rect<N,T>* rects, size_t count, bool last);
+    // used on remote nodes when the owner believes we already hold a copy of the
+    //  contents - returns false (and the caller must request the entries) if not
+    bool contribute_interned(unsigned long long hash, size_t count);
 
     // adds a microop as a waiter for valid sparsity map data - returns true
     //  if the uop is added to the list (i.e. will be getting a callback at some point),
     //  or false if the sparsity map became valid before this call (i.e. no callback)
     bool add_waiter(PartitioningMicroOp *uop, bool precise);
 
-    void remote_data_request(NodeID requestor, bool send_precise, bool send_approx);
-    void remote_data_reply(NodeID requestor, bool send_precise, bool send_approx);
+    void remote_data_request(NodeID requestor, bool send_precise, bool send_approx,
+			     bool allow_by_hash);
+    void remote_data_reply(NodeID requestor, bool send_precise, bool send_approx,
+			   bool allow_by_hash = true);
 
     SparsityMap<N,T> me;
 
+    static SparsityMapInternTable<N,T> intern_table;
+
   protected:
     void finalize(void);
+
+    typename SparsityMapInternTable<N,T>::SharedEntries *interned;
     
     int remaining_contributor_count;
     GASNetHSL mutex;
@@ -126,6 +167,7 @@ namespace Realm {
       ID::IDType sparsity_id;
       bool send_precise;
       bool send_approx;
+      bool allow_by_hash;
     };
 
     struct DecodeHelper {
@@ -141,7 +183,8 @@ namespace Realm {
 
     template <int N, typename T>
     static void send_request(NodeID target, SparsityMap<N,T> sparsity,
-			     bool send_precise, bool send_approx);
+			     bool send_precise, bool send_approx,
+			     bool allow_by_hash = true);
   };
 
   struct SetContribCountMessage {
@@ -173,6 +216,11 @@ namespace Realm {
       ID::IDType sparsity_id;
       int sequence_id;
       int sequence_count;
+      // if 'by_hash' is set, there is no payload and the receiver should use its
+      //  interned copy of the 'entry_count' entries with hash 'content_hash'
+      bool by_hash;
+      unsigned long long content_hash;
+      size_t entry_count;
     };
 
     struct DecodeHelper {
@@ -190,6 +238,10 @@ namespace Realm {
     static void send_request(NodeID target, SparsityMap<N,T> sparsity,
 			     int sequence_id, int sequence_count,
 			     const Rect<N,T> *rects, size_t count);
+
+    template <int N, typename T>
+    static void send_interned(NodeID target, SparsityMap<N,T> sparsity,
+			      unsigned long long hash, size_t count);
   };
 
 }; // namespace Realm
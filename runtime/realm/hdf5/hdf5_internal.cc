@@ -34,7 +34,140 @@ namespace Realm {
 
     HDF5Memory::~HDF5Memory(void)
     {
-      // close all HDF metadata
+      // close any files that are still open
+      while(!open_files.empty())
+	close_file(open_files.begin()->first, open_files.begin()->second);
+    }
+
+    void HDF5Memory::release_instance_storage(RegionInstance i,
+					      Event precondition)
+    {
+      // the instance can no longer be the reason for keeping a file open
+      {
+	AutoHSLLock al(handle_mutex);
+	std::map<std::string, OpenFile *>::iterator it = open_files.begin();
+	while(it != open_files.end()) {
+	  OpenFile *file = it->second;
+	  file->users.erase(i);
+	  if(file->users.empty() && (file->active == 0))
+	    close_file((it++)->first, file);
+	  else
+	    ++it;
+	}
+      }
+
+      MemoryImpl::release_instance_storage(i, precondition);
+    }
+
+    HDF5Memory::OpenDataset *HDF5Memory::acquire_dataset(RegionInstance inst,
+							 const std::string& filename,
+							 const std::string& dsetname,
+							 bool need_write)
+    {
+      AutoHSLLock al(handle_mutex);
+
+      OpenFile *file = 0;
+      std::set<RegionInstance> prev_users;
+      std::map<std::string, OpenFile *>::iterator it = open_files.find(filename);
+      if(it != open_files.end()) {
+	file = it->second;
+	// HDF5 won't let us have the same file open both ways, so a file that
+	//  was only read so far has to be reopened before we can write to it
+	if(need_write && file->read_only) {
+	  if(file->active > 0) {
+	    log_hdf5.fatal() << "cannot write to \"" << filename
+			     << "\" while it is being read";
+	    assert(0);
+	  }
+	  // the reopened file is kept alive by the same instances
+	  prev_users.swap(file->users);
+	  close_file(filename, file);
+	  file = 0;
+	}
+      }
+      if(!file) {
+	file = new OpenFile;
+	CHECK_HDF5( file->file_id = H5Fopen(filename.c_str(),
+					    (need_write ? H5F_ACC_RDWR :
+					                  H5F_ACC_RDONLY),
+					    H5P_DEFAULT) );
+	log_hdf5.info() << "H5Fopen(\"" << filename << "\") = " << file->file_id;
+	file->read_only = !need_write;
+	file->active = 0;
+	file->users.swap(prev_users);
+	open_files[filename] = file;
+      }
+
+      OpenDataset *dset;
+      std::map<std::string, OpenDataset *>::const_iterator it2 = file->datasets.find(dsetname);
+      if(it2 != file->datasets.end()) {
+	dset = it2->second;
+      } else {
+	dset = new OpenDataset;
+	CHECK_HDF5( dset->dset_id = H5Dopen2(file->file_id, dsetname.c_str(),
+					     H5P_DEFAULT) );
+	log_hdf5.info() << "H5Dopen2(" << file->file_id << ", \"" << dsetname << "\") = " << dset->dset_id;
+	CHECK_HDF5( dset->dtype_id = H5Dget_type(dset->dset_id) );
+	dset->dtype_size = H5Tget_size(dset->dtype_id);
+	{
+	  // remember the chunking so that transfers can split along chunk
+	  //  boundaries
+	  hid_t dcpl_id;
+	  CHECK_HDF5( dcpl_id = H5Dget_create_plist(dset->dset_id) );
+	  if(H5Pget_layout(dcpl_id) == H5D_CHUNKED) {
+	    int ndims;
+	    CHECK_HDF5( ndims = H5Pget_chunk(dcpl_id, 0, 0) );
+	    dset->chunk_dims.resize(ndims);
+	    CHECK_HDF5( H5Pget_chunk(dcpl_id, ndims, dset->chunk_dims.data()) );
+	  }
+	  CHECK_HDF5( H5Pclose(dcpl_id) );
+	}
+	dset->file = file;
+	file->datasets[dsetname] = dset;
+      }
+
+      if(inst.exists())
+	file->users.insert(inst);
+      file->active++;
+      return dset;
+    }
+
+    void HDF5Memory::release_dataset(OpenDataset *dset)
+    {
+      AutoHSLLock al(handle_mutex);
+
+      OpenFile *file = dset->file;
+      assert(file->active > 0);
+      file->active--;
+      // files that no instance is keeping alive are closed right away
+      if(file->users.empty() && (file->active == 0)) {
+	for(std::map<std::string, OpenFile *>::iterator it = open_files.begin();
+	    it != open_files.end();
+	    ++it)
+	  if(it->second == file) {
+	    close_file(it->first, file);
+	    break;
+	  }
+      }
+    }
+
+    // caller must hold handle_mutex (or be the destructor)
+    void HDF5Memory::close_file(const std::string& filename, OpenFile *file)
+    {
+      for(std::map<std::string, OpenDataset *>::const_iterator it = file->datasets.begin();
+	  it != file->datasets.end();
+	  ++it) {
+	log_hdf5.info() << "H5Dclose(" << it->second->dset_id << " /* \"" << it->first << "\" */)";
+	CHECK_HDF5( H5Tclose(it->second->dtype_id) );
+	CHECK_HDF5( H5Dclose(it->second->dset_id) );
+	delete it->second;
+      }
+      log_hdf5.info() << "H5Fclose(" << file->file_id << " /* \"" << filename << "\" */)";
+      CHECK_HDF5( H5Fclose(file->file_id) );
+      delete file;
+      // erase by key last - 'filename' may refer to the map's own key
+      std::string name(filename);
+      open_files.erase(name);
     }
 
     off_t HDF5Memory::alloc_bytes(size_t size)
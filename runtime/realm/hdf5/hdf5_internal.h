@@ -22,6 +22,9 @@
 
 #include <hdf5.h>
 
+#include <set>
+#include <string>
+
 #define CHECK_HDF5(cmd) \
   do { \
     herr_t res = (cmd); \
@@ -55,6 +58,40 @@ namespace Realm {
       virtual void *get_direct_ptr(off_t offset, size_t size);
       virtual int get_home_node(off_t offset, size_t size);
 
+      virtual void release_instance_storage(RegionInstance i,
+					    Event precondition);
+
+      // file and dataset handles are cached across fills and transfers - each
+      //  acquire must be matched by a release once the caller's I/O is done,
+      //  and a file is closed once every instance that has used it has been
+      //  destroyed
+      struct OpenFile;
+      struct OpenDataset {
+	hid_t dset_id, dtype_id;
+	size_t dtype_size;
+	std::vector<hsize_t> chunk_dims;  // empty if the layout is not chunked
+	OpenFile *file;
+      };
+      struct OpenFile {
+	hid_t file_id;
+	bool read_only;
+	int active;  // number of unreleased acquires
+	std::map<std::string, OpenDataset *> datasets;
+	std::set<RegionInstance> users;
+      };
+
+      OpenDataset *acquire_dataset(RegionInstance inst,
+				   const std::string& filename,
+				   const std::string& dsetname,
+				   bool need_write);
+      void release_dataset(OpenDataset *dset);
+
+    protected:
+      void close_file(const std::string& filename, OpenFile *file);
+
+      GASNetHSL handle_mutex;
+      std::map<std::string, OpenFile *> open_files;
+
     public:
       struct HDFMetadata {
         int lo[3];
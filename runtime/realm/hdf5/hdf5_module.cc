@@ -23,6 +23,7 @@
 #include "realm/runtime_impl.h"
 #include "realm/utils.h"
 #include "realm/inst_impl.h"
+#include "realm/transfer/channel.h"
 
 namespace Realm {
 
@@ -40,6 +41,7 @@ namespace Realm {
     HDF5Module::HDF5Module(void)
       : Module("hdf5")
       , cfg_showerrors(true)
+      , cfg_io_threads(0)
       , version_major(0)
       , version_minor(0)
       , version_rel(0)
@@ -63,6 +65,7 @@ namespace Realm {
 	CommandLineParser cp;
 
 	cp.add_option_bool("-hdf5:showerrors", m->cfg_showerrors);
+	cp.add_option_int("-hdf5:iothreads", m->cfg_io_threads);
 	
 	bool ok = cp.parse_command_line(cmdline);
 	if(!ok) {
@@ -102,6 +105,14 @@ namespace Realm {
 			<< (m->threadsafe ? " (thread-safe)" : " (NOT thread-safe)");
       }
 
+      // dedicated I/O threads call into HDF5 concurrently with the DMA
+      //  threads, which is only safe with a thread-safe library
+      if((m->cfg_io_threads > 0) && !m->threadsafe) {
+	log_hdf5.warning() << "HDF5 library is not thread-safe - ignoring -hdf5:iothreads";
+	m->cfg_io_threads = 0;
+      }
+      set_hdf5_io_threads(m->cfg_io_threads);
+
       hdf5mod = m; // hack for now
       return m;
     }
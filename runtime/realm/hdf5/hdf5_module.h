@@ -60,6 +60,7 @@ namespace Realm {
 
     public:
       bool cfg_showerrors;
+      int cfg_io_threads;
 
       unsigned version_major, version_minor, version_rel;
       bool threadsafe;
@@ -459,6 +459,23 @@ namespace Realm {
 				    const ProfilingRequestSet &reqs,
 				    Event wait_on = Event::NO_EVENT) const;
 
+    // incremental version of the above - 'prev_subspaces' must be the result of an
+    //  earlier call with the same colors, 'dirty' must be a subset of this space
+    //  that covers every point whose field value may have changed since then, and
+    //  'changed_colors' must include every color that a dirty point had before or
+    //  has now (passing all the colors is always correct) - only the dirty points
+    //  are re-examined, and the subspaces of all other colors are returned as is
+    //  (i.e. subspaces[i] == prev_subspaces[i])
+    template <typename FT>
+    Event update_subspaces_by_field(const std::vector<FieldDataDescriptor<IndexSpace<N,T>,FT> >& field_data,
+				    const std::vector<FT>& colors,
+				    const std::vector<IndexSpace<N,T> >& prev_subspaces,
+				    const IndexSpace<N,T>& dirty,
+				    const std::vector<FT>& changed_colors,
+				    std::vector<IndexSpace<N,T> >& subspaces,
+				    const ProfilingRequestSet &reqs,
+				    Event wait_on = Event::NO_EVENT) const;
+
     // this version allows the "function" described by the field to be composed with a
     //  second (computable) function before matching the colors - the second function
     //  is provided via a CodeDescriptor object and should have the type FT->FT2
@@ -79,6 +79,20 @@ namespace Realm {
       return ID(id).instance.owner_node;
     }
 
+    bool RegionInstance::is_zero_initialized(void) const
+    {
+      // only the creator is told how the storage was allocated
+      if(ID(id).instance.creator_node != my_node_id)
+	return false;
+      RegionInstanceImpl *r_impl = get_runtime()->get_instance_impl(*this);
+      AutoHSLLock al(r_impl->mutex);
+      // an allocation that hasn't completed (or failed) isn't known-zero
+      if((r_impl->metadata.inst_offset == (size_t)-1) ||
+	 (r_impl->metadata.inst_offset == (size_t)-2))
+	return false;
+      return r_impl->zero_initialized;
+    }
+
     Memory RegionInstance::get_location(void) const
     {
       return ID::make_memory(ID(id).instance.owner_node,
@@ -429,6 +443,7 @@ namespace Realm {
       metadata.inst_offset = (size_t)-1;
       metadata.ready_event = Event::NO_EVENT;
       metadata.layout = 0;
+      zero_initialized = false;
       
       // Initialize this in case the user asks for profiling information
       timeline.instance = _me;
@@ -440,7 +455,8 @@ namespace Realm {
 	delete metadata.layout;
     }
 
-    void RegionInstanceImpl::notify_allocation(bool success, size_t offset)
+    void RegionInstanceImpl::notify_allocation(bool success, size_t offset,
+					       bool zeroed /*= false*/)
     {
       if(!success) {
 	// if somebody is listening to profiling measurements, we report
@@ -499,6 +515,7 @@ namespace Realm {
 	ready_event = metadata.ready_event;
 	metadata.ready_event = Event::NO_EVENT;
 	metadata.inst_offset = offset;
+	zero_initialized = zeroed;
       }
       if(ready_event.exists())
 	GenEventImpl::trigger(ready_event, false /*!poisoned*/);
@@ -576,6 +593,7 @@ namespace Realm {
 
       // set the offset back to the "unallocated" value
       metadata.inst_offset = size_t(-1);
+      zero_initialized = false;
 
       measurements.clear();
 
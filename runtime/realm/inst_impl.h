@@ -40,7 +40,7 @@ namespace Realm {
       // the life cycle of an instance is defined in part by when the
       //  allocation and deallocation of storage occurs, but that is managed
       //  by the memory, which uses these callbacks to notify us
-      void notify_allocation(bool success, size_t offset);
+      void notify_allocation(bool success, size_t offset, bool zeroed = false);
       void notify_deallocation(void);
 
 #ifdef POINTER_CHECKS
@@ -101,6 +101,10 @@ namespace Realm {
       GASNetHSL mutex;
       Metadata metadata;
 
+      // set (on the creator node only) if the memory reported that the
+      //  instance's storage was all zeroes when it was allocated
+      bool zero_initialized;
+
       // used for serialized application access to contents of instance
       ReservationImpl lock;
     };
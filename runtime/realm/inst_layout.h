@@ -24,6 +24,7 @@
 #include <vector>
 #include <map>
 #include <iostream>
+#include <cstdlib>
 
 namespace Realm {
 
@@ -368,6 +369,59 @@ namespace Realm {
   template <typename FT, int N, typename T>
   std::ostream& operator<<(std::ostream& os, const AffineAccessor<FT,N,T>& a);
 
+  // iterates over an index space one "span" at a time using an AffineAccessor -
+  //  a span is a run of points that differ only in the accessor's innermost
+  //  (i.e. smallest-stride) dimension, so its elements can be walked with a
+  //  simple strided pointer loop that the compiler is able to vectorize:
+  //
+  //    for(AffineSpanIterator<float,3> it(space, acc); it.valid; it.step())
+  //      for(size_t i = 0; i < it.extent; i++)
+  //        it.element(i) += 1.0f;
+  //
+  //  the optional restriction allows the iteration space to be divided into
+  //  disjoint pieces (e.g. one per OpenMP thread) - see chunk_bounds below
+  template <typename FT, int N, typename T = int>
+  class AffineSpanIterator {
+  public:
+    AffineSpanIterator(const IndexSpace<N,T>& _space,
+		       const AffineAccessor<FT,N,T>& _accessor);
+    AffineSpanIterator(const IndexSpace<N,T>& _space,
+		       const AffineAccessor<FT,N,T>& _accessor,
+		       const Rect<N,T>& _restrict);
+
+    // steps to the next span, returning true if a next span exists
+    bool step(void);
+
+    // i'th element of the current span
+    FT& element(size_t i) const;
+
+    // true if the elements of the current span are adjacent in memory (i.e.
+    //  'base' can be treated as a plain FT array of length 'extent')
+    bool is_dense(void) const;
+
+    // divides 'bounds' into 'num_chunks' slabs along the accessor's outermost
+    //  (i.e. largest-stride) dimension and returns the 'chunk_idx'th one, which
+    //  may be empty if there are more chunks than planes in that dimension
+    static Rect<N,T> chunk_bounds(const Rect<N,T>& bounds,
+				  const AffineAccessor<FT,N,T>& accessor,
+				  size_t num_chunks, size_t chunk_idx);
+
+    // the current span is 'extent' elements starting at point 'start' (whose
+    //  address is 'base'), with consecutive elements 'stride' bytes apart
+    bool valid;
+    Point<N,T> start;
+    FT *base;
+    size_t extent;
+    ptrdiff_t stride;
+
+  protected:
+    void start_rect(void);
+
+    IndexSpaceIterator<N,T> rect_iter;
+    AffineAccessor<FT,N,T> accessor;
+    int inner_dim;
+  };
+
 }; // namespace Realm
 
 #include "realm/inst_layout.inl"
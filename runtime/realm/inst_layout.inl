@@ -1082,4 +1082,118 @@ namespace Realm {
     return os;
   }
 
+
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class AffineSpanIterator<FT,N,T>
+
+  template <typename FT, int N, typename T>
+  inline AffineSpanIterator<FT,N,T>::AffineSpanIterator(const IndexSpace<N,T>& _space,
+							const AffineAccessor<FT,N,T>& _accessor)
+    : valid(false), base(0), extent(0), stride(0)
+    , rect_iter(_space), accessor(_accessor), inner_dim(0)
+  {
+    // pick the dimension with the smallest stride - ties go to the earlier
+    //  dimension (i.e. Fortran order)
+    for(int i = 1; i < N; i++)
+      if(std::abs(accessor.strides[i]) < std::abs(accessor.strides[inner_dim]))
+	inner_dim = i;
+    if(rect_iter.valid)
+      start_rect();
+  }
+
+  template <typename FT, int N, typename T>
+  inline AffineSpanIterator<FT,N,T>::AffineSpanIterator(const IndexSpace<N,T>& _space,
+							const AffineAccessor<FT,N,T>& _accessor,
+							const Rect<N,T>& _restrict)
+    : valid(false), base(0), extent(0), stride(0)
+    , rect_iter(_space, _restrict), accessor(_accessor), inner_dim(0)
+  {
+    for(int i = 1; i < N; i++)
+      if(std::abs(accessor.strides[i]) < std::abs(accessor.strides[inner_dim]))
+	inner_dim = i;
+    if(rect_iter.valid)
+      start_rect();
+  }
+
+  template <typename FT, int N, typename T>
+  inline void AffineSpanIterator<FT,N,T>::start_rect(void)
+  {
+    const Rect<N,T>& r = rect_iter.rect;
+    start = r.lo;
+    base = accessor.ptr(start);
+    extent = r.hi[inner_dim] - r.lo[inner_dim] + 1;
+    stride = accessor.strides[inner_dim];
+    valid = true;
+  }
+
+  template <typename FT, int N, typename T>
+  inline bool AffineSpanIterator<FT,N,T>::step(void)
+  {
+    assert(valid);  // can't step an iterator that's already done
+
+    // advance through the rest of the current rectangle in Fortran order,
+    //  skipping the inner dimension (which is covered by the span itself)
+    const Rect<N,T>& r = rect_iter.rect;
+    for(int i = 0; i < N; i++) {
+      if(i == inner_dim) continue;
+      if(start[i] < r.hi[i]) {
+	start[i]++;
+	base = accessor.ptr(start);
+	return true;
+      }
+      start[i] = r.lo[i];
+    }
+
+    // current rectangle is exhausted - move on to the next one
+    if(rect_iter.step()) {
+      start_rect();
+      return true;
+    }
+
+    valid = false;
+    return false;
+  }
+
+  template <typename FT, int N, typename T>
+  inline FT& AffineSpanIterator<FT,N,T>::element(size_t i) const
+  {
+    return *reinterpret_cast<FT *>(reinterpret_cast<intptr_t>(base) + i * stride);
+  }
+
+  template <typename FT, int N, typename T>
+  inline bool AffineSpanIterator<FT,N,T>::is_dense(void) const
+  {
+    return (stride == sizeof(FT)) || (extent == 1);
+  }
+
+  template <typename FT, int N, typename T>
+  inline /*static*/ Rect<N,T> AffineSpanIterator<FT,N,T>::chunk_bounds(const Rect<N,T>& bounds,
+								    const AffineAccessor<FT,N,T>& accessor,
+								    size_t num_chunks,
+								    size_t chunk_idx)
+  {
+    assert(chunk_idx < num_chunks);
+
+    // slice along the largest-stride dimension so that chunks are as far
+    //  apart in memory as possible - ties go to the later dimension
+    int outer_dim = N - 1;
+    for(int i = N - 2; i >= 0; i--)
+      if(std::abs(accessor.strides[i]) > std::abs(accessor.strides[outer_dim]))
+	outer_dim = i;
+
+    if(bounds.empty())
+      return bounds;
+    unsigned long long count = ((long long)(bounds.hi[outer_dim]) -
+				(long long)(bounds.lo[outer_dim]) + 1);
+    unsigned long long first = (count * chunk_idx) / num_chunks;
+    unsigned long long last = (count * (chunk_idx + 1)) / num_chunks;
+    if(first == last)
+      return Rect<N,T>::make_empty();
+    Rect<N,T> chunk = bounds;
+    chunk.lo[outer_dim] = bounds.lo[outer_dim] + (T)first;
+    chunk.hi[outer_dim] = bounds.lo[outer_dim] + (T)(last - 1);
+    return chunk;
+  }
+
 }; // namespace Realm
@@ -104,6 +104,13 @@ namespace Realm {
 
     Event get_ready_event(void) const;
 
+    // returns true if the instance's storage was known to hold all zeroes
+    //  when it was allocated (e.g. fresh pages from the OS that nobody has
+    //  touched yet), in which case an initial fill of zeroes is unnecessary -
+    //  only answered on the node that created the instance, and false until
+    //  the allocation has succeeded
+    bool is_zero_initialized(void) const;
+
     // calls to create_instance return immediately with a handle, but also
     //  return an event that must be used as a precondition for any use (or
     //  destruction) of the instance
@@ -70,6 +70,32 @@
 #pragma weak LLVMSetTarget
 #endif
 
+// the object cache hooks into MCJIT through the C++ API, which we can't
+//  weaken, and which changed after 3.5
+#if !defined(USE_OLD_JIT) && !defined(REALM_ALLOW_MISSING_LLVM_LIBS) && (LLVM_VERSION >= 36)
+#define REALM_LLVMJIT_OBJECT_CACHE
+#endif
+
+#ifdef REALM_LLVMJIT_OBJECT_CACHE
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/ExecutionEngine/ObjectCache.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Host.h>
+#include <llvm/ADT/StringMap.h>
+
+#include <algorithm>
+#include <sstream>
+#include <vector>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#endif
+
 namespace Realm {
 
   extern Logger log_llvmjit;  // defined in llvmjit_module.cc
@@ -117,6 +143,150 @@ namespace Realm {
     };
 #endif
 
+#ifdef REALM_LLVMJIT_OBJECT_CACHE
+    ////////////////////////////////////////////////////////////////////////
+    //
+    // class JitObjectCache
+
+    // MCJIT asks the cache for an object before compiling a module and hands
+    //  it every object it does compile - modules are named with the hash of
+    //  everything that affects code generation, so the name is all that's
+    //  needed to find the object on disk
+    class JitObjectCache : public llvm::ObjectCache {
+    public:
+      JitObjectCache(const std::string& _dir, const std::string& _target_key);
+
+      // name to give the module compiled from 'ir'
+      std::string module_name(const ByteArray& ir,
+			      const std::string& entry_symbol) const;
+
+      virtual void notifyObjectCompiled(const llvm::Module *m,
+					llvm::MemoryBufferRef obj) override;
+      virtual std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module *m) override;
+
+      LLVMJitInternal::CacheStats stats;
+
+    protected:
+      // only modules we named (i.e. not the execution engine's dummy module)
+      //  are cached
+      static bool is_cacheable(const llvm::Module *m);
+      std::string object_path(const llvm::Module *m) const;
+
+      std::string dir, target_key;
+    };
+
+    JitObjectCache::JitObjectCache(const std::string& _dir,
+				   const std::string& _target_key)
+      : dir(_dir), target_key(_target_key)
+    {
+      stats.hits = stats.misses = stats.writes = stats.write_failures = 0;
+
+      // the directory may be shared by many processes - losing the race to
+      //  create it is fine
+      if((mkdir(dir.c_str(), 0777) != 0) && (errno != EEXIST))
+	log_llvmjit.warning() << "could not create JIT cache directory '" << dir << "': " << strerror(errno);
+    }
+
+    std::string JitObjectCache::module_name(const ByteArray& ir,
+					    const std::string& entry_symbol) const
+    {
+      // two independent FNV-1a-style lanes give a 128-bit name
+      unsigned long long h1 = 0xcbf29ce484222325ULL;
+      unsigned long long h2 = 0x6c62272e07bb0142ULL;
+      const std::string *strs[2] = { &target_key, &entry_symbol };
+      for(int i = 0; i < 2; i++) {
+	for(size_t j = 0; j <= strs[i]->size(); j++) {  // includes the '\0'
+	  unsigned char c = (j < strs[i]->size()) ? (*strs[i])[j] : 0;
+	  h1 = (h1 ^ c) * 0x100000001b3ULL;
+	  h2 = (h2 ^ c) * 0x9e3779b97f4a7c15ULL;
+	}
+      }
+      const unsigned char *p = static_cast<const unsigned char *>(ir.base());
+      for(size_t j = 0; j < ir.size(); j++) {
+	h1 = (h1 ^ p[j]) * 0x100000001b3ULL;
+	h2 = (h2 ^ p[j]) * 0x9e3779b97f4a7c15ULL;
+      }
+      h2 ^= ir.size();
+
+      char name[48];
+      snprintf(name, sizeof(name), "realm_%016llx%016llx", h1, h2);
+      return name;
+    }
+
+    /*static*/ bool JitObjectCache::is_cacheable(const llvm::Module *m)
+    {
+      return (m->getModuleIdentifier().compare(0, 6, "realm_") == 0);
+    }
+
+    std::string JitObjectCache::object_path(const llvm::Module *m) const
+    {
+      return dir + "/" + m->getModuleIdentifier() + ".o";
+    }
+
+    void JitObjectCache::notifyObjectCompiled(const llvm::Module *m,
+					      llvm::MemoryBufferRef obj)
+    {
+      if(!is_cacheable(m))
+	return;
+
+      // write to a private file and rename it into place so that concurrent
+      //  readers never see a partial object
+      std::string path = object_path(m);
+      char tmp_path[1024];
+      snprintf(tmp_path, sizeof(tmp_path), "%s.%d.tmp", path.c_str(), (int)getpid());
+      int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+      bool ok = (fd >= 0);
+      if(ok) {
+	const char *data = obj.getBufferStart();
+	size_t left = obj.getBufferSize();
+	while(ok && (left > 0)) {
+	  ssize_t amt = write(fd, data, left);
+	  if(amt > 0) {
+	    data += amt;
+	    left -= amt;
+	  } else if((amt < 0) && (errno == EINTR)) {
+	    continue;
+	  } else
+	    ok = false;
+	}
+	ok = (close(fd) == 0) && ok;
+	if(ok)
+	  ok = (rename(tmp_path, path.c_str()) == 0);
+	if(!ok)
+	  unlink(tmp_path);
+      }
+      if(ok) {
+	stats.writes++;
+	log_llvmjit.debug() << "cached object: " << path << " (" << obj.getBufferSize() << " bytes)";
+      } else {
+	stats.write_failures++;
+	log_llvmjit.info() << "failed to cache object '" << path << "': " << strerror(errno);
+      }
+    }
+
+    std::unique_ptr<llvm::MemoryBuffer> JitObjectCache::getObject(const llvm::Module *m)
+    {
+      if(!is_cacheable(m))
+	return nullptr;
+
+      std::string path = object_path(m);
+      llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer> > buf = llvm::MemoryBuffer::getFile(path);
+      if(buf) {
+	stats.hits++;
+	log_llvmjit.debug() << "cache hit: " << path;
+	return std::move(*buf);
+      } else {
+	stats.misses++;
+	log_llvmjit.debug() << "cache miss: " << path;
+	return nullptr;
+      }
+    }
+#else
+    // placeholder so that the pointer in LLVMJitInternal has a complete type
+    class JitObjectCache {};
+#endif
+
+
     ////////////////////////////////////////////////////////////////////////
     //
     // class LLVMJitInternal
@@ -131,7 +301,8 @@ namespace Realm {
     }
 #endif
 
-    LLVMJitInternal::LLVMJitInternal(void)
+    LLVMJitInternal::LLVMJitInternal(const std::string& cache_dir)
+      : object_cache(0)
     {
       context = LLVMContextCreate();
 
@@ -211,6 +382,35 @@ namespace Realm {
 #endif
 	}
 
+	if(!cache_dir.empty()) {
+#ifdef REALM_LLVMJIT_OBJECT_CACHE
+	  // everything other than the IR itself that affects the generated code
+	  std::ostringstream oss;
+	  oss << "llvm" << LLVM_VERSION << " " << triple
+	      << " cpu=" << llvm::sys::getHostCPUName().str()
+	      << " opt=" << opt_level << " reloc=" << reloc_model
+	      << " model=" << code_model;
+	  std::string target_key = oss.str();
+	  llvm::StringMap<bool> features;
+	  if(llvm::sys::getHostCPUFeatures(features)) {
+	    std::vector<std::string> names;
+	    for(llvm::StringMap<bool>::const_iterator it = features.begin();
+		it != features.end();
+		++it)
+	      names.push_back((it->second ? "+" : "-") + it->getKey().str());
+	    std::sort(names.begin(), names.end());
+	    for(size_t i = 0; i < names.size(); i++)
+	      target_key += (i ? "," : " features=") + names[i];
+	  }
+	  log_llvmjit.debug() << "object cache: dir=" << cache_dir << " target=" << target_key;
+
+	  object_cache = new JitObjectCache(cache_dir, target_key);
+	  llvm::unwrap(host_exec_engine)->setObjectCache(object_cache);
+#else
+	  log_llvmjit.warning() << "object cache not supported with this LLVM build - ignoring cache directory";
+#endif
+	}
+
 	// should be safe to dispose of triple now?
 	LLVMDisposeMessage(triple);
       }
@@ -222,6 +422,18 @@ namespace Realm {
     {
       LLVMDisposeExecutionEngine(host_exec_engine);
       LLVMContextDispose(context);
+      delete object_cache;
+    }
+
+    bool LLVMJitInternal::get_cache_stats(CacheStats& stats) const
+    {
+#ifdef REALM_LLVMJIT_OBJECT_CACHE
+      if(object_cache) {
+	stats = object_cache->stats;
+	return true;
+      }
+#endif
+      return false;
     }
 
     void *LLVMJitInternal::llvmir_to_fnptr(const ByteArray& ir,
@@ -231,6 +443,14 @@ namespace Realm {
       if(!host_exec_engine)
 	return 0;
 
+      // the module takes its name from the memory buffer - when caching, that
+      //  name is how the cache finds a previously-compiled object
+      std::string mbname = "membuf";
+#ifdef REALM_LLVMJIT_OBJECT_CACHE
+      if(object_cache)
+	mbname = object_cache->module_name(ir, entry_symbol);
+#endif
+
       // may need to manually add null-termination here
       LLVMMemoryBufferRef mb;
       if((ir.size() == 0) || (((const char *)(ir.base()))[ir.size() - 1] != 0)) {
@@ -240,12 +460,12 @@ namespace Realm {
 	nullterm[ir.size()] = 0;
 	mb = LLVMCreateMemoryBufferWithMemoryRangeCopy(nullterm,
 	                                               ir.size()+1,
-	                                               "membuf");
+	                                               mbname.c_str());
 	delete[] nullterm;
       } else {
 	mb = LLVMCreateMemoryBufferWithMemoryRange((const char *)(ir.base()),
 						   ir.size(),
-						   "membuf",
+						   mbname.c_str(),
 						   true /*RequiresTerminator*/);
       }
 
@@ -29,13 +29,23 @@ typedef struct LLVMTarget *LLVMTargetRef;
 namespace Realm {
   namespace LLVMJit {
 
+    class JitObjectCache;
+
     class LLVMJitInternal {
     public:
-      LLVMJitInternal(void);
+      // if 'cache_dir' is non-empty, compiled objects are stored there and
+      //  reused by later compilations of the same IR for the same target
+      LLVMJitInternal(const std::string& cache_dir);
       ~LLVMJitInternal(void);
 
       void *llvmir_to_fnptr(const ByteArray& ir, const std::string& entry_symbol);
 
+      // statistics for the on-disk object cache
+      struct CacheStats {
+	size_t hits, misses, writes, write_failures;
+      };
+      bool get_cache_stats(CacheStats& stats) const;
+
 #ifdef REALM_ALLOW_MISSING_LLVM_LIBS
       static bool detect_llvm_libraries(void);
 #endif
@@ -44,6 +54,7 @@ namespace Realm {
       LLVMContextRef context;
       LLVMExecutionEngineRef host_exec_engine;
       LLVMTargetRef nvptx_machine;
+      JitObjectCache *object_cache;
     };
 
   }; // namespace LLVMJit
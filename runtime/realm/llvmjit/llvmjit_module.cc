@@ -19,6 +19,7 @@
 
 #include "realm/runtime_impl.h"
 #include "realm/logging.h"
+#include "realm/cmdline.h"
 
 namespace Realm {
 
@@ -129,6 +130,20 @@ namespace Realm {
       }
 #endif
       LLVMJitModule *m = new LLVMJitModule;
+
+      // first order of business - read command line parameters
+      {
+	CommandLineParser cp;
+
+	cp.add_option_string("-llvm:cachedir", m->cfg_cache_dir);
+
+	bool ok = cp.parse_command_line(cmdline);
+	if(!ok) {
+	  log_llvmjit.fatal() << "error reading LLVM command line parameters";
+	  assert(false);
+	}
+      }
+
       return m;
     }
 
@@ -138,7 +153,7 @@ namespace Realm {
     {
       Module::initialize(runtime);
 
-      internal = new LLVMJitInternal;
+      internal = new LLVMJitInternal(cfg_cache_dir);
     }
 
     // create any code translators provided by the module (default == do nothing)
@@ -153,6 +168,13 @@ namespace Realm {
     //  after all memories/processors/etc. have been shut down and destroyed
     void LLVMJitModule::cleanup(void)
     {
+      LLVMJitInternal::CacheStats stats;
+      if(internal->get_cache_stats(stats))
+	log_llvmjit.info() << "object cache: dir=" << cfg_cache_dir
+			   << " hits=" << stats.hits << " misses=" << stats.misses
+			   << " writes=" << stats.writes
+			   << " write_failures=" << stats.write_failures;
+
       delete internal;
 
       Module::cleanup();
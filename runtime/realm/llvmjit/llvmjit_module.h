@@ -60,6 +60,8 @@ namespace Realm {
       virtual void cleanup(void);
 
     public:
+      // directory for the on-disk cache of compiled objects (empty = no cache)
+      std::string cfg_cache_dir;
 
       LLVMJitInternal *internal;
     };
@@ -26,6 +26,9 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
 
 #include <set>
 #include <map>
@@ -136,6 +139,316 @@ namespace Realm {
     pthread_mutex_t mutex;
   };
 
+  // buffers each thread's output in a private ring buffer that is drained by
+  //  a background writer thread - a logging thread never takes a lock (other
+  //  than the first time it logs) and the underlying stream sees a few large
+  //  writes instead of one per message
+  // messages from a single thread stay in order, but the interleaving of
+  //  messages from different threads is only approximately chronological
+  class LoggerAsyncStream : public LoggerOutputStream {
+  public:
+    LoggerAsyncStream(LoggerOutputStream *_stream, bool _delete_inner,
+		      size_t _ring_size, bool _drop_when_full);
+    virtual ~LoggerAsyncStream(void);
+
+    virtual void write(const char *buffer, size_t len);
+    virtual void flush(void);
+
+  protected:
+    // single-producer/single-consumer byte ring - only the owning thread
+    //  advances 'tail' and only the (drain_mutex-holding) drainer advances 'head'
+    struct ThreadRing {
+      ThreadRing *next;
+      char *data;
+      volatile size_t head, tail;  // free-running counters
+      volatile int in_use;
+    };
+
+    ThreadRing *attach_ring(void);
+    static void detach_ring(void *ring);
+    static void *writer_thread_entry(void *arg);
+    size_t drain_all(void);
+    void report_drops(void);
+
+    LoggerOutputStream *stream;
+    bool delete_inner;
+    size_t ring_size;
+    bool drop_when_full;
+    ThreadRing * volatile rings;  // lock-free push-only list
+    pthread_key_t ring_key;
+    pthread_mutex_t drain_mutex;
+    pthread_cond_t wake_cond;
+    pthread_mutex_t wake_mutex;
+    volatile bool shutdown_requested;
+    volatile bool writer_exited;
+    pthread_t writer_thread;
+    char *batch;
+    size_t batch_size;
+    volatile unsigned long long dropped_msgs, dropped_bytes, overflow_waits;
+    unsigned long long reported_drops, reported_waits;
+  };
+
+  LoggerAsyncStream::LoggerAsyncStream(LoggerOutputStream *_stream,
+				       bool _delete_inner,
+				       size_t _ring_size, bool _drop_when_full)
+    : stream(_stream), delete_inner(_delete_inner)
+    , ring_size(_ring_size), drop_when_full(_drop_when_full)
+    , rings(0), shutdown_requested(false), writer_exited(false)
+    , dropped_msgs(0), dropped_bytes(0), overflow_waits(0)
+    , reported_drops(0), reported_waits(0)
+  {
+    // batches are written to the inner stream in pieces of up to 1MB
+    batch_size = 1 << 20;
+    batch = (char *)malloc(batch_size);
+    assert(batch != 0);
+
+#ifndef NDEBUG
+    int ret;
+    ret =
+#endif
+      pthread_key_create(&ring_key, &LoggerAsyncStream::detach_ring);
+    assert(ret == 0);
+#ifndef NDEBUG
+    ret =
+#endif
+      pthread_mutex_init(&drain_mutex, 0);
+    assert(ret == 0);
+#ifndef NDEBUG
+    ret =
+#endif
+      pthread_mutex_init(&wake_mutex, 0);
+    assert(ret == 0);
+#ifndef NDEBUG
+    ret =
+#endif
+      pthread_cond_init(&wake_cond, 0);
+    assert(ret == 0);
+#ifndef NDEBUG
+    ret =
+#endif
+      pthread_create(&writer_thread, 0,
+		     &LoggerAsyncStream::writer_thread_entry, this);
+    assert(ret == 0);
+  }
+
+  LoggerAsyncStream::~LoggerAsyncStream(void)
+  {
+    pthread_mutex_lock(&wake_mutex);
+    shutdown_requested = true;
+    pthread_cond_signal(&wake_cond);
+    pthread_mutex_unlock(&wake_mutex);
+    pthread_join(writer_thread, 0);
+
+    // one last drain for anything logged while the writer was stopping
+    flush();
+
+    pthread_key_delete(ring_key);
+    while(rings) {
+      ThreadRing *r = rings;
+      rings = r->next;
+      free(r->data);
+      delete r;
+    }
+    free(batch);
+    pthread_cond_destroy(&wake_cond);
+    pthread_mutex_destroy(&wake_mutex);
+    pthread_mutex_destroy(&drain_mutex);
+    if(delete_inner)
+      delete stream;
+  }
+
+  LoggerAsyncStream::ThreadRing *LoggerAsyncStream::attach_ring(void)
+  {
+    // first try to adopt a ring abandoned by a thread that has exited
+    ThreadRing *r;
+    for(r = rings; r; r = r->next)
+      if(!r->in_use && __sync_bool_compare_and_swap(&r->in_use, 0, 1))
+	break;
+
+    if(!r) {
+      r = new ThreadRing;
+      r->data = (char *)malloc(ring_size);
+      assert(r->data != 0);
+      r->head = r->tail = 0;
+      r->in_use = 1;
+      // push onto the list - the drainer only ever walks it
+      do {
+	r->next = rings;
+      } while(!__sync_bool_compare_and_swap(&rings, r->next, r));
+    }
+
+    pthread_setspecific(ring_key, r);
+    return r;
+  }
+
+  /*static*/ void LoggerAsyncStream::detach_ring(void *ring)
+  {
+    // leave any unwritten data in place - the drainer will still find it
+    ThreadRing *r = static_cast<ThreadRing *>(ring);
+    __sync_synchronize();
+    r->in_use = 0;
+  }
+
+  void LoggerAsyncStream::write(const char *buffer, size_t len)
+  {
+    ThreadRing *r = static_cast<ThreadRing *>(pthread_getspecific(ring_key));
+    if(!r)
+      r = attach_ring();
+
+    // a message that can never fit is written through directly, after
+    //  draining what this thread already has buffered to keep it in order -
+    //  the same is done for everything once the writer thread is gone
+    if((len > ring_size) || writer_exited) {
+      pthread_mutex_lock(&drain_mutex);
+      drain_all();
+      stream->write(buffer, len);
+      pthread_mutex_unlock(&drain_mutex);
+      return;
+    }
+
+    size_t tail = r->tail;
+    size_t used = tail - r->head;
+    if((ring_size - used) < len) {
+      if(drop_when_full) {
+	__sync_fetch_and_add(&dropped_msgs, 1);
+	__sync_fetch_and_add(&dropped_bytes, len);
+	return;
+      }
+
+      // wake the writer and wait for it to make room
+      __sync_fetch_and_add(&overflow_waits, 1);
+      do {
+	// nobody is left to make room if the writer has already exited
+	if(writer_exited) {
+	  pthread_mutex_lock(&drain_mutex);
+	  drain_all();
+	  stream->write(buffer, len);
+	  pthread_mutex_unlock(&drain_mutex);
+	  return;
+	}
+	pthread_mutex_lock(&wake_mutex);
+	pthread_cond_signal(&wake_cond);
+	pthread_mutex_unlock(&wake_mutex);
+	sched_yield();
+	used = tail - r->head;
+      } while((ring_size - used) < len);
+    }
+
+    size_t ofs = tail % ring_size;
+    size_t first = ring_size - ofs;
+    if(first >= len) {
+      memcpy(r->data + ofs, buffer, len);
+    } else {
+      memcpy(r->data + ofs, buffer, first);
+      memcpy(r->data, buffer + first, len - first);
+    }
+    // data must be visible before the new tail is
+    __sync_synchronize();
+    r->tail = tail + len;
+
+    // give the writer a nudge once the ring is half full
+    if((used < (ring_size >> 1)) && ((used + len) >= (ring_size >> 1))) {
+      pthread_mutex_lock(&wake_mutex);
+      pthread_cond_signal(&wake_cond);
+      pthread_mutex_unlock(&wake_mutex);
+    }
+  }
+
+  void LoggerAsyncStream::flush(void)
+  {
+    pthread_mutex_lock(&drain_mutex);
+    drain_all();
+    stream->flush();
+    pthread_mutex_unlock(&drain_mutex);
+    report_drops();
+  }
+
+  // must be called while holding drain_mutex
+  size_t LoggerAsyncStream::drain_all(void)
+  {
+    size_t total = 0;
+    size_t filled = 0;
+    for(ThreadRing *r = rings; r; r = r->next) {
+      size_t head = r->head;
+      size_t tail = r->tail;
+      __sync_synchronize();
+      while(head != tail) {
+	size_t ofs = head % ring_size;
+	size_t amt = tail - head;
+	if(amt > (ring_size - ofs))
+	  amt = ring_size - ofs;
+	if(amt > (batch_size - filled))
+	  amt = batch_size - filled;
+	memcpy(batch + filled, r->data + ofs, amt);
+	filled += amt;
+	head += amt;
+	if(filled == batch_size) {
+	  stream->write(batch, filled);
+	  total += filled;
+	  filled = 0;
+	}
+      }
+      // finish reading before handing the space back to the producer
+      __sync_synchronize();
+      r->head = head;
+    }
+    if(filled > 0) {
+      stream->write(batch, filled);
+      total += filled;
+    }
+    return total;
+  }
+
+  /*static*/ void *LoggerAsyncStream::writer_thread_entry(void *arg)
+  {
+    LoggerAsyncStream *s = static_cast<LoggerAsyncStream *>(arg);
+    while(true) {
+      pthread_mutex_lock(&s->drain_mutex);
+      size_t amt = s->drain_all();
+      pthread_mutex_unlock(&s->drain_mutex);
+
+      pthread_mutex_lock(&s->wake_mutex);
+      if(s->shutdown_requested) {
+	// from here on producers must write through on their own
+	s->writer_exited = true;
+	__sync_synchronize();
+	pthread_mutex_unlock(&s->wake_mutex);
+	break;
+      }
+      // sleep until nudged, with a timeout so that trickles of output
+      //  still show up promptly
+      if(amt == 0) {
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_nsec += 10000000;  // 10 ms
+	if(ts.tv_nsec >= 1000000000) {
+	  ts.tv_sec++;
+	  ts.tv_nsec -= 1000000000;
+	}
+	pthread_cond_timedwait(&s->wake_cond, &s->wake_mutex, &ts);
+      }
+      pthread_mutex_unlock(&s->wake_mutex);
+    }
+    return 0;
+  }
+
+  void LoggerAsyncStream::report_drops(void)
+  {
+    unsigned long long msgs = dropped_msgs;
+    unsigned long long waits = overflow_waits;
+    if((msgs == reported_drops) && (waits == reported_waits))
+      return;
+    reported_drops = msgs;
+    reported_waits = waits;
+    // goes straight to stderr - the log itself is where the space ran out
+    if(drop_when_full)
+      fprintf(stderr, "WARNING: async logger dropped %llu messages (%llu bytes) - consider a larger -logasync\n",
+	      msgs, (unsigned long long)dropped_bytes);
+    else
+      fprintf(stderr, "WARNING: async logger stalled %llu times on a full buffer - consider a larger -logasync\n",
+	      waits);
+  }
+
   class LoggerConfig {
   protected:
     LoggerConfig(void);
@@ -288,12 +601,16 @@ namespace Realm {
   void LoggerConfig::read_command_line(std::vector<std::string>& cmdline)
   {
     std::string logname;
+    int async_kb = 0;
+    bool async_drop = false;
 
     bool ok = CommandLineParser()
       .add_option_string("-cat", cats_enabled)
       .add_option_string("-logfile", logname)
       .add_option_method("-level", this, &LoggerConfig::parse_level_argument)
       .add_option_int("-errlevel", stderr_level)
+      .add_option_int("-logasync", async_kb)
+      .add_option_bool("-logdrop", async_drop)
       .parse_command_line(cmdline);
 
     if(!ok) {
@@ -368,6 +685,12 @@ namespace Realm {
 								     true);
     }
 
+    // with -logasync, the main stream is buffered per thread and written by a
+    //  background thread (the stderr copy of critical messages stays synchronous)
+    if(async_kb > 0)
+      stream = new LoggerAsyncStream(stream, true, size_t(async_kb) << 10,
+				     async_drop);
+
     atexit(LoggerConfig::flush_all_streams);
 
     cmdline_read = true;
@@ -492,7 +815,9 @@ namespace Realm {
 
           it->s->write(full_buffer, full_len);
 
-          if(it->flush_each_write)
+          // errors are often followed immediately by an abort, so they
+          //  must not sit in a buffered (e.g. -logasync) stream
+          if(it->flush_each_write || (level >= LEVEL_ERROR))
             it->s->flush();
         }
         free(full_buffer);
@@ -514,7 +839,8 @@ namespace Realm {
 
       it->s->write(buffer, len);
 
-      if(it->flush_each_write)
+      // see above - errors must be visible before a possible abort
+      if(it->flush_each_write || (level >= LEVEL_ERROR))
 	it->s->flush();
     }
   }
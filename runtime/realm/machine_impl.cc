@@ -23,6 +23,8 @@
 #include "realm/activemsg.h"
 #include "realm/transfer/channel.h"
 
+#include <algorithm>
+
 TYPE_IS_SERIALIZABLE(Realm::NodeAnnounceTag);
 TYPE_IS_SERIALIZABLE(Realm::Memory);
 TYPE_IS_SERIALIZABLE(Realm::Memory::Kind);
@@ -260,6 +262,133 @@ namespace Realm {
   }
 
 
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class MachineSnapshotIndex<T>
+  //
+
+  namespace {
+    inline int snapshot_node(Processor p) { return ID(p).proc.owner_node; }
+    inline int snapshot_node(Memory m) { return ID(m).memory.owner_node; }
+
+    // orders things by owner node alone, for finding a node's range in a list
+    //  that is sorted by (owner node, id)
+    template <typename T>
+    struct SnapshotNodeCompare {
+      bool operator()(const T& a, int node) const { return snapshot_node(a) < node; }
+      bool operator()(int node, const T& b) const { return node < snapshot_node(b); }
+    };
+
+    // orders things the same way as a walk over the node infos
+    template <typename T>
+    struct SnapshotOrderCompare {
+      bool operator()(const T& a, const T& b) const
+      {
+	int na = snapshot_node(a);
+	int nb = snapshot_node(b);
+	return ((na < nb) || ((na == nb) && (a < b)));
+      }
+    };
+
+    template <typename T>
+    void restrict_span_to_node(MachineQuerySpan<T>& span, int node)
+    {
+      std::pair<const T *, const T *> range =
+	std::equal_range(span.first, span.last, node, SnapshotNodeCompare<T>());
+      span.first = range.first;
+      span.last = range.second;
+    }
+
+    template <typename T>
+    T span_next(const MachineQuerySpan<T>& span, T after, T none)
+    {
+      const T *pos = std::upper_bound(span.first, span.last, after,
+				      SnapshotOrderCompare<T>());
+      return ((pos != span.last) ? *pos : none);
+    }
+  };
+
+  template <typename T>
+  void MachineSnapshotIndex<T>::add(ID::IDType key, int kind, T thing)
+  {
+    lists[std::make_pair(key, kind)].push_back(thing);
+    lists[std::make_pair(key, -1)].push_back(thing);
+  }
+
+  template <typename T>
+  bool MachineSnapshotIndex<T>::lookup(ID::IDType key, int kind,
+				       MachineQuerySpan<T>& span) const
+  {
+    typename std::map<std::pair<ID::IDType, int>, std::vector<T> >::const_iterator it = lists.find(std::make_pair(key, kind));
+    if(it == lists.end()) {
+      span.first = span.last = 0;
+      return false;
+    }
+    span.first = &(it->second[0]);
+    span.last = span.first + it->second.size();
+    return true;
+  }
+
+
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class MachineSnapshot
+  //
+
+  MachineSnapshot::MachineSnapshot(const std::map<int, MachineNodeInfo *>& nodeinfos,
+				   unsigned _version)
+    : version(_version)
+  {
+    // the node infos are walked in (node, id) order, which is the order the
+    //  indices need
+    for(std::map<int, MachineNodeInfo *>::const_iterator it = nodeinfos.begin();
+	it != nodeinfos.end();
+	++it) {
+      for(std::map<Processor, MachineProcInfo *>::const_iterator it2 = it->second->procs.begin();
+	  it2 != it->second->procs.end();
+	  ++it2) {
+	Processor p = it2->first;
+	int kind = p.kind();
+	procs_all.add(0, kind, p);
+	const MachineAffinityInfo<Memory, Machine::ProcessorMemoryAffinity>& pmas = it2->second->pmas;
+	for(std::map<Memory, Machine::ProcessorMemoryAffinity *>::const_iterator it3 = pmas.all.begin();
+	    it3 != pmas.all.end();
+	    ++it3)
+	  procs_by_mem_affinity.add(it3->first.id, kind, p);
+	for(std::map<Memory, Machine::ProcessorMemoryAffinity *>::const_iterator it3 = pmas.best.begin();
+	    it3 != pmas.best.end();
+	    ++it3)
+	  procs_by_best_mem.add(it3->first.id, kind, p);
+      }
+
+      for(std::map<Memory, MachineMemInfo *>::const_iterator it2 = it->second->mems.begin();
+	  it2 != it->second->mems.end();
+	  ++it2) {
+	Memory m = it2->first;
+	int kind = m.kind();
+	mems_all.add(0, kind, m);
+	const MachineMemInfo *mmi = it2->second;
+	for(std::map<Processor, Machine::ProcessorMemoryAffinity *>::const_iterator it3 = mmi->pmas.all.begin();
+	    it3 != mmi->pmas.all.end();
+	    ++it3)
+	  mems_by_proc_affinity.add(it3->first.id, kind, m);
+	for(std::map<Processor, Machine::ProcessorMemoryAffinity *>::const_iterator it3 = mmi->pmas.best.begin();
+	    it3 != mmi->pmas.best.end();
+	    ++it3)
+	  mems_by_best_proc.add(it3->first.id, kind, m);
+	for(std::map<Memory, Machine::MemoryMemoryAffinity *>::const_iterator it3 = mmi->mmas_out.all.begin();
+	    it3 != mmi->mmas_out.all.end();
+	    ++it3)
+	  mems_by_mem_affinity.add(it3->first.id, kind, m);
+	for(std::map<Memory, Machine::MemoryMemoryAffinity *>::const_iterator it3 = mmi->mmas_out.best.begin();
+	    it3 != mmi->mmas_out.best.end();
+	    ++it3)
+	  mems_by_best_mem.add(it3->first.id, kind, m);
+      }
+    }
+  }
+
+
   ////////////////////////////////////////////////////////////////////////
   //
   // class Machine
@@ -356,6 +485,8 @@ namespace Realm {
 
   namespace Config {
     bool use_machine_query_cache = true;
+    bool use_machine_snapshot = true;
+    bool lazy_machine_announce = true;
   };
 
   ////////////////////////////////////////////////////////////////////////
@@ -366,6 +497,9 @@ namespace Realm {
     MachineImpl *machine_singleton = 0;
 
   MachineImpl::MachineImpl(void)
+    : snapshot(0)
+    , snapshot_version(0)
+    , num_pending_announcements(0)
   {
     assert(machine_singleton == 0);
     machine_singleton = this;
@@ -376,6 +510,15 @@ namespace Realm {
     assert(machine_singleton == this);
     machine_singleton = 0;
     delete_map_contents(nodeinfos);
+    delete snapshot;
+    for(std::vector<MachineSnapshot *>::iterator it = retired_snapshots.begin();
+	it != retired_snapshots.end();
+	++it)
+      delete *it;
+    for(std::vector<PendingAnnouncement *>::iterator it = pending_announcements.begin();
+	it != pending_announcements.end();
+	++it)
+      delete *it;
   }
 
 #ifndef REALM_SKIP_INTERNODE_AFFINITIES
@@ -429,6 +572,70 @@ namespace Realm {
     {
       AutoHSLLock al(mutex);
 
+      // the processor/memory/channel objects are needed right away, but the
+      //  affinities (including the manufactured inter-node ones, which cost
+      //  O(local memories) per remote memory) are only needed once somebody
+      //  asks a question of the machine model
+      if(remote && Config::lazy_machine_announce) {
+	parse_announce_payload(node_id, num_procs, num_memories, num_ib_memories,
+			       args, arglen, remote,
+			       true /*objects*/, false /*affinities*/);
+
+	PendingAnnouncement *pa = new PendingAnnouncement;
+	pa->node_id = node_id;
+	pa->num_procs = num_procs;
+	pa->num_memories = num_memories;
+	pa->num_ib_memories = num_ib_memories;
+	pa->data.assign(static_cast<const char *>(args),
+			static_cast<const char *>(args) + arglen);
+	pending_announcements.push_back(pa);
+	num_pending_announcements = pending_announcements.size();
+      } else
+	parse_announce_payload(node_id, num_procs, num_memories, num_ib_memories,
+			       args, arglen, remote,
+			       true /*objects*/, true /*affinities*/);
+    }
+
+    void MachineImpl::apply_pending_announcements(void) const
+    {
+      // fast path - nothing deferred (or somebody already applied it all)
+      if(num_pending_announcements == 0)
+	return;
+
+      AutoHSLLock al(mutex);
+
+      std::vector<PendingAnnouncement *> todo;
+      todo.swap(pending_announcements);
+
+      for(std::vector<PendingAnnouncement *>::iterator it = todo.begin();
+	  it != todo.end();
+	  ++it) {
+	PendingAnnouncement *pa = *it;
+	log_annc.debug() << "applying deferred announcement from node " << pa->node_id;
+	const_cast<MachineImpl *>(this)->parse_announce_payload(pa->node_id,
+								pa->num_procs,
+								pa->num_memories,
+								pa->num_ib_memories,
+								&(pa->data[0]),
+								pa->data.size(),
+								true /*remote*/,
+								false /*objects*/,
+								true /*affinities*/);
+	delete pa;
+      }
+
+      // only clear the count once the model is complete, so that anybody
+      //  who sees zero without taking the lock sees all the affinities
+      __sync_synchronize();
+      num_pending_announcements = 0;
+    }
+
+    void MachineImpl::parse_announce_payload(int node_id, unsigned num_procs,
+					     unsigned num_memories, unsigned num_ib_memories,
+					     const void *args, size_t arglen,
+					     bool remote, bool add_objects,
+					     bool add_affinities)
+    {
       assert(node_id <= max_node_id);
       Node& n = get_runtime()->nodes[node_id];
 
@@ -459,7 +666,7 @@ namespace Realm {
 	      assert(ID(p).proc.proc_idx < num_procs);
 	      log_annc.debug() << "adding proc " << p << " (kind = " << kind
 			       << " num_cores = " << num_cores << ")";
-	      if(remote) {
+	      if(remote && add_objects) {
 		RemoteProcessor *proc = new RemoteProcessor(p, kind, num_cores);
 		n.processors[ID(p).proc.proc_idx] = proc;
 	      }
@@ -484,12 +691,14 @@ namespace Realm {
 	      log_annc.debug() << "adding memory " << m << " (kind = " << kind
 			       << ", size = " << size << ", regbase = " << std::hex << regbase << std::dec << ")";
 	      if(remote) {
-		RemoteMemory *mem = new RemoteMemory(m, size, kind,
-						     reinterpret_cast<void *>(regbase));
-		n.memories[ID(m).memory.mem_idx] = mem;
+		if(add_objects) {
+		  RemoteMemory *mem = new RemoteMemory(m, size, kind,
+						       reinterpret_cast<void *>(regbase));
+		  n.memories[ID(m).memory.mem_idx] = mem;
+		}
 
 #ifndef REALM_SKIP_INTERNODE_AFFINITIES
-		{
+		if(add_affinities) {
 		  // manufacture affinities for remote writes
 		  // acceptable local sources: SYSTEM, Z_COPY, REGDMA (bonus)
 		  // acceptable remote targets: SYSTEM, Z_COPY, GPU_FB, DISK, HDF, FILE, REGDMA (bonus)
@@ -561,7 +770,7 @@ namespace Realm {
 	      assert(ID(m).memory.mem_idx < num_ib_memories);
 	      log_annc.debug() << "adding ib memory " << m << " (kind = " << kind
 			       << ", size = " << size << ", regbase = " << std::hex << regbase << std::dec << ")";
-	      if(remote) {
+	      if(remote && add_objects) {
 		RemoteMemory *mem = new RemoteMemory(m, size, kind,
 						     reinterpret_cast<void *>(regbase));
 		n.ib_memories[ID(m).memory.mem_idx] = mem;
@@ -582,7 +791,8 @@ namespace Realm {
 	      log_annc.debug() << "adding affinity " << pma.p << " -> " << pma.m
 			       << " (bw = " << pma.bandwidth << ", latency = " << pma.latency << ")";
 
-	      add_proc_mem_affinity(pma, true /*lock held*/);
+	      if(add_affinities)
+		add_proc_mem_affinity(pma, true /*lock held*/);
 	      //proc_mem_affinities.push_back(pma);
 	    }
 	  }
@@ -600,7 +810,8 @@ namespace Realm {
 	      log_annc.debug() << "adding affinity " << mma.m1 << " <-> " << mma.m2
 			       << " (bw = " << mma.bandwidth << ", latency = " << mma.latency << ")";
 
-	      add_mem_mem_affinity(mma, true /*lock held*/);
+	      if(add_affinities)
+		add_mem_mem_affinity(mma, true /*lock held*/);
 	      //mem_mem_affinities.push_back(mma);
 	    }
 	  }
@@ -612,7 +823,7 @@ namespace Realm {
 	    if(rc) {
 	      log_annc.debug() << "adding channel: " << *rc;
 	      assert(rc->node == node_id);
-	      if(remote)
+	      if(remote && add_objects)
 		get_runtime()->add_dma_channel(rc);
 	      else
 		delete rc; // don't actually need it
@@ -631,6 +842,8 @@ namespace Realm {
 
     void MachineImpl::get_all_memories(std::set<Memory>& mset) const
     {
+      apply_pending_announcements();
+
       // TODO: consider using a reader/writer lock here instead
       AutoHSLLock al(mutex);
 #ifdef USE_OLD_AFFINITIES
@@ -652,6 +865,8 @@ namespace Realm {
 
     void MachineImpl::get_all_processors(std::set<Processor>& pset) const
     {
+      apply_pending_announcements();
+
       // TODO: consider using a reader/writer lock here instead
       AutoHSLLock al(mutex);
 #ifdef USE_OLD_AFFINITIES
@@ -692,6 +907,8 @@ namespace Realm {
 
     void MachineImpl::get_local_processors(std::set<Processor>& pset) const
     {
+      apply_pending_announcements();
+
       // TODO: consider using a reader/writer lock here instead
       AutoHSLLock al(mutex);
 #ifdef USE_OLD_AFFINITIES
@@ -715,6 +932,8 @@ namespace Realm {
     void MachineImpl::get_local_processors_by_kind(std::set<Processor>& pset,
 						   Processor::Kind kind) const
     {
+      apply_pending_announcements();
+
       // TODO: consider using a reader/writer lock here instead
       AutoHSLLock al(mutex);
 #ifdef USE_OLD_AFFINITIES
@@ -740,6 +959,8 @@ namespace Realm {
     // Return the set of memories visible from a processor
     void MachineImpl::get_visible_memories(Processor p, std::set<Memory>& mset, bool local_only) const
     {
+      apply_pending_announcements();
+
       // TODO: consider using a reader/writer lock here instead
       AutoHSLLock al(mutex);
 #ifdef USE_OLD_AFFINITIES
@@ -769,6 +990,8 @@ namespace Realm {
     void MachineImpl::get_visible_memories(Memory m, std::set<Memory>& mset,
 					   bool local_only) const
     {
+      apply_pending_announcements();
+
       // TODO: consider using a reader/writer lock here instead
       AutoHSLLock al(mutex);
 #ifdef USE_OLD_AFFINITIES
@@ -814,6 +1037,8 @@ namespace Realm {
     void MachineImpl::get_shared_processors(Memory m, std::set<Processor>& pset,
 					    bool local_only) const
     {
+      apply_pending_announcements();
+
       // TODO: consider using a reader/writer lock here instead
       AutoHSLLock al(mutex);
 #ifdef USE_OLD_AFFINITIES
@@ -840,6 +1065,8 @@ namespace Realm {
 
     bool MachineImpl::has_affinity(Processor p, Memory m, Machine::AffinityDetails *details /*= 0*/) const
     {
+      apply_pending_announcements();
+
       // TODO: consider using a reader/writer lock here instead
       AutoHSLLock al(mutex);
       for(std::vector<Machine::ProcessorMemoryAffinity>::const_iterator it = proc_mem_affinities.begin();
@@ -858,6 +1085,8 @@ namespace Realm {
 
     bool MachineImpl::has_affinity(Memory m1, Memory m2, Machine::AffinityDetails *details /*= 0*/) const
     {
+      apply_pending_announcements();
+
       // TODO: consider using a reader/writer lock here instead
       AutoHSLLock al(mutex);
       for(std::vector<Machine::MemoryMemoryAffinity>::const_iterator it = mem_mem_affinities.begin();
@@ -879,6 +1108,8 @@ namespace Realm {
 					     Memory restrict_memory /*= Memory::NO_MEMORY*/,
 					     bool local_only /*= true*/) const
     {
+      apply_pending_announcements();
+
       int count = 0;
 
       {
@@ -963,6 +1194,8 @@ namespace Realm {
 					  Memory restrict_mem2 /*= Memory::NO_MEMORY*/,
 					  bool local_only /*= true*/) const
     {
+      apply_pending_announcements();
+
       // Handle the case for same memories
       if (restrict_mem1.exists() && (restrict_mem1 == restrict_mem2))
       {
@@ -1122,8 +1355,30 @@ namespace Realm {
       subscribers.erase(subscriber);
     }
 
+    const MachineSnapshot *MachineImpl::get_snapshot(void) const
+    {
+      MachineSnapshot *snap = snapshot;
+      if(snap && (snap->version == snapshot_version))
+	return snap;
+
+      AutoHSLLock al(mutex);
+      // recheck now that we hold the lock
+      if(!snapshot || (snapshot->version != snapshot_version)) {
+	MachineSnapshot *new_snap = new MachineSnapshot(nodeinfos,
+							snapshot_version);
+	// other threads may still be looking at the old one
+	if(snapshot)
+	  retired_snapshots.push_back((MachineSnapshot *)snapshot);
+	__sync_synchronize();
+	snapshot = new_snap;
+      }
+      return snapshot;
+    }
+
     void MachineImpl::invalidate_query_caches()
     {
+      // caller holds the mutex
+      snapshot_version++;
       while (!__sync_bool_compare_and_swap(&MemoryQueryImpl::init,0,1))
         continue;
       __sync_fetch_and_add(&MemoryQueryImpl::cache_invalid_count,1);
@@ -1401,6 +1656,17 @@ namespace Realm {
 #endif
   }
 
+  bool ProcessorHasAffinityPredicate::snapshot_index(const MachineSnapshot *snap,
+						    const MachineSnapshotIndex<Processor> *& index,
+						    ID::IDType& key) const
+  {
+    if((min_bandwidth != 0) || (max_latency != 0))
+      return false;
+    index = &snap->procs_by_mem_affinity;
+    key = memory.id;
+    return true;
+  }
+
 
   ////////////////////////////////////////////////////////////////////////
   //
@@ -1448,6 +1714,17 @@ namespace Realm {
     return (best == memory);
   }
 
+  bool ProcessorBestAffinityPredicate::snapshot_index(const MachineSnapshot *snap,
+						     const MachineSnapshotIndex<Processor> *& index,
+						     ID::IDType& key) const
+  {
+    if((bandwidth_weight != 1) || (latency_weight != 0))
+      return false;
+    index = &snap->procs_by_best_mem;
+    key = memory.id;
+    return true;
+  }
+
 
   ////////////////////////////////////////////////////////////////////////
   //
@@ -1473,7 +1750,9 @@ namespace Realm {
     , cur_cached_list(NULL)
     , invalid_count(cache_invalid_count)
 
-  {}
+  {
+    machine->apply_pending_announcements();
+  }
 
   ProcessorQueryImpl::ProcessorQueryImpl(const ProcessorQueryImpl& copy_from)
     : references(1)
@@ -1576,6 +1855,24 @@ namespace Realm {
 
   }
 
+  bool ProcessorQueryImpl::snapshot_span(MachineQuerySpan<Processor>& span) const
+  {
+    if(!Config::use_machine_snapshot || (predicates.size() > 1))
+      return false;
+
+    const MachineSnapshot *snap = machine->get_snapshot();
+    const MachineSnapshotIndex<Processor> *index = &snap->procs_all;
+    ID::IDType key = 0;
+    if(!predicates.empty() &&
+       !predicates[0]->snapshot_index(snap, index, key))
+      return false;
+
+    index->lookup(key, (is_restricted_kind ? int(restricted_kind) : -1), span);
+    if(is_restricted_node)
+      restrict_span_to_node(span, restricted_node_id);
+    return true;
+  }
+
   Processor ProcessorQueryImpl::next(Processor after)
   {
     Processor nextp = Processor::NO_PROC;
@@ -1857,6 +2154,10 @@ namespace Realm {
     return lowest;
 #else
 
+    MachineQuerySpan<Processor> span;
+    if(snapshot_span(span))
+      return ((span.first != span.last) ? *span.first : Processor::NO_PROC);
+
     // optimize if restricted kind without predicates and restricted_node attached to the query
     Processor pval = Processor::NO_PROC;
     if (cached_query(pval, QUERY_FIRST))
@@ -1938,6 +2239,10 @@ namespace Realm {
     }
     return lowest;
 #else
+    MachineQuerySpan<Processor> span;
+    if(snapshot_span(span))
+      return span_next(span, after, Processor::NO_PROC);
+
     std::map<int, MachineNodeInfo *>::const_iterator it;
     // start where we left off
     it = machine->nodeinfos.find(ID(after).proc.owner_node);
@@ -1988,6 +2293,10 @@ namespace Realm {
   {
 
     log_query.debug("cache_next: processor input id =  %llx\n", after.id);
+    MachineQuerySpan<Processor> span;
+    if(snapshot_span(span))
+      return span_next(span, after, Processor::NO_PROC);
+
     Processor pval = Processor::NO_PROC;
     if (cached_query(after, pval))
       return pval;
@@ -2023,6 +2332,10 @@ namespace Realm {
     }
     return pset.size();
 #else
+    MachineQuerySpan<Processor> span;
+    if(snapshot_span(span))
+      return span.size();
+
     size_t count=0;
     if (cached_query(count))
       return count;
@@ -2105,6 +2418,10 @@ namespace Realm {
       }
     }
 #else
+    MachineQuerySpan<Processor> span;
+    if(snapshot_span(span))
+      return ((span.first != span.last) ? span.first[lrand48() % span.size()] : Processor::NO_PROC);
+
     // optimize if restricted kind without predicates and restricted_node attached to the query
     Processor pval = Processor::NO_PROC;
     if (cached_query(pval, QUERY_RANDOM))
@@ -2192,6 +2509,17 @@ namespace Realm {
 #endif
   }
 
+  bool MemoryHasProcAffinityPredicate::snapshot_index(const MachineSnapshot *snap,
+						     const MachineSnapshotIndex<Memory> *& index,
+						     ID::IDType& key) const
+  {
+    if((min_bandwidth != 0) || (max_latency != 0))
+      return false;
+    index = &snap->mems_by_proc_affinity;
+    key = proc.id;
+    return true;
+  }
+
 
   ////////////////////////////////////////////////////////////////////////
   //
@@ -2230,6 +2558,17 @@ namespace Realm {
 #endif
   }
 
+  bool MemoryHasMemAffinityPredicate::snapshot_index(const MachineSnapshot *snap,
+						    const MachineSnapshotIndex<Memory> *& index,
+						    ID::IDType& key) const
+  {
+    if((min_bandwidth != 0) || (max_latency != 0))
+      return false;
+    index = &snap->mems_by_mem_affinity;
+    key = memory.id;
+    return true;
+  }
+
 
   ////////////////////////////////////////////////////////////////////////
   //
@@ -2277,6 +2616,17 @@ namespace Realm {
     return (best == proc);
   }
 
+  bool MemoryBestProcAffinityPredicate::snapshot_index(const MachineSnapshot *snap,
+						      const MachineSnapshotIndex<Memory> *& index,
+						      ID::IDType& key) const
+  {
+    if((bandwidth_weight != 1) || (latency_weight != 0))
+      return false;
+    index = &snap->mems_by_best_proc;
+    key = proc.id;
+    return true;
+  }
+
 
   ////////////////////////////////////////////////////////////////////////
   //
@@ -2324,6 +2674,17 @@ namespace Realm {
     return (best == memory);
   }
 
+  bool MemoryBestMemAffinityPredicate::snapshot_index(const MachineSnapshot *snap,
+						     const MachineSnapshotIndex<Memory> *& index,
+						     ID::IDType& key) const
+  {
+    if((bandwidth_weight != 1) || (latency_weight != 0))
+      return false;
+    index = &snap->mems_by_best_mem;
+    key = memory.id;
+    return true;
+  }
+
 
   ////////////////////////////////////////////////////////////////////////
   //
@@ -2346,6 +2707,7 @@ namespace Realm {
     , invalid_count(cache_invalid_count)
 
   {
+    machine->apply_pending_announcements();
   }
 
   MemoryQueryImpl::MemoryQueryImpl(const MemoryQueryImpl& copy_from)
@@ -2442,6 +2804,24 @@ namespace Realm {
     valid_cache = false;
   }
 
+  bool MemoryQueryImpl::snapshot_span(MachineQuerySpan<Memory>& span) const
+  {
+    if(!Config::use_machine_snapshot || (predicates.size() > 1))
+      return false;
+
+    const MachineSnapshot *snap = machine->get_snapshot();
+    const MachineSnapshotIndex<Memory> *index = &snap->mems_all;
+    ID::IDType key = 0;
+    if(!predicates.empty() &&
+       !predicates[0]->snapshot_index(snap, index, key))
+      return false;
+
+    index->lookup(key, (is_restricted_kind ? int(restricted_kind) : -1), span);
+    if(is_restricted_node)
+      restrict_span_to_node(span, restricted_node_id);
+    return true;
+  }
+
 
 
   std::vector<Memory>* MemoryQueryImpl::cached_list() const
@@ -2666,6 +3046,9 @@ namespace Realm {
     }
     return lowest;
 #else
+    MachineQuerySpan<Memory> span;
+    if(snapshot_span(span))
+      return ((span.first != span.last) ? *span.first : Memory::NO_MEMORY);
 
     Memory mval = Memory::NO_MEMORY;
     if (cached_query(mval, QUERY_FIRST))
@@ -2745,6 +3128,10 @@ namespace Realm {
     }
     return lowest;
 #else
+    MachineQuerySpan<Memory> span;
+    if(snapshot_span(span))
+      return span_next(span, after, Memory::NO_MEMORY);
+
     std::map<int, MachineNodeInfo *>::const_iterator it;
     // start where we left off
     it = machine->nodeinfos.find(ID(after).memory.owner_node);
@@ -2805,6 +3192,10 @@ namespace Realm {
 
   Memory MemoryQueryImpl::cache_next(Memory after) {
     log_query.debug("cache_next: memory input id =  %llx\n", after.id);
+    MachineQuerySpan<Memory> span;
+    if(snapshot_span(span))
+      return span_next(span, after, Memory::NO_MEMORY);
+
     Memory mval = Memory::NO_MEMORY;
     if (cached_query(after, mval))
       return mval;
@@ -2840,6 +3231,10 @@ namespace Realm {
     }
     return pset.size();
 #else
+    MachineQuerySpan<Memory> span;
+    if(snapshot_span(span))
+      return span.size();
+
     size_t count = 0;
     if (cached_query(count))
       return count;
@@ -2922,6 +3317,9 @@ namespace Realm {
       }
     }
 #else
+    MachineQuerySpan<Memory> span;
+    if(snapshot_span(span))
+      return ((span.first != span.last) ? span.first[lrand48() % span.size()] : Memory::NO_MEMORY);
 
     Memory mval = Memory::NO_MEMORY;
     if (cached_query(mval, QUERY_RANDOM))
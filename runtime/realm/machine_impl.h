@@ -23,9 +23,11 @@
 #include "legion/legion_types.h"
 #include "legion/legion_utilities.h"
 #include "realm/activemsg.h"
+#include "realm/id.h"
 
 #include <vector>
 #include <set>
+#include <map>
 
 namespace Realm {
 
@@ -80,6 +82,54 @@ namespace Realm {
     std::map<Memory::Kind, std::map<Memory, MachineMemInfo *> > mem_by_kind;
   };
 
+  // a contiguous range of query results, ordered by (owner node, id) just
+  //  like a walk over the node infos would produce them
+  template <typename T>
+  struct MachineQuerySpan {
+    const T *first;
+    const T *last;
+
+    size_t size(void) const { return last - first; }
+  };
+
+  template <typename T>
+  class MachineSnapshotIndex {
+  public:
+    // things must be added in (owner node, id) order - each thing is
+    //  recorded under its own kind and under a kind of -1 (i.e. any kind)
+    void add(ID::IDType key, int kind, T thing);
+
+    // returns false if there are no matching things at all
+    bool lookup(ID::IDType key, int kind, MachineQuerySpan<T>& span) const;
+
+  protected:
+    std::map<std::pair<ID::IDType, int>, std::vector<T> > lists;
+  };
+
+  // an immutable, indexed copy of the machine model, rebuilt (lazily) after
+  //  the machine changes - the common forms of processor/memory queries (a
+  //  kind and/or node restriction plus at most one affinity predicate) are
+  //  answered with an index lookup instead of a scan over every processor
+  //  or memory
+  struct MachineSnapshot {
+    MachineSnapshot(const std::map<int, MachineNodeInfo *>& nodeinfos,
+		    unsigned _version);
+
+    unsigned version;
+
+    // the key is 0 for the _all indices, and the id of the other side of the
+    //  affinity otherwise - the _best_ indices only include things for which
+    //  the key's affinity has the highest bandwidth
+    MachineSnapshotIndex<Processor> procs_all;
+    MachineSnapshotIndex<Processor> procs_by_mem_affinity;
+    MachineSnapshotIndex<Processor> procs_by_best_mem;
+    MachineSnapshotIndex<Memory> mems_all;
+    MachineSnapshotIndex<Memory> mems_by_proc_affinity;
+    MachineSnapshotIndex<Memory> mems_by_best_proc;
+    MachineSnapshotIndex<Memory> mems_by_mem_affinity;
+    MachineSnapshotIndex<Memory> mems_by_best_mem;
+  };
+
     class MachineImpl {
     public:
       MachineImpl(void);
@@ -122,6 +172,11 @@ namespace Realm {
 				    const void *args, size_t arglen,
 				    bool remote);
 
+      // adds the affinities from any remote announcements whose processing
+      //  was deferred - called on the way into every query (must not be
+      //  called with the mutex held)
+      void apply_pending_announcements(void) const;
+
       void add_proc_mem_affinity(const Machine::ProcessorMemoryAffinity& pma,
 				 bool lock_held = false);
       void add_mem_mem_affinity(const Machine::MemoryMemoryAffinity& mma,
@@ -130,6 +185,10 @@ namespace Realm {
       void add_subscription(Machine::MachineUpdateSubscriber *subscriber);
       void remove_subscription(Machine::MachineUpdateSubscriber *subscriber);
 
+      // returns an up-to-date snapshot - snapshots are never freed before the
+      //  machine is, so the caller needs no reference
+      const MachineSnapshot *get_snapshot(void) const;
+
       mutable GASNetHSL mutex;
       std::vector<Machine::ProcessorMemoryAffinity> proc_mem_affinities;
       std::vector<Machine::MemoryMemoryAffinity> mem_mem_affinities;
@@ -138,6 +197,27 @@ namespace Realm {
       std::map<int, MachineNodeInfo *> nodeinfos;
 
     protected:
+      mutable MachineSnapshot * volatile snapshot;
+      mutable std::vector<MachineSnapshot *> retired_snapshots;
+      volatile unsigned snapshot_version;
+
+      // remote announcements whose affinities have not been added to the
+      //  machine model yet
+      struct PendingAnnouncement {
+	int node_id;
+	unsigned num_procs, num_memories, num_ib_memories;
+	std::vector<char> data;
+      };
+      mutable std::vector<PendingAnnouncement *> pending_announcements;
+      mutable volatile unsigned num_pending_announcements;
+
+      // caller holds the mutex
+      void parse_announce_payload(int node_id, unsigned num_procs,
+				  unsigned num_memories, unsigned num_ib_memories,
+				  const void *args, size_t arglen,
+				  bool remote, bool add_objects,
+				  bool add_affinities);
+
       MachineNodeInfo *get_nodeinfo(int node) const;
       MachineNodeInfo *get_nodeinfo(Processor p) const;
       MachineNodeInfo *get_nodeinfo(Memory m) const;
@@ -153,6 +233,12 @@ namespace Realm {
 
       virtual bool matches_predicate(MachineImpl *machine, T thing,
 				     const T2 *info = 0) const = 0;
+
+      // if the things matching this predicate are exactly those in one of
+      //  the snapshot's indices, sets 'index' and 'key' and returns true
+      virtual bool snapshot_index(const MachineSnapshot *snap,
+				  const MachineSnapshotIndex<T> *& index,
+				  ID::IDType& key) const { return false; }
     };
 
     typedef QueryPredicate<Processor,MachineProcInfo> ProcQueryPredicate;
@@ -166,6 +252,10 @@ namespace Realm {
       virtual bool matches_predicate(MachineImpl *machine, Processor thing,
 				     const MachineProcInfo *info = 0) const;
 
+      virtual bool snapshot_index(const MachineSnapshot *snap,
+				  const MachineSnapshotIndex<Processor> *& index,
+				  ID::IDType& key) const;
+
     protected:
       Memory memory;
       unsigned min_bandwidth;
@@ -181,6 +271,10 @@ namespace Realm {
       virtual bool matches_predicate(MachineImpl *machine, Processor thing,
 				     const MachineProcInfo *info = 0) const;
 
+      virtual bool snapshot_index(const MachineSnapshot *snap,
+				  const MachineSnapshotIndex<Processor> *& index,
+				  ID::IDType& key) const;
+
     protected:
       Memory memory;
       int bandwidth_weight;
@@ -189,6 +283,8 @@ namespace Realm {
 
   namespace Config {
     extern bool use_machine_query_cache;
+    extern bool use_machine_snapshot;
+    extern bool lazy_machine_announce;
   };
 
   enum QueryType {
@@ -232,6 +328,10 @@ namespace Realm {
       Processor cache_next(Processor after);
 
     protected:
+      // fills in 'span' and returns true if the query can be answered from
+      //  the machine snapshot
+      bool snapshot_span(MachineQuerySpan<Processor>& span) const;
+
       int references;
       MachineImpl *machine;
       bool is_restricted_node;
@@ -263,6 +363,10 @@ namespace Realm {
       virtual bool matches_predicate(MachineImpl *machine, Memory thing,
 				     const MachineMemInfo *info = 0) const;
 
+      virtual bool snapshot_index(const MachineSnapshot *snap,
+				  const MachineSnapshotIndex<Memory> *& index,
+				  ID::IDType& key) const;
+
     protected:
       Processor proc;
       unsigned min_bandwidth;
@@ -278,6 +382,10 @@ namespace Realm {
       virtual bool matches_predicate(MachineImpl *machine, Memory thing,
 				     const MachineMemInfo *info = 0) const;
 
+      virtual bool snapshot_index(const MachineSnapshot *snap,
+				  const MachineSnapshotIndex<Memory> *& index,
+				  ID::IDType& key) const;
+
     protected:
       Memory memory;
       unsigned min_bandwidth;
@@ -293,6 +401,10 @@ namespace Realm {
       virtual bool matches_predicate(MachineImpl *machine, Memory thing,
 				     const MachineMemInfo *info = 0) const;
 
+      virtual bool snapshot_index(const MachineSnapshot *snap,
+				  const MachineSnapshotIndex<Memory> *& index,
+				  ID::IDType& key) const;
+
     protected:
       Processor proc;
       int bandwidth_weight;
@@ -308,6 +420,10 @@ namespace Realm {
       virtual bool matches_predicate(MachineImpl *machine, Memory thing,
 				     const MachineMemInfo *info = 0) const;
 
+      virtual bool snapshot_index(const MachineSnapshot *snap,
+				  const MachineSnapshotIndex<Memory> *& index,
+				  ID::IDType& key) const;
+
     protected:
       Memory memory;
       int bandwidth_weight;
@@ -347,6 +463,8 @@ namespace Realm {
       Memory mutated_cached_query(Memory p);
 
     protected:
+      bool snapshot_span(MachineQuerySpan<Memory>& span) const;
+
       int references;
       MachineImpl *machine;
       bool is_restricted_node;
@@ -22,6 +22,11 @@
 #include "realm/runtime_impl.h"
 #include "realm/profiling.h"
 #include "realm/utils.h"
+#include "realm/numa/numasysif.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include <errno.h>
 
 #ifdef USE_GASNET
 #ifndef GASNET_PAR
@@ -423,15 +428,20 @@ namespace Realm {
 	ok = allocator.allocate(i, bytes, alignment, offset);
       }
 
+      // let the creator know if the storage is already known to be zero, so
+      //  that an initial fill of zeroes can be skipped
+      bool zeroed = (ok && (bytes > 0) && claim_zeroed_range(offset, bytes));
+
       if(ID(i).instance.creator_node == my_node_id) {
 	// local notification of result
-	get_instance(i)->notify_allocation(ok, offset);
+	get_instance(i)->notify_allocation(ok, offset, zeroed);
       } else {
 	// remote notification
 	MemStorageAllocResponse::send_request(ID(i).instance.creator_node,
 					      i,
 					      offset,
-					      ok);
+					      ok,
+					      zeroed);
       }
 
       return true /*immediate notification*/;
@@ -460,7 +470,39 @@ namespace Realm {
       assert(impl->metadata.inst_offset != size_t(-1));
       // deallocate unless the allocation had failed
       if(impl->metadata.inst_offset != size_t(-2)) {
+	// the placement of the instance's pages has to be sampled before the
+	//  storage is given back (and only the creator has the measurements)
+	if((ID(i).instance.creator_node == my_node_id) &&
+	   impl->measurements.wants_measurement<ProfilingMeasurements::InstanceNumaLocality>()) {
+	  std::map<int, size_t> bytes_per_node;
+	  if(get_numa_locality(impl->metadata.inst_offset,
+			       impl->metadata.layout->bytes_used,
+			       bytes_per_node)) {
+	    ProfilingMeasurements::InstanceNumaLocality locality;
+	    locality.instance = i;
+	    locality.memory = me;
+	    for(std::map<int, size_t>::const_iterator it = bytes_per_node.begin();
+		it != bytes_per_node.end();
+		++it) {
+	      ProfilingMeasurements::InstanceNumaLocality::NodeBytes nb;
+	      nb.numa_node = it->first;
+	      nb.bytes = it->second;
+	      locality.nodes.push_back(nb);
+	      log_inst.info() << "numa locality: inst=" << i << " node=" << it->first
+			      << " bytes=" << it->second;
+	    }
+	    impl->measurements.add_measurement(locality);
+	  }
+	}
+
 	AutoHSLLock al(allocator_mutex);
+	// the range must be released while we still own it - once it's back in
+	//  the allocator, somebody else may start using it
+	std::map<RegionInstance, BasicRangeAllocator<size_t, RegionInstance>::Range *>::const_iterator it = allocator.allocated.find(i);
+	if((it != allocator.allocated.end()) &&
+	   (it->second->last > it->second->first))
+	  release_zeroed_range(it->second->first,
+			       it->second->last - it->second->first);
 	allocator.deallocate(i);
       }
 
@@ -482,42 +524,75 @@ namespace Realm {
 
   LocalCPUMemory::LocalCPUMemory(Memory _me, size_t _size, 
                                  int _numa_node, Memory::Kind _lowlevel_kind,
-				 void *prealloc_base /*= 0*/, bool _registered /*= false*/) 
+				 void *prealloc_base /*= 0*/, bool _registered /*= false*/,
+				 bool _shared /*= false*/)
     : MemoryImpl(_me, _size, MKIND_SYSMEM, ALIGNMENT, _lowlevel_kind),
-      numa_node(_numa_node)
+      numa_node(_numa_node),
+      numa_policy((_numa_node >= 0) ? NUMA_BIND : NUMA_DEFAULT),
+      zero_page_threshold(0)
   {
+    mapped = false;
+    shared = false;
     if(prealloc_base) {
       base = (char *)prealloc_base;
       prealloced = true;
       registered = _registered;
+      if(_shared) {
+	assert((reinterpret_cast<size_t>(base) % ALIGNMENT) == 0);
+	shared = true;
+	if(_size > 0)
+	  zeroed_ranges[0] = _size;
+      }
     } else {
-      // allocate our own space
-      // enforce alignment on the whole memory range
-      base_orig = new char[_size + ALIGNMENT - 1];
-      size_t ofs = reinterpret_cast<size_t>(base_orig) % ALIGNMENT;
-      if(ofs > 0) {
-	base = base_orig + (ALIGNMENT - ofs);
+      // allocate our own space - an anonymous mapping is preferred because the
+      //  OS zero-fills its pages lazily on first touch, so storage that has
+      //  never been used is known to be zero without us writing to it
+      void *ptr = mmap(0, _size, PROT_READ | PROT_WRITE,
+		       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if(ptr != MAP_FAILED) {
+	// mappings are page-aligned, which is at least ALIGNMENT
+	base_orig = base = (char *)ptr;
+	assert((reinterpret_cast<size_t>(base) % ALIGNMENT) == 0);
+	mapped = true;
+	if(_size > 0)
+	  zeroed_ranges[0] = _size;
       } else {
-	base = base_orig;
+	// enforce alignment on the whole memory range
+	base_orig = new char[_size + ALIGNMENT - 1];
+	size_t ofs = reinterpret_cast<size_t>(base_orig) % ALIGNMENT;
+	if(ofs > 0) {
+	  base = base_orig + (ALIGNMENT - ofs);
+	} else {
+	  base = base_orig;
+	}
       }
       prealloced = false;
-      assert(!_registered);
+      assert(!_registered && !_shared);
       registered = false;
     }
-    log_malloc.debug("CPU memory at %p, size = %zd%s%s", base, _size, 
-		     prealloced ? " (prealloced)" : "", registered ? " (registered)" : "");
+    log_malloc.debug("CPU memory at %p, size = %zd%s%s%s%s", base, _size, 
+		     prealloced ? " (prealloced)" : "", registered ? " (registered)" : "",
+		     mapped ? " (mapped)" : "", shared ? " (shared)" : "");
     free_blocks[0] = _size;
   }
 
   LocalCPUMemory::~LocalCPUMemory(void)
   {
-    if(!prealloced)
-      delete[] base_orig;
+    if(!prealloced) {
+      if(mapped)
+	munmap(base_orig, size);
+      else
+	delete[] base_orig;
+    }
   }
 
   off_t LocalCPUMemory::alloc_bytes(size_t size)
   {
-    return alloc_bytes_local(size);
+    off_t offset = alloc_bytes_local(size);
+    // these bytes are about to be written by somebody we can't track
+    if((offset >= 0) && (size > 0))
+      claim_zeroed_range(offset, size);
+    return offset;
   }
   
   void LocalCPUMemory::free_bytes(off_t offset, size_t size)
@@ -550,6 +625,123 @@ namespace Realm {
   {
     return registered ? base : 0;
   };
+
+  bool LocalCPUMemory::claim_zeroed_range(off_t offset, size_t size)
+  {
+    if(!mapped && !shared)
+      return false;
+
+    off_t end = offset + size;
+    bool all_zero = false;
+
+    AutoHSLLock al(zero_mutex);
+
+    // start with the last range that begins at or before 'offset'
+    std::map<off_t, off_t>::iterator it = zeroed_ranges.upper_bound(offset);
+    if(it != zeroed_ranges.begin()) {
+      --it;
+      if((it->first + it->second) <= offset)
+	++it;  // doesn't overlap
+    }
+
+    // remove every overlapping part, keeping anything that sticks out on
+    //  either side
+    while((it != zeroed_ranges.end()) && (it->first < end)) {
+      off_t r_start = it->first;
+      off_t r_end = it->first + it->second;
+      if((r_start <= offset) && (r_end >= end))
+	all_zero = true;
+      zeroed_ranges.erase(it++);
+      if(r_start < offset)
+	zeroed_ranges[r_start] = offset - r_start;
+      if(r_end > end)
+	zeroed_ranges[end] = r_end - end;
+    }
+
+    return all_zero;
+  }
+
+  void LocalCPUMemory::release_zeroed_range(off_t offset, size_t size)
+  {
+    if((!mapped && !shared) || (zero_page_threshold == 0) || (size < zero_page_threshold))
+      return;
+
+    // only whole pages can be handed back
+    static const size_t page_size = sysconf(_SC_PAGESIZE);
+    off_t start = ((offset + page_size - 1) / page_size) * page_size;
+    off_t end = ((offset + size) / page_size) * page_size;
+    if(start >= end)
+      return;
+
+    // a private anonymous mapping reads back as zeroes after this, but shared
+    //  storage has to be removed from the underlying object
+    int ret = madvise(base + start, end - start,
+		      (shared ? MADV_REMOVE : MADV_DONTNEED));
+    if(ret != 0) {
+      log_malloc.info() << "madvise failed: mem=" << me << " offset=" << start
+			<< " size=" << (end - start) << " errno=" << errno;
+      return;
+    }
+
+    AutoHSLLock al(zero_mutex);
+
+    // merge with neighbors that touch the new range
+    std::map<off_t, off_t>::iterator it = zeroed_ranges.lower_bound(start);
+    if(it != zeroed_ranges.begin()) {
+      std::map<off_t, off_t>::iterator prev = it;
+      --prev;
+      if((prev->first + prev->second) >= start) {
+	if((prev->first + prev->second) > end)
+	  end = prev->first + prev->second;
+	start = prev->first;
+	zeroed_ranges.erase(prev);
+      }
+    }
+    while((it != zeroed_ranges.end()) && (it->first <= end)) {
+      if((it->first + it->second) > end)
+	end = it->first + it->second;
+      zeroed_ranges.erase(it++);
+    }
+    zeroed_ranges[start] = end - start;
+  }
+
+  bool LocalCPUMemory::get_numa_locality(off_t offset, size_t size,
+					 std::map<int, size_t>& bytes_per_node)
+  {
+    return numasysif_get_mem_locality(base + offset, size, bytes_per_node);
+  }
+
+  int LocalCPUMemory::get_numa_distance(int cpu_node) const
+  {
+    switch(numa_policy) {
+    case NUMA_BIND:
+      return numasysif_get_distance(cpu_node, numa_node);
+
+    case NUMA_INTERLEAVE:
+      {
+	// every node holds an equal share of the pages
+	if(interleave_nodes.empty())
+	  return -1;
+	int total = 0;
+	for(std::vector<int>::const_iterator it = interleave_nodes.begin();
+	    it != interleave_nodes.end();
+	    ++it) {
+	  int d = numasysif_get_distance(cpu_node, *it);
+	  if(d < 0)
+	    return -1;
+	  total += d;
+	}
+	return (total / (int)interleave_nodes.size());
+      }
+
+    case NUMA_FIRST_TOUCH:
+      // pages land wherever the consumer touches them first
+      return numasysif_get_distance(cpu_node, cpu_node);
+
+    default:
+      return -1;
+    }
+  }
   
   ////////////////////////////////////////////////////////////////////////
   //
@@ -902,19 +1094,21 @@ namespace Realm {
   {
     RegionInstanceImpl *impl = get_runtime()->get_instance_impl(args.inst);
 
-    impl->notify_allocation(args.success, args.offset);
+    impl->notify_allocation(args.success, args.offset, args.zeroed);
   }
 
   /*static*/ void MemStorageAllocResponse::send_request(NodeID target,
 							RegionInstance inst,
 							size_t offset,
-							bool success)
+							bool success,
+							bool zeroed /*= false*/)
   {
     RequestArgs args;
 
     args.inst = inst;
     args.offset = offset;
     args.success = success;
+    args.zeroed = zeroed;
 
     Message::request(target, args);
   }
@@ -111,6 +111,20 @@ namespace Realm {
       virtual void release_instance_storage(RegionInstance i,
 					    Event precondition);
 
+      // memories that can tell when a range of their storage is known to hold
+      //  zeroes override these - 'claim_zeroed_range' is called when a range is
+      //  handed out and returns whether all of it was zero, and
+      //  'release_zeroed_range' is called (while the range is still owned by
+      //  the caller) when a range is about to be given back
+      virtual bool claim_zeroed_range(off_t offset, size_t size) { return false; }
+      virtual void release_zeroed_range(off_t offset, size_t size) {}
+
+      // memories backed by local host memory can report which NUMA node(s)
+      //  currently hold the pages of a range (bytes per node, -1 for pages that
+      //  are untouched or of unknown location) - returns false if not possible
+      virtual bool get_numa_locality(off_t offset, size_t size,
+				     std::map<int, size_t>& bytes_per_node) { return false; }
+
       off_t alloc_bytes_local(size_t size);
       void free_bytes_local(off_t offset, size_t size);
 
@@ -166,8 +180,11 @@ namespace Realm {
     public:
       static const size_t ALIGNMENT = 256;
 
+      // '_shared' means 'prealloc_base' is fresh (i.e. zero-filled) storage
+      //  from SharedMemoryTransport that co-located processes also map
       LocalCPUMemory(Memory _me, size_t _size, int numa_node, Memory::Kind _lowlevel_kind,
-		     void *prealloc_base = 0, bool _registered = false);
+		     void *prealloc_base = 0, bool _registered = false,
+		     bool _shared = false);
 
       virtual ~LocalCPUMemory(void);
 
@@ -179,11 +196,42 @@ namespace Realm {
       virtual int get_home_node(off_t offset, size_t size);
       virtual void *local_reg_base(void);
 
+      virtual bool claim_zeroed_range(off_t offset, size_t size);
+      virtual void release_zeroed_range(off_t offset, size_t size);
+
+      virtual bool get_numa_locality(off_t offset, size_t size,
+				     std::map<int, size_t>& bytes_per_node);
+
+      // how the pages of the memory are placed - 'numa_node' is only
+      //  meaningful for NUMA_BIND, NUMA_INTERLEAVE spreads pages round-robin
+      //  over 'interleave_nodes', and NUMA_FIRST_TOUCH leaves each page on
+      //  the node of the first thread to touch it
+      enum NumaPolicy {
+	NUMA_DEFAULT,
+	NUMA_BIND,
+	NUMA_INTERLEAVE,
+	NUMA_FIRST_TOUCH,
+      };
+
+      // estimated distance (in numasysif_get_distance units) from a cpu in
+      //  'cpu_node' to this memory, or -1 if unknown
+      int get_numa_distance(int cpu_node) const;
+
     public:
       const int numa_node;
+      NumaPolicy numa_policy;
+      std::vector<int> interleave_nodes;
+      // freed ranges at least this large have their pages handed back to the
+      //  OS so that the next allocation to use them sees fresh zero pages (only
+      //  possible when we mapped our own storage or it is shared, 0 = never)
+      size_t zero_page_threshold;
     public: //protected:
       char *base, *base_orig;
-      bool prealloced, registered;
+      bool prealloced, registered, mapped, shared;
+      // known-zero ranges (offset -> size) of storage that has never been
+      //  written or whose pages have been handed back to the OS
+      GASNetHSL zero_mutex;
+      std::map<off_t, off_t> zeroed_ranges;
     };
 
     class GASNetMemory : public MemoryImpl {
@@ -328,6 +376,7 @@ namespace Realm {
 	RegionInstance inst;
 	size_t offset;
 	bool success;
+	bool zeroed;
       };
 
       static void handle_request(RequestArgs args);
@@ -338,7 +387,8 @@ namespace Realm {
 
       static void send_request(NodeID target,
 			       RegionInstance inst,
-			       size_t offset, bool success);
+			       size_t offset, bool success,
+			       bool zeroed = false);
     };
 
     struct MemStorageReleaseRequest {
@@ -38,6 +38,7 @@
 #include "realm/openmp/openmp_module.h"
 #endif
 #include "realm/procset/procset_module.h"
+#include "realm/stacksampler/stacksampler_module.h"
 #ifdef REALM_USE_PYTHON
 #include "realm/python/python_module.h"
 #endif
@@ -23,6 +23,8 @@
 #include "realm/runtime_impl.h"
 #include "realm/utils.h"
 
+#include <unistd.h>
+
 namespace Realm {
 
   Logger log_numa("numa");
@@ -97,6 +99,11 @@ namespace Realm {
       , cfg_num_numa_cpus(0)
       , cfg_pin_memory(false)
       , cfg_stack_size_in_mb(2)
+      , cfg_interleave_mem_size_in_mb(0)
+      , cfg_first_touch_mem_size_in_mb(0)
+      , interleave_mem_base(0)
+      , interleave_memory(0)
+      , first_touch_memory(0)
     {
     }
       
@@ -117,7 +124,9 @@ namespace Realm {
 	cp.add_option_int("-ll:nsize", m->cfg_numa_mem_size_in_mb)
 	  .add_option_int("-ll:ncsize", m->cfg_numa_nocpu_mem_size_in_mb)
 	  .add_option_int("-ll:ncpu", m->cfg_num_numa_cpus)
-	  .add_option_bool("-numa:pin", m->cfg_pin_memory);
+	  .add_option_bool("-numa:pin", m->cfg_pin_memory)
+	  .add_option_int("-numa:isize", m->cfg_interleave_mem_size_in_mb)
+	  .add_option_int("-numa:ftsize", m->cfg_first_touch_mem_size_in_mb);
 	
 	bool ok = cp.parse_command_line(cmdline);
 	if(!ok) {
@@ -129,6 +138,8 @@ namespace Realm {
       // if neither NUMA memory nor cpus was requested, there's no point
       if((m->cfg_numa_mem_size_in_mb == 0) &&
 	 (m->cfg_numa_nocpu_mem_size_in_mb <= 0) &&
+	 (m->cfg_interleave_mem_size_in_mb == 0) &&
+	 (m->cfg_first_touch_mem_size_in_mb == 0) &&
 	 (m->cfg_num_numa_cpus == 0)) {
 	log_numa.debug() << "no NUMA memory or cpus requested";
 	delete m;
@@ -178,6 +189,38 @@ namespace Realm {
 	  log_numa.warning() << "insufficient memory in NUMA node " << mi.node_id << " (" << mem_size << " > " << mi.bytes_available << " bytes) - skipping allocation";
 	}
       }
+      // an interleaved memory takes an equal share of its size from every node
+      if(m->cfg_interleave_mem_size_in_mb > 0) {
+	size_t mem_size = (m->cfg_interleave_mem_size_in_mb << 20);
+	size_t share = mem_size / meminfo.size();
+	bool ok = true;
+	for(std::map<int, NumaNodeMemInfo>::const_iterator it = meminfo.begin();
+	    it != meminfo.end();
+	    ++it) {
+	  size_t needed = share;
+	  std::map<int, size_t>::const_iterator it2 = m->numa_mem_sizes.find(it->first);
+	  if(it2 != m->numa_mem_sizes.end())
+	    needed += it2->second;
+	  if(it->second.bytes_available < needed) {
+	    log_numa.warning() << "insufficient memory in NUMA node " << it->first << " for interleaved memory (" << needed << " > " << it->second.bytes_available << " bytes) - skipping allocation";
+	    ok = false;
+	    break;
+	  }
+	}
+	if(ok) {
+	  for(std::map<int, NumaNodeMemInfo>::const_iterator it = meminfo.begin();
+	      it != meminfo.end();
+	      ++it)
+	    m->interleave_nodes.push_back(it->first);
+	} else
+	  m->cfg_interleave_mem_size_in_mb = 0;
+      }
+
+      // first-touch memory is only useful if the pages can move freely, so it
+      //  is never pinned
+      if((m->cfg_first_touch_mem_size_in_mb > 0) && m->cfg_pin_memory)
+	log_numa.warning() << "-numa:pin does not apply to first-touch memory";
+
       for(std::map<int, NumaNodeCpuInfo>::const_iterator it = cpuinfo.begin();
 	  it != cpuinfo.end();
 	  ++it) {
@@ -216,6 +259,17 @@ namespace Realm {
 	}
 	it->second = base;
       }
+
+      if(cfg_interleave_mem_size_in_mb > 0) {
+	size_t mem_size = cfg_interleave_mem_size_in_mb << 20;
+	interleave_mem_base = numasysif_alloc_interleaved_mem(interleave_nodes,
+							      mem_size,
+							      cfg_pin_memory);
+	if(!interleave_mem_base) {
+	  log_numa.fatal() << "allocation of " << mem_size << " bytes interleaved across " << interleave_nodes.size() << " NUMA nodes failed!";
+	  assert(false);
+	}
+      }
     }
 
     // create any memories provided by this module (default == do nothing)
@@ -242,6 +296,37 @@ namespace Realm {
 	runtime->add_memory(numamem);
 	memories[mem_node] = numamem;
       }
+
+      if(interleave_mem_base) {
+	Memory m = runtime->next_local_memory_id();
+	LocalCPUMemory *numamem = new LocalCPUMemory(m,
+						     cfg_interleave_mem_size_in_mb << 20,
+						     -1 /*no single numa node*/,
+						     Memory::SOCKET_MEM,
+						     interleave_mem_base,
+						     false /*!registered*/);
+	numamem->numa_policy = LocalCPUMemory::NUMA_INTERLEAVE;
+	numamem->interleave_nodes = interleave_nodes;
+	runtime->add_memory(numamem);
+	interleave_memory = numamem;
+      }
+
+      if(cfg_first_touch_mem_size_in_mb > 0) {
+	// the memory maps its own storage, leaving page placement to the
+	//  kernel's default (local) policy - freed pages are handed back so that
+	//  the next instance to use them is placed by its own consumer
+	Memory m = runtime->next_local_memory_id();
+	LocalCPUMemory *numamem = new LocalCPUMemory(m,
+						     cfg_first_touch_mem_size_in_mb << 20,
+						     -1 /*no single numa node*/,
+						     Memory::SOCKET_MEM);
+	if(!numamem->mapped)
+	  log_numa.warning() << "first-touch memory " << m << " could not be mapped - pages may not be placed by their consumers";
+	numamem->numa_policy = LocalCPUMemory::NUMA_FIRST_TOUCH;
+	numamem->zero_page_threshold = sysconf(_SC_PAGESIZE);
+	runtime->add_memory(numamem);
+	first_touch_memory = numamem;
+      }
     }
 
     // create any processors provided by the module (default == do nothing)
@@ -281,9 +366,7 @@ namespace Realm {
 
             if (kind == Memory::SOCKET_MEM) {
               LocalCPUMemory *cpu_mem = static_cast<LocalCPUMemory*>(*it2);
-              int mem_node = cpu_mem->numa_node;
-              assert(mem_node != -1);
-              int d = numasysif_get_distance(cpu_node, mem_node);
+              int d = cpu_mem->get_numa_distance(cpu_node);
 	      if(d >= 0) {
 		pma.bandwidth = 150 - d;
 		pma.latency = d / 10;     // Linux uses a cost of ~10/hop
@@ -340,6 +423,13 @@ namespace Realm {
 	if(!ok)
 	  log_numa.error() << "failed to free memory in NUMA node " << it->first << ": ptr=" << it->second;
       }
+
+      if(interleave_mem_base) {
+	bool ok = numasysif_free_mem(-1, interleave_mem_base,
+				     cfg_interleave_mem_size_in_mb << 20);
+	if(!ok)
+	  log_numa.error() << "failed to free interleaved memory: ptr=" << interleave_mem_base;
+      }
     }
 
   }; // namespace Numa
@@ -63,12 +63,20 @@ namespace Realm {
       int cfg_num_numa_cpus;
       bool cfg_pin_memory;
       size_t cfg_stack_size_in_mb;
+      // sizes of the (at most one each) SOCKET_MEMs whose pages are
+      //  interleaved across all NUMA nodes or placed by first touch
+      size_t cfg_interleave_mem_size_in_mb;
+      size_t cfg_first_touch_mem_size_in_mb;
 
       // "global" variables live here too
       std::map<int, void *> numa_mem_bases;
       std::map<int, size_t> numa_mem_sizes;
       std::map<int, int> numa_cpu_counts;
       std::map<int, MemoryImpl *> memories;
+      std::vector<int> interleave_nodes;
+      void *interleave_mem_base;
+      MemoryImpl *interleave_memory;
+      MemoryImpl *first_touch_memory;
     };
 
     REGISTER_REALM_MODULE(NumaModule);
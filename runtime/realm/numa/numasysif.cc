@@ -24,8 +24,10 @@
 #include <string.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <stdint.h>
 
 #include <vector>
+#include <algorithm>
 
 #ifdef __linux__
 #include <alloca.h>
@@ -52,6 +54,12 @@ namespace {
 		   maxnode, flags);
   }
 
+  long move_pages(int pid, unsigned long count, void **pages,
+		  const int *nodes, int *status, int flags)
+  {
+    return syscall(__NR_move_pages, pid, count, pages, nodes, status, flags);
+  }
+
 #if 0
   long set_mempolicy(int mode, const unsigned long *nmask,
 		     unsigned long maxnode)
@@ -387,4 +395,127 @@ namespace Realm {
 #endif
   }
 
+  // allocate memory whose pages are interleaved round-robin across the given
+  //  NUMA nodes - pin if requested (free with numasysif_free_mem)
+  void *numasysif_alloc_interleaved_mem(const std::vector<int>& nodes,
+					size_t bytes, bool pin)
+  {
+#ifdef __linux__
+    if(nodes.empty()) return 0;
+
+    unsigned char *nmask = (unsigned char *)alloca(detected_node_count >> 3);
+    for(int i = 0; i < detected_node_count >> 3; i++)
+      nmask[i] = 0;
+    for(std::vector<int>::const_iterator it = nodes.begin();
+	it != nodes.end();
+	++it) {
+      if((*it < 0) || (*it >= detected_node_count)) {
+	fprintf(stderr, "interleave request for node out of range: %d\n", *it);
+	return 0;
+      }
+      nmask[(*it >> 3)] |= (1 << (*it & 7));
+    }
+
+    void *base = mmap(0,
+		      bytes, 
+		      PROT_READ | PROT_WRITE,
+		      MAP_PRIVATE | MAP_ANONYMOUS,
+		      -1,
+		      0);
+    if(base == MAP_FAILED) return 0;
+
+    // the policy has to be in place before anything touches the pages
+    int ret = mbind(base, bytes,
+		    MPOL_INTERLEAVE,
+		    (const unsigned long *)nmask, detected_node_count,
+		    MPOL_MF_STRICT | MPOL_MF_MOVE);
+    if(ret != 0) {
+      fprintf(stderr, "failed to interleave memory across %zd nodes: %s\n",
+	      nodes.size(), strerror(errno));
+      numasysif_free_mem(-1, base, bytes);
+      return 0;
+    }
+
+    // pinning faults in every page, which places them according to the policy
+    if(pin) {
+      int ret = mlock(base, bytes);
+      if(ret != 0) {
+	fprintf(stderr, "mlock failed for interleaved memory: %s\n", strerror(errno));
+	numasysif_free_mem(-1, base, bytes);
+	return 0;
+      }
+    }
+
+    return base;
+#else
+    return 0;
+#endif
+  }
+
+  // report how many bytes of the given range currently reside in each NUMA
+  //  node - pages that have not been touched yet (or whose location cannot
+  //  be determined) are counted against node -1
+  // large ranges are sampled rather than queried page-by-page
+  bool numasysif_get_mem_locality(const void *base, size_t bytes,
+				  std::map<int, size_t>& bytes_per_node)
+  {
+#ifdef __linux__
+    static const size_t page_size = sysconf(_SC_PAGESIZE);
+    // upper bound on the number of pages whose location is asked for
+    static const size_t MAX_SAMPLES = 4096;
+    static const size_t BATCH_SIZE = 256;
+
+    if(bytes == 0) return true;
+
+    uintptr_t first = reinterpret_cast<uintptr_t>(base) & ~(uintptr_t)(page_size - 1);
+    uintptr_t last = ((reinterpret_cast<uintptr_t>(base) + bytes - 1) &
+		      ~(uintptr_t)(page_size - 1));
+    size_t num_pages = ((last - first) / page_size) + 1;
+    size_t stride = (num_pages + MAX_SAMPLES - 1) / MAX_SAMPLES;
+    size_t num_samples = (num_pages + stride - 1) / stride;
+
+    std::map<int, size_t> samples_per_node;
+    void *pages[BATCH_SIZE];
+    int status[BATCH_SIZE];
+    size_t done = 0;
+    while(done < num_samples) {
+      size_t count = std::min(BATCH_SIZE, num_samples - done);
+      for(size_t i = 0; i < count; i++)
+	pages[i] = reinterpret_cast<void *>(first + ((done + i) * stride * page_size));
+      // a null node list asks for the current location of each page
+      long ret = move_pages(0, count, pages, 0, status, 0);
+      if(ret != 0) {
+	// ENOSYS or EPERM mean we can't find out
+	return false;
+      }
+      for(size_t i = 0; i < count; i++)
+	samples_per_node[(status[i] >= 0) ? status[i] : -1]++;
+      done += count;
+    }
+
+    // scale the samples back up to the size of the range
+    size_t assigned = 0;
+    for(std::map<int, size_t>::const_iterator it = samples_per_node.begin();
+	it != samples_per_node.end();
+	++it) {
+      size_t b = (it->second == num_samples) ? bytes : (bytes * it->second / num_samples);
+      bytes_per_node[it->first] += b;
+      assigned += b;
+    }
+    // rounding leftovers go to the most common node
+    if(assigned < bytes) {
+      std::map<int, size_t>::const_iterator best = samples_per_node.begin();
+      for(std::map<int, size_t>::const_iterator it = samples_per_node.begin();
+	  it != samples_per_node.end();
+	  ++it)
+	if(it->second > best->second)
+	  best = it;
+      bytes_per_node[best->first] += (bytes - assigned);
+    }
+    return true;
+#else
+    return false;
+#endif
+  }
+
 };
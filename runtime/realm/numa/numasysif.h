@@ -25,6 +25,7 @@
 
 #include <stdlib.h>
 #include <map>
+#include <vector>
 
 namespace Realm {
 
@@ -63,6 +64,18 @@ namespace Realm {
   // may fail if the memory has already been touched
   bool numasysif_bind_mem(int node, void *base, size_t bytes, bool pin);
 
+  // allocate memory whose pages are interleaved round-robin across the given
+  //  NUMA nodes - pin if requested (free with numasysif_free_mem)
+  void *numasysif_alloc_interleaved_mem(const std::vector<int>& nodes,
+					size_t bytes, bool pin);
+
+  // report how many bytes of the given range currently reside in each NUMA
+  //  node - pages that have not been touched yet (or whose location cannot
+  //  be determined) are counted against node -1
+  // large ranges are sampled rather than queried page-by-page
+  bool numasysif_get_mem_locality(const void *base, size_t bytes,
+				  std::map<int, size_t>& bytes_per_node);
+
 };
 
 #endif
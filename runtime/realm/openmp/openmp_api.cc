@@ -19,10 +19,79 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 
 namespace Realm {
   extern Logger log_omp;
 
+#if defined(REALM_OPENMP_GOMP_SUPPORT) || defined(REALM_OPENMP_KMP_SUPPORT)
+  // locks for unnamed critical sections and for atomics the compiler can't
+  //  do natively - like named critical sections, these are global rather
+  //  than per-team
+  static int critical_lock = 0;
+  static int atomic_lock = 0;
+
+  static inline void spin_lock(volatile int *lock)
+  {
+    while(__sync_lock_test_and_set(lock, 1))
+      sched_yield();
+  }
+
+  static inline void spin_unlock(volatile int *lock)
+  {
+    __sync_lock_release(lock);
+  }
+
+  // a dynamic/guided loop on a thread that isn't part of a thread pool gets
+  //  all of its iterations in a single chunk
+  static __thread bool serial_loop_pending = false;
+  static __thread int64_t serial_loop_start, serial_loop_incr, serial_loop_iters;
+
+  static void start_dynamic_loop(int schedule, int64_t start, int64_t incr,
+				 int64_t iters, int64_t chunk_size)
+  {
+    Realm::ThreadPool::WorkerInfo *wi = Realm::ThreadPool::get_worker_info();
+    if(wi) {
+      wi->start_loop(schedule, start, incr, iters, chunk_size);
+    } else {
+      log_omp.warning() << "OpenMP-parallelized loop on non-OpenMP Realm processor!";
+      serial_loop_pending = true;
+      serial_loop_start = start;
+      serial_loop_incr = incr;
+      serial_loop_iters = iters;
+    }
+  }
+
+  // claims the next chunk of the caller's current loop, also returning the
+  //  loop's start, increment and iteration count
+  static bool next_dynamic_chunk(int64_t& first, int64_t& count,
+				 int64_t& start, int64_t& incr, int64_t& iters)
+  {
+    Realm::ThreadPool::WorkerInfo *wi = Realm::ThreadPool::get_worker_info();
+    if(!wi) {
+      if(!serial_loop_pending)
+	return false;
+      serial_loop_pending = false;
+      first = 0;
+      count = serial_loop_iters;
+      start = serial_loop_start;
+      incr = serial_loop_incr;
+      iters = serial_loop_iters;
+      return (count > 0);
+    }
+
+    const ThreadPool::LoopDispenser *ld = wi->current_loop();
+    if(!ld)
+      return false;
+    // read these first - the dispenser is recycled once we exhaust it
+    start = ld->start;
+    incr = ld->incr;
+    iters = ld->total_iters;
+    return wi->next_loop_chunk(first, count);
+  }
+#endif
+
   // application-visible calls - always generated
   extern "C" {
     int omp_get_num_threads(void)
@@ -93,6 +162,7 @@ namespace Realm {
       if(!wi)
 	return;
 
+      wi->finish_tasks();
       ThreadPool::WorkItem *work = wi->pop_work_item();
       assert(work != 0);
       // make sure all workers have finished
@@ -110,6 +180,286 @@ namespace Realm {
       fnptr(data);
       GOMP_parallel_end();
     }
+
+    void GOMP_barrier(void)
+    {
+      Realm::ThreadPool::WorkerInfo *wi = Realm::ThreadPool::get_worker_info();
+      if(wi)
+	wi->barrier();
+    }
+
+    void GOMP_critical_start(void)
+    {
+      spin_lock(&critical_lock);
+    }
+
+    void GOMP_critical_end(void)
+    {
+      spin_unlock(&critical_lock);
+    }
+
+    // the compiler provides a zero-initialized pointer for each name, which
+    //  is big enough to serve as the lock itself
+    void GOMP_critical_name_start(void **pptr)
+    {
+      spin_lock((volatile int *)pptr);
+    }
+
+    void GOMP_critical_name_end(void **pptr)
+    {
+      spin_unlock((volatile int *)pptr);
+    }
+
+    void GOMP_atomic_start(void)
+    {
+      spin_lock(&atomic_lock);
+    }
+
+    void GOMP_atomic_end(void)
+    {
+      spin_unlock(&atomic_lock);
+    }
+
+    bool GOMP_single_start(void)
+    {
+      Realm::ThreadPool::WorkerInfo *wi = Realm::ThreadPool::get_worker_info();
+      return (wi ? wi->single() : true);
+    }
+  };
+
+  // GOMP loops are [start, end) with a nonzero increment
+  static void gomp_loop_start(int schedule, long start, long end,
+			      long incr, long chunk_size)
+  {
+    long iters;
+    if(incr > 0)
+      iters = (end > start) ? ((end - start + incr - 1) / incr) : 0;
+    else
+      iters = (end < start) ? ((start - end - incr - 1) / -incr) : 0;
+    start_dynamic_loop(schedule, start, incr, iters, chunk_size);
+  }
+
+  static bool gomp_loop_next(long *istart, long *iend)
+  {
+    int64_t first, count, start, incr, iters;
+    if(!next_dynamic_chunk(first, count, start, incr, iters))
+      return false;
+
+    *istart = start + first * incr;
+    *iend = start + (first + count) * incr;
+    return true;
+  }
+
+  // used to set up the loop in each thread of a combined parallel loop
+  struct gomp_parallel_loop_thunk {
+    void (*fnptr)(void *data);
+    void *data;
+    int schedule;
+    long start, end, incr, chunk_size;
+
+    static void invoke(void *data)
+    {
+      const gomp_parallel_loop_thunk *thunk = (const gomp_parallel_loop_thunk *)data;
+      gomp_loop_start(thunk->schedule, thunk->start, thunk->end,
+		      thunk->incr, thunk->chunk_size);
+      (thunk->fnptr)(thunk->data);
+    }
+  };
+
+  static void gomp_parallel_loop(int schedule,
+				 void (*fnptr)(void *data), void *data,
+				 unsigned nthreads,
+				 long start, long end, long incr,
+				 long chunk_size, unsigned flags)
+  {
+    gomp_parallel_loop_thunk thunk;
+    thunk.fnptr = fnptr;
+    thunk.data = data;
+    thunk.schedule = schedule;
+    thunk.start = start;
+    thunk.end = end;
+    thunk.incr = incr;
+    thunk.chunk_size = chunk_size;
+    GOMP_parallel(&gomp_parallel_loop_thunk::invoke, &thunk, nthreads, flags);
+  }
+
+  extern "C" {
+    bool GOMP_loop_dynamic_start(long start, long end, long incr, long chunk_size,
+				 long *istart, long *iend)
+    {
+      gomp_loop_start(ThreadPool::LoopDispenser::SCHED_DYNAMIC,
+		      start, end, incr, chunk_size);
+      return gomp_loop_next(istart, iend);
+    }
+
+    bool GOMP_loop_dynamic_next(long *istart, long *iend)
+    {
+      return gomp_loop_next(istart, iend);
+    }
+
+    bool GOMP_loop_guided_start(long start, long end, long incr, long chunk_size,
+				long *istart, long *iend)
+    {
+      gomp_loop_start(ThreadPool::LoopDispenser::SCHED_GUIDED,
+		      start, end, incr, chunk_size);
+      return gomp_loop_next(istart, iend);
+    }
+
+    bool GOMP_loop_guided_next(long *istart, long *iend)
+    {
+      return gomp_loop_next(istart, iend);
+    }
+
+    // newer compilers use these for schedule(dynamic/guided) - our
+    //  dispensers are fine with either
+    bool GOMP_loop_nonmonotonic_dynamic_start(long start, long end, long incr,
+					      long chunk_size,
+					      long *istart, long *iend)
+    {
+      return GOMP_loop_dynamic_start(start, end, incr, chunk_size, istart, iend);
+    }
+
+    bool GOMP_loop_nonmonotonic_dynamic_next(long *istart, long *iend)
+    {
+      return gomp_loop_next(istart, iend);
+    }
+
+    bool GOMP_loop_nonmonotonic_guided_start(long start, long end, long incr,
+					     long chunk_size,
+					     long *istart, long *iend)
+    {
+      return GOMP_loop_guided_start(start, end, incr, chunk_size, istart, iend);
+    }
+
+    bool GOMP_loop_nonmonotonic_guided_next(long *istart, long *iend)
+    {
+      return gomp_loop_next(istart, iend);
+    }
+
+    // schedule(runtime) - we don't read OMP_SCHEDULE, so use guided
+    bool GOMP_loop_runtime_start(long start, long end, long incr,
+				 long *istart, long *iend)
+    {
+      gomp_loop_start(ThreadPool::LoopDispenser::SCHED_GUIDED,
+		      start, end, incr, 1);
+      return gomp_loop_next(istart, iend);
+    }
+
+    bool GOMP_loop_runtime_next(long *istart, long *iend)
+    {
+      return gomp_loop_next(istart, iend);
+    }
+
+    void GOMP_loop_end(void)
+    {
+      GOMP_barrier();
+    }
+
+    void GOMP_loop_end_nowait(void)
+    {
+      // nothing to do - the dispenser was released by the last _next call
+    }
+
+    void GOMP_parallel_loop_dynamic(void (*fnptr)(void *data), void *data,
+				    unsigned nthreads, long start, long end,
+				    long incr, long chunk_size, unsigned flags)
+    {
+      gomp_parallel_loop(ThreadPool::LoopDispenser::SCHED_DYNAMIC,
+			 fnptr, data, nthreads, start, end, incr, chunk_size, flags);
+    }
+
+    void GOMP_parallel_loop_guided(void (*fnptr)(void *data), void *data,
+				   unsigned nthreads, long start, long end,
+				   long incr, long chunk_size, unsigned flags)
+    {
+      gomp_parallel_loop(ThreadPool::LoopDispenser::SCHED_GUIDED,
+			 fnptr, data, nthreads, start, end, incr, chunk_size, flags);
+    }
+
+    void GOMP_parallel_loop_nonmonotonic_dynamic(void (*fnptr)(void *data), void *data,
+						 unsigned nthreads, long start, long end,
+						 long incr, long chunk_size, unsigned flags)
+    {
+      gomp_parallel_loop(ThreadPool::LoopDispenser::SCHED_DYNAMIC,
+			 fnptr, data, nthreads, start, end, incr, chunk_size, flags);
+    }
+
+    void GOMP_parallel_loop_nonmonotonic_guided(void (*fnptr)(void *data), void *data,
+						unsigned nthreads, long start, long end,
+						long incr, long chunk_size, unsigned flags)
+    {
+      gomp_parallel_loop(ThreadPool::LoopDispenser::SCHED_GUIDED,
+			 fnptr, data, nthreads, start, end, incr, chunk_size, flags);
+    }
+
+    void GOMP_parallel_loop_runtime(void (*fnptr)(void *data), void *data,
+				    unsigned nthreads, long start, long end,
+				    long incr, unsigned flags)
+    {
+      gomp_parallel_loop(ThreadPool::LoopDispenser::SCHED_GUIDED,
+			 fnptr, data, nthreads, start, end, incr, 1, flags);
+    }
+
+    // task flags from libgomp
+    enum {
+      GOMP_TASK_FLAG_UNTIED = 1,
+      GOMP_TASK_FLAG_FINAL = 2,
+      GOMP_TASK_FLAG_MERGEABLE = 4,
+      GOMP_TASK_FLAG_DEPEND = 8,
+    };
+
+    // newer compilers pass an additional priority argument, which we ignore
+    void GOMP_task(void (*fnptr)(void *data), void *data,
+		   void (*cpyfn)(void *dst, void *src),
+		   long arg_size, long arg_align, bool if_clause,
+		   unsigned flags, void **depend)
+    {
+      Realm::ThreadPool::WorkerInfo *wi = Realm::ThreadPool::get_worker_info();
+
+      bool deferred = wi && if_clause && !(flags & GOMP_TASK_FLAG_FINAL);
+      // dependences aren't tracked - instead, wait for all earlier siblings
+      //  and then run the task immediately
+      if(wi && (flags & GOMP_TASK_FLAG_DEPEND)) {
+	wi->wait_for_children();
+	deferred = false;
+      }
+
+      // a deferred task needs its own copy of the arguments, as does any
+      //  task with a copy constructor to run
+      void *alloc = 0;
+      void *args = data;
+      if(deferred || cpyfn) {
+	if(arg_align < 1)
+	  arg_align = 1;
+	alloc = malloc(arg_size + arg_align - 1);
+	assert(alloc != 0);
+	args = (void *)((((uintptr_t)alloc) + arg_align - 1) & ~(uintptr_t)(arg_align - 1));
+	if(cpyfn)
+	  (*cpyfn)(args, data);
+	else
+	  memcpy(args, data, arg_size);
+      }
+
+      if(wi) {
+	wi->spawn_task(fnptr, args, alloc, deferred);
+      } else {
+	(*fnptr)(args);
+	if(alloc)
+	  free(alloc);
+      }
+    }
+
+    void GOMP_taskwait(void)
+    {
+      Realm::ThreadPool::WorkerInfo *wi = Realm::ThreadPool::get_worker_info();
+      if(wi)
+	wi->wait_for_children();
+    }
+
+    void GOMP_taskyield(void)
+    {
+      // do nothing
+    }
   };
 #endif
 
@@ -122,6 +472,15 @@ namespace Realm {
   typedef struct ident ident_t;
   typedef void (*kmpc_reduce)(void *lhs_data, void *rhs_data);
   typedef int32_t kmp_critical_name;
+  typedef kmp_int32 (*kmp_routine_entry_t)(kmp_int32 global_tid, void *task);
+
+  // the start of libomp's task descriptor - the compiler puts the task's
+  //  private data immediately after it
+  struct kmp_task_t {
+    void *shareds;
+    kmp_routine_entry_t routine;
+    kmp_int32 part_id;
+  };
 
   extern "C" {
     void __kmpc_begin(ident_t *loc, kmp_int32 flags);
@@ -165,6 +524,69 @@ namespace Realm {
 
     void __kmpc_serialized_parallel(ident_t *loc, kmp_int32 global_tid);
     void __kmpc_end_serialized_parallel(ident_t *loc, kmp_int32 global_tid);
+
+    void __kmpc_barrier(ident_t *loc, kmp_int32 global_tid);
+    void __kmpc_critical(ident_t *loc, kmp_int32 global_tid,
+			 kmp_critical_name *lck);
+    void __kmpc_end_critical(ident_t *loc, kmp_int32 global_tid,
+			     kmp_critical_name *lck);
+    void __kmpc_atomic_start(void);
+    void __kmpc_atomic_end(void);
+    kmp_int32 __kmpc_single(ident_t *loc, kmp_int32 global_tid);
+    void __kmpc_end_single(ident_t *loc, kmp_int32 global_tid);
+    kmp_int32 __kmpc_master(ident_t *loc, kmp_int32 global_tid);
+    void __kmpc_end_master(ident_t *loc, kmp_int32 global_tid);
+
+    void __kmpc_dispatch_init_4(ident_t *loc, kmp_int32 global_tid,
+				kmp_int32 schedtype,
+				kmp_int32 lb, kmp_int32 ub,
+				kmp_int32 st, kmp_int32 chunk);
+    void __kmpc_dispatch_init_4u(ident_t *loc, kmp_int32 global_tid,
+				 kmp_int32 schedtype,
+				 kmp_uint32 lb, kmp_uint32 ub,
+				 kmp_int32 st, kmp_int32 chunk);
+    void __kmpc_dispatch_init_8(ident_t *loc, kmp_int32 global_tid,
+				kmp_int32 schedtype,
+				kmp_int64 lb, kmp_int64 ub,
+				kmp_int64 st, kmp_int64 chunk);
+    void __kmpc_dispatch_init_8u(ident_t *loc, kmp_int32 global_tid,
+				 kmp_int32 schedtype,
+				 kmp_uint64 lb, kmp_uint64 ub,
+				 kmp_int64 st, kmp_int64 chunk);
+    int __kmpc_dispatch_next_4(ident_t *loc, kmp_int32 global_tid,
+			       kmp_int32 *plastiter,
+			       kmp_int32 *plower, kmp_int32 *pupper,
+			       kmp_int32 *pstride);
+    int __kmpc_dispatch_next_4u(ident_t *loc, kmp_int32 global_tid,
+				kmp_int32 *plastiter,
+				kmp_uint32 *plower, kmp_uint32 *pupper,
+				kmp_int32 *pstride);
+    int __kmpc_dispatch_next_8(ident_t *loc, kmp_int32 global_tid,
+			       kmp_int32 *plastiter,
+			       kmp_int64 *plower, kmp_int64 *pupper,
+			       kmp_int64 *pstride);
+    int __kmpc_dispatch_next_8u(ident_t *loc, kmp_int32 global_tid,
+				kmp_int32 *plastiter,
+				kmp_uint64 *plower, kmp_uint64 *pupper,
+				kmp_int64 *pstride);
+
+    kmp_task_t *__kmpc_omp_task_alloc(ident_t *loc, kmp_int32 global_tid,
+				      kmp_int32 flags,
+				      size_t sizeof_kmp_task_t,
+				      size_t sizeof_shareds,
+				      kmp_routine_entry_t task_entry);
+    kmp_int32 __kmpc_omp_task(ident_t *loc, kmp_int32 global_tid,
+			      kmp_task_t *new_task);
+    kmp_int32 __kmpc_omp_task_with_deps(ident_t *loc, kmp_int32 global_tid,
+					kmp_task_t *new_task,
+					kmp_int32 ndeps, void *dep_list,
+					kmp_int32 ndeps_noalias,
+					void *noalias_dep_list);
+    void __kmpc_omp_task_begin_if0(ident_t *loc, kmp_int32 global_tid,
+				   kmp_task_t *task);
+    void __kmpc_omp_task_complete_if0(ident_t *loc, kmp_int32 global_tid,
+				      kmp_task_t *task);
+    kmp_int32 __kmpc_omp_taskwait(ident_t *loc, kmp_int32 global_tid);
   };
 
   struct kmp_thunk {
@@ -387,6 +809,7 @@ namespace Realm {
     (*invoker)(&thunk);
 
     // and then we immediately clean things up (c.f. GOMP_parallel_end)
+    wi->finish_tasks();
     ThreadPool::WorkItem *work2 = wi->pop_work_item();
     assert(work == work2);
     // make sure all workers have finished
@@ -535,11 +958,299 @@ namespace Realm {
       return;
 
     // pop the top work item and make sure we're the only worker
+    wi->finish_tasks();
     ThreadPool::WorkItem *work = wi->pop_work_item();
     assert(work != 0);
     assert(work->remaining_workers == 1);
     delete work;
   }
+
+  void __kmpc_barrier(ident_t *loc, kmp_int32 global_tid)
+  {
+    Realm::ThreadPool::WorkerInfo *wi = Realm::ThreadPool::get_worker_info();
+    if(wi)
+      wi->barrier();
+  }
+
+  // the compiler provides a zero-initialized kmp_critical_name for each
+  //  name, the first word of which serves as our lock
+  void __kmpc_critical(ident_t *loc, kmp_int32 global_tid,
+		       kmp_critical_name *lck)
+  {
+    spin_lock(lck ? lck : &critical_lock);
+  }
+
+  void __kmpc_end_critical(ident_t *loc, kmp_int32 global_tid,
+			   kmp_critical_name *lck)
+  {
+    spin_unlock(lck ? lck : &critical_lock);
+  }
+
+  void __kmpc_atomic_start(void)
+  {
+    spin_lock(&atomic_lock);
+  }
+
+  void __kmpc_atomic_end(void)
+  {
+    spin_unlock(&atomic_lock);
+  }
+
+  kmp_int32 __kmpc_single(ident_t *loc, kmp_int32 global_tid)
+  {
+    Realm::ThreadPool::WorkerInfo *wi = Realm::ThreadPool::get_worker_info();
+    return ((!wi || wi->single()) ? 1 : 0);
+  }
+
+  void __kmpc_end_single(ident_t *loc, kmp_int32 global_tid)
+  {
+    // do nothing
+  }
+
+  kmp_int32 __kmpc_master(ident_t *loc, kmp_int32 global_tid)
+  {
+    return ((omp_get_thread_num() == 0) ? 1 : 0);
+  }
+
+  void __kmpc_end_master(ident_t *loc, kmp_int32 global_tid)
+  {
+    // do nothing
+  }
+
+  // templated code for __kmpc_dispatch_init_{4,4u,8,8u} - bounds are
+  //  inclusive, and iterations are computed in the loop variable's type and
+  //  then carried as signed 64-bit values
+  template <typename T, typename ST>
+  static inline void kmpc_dispatch_init(ident_t *loc, kmp_int32 global_tid,
+					kmp_int32 schedtype,
+					T lb, T ub, ST st, ST chunk)
+  {
+    Realm::ThreadPool::WorkerInfo *wi = Realm::ThreadPool::get_worker_info();
+    int num_threads = (wi ? wi->num_threads : 1);
+
+    T iters;
+    if(st > 0)
+      iters = (ub >= lb) ? (1 + (ub - lb) / (T)st) : 0;
+    else
+      iters = (lb >= ub) ? (1 + (lb - ub) / (T)(-st)) : 0;
+
+    // ignore the monotonic/nonmonotonic modifiers
+    int schedule;
+    int64_t chunk_size = chunk;
+    switch(schedtype & ~((1 << 29) | (1 << 30))) {
+    case 33 /* kmp_sch_static_chunked */:
+      {
+	schedule = ThreadPool::LoopDispenser::SCHED_STATIC;
+	break;
+      }
+
+    case 34 /* kmp_sch_static */:
+      {
+	// one even share per thread
+	schedule = ThreadPool::LoopDispenser::SCHED_STATIC;
+	chunk_size = ((int64_t)iters + num_threads - 1) / num_threads;
+	break;
+      }
+
+    case 35 /* kmp_sch_dynamic_chunked */:
+      {
+	schedule = ThreadPool::LoopDispenser::SCHED_DYNAMIC;
+	break;
+      }
+
+    case 36 /* kmp_sch_guided_chunked */:
+    case 37 /* kmp_sch_runtime */:
+    case 38 /* kmp_sch_auto */:
+      {
+	schedule = ThreadPool::LoopDispenser::SCHED_GUIDED;
+	break;
+      }
+
+    default:
+      {
+	log_omp.fatal() << "unsupported loop schedule type: " << schedtype;
+	assert(false);
+	return;
+      }
+    }
+
+    start_dynamic_loop(schedule, (int64_t)lb, (int64_t)st, (int64_t)iters,
+		       chunk_size);
+  }
+
+  template <typename T, typename ST>
+  static inline int kmpc_dispatch_next(ident_t *loc, kmp_int32 global_tid,
+				       kmp_int32 *plastiter,
+				       T *plower, T *pupper, ST *pstride)
+  {
+    int64_t first, count, start, incr, iters;
+    if(!next_dynamic_chunk(first, count, start, incr, iters))
+      return 0;
+
+    T lb = (T)start;
+    ST st = (ST)incr;
+    *plower = lb + (T)(first * st);
+    *pupper = lb + (T)((first + count - 1) * st);
+    if(pstride)
+      *pstride = st;
+    if(plastiter)
+      *plastiter = ((first + count) == iters) ? 1 : 0;
+    return 1;
+  }
+
+  void __kmpc_dispatch_init_4(ident_t *loc, kmp_int32 global_tid,
+			      kmp_int32 schedtype,
+			      kmp_int32 lb, kmp_int32 ub,
+			      kmp_int32 st, kmp_int32 chunk)
+  {
+    kmpc_dispatch_init<kmp_int32, kmp_int32>(loc, global_tid, schedtype,
+					     lb, ub, st, chunk);
+  }
+
+  void __kmpc_dispatch_init_4u(ident_t *loc, kmp_int32 global_tid,
+			       kmp_int32 schedtype,
+			       kmp_uint32 lb, kmp_uint32 ub,
+			       kmp_int32 st, kmp_int32 chunk)
+  {
+    kmpc_dispatch_init<kmp_uint32, kmp_int32>(loc, global_tid, schedtype,
+					      lb, ub, st, chunk);
+  }
+
+  void __kmpc_dispatch_init_8(ident_t *loc, kmp_int32 global_tid,
+			      kmp_int32 schedtype,
+			      kmp_int64 lb, kmp_int64 ub,
+			      kmp_int64 st, kmp_int64 chunk)
+  {
+    kmpc_dispatch_init<kmp_int64, kmp_int64>(loc, global_tid, schedtype,
+					     lb, ub, st, chunk);
+  }
+
+  void __kmpc_dispatch_init_8u(ident_t *loc, kmp_int32 global_tid,
+			       kmp_int32 schedtype,
+			       kmp_uint64 lb, kmp_uint64 ub,
+			       kmp_int64 st, kmp_int64 chunk)
+  {
+    kmpc_dispatch_init<kmp_uint64, kmp_int64>(loc, global_tid, schedtype,
+					      lb, ub, st, chunk);
+  }
+
+  int __kmpc_dispatch_next_4(ident_t *loc, kmp_int32 global_tid,
+			     kmp_int32 *plastiter,
+			     kmp_int32 *plower, kmp_int32 *pupper,
+			     kmp_int32 *pstride)
+  {
+    return kmpc_dispatch_next<kmp_int32, kmp_int32>(loc, global_tid, plastiter,
+						    plower, pupper, pstride);
+  }
+
+  int __kmpc_dispatch_next_4u(ident_t *loc, kmp_int32 global_tid,
+			      kmp_int32 *plastiter,
+			      kmp_uint32 *plower, kmp_uint32 *pupper,
+			      kmp_int32 *pstride)
+  {
+    return kmpc_dispatch_next<kmp_uint32, kmp_int32>(loc, global_tid, plastiter,
+						     plower, pupper, pstride);
+  }
+
+  int __kmpc_dispatch_next_8(ident_t *loc, kmp_int32 global_tid,
+			     kmp_int32 *plastiter,
+			     kmp_int64 *plower, kmp_int64 *pupper,
+			     kmp_int64 *pstride)
+  {
+    return kmpc_dispatch_next<kmp_int64, kmp_int64>(loc, global_tid, plastiter,
+						    plower, pupper, pstride);
+  }
+
+  int __kmpc_dispatch_next_8u(ident_t *loc, kmp_int32 global_tid,
+			      kmp_int32 *plastiter,
+			      kmp_uint64 *plower, kmp_uint64 *pupper,
+			      kmp_int64 *pstride)
+  {
+    return kmpc_dispatch_next<kmp_uint64, kmp_int64>(loc, global_tid, plastiter,
+						     plower, pupper, pstride);
+  }
+
+  static void kmp_task_invoke(void *data)
+  {
+    kmp_task_t *task = (kmp_task_t *)data;
+    (task->routine)(__kmpc_global_thread_num(0), task);
+  }
+
+  kmp_task_t *__kmpc_omp_task_alloc(ident_t *loc, kmp_int32 global_tid,
+				    kmp_int32 flags,
+				    size_t sizeof_kmp_task_t,
+				    size_t sizeof_shareds,
+				    kmp_routine_entry_t task_entry)
+  {
+    // shareds go after the descriptor (and the privates that follow it)
+    size_t shareds_ofs = (sizeof_kmp_task_t + 15) & ~(size_t)15;
+    char *base = (char *)malloc(shareds_ofs + sizeof_shareds);
+    assert(base != 0);
+    kmp_task_t *task = (kmp_task_t *)base;
+    task->shareds = (sizeof_shareds ? (base + shareds_ofs) : 0);
+    task->routine = task_entry;
+    task->part_id = 0;
+    return task;
+  }
+
+  kmp_int32 __kmpc_omp_task(ident_t *loc, kmp_int32 global_tid,
+			    kmp_task_t *new_task)
+  {
+    Realm::ThreadPool::WorkerInfo *wi = Realm::ThreadPool::get_worker_info();
+    if(wi) {
+      wi->spawn_task(&kmp_task_invoke, new_task, new_task, true /*deferred*/);
+    } else {
+      kmp_task_invoke(new_task);
+      free(new_task);
+    }
+    return 0;
+  }
+
+  kmp_int32 __kmpc_omp_task_with_deps(ident_t *loc, kmp_int32 global_tid,
+				      kmp_task_t *new_task,
+				      kmp_int32 ndeps, void *dep_list,
+				      kmp_int32 ndeps_noalias,
+				      void *noalias_dep_list)
+  {
+    // dependences aren't tracked - instead, wait for all earlier siblings
+    //  and then run the task immediately
+    Realm::ThreadPool::WorkerInfo *wi = Realm::ThreadPool::get_worker_info();
+    if(wi) {
+      wi->wait_for_children();
+      wi->spawn_task(&kmp_task_invoke, new_task, new_task, false /*!deferred*/);
+    } else {
+      kmp_task_invoke(new_task);
+      free(new_task);
+    }
+    return 0;
+  }
+
+  // an undeferred task (i.e. if(0)) whose routine the caller runs itself
+  void __kmpc_omp_task_begin_if0(ident_t *loc, kmp_int32 global_tid,
+				 kmp_task_t *task)
+  {
+    Realm::ThreadPool::WorkerInfo *wi = Realm::ThreadPool::get_worker_info();
+    if(wi && wi->work_item)
+      wi->begin_inline_task(task);
+  }
+
+  void __kmpc_omp_task_complete_if0(ident_t *loc, kmp_int32 global_tid,
+				    kmp_task_t *task)
+  {
+    Realm::ThreadPool::WorkerInfo *wi = Realm::ThreadPool::get_worker_info();
+    if(wi && wi->work_item)
+      wi->end_inline_task();  // frees the descriptor
+    else
+      free(task);
+  }
+
+  kmp_int32 __kmpc_omp_taskwait(ident_t *loc, kmp_int32 global_tid)
+  {
+    Realm::ThreadPool::WorkerInfo *wi = Realm::ThreadPool::get_worker_info();
+    if(wi)
+      wi->wait_for_children();
+    return 0;
+  }
 #endif
 
 }; // namespace Realm
@@ -300,10 +300,8 @@ namespace Realm {
             if (cfg_use_numa) {
               // Figure out which numa node the memory is in
               LocalCPUMemory *cpu_mem = static_cast<LocalCPUMemory*>(*it2);
-              int mem_node = cpu_mem->numa_node;
-              assert(mem_node >= 0);
               // We know our numa node
-              int distance = numasysif_get_distance(cpu_node, mem_node);
+              int distance = cpu_mem->get_numa_distance(cpu_node);
               if (distance >= 0) {
                 pma.bandwidth = 150 - distance;
                 pma.latency = distance / 10;     // Linux uses a cost of ~10/hop
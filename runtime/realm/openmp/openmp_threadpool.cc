@@ -18,6 +18,9 @@
 
 #include "realm/logging.h"
 
+#include <stdlib.h>
+#include <algorithm>
+
 namespace Realm {
 
   Logger log_pool("threadpool");
@@ -26,6 +29,108 @@ namespace Realm {
     __thread ThreadPool::WorkerInfo *threadpool_workerinfo = 0;
   };
 
+  // team state is touched by few threads for short periods, so simple
+  //  spinlocks are used rather than anything that can put a thread to sleep
+  static inline void spin_lock(int *lock)
+  {
+    while(__sync_lock_test_and_set(lock, 1))
+      sched_yield();
+  }
+
+  static inline void spin_unlock(int *lock)
+  {
+    __sync_lock_release(lock);
+  }
+
+  static inline void clear_context(ThreadPool::TeamContext& ctx)
+  {
+    ctx.loop_index = 0;
+    ctx.single_index = 0;
+    ctx.loop = 0;
+    ctx.static_chunks = 0;
+    ctx.task = 0;
+  }
+
+  static inline void release_task(ThreadPool::Task *task)
+  {
+    if(__sync_sub_and_fetch(&(task->refcount), 1) == 0) {
+      if(task->alloc)
+	free(task->alloc);
+      delete task;
+    }
+  }
+
+
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // struct ThreadPool::LoopDispenser
+
+  bool ThreadPool::LoopDispenser::next_chunk(int thread_id,
+					     int64_t& static_chunks,
+					     int64_t& first, int64_t& count)
+  {
+    if(schedule == SCHED_STATIC) {
+      // no shared state - this thread's chunks are fixed by its id
+      int64_t chunk = thread_id + (static_chunks * num_threads);
+      if(chunk >= ((total_iters + chunk_size - 1) / chunk_size))
+	return false;
+      first = chunk * chunk_size;
+      count = std::min(chunk_size, total_iters - first);
+      static_chunks++;
+      return true;
+    }
+
+    if(schedule == SCHED_DYNAMIC) {
+      first = __sync_fetch_and_add(&next_iter, chunk_size);
+      if(first >= total_iters)
+	return false;
+      count = std::min(chunk_size, total_iters - first);
+      return true;
+    }
+
+    // guided: each chunk is a share of what is left, but no smaller than
+    //  chunk_size
+    assert(schedule == SCHED_GUIDED);
+    while(true) {
+      int64_t cur = __sync_fetch_and_add(&next_iter, 0);
+      if(cur >= total_iters)
+	return false;
+      int64_t left = total_iters - cur;
+      int64_t amt = std::max(chunk_size, (left + num_threads - 1) / num_threads);
+      if(amt > left)
+	amt = left;
+      if(__sync_bool_compare_and_swap(&next_iter, cur, cur + amt)) {
+	first = cur;
+	count = amt;
+	return true;
+      }
+    }
+  }
+
+
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // struct ThreadPool::WorkItem
+
+  ThreadPool::WorkItem::WorkItem(void)
+    : prev_thread_id(0)
+    , prev_num_threads(1)
+    , parent_work_item(0)
+    , remaining_workers(0)
+    , single_count(0)
+    , barrier_count(0)
+    , barrier_gen(0)
+    , team_lock(0)
+    , outstanding_tasks(0)
+  {
+    clear_context(prev_context);
+    for(int i = 0; i < MAX_ACTIVE_LOOPS; i++) {
+      loops[i].loop_index = -1;
+      loops[i].users = 0;
+    }
+  }
+
+
   ////////////////////////////////////////////////////////////////////////
   //
   // class ThreadPool::WorkerInfo
@@ -34,8 +139,10 @@ namespace Realm {
   {
     new_work->prev_thread_id = thread_id;
     new_work->prev_num_threads = num_threads;
+    new_work->prev_context = context;
     new_work->parent_work_item = work_item;
     work_item = new_work;
+    clear_context(context);
   }
 
   ThreadPool::WorkItem *ThreadPool::WorkerInfo::pop_work_item(void)
@@ -43,10 +150,256 @@ namespace Realm {
     WorkItem *old_item = work_item;
     thread_id = old_item->prev_thread_id;
     num_threads = old_item->prev_num_threads;
+    context = old_item->prev_context;
     work_item = old_item->parent_work_item;
     return old_item;
   }
 
+  void ThreadPool::WorkerInfo::barrier(void)
+  {
+    WorkItem *team = work_item;
+    if(!team)
+      return;
+
+    // a barrier is also a task scheduling point - it isn't released until
+    //  every task of the team is complete, and waiting threads help out
+    int gen = __sync_fetch_and_add(&(team->barrier_gen), 0);
+    if(__sync_add_and_fetch(&(team->barrier_count), 1) == num_threads) {
+      // everybody's here, so only tasks can create more tasks now
+      while(__sync_fetch_and_add(&(team->outstanding_tasks), 0) > 0)
+	if(!run_queued_task())
+	  sched_yield();
+      team->barrier_count = 0;
+      __sync_fetch_and_add(&(team->barrier_gen), 1);
+    } else {
+      while(__sync_fetch_and_add(&(team->barrier_gen), 0) == gen)
+	if(!run_queued_task())
+	  sched_yield();
+    }
+  }
+
+  void ThreadPool::WorkerInfo::start_loop(int schedule,
+					  int64_t start, int64_t incr,
+					  int64_t total_iters, int64_t chunk_size)
+  {
+    assert(context.loop == 0);
+    WorkItem *team = work_item;
+    if(!team) {
+      // not in a parallel region - use a private dispenser for the loop
+      LoopDispenser *ld = new LoopDispenser;
+      ld->loop_index = -1;
+      ld->users = 1;
+      ld->schedule = schedule;
+      ld->num_threads = 1;
+      ld->start = start;
+      ld->incr = incr;
+      ld->total_iters = total_iters;
+      ld->chunk_size = ((total_iters > 0) ? total_iters : 1);
+      ld->next_iter = 0;
+      context.loop = ld;
+      context.static_chunks = 0;
+      return;
+    }
+
+    // the team's n'th loop uses slot n % MAX_ACTIVE_LOOPS - whichever thread
+    //  gets there first sets it up, but not until every thread is done with
+    //  the slot's previous loop
+    int index = context.loop_index++;
+    LoopDispenser *ld = &(team->loops[index % WorkItem::MAX_ACTIVE_LOOPS]);
+    while(true) {
+      spin_lock(&(team->team_lock));
+      if(ld->loop_index == index)
+	break;
+      if((ld->loop_index < index) && (ld->users == 0)) {
+	ld->loop_index = index;
+	ld->users = num_threads;
+	ld->schedule = schedule;
+	ld->num_threads = num_threads;
+	ld->start = start;
+	ld->incr = incr;
+	ld->total_iters = total_iters;
+	ld->chunk_size = ((chunk_size > 0) ? chunk_size : 1);
+	ld->next_iter = 0;
+	break;
+      }
+      spin_unlock(&(team->team_lock));
+      sched_yield();
+    }
+    spin_unlock(&(team->team_lock));
+    context.loop = ld;
+    context.static_chunks = 0;
+  }
+
+  bool ThreadPool::WorkerInfo::next_loop_chunk(int64_t& first, int64_t& count)
+  {
+    LoopDispenser *ld = context.loop;
+    if(!ld)
+      return false;
+
+    if(ld->next_chunk((work_item ? thread_id : 0), context.static_chunks,
+		      first, count))
+      return true;
+
+    // this thread is done with the loop
+    context.loop = 0;
+    if(work_item) {
+      spin_lock(&(work_item->team_lock));
+      ld->users--;
+      spin_unlock(&(work_item->team_lock));
+    } else
+      delete ld;
+    return false;
+  }
+
+  bool ThreadPool::WorkerInfo::single(void)
+  {
+    if(!work_item)
+      return true;
+
+    // the first thread to get to its n'th single construct wins it
+    int index = context.single_index++;
+    return __sync_bool_compare_and_swap(&(work_item->single_count),
+					index, index + 1);
+  }
+
+  ThreadPool::Task *ThreadPool::WorkerInfo::current_task(void)
+  {
+    // the implicit task only gets a record once it has children
+    if(!context.task) {
+      Task *task = new Task;
+      task->fnptr = 0;
+      task->data = 0;
+      task->alloc = 0;
+      task->parent = 0;
+      task->refcount = 1;
+      context.task = task;
+    }
+    return context.task;
+  }
+
+  void ThreadPool::WorkerInfo::spawn_task(void (*fnptr)(void *data),
+					  void *data, void *alloc,
+					  bool deferred)
+  {
+    if(!work_item) {
+      // not in a parallel region - nobody else could run it anyway
+      (*fnptr)(data);
+      if(alloc)
+	free(alloc);
+      return;
+    }
+
+    Task *parent = current_task();
+    Task *task = new Task;
+    task->fnptr = fnptr;
+    task->data = data;
+    task->alloc = alloc;
+    task->parent = parent;
+    task->refcount = 1;
+    __sync_fetch_and_add(&(parent->refcount), 1);
+
+    if(deferred) {
+      __sync_fetch_and_add(&(work_item->outstanding_tasks), 1);
+      spin_lock(&(work_item->team_lock));
+      work_item->task_queue.push_back(task);
+      spin_unlock(&(work_item->team_lock));
+    } else
+      execute_task(task);
+  }
+
+  void ThreadPool::WorkerInfo::begin_inline_task(void *alloc)
+  {
+    if(!work_item)
+      return;
+
+    Task *parent = current_task();
+    Task *task = new Task;
+    task->fnptr = 0;
+    task->data = 0;
+    task->alloc = alloc;
+    task->parent = parent;
+    task->refcount = 1;
+    __sync_fetch_and_add(&(parent->refcount), 1);
+    context.task = task;
+  }
+
+  void ThreadPool::WorkerInfo::end_inline_task(void)
+  {
+    if(!work_item)
+      return;
+
+    Task *task = context.task;
+    assert(task && task->parent);
+    context.task = task->parent;
+    release_task(task->parent);
+    release_task(task);
+  }
+
+  void ThreadPool::WorkerInfo::execute_task(Task *task)
+  {
+    Task *prev_task = context.task;
+    context.task = task;
+    (task->fnptr)(task->data);
+    context.task = prev_task;
+    // the parent has one fewer unfinished child, and the task record goes
+    //  away once its own children are finished
+    release_task(task->parent);
+    release_task(task);
+  }
+
+  bool ThreadPool::WorkerInfo::run_queued_task(void)
+  {
+    WorkItem *team = work_item;
+    if(!team)
+      return false;
+
+    Task *task;
+    spin_lock(&(team->team_lock));
+    if(team->task_queue.empty()) {
+      task = 0;
+    } else {
+      // most recently created first, as it's likely to be cache-warm
+      task = team->task_queue.back();
+      team->task_queue.pop_back();
+    }
+    spin_unlock(&(team->team_lock));
+
+    if(!task)
+      return false;
+
+    execute_task(task);
+    __sync_fetch_and_sub(&(team->outstanding_tasks), 1);
+    return true;
+  }
+
+  void ThreadPool::WorkerInfo::wait_for_children(void)
+  {
+    Task *task = context.task;
+    if(!task)
+      return;
+
+    while(__sync_fetch_and_add(&(task->refcount), 0) > 1)
+      if(!run_queued_task())
+	sched_yield();
+  }
+
+  void ThreadPool::WorkerInfo::finish_tasks(void)
+  {
+    if(!work_item)
+      return;
+
+    while(__sync_fetch_and_add(&(work_item->outstanding_tasks), 0) > 0)
+      if(!run_queued_task())
+	sched_yield();
+
+    // all children of the implicit task are done too
+    if(context.task) {
+      assert(context.task->parent == 0);
+      release_task(context.task);
+      context.task = 0;
+    }
+  }
+
 
   ////////////////////////////////////////////////////////////////////////
   //
@@ -68,6 +421,7 @@ namespace Realm {
       wi.fnptr = 0;
       wi.data = 0;
       wi.work_item = 0;
+      clear_context(wi.context);
     }
 
     log_pool.info() << "pool " << (void *)this << " started - " << num_workers << " workers";
@@ -124,6 +478,8 @@ namespace Realm {
 	{
 	  log_pool.info() << "worker " << wi->thread_id << "/" << wi->num_threads << " executing: " << (void *)(wi->fnptr) << "(" << wi->data << ")";
 	  (wi->fnptr)(wi->data);
+	  // the end of a parallel region waits for all of its tasks
+	  wi->finish_tasks();
 	  log_pool.info() << "worker " << wi->thread_id << "/" << wi->num_threads << " done";
 	  __sync_fetch_and_sub(&(wi->work_item->remaining_workers), 1);
 	  wi->status = WorkerInfo::WORKER_IDLE;
@@ -197,6 +553,7 @@ namespace Realm {
     wi->fnptr = fnptr;
     wi->data = data;
     wi->work_item = work_item;
+    clear_context(wi->context);
     __sync_bool_compare_and_swap(&(wi->status),
 				 WorkerInfo::WORKER_CLAIMED,
 				 WorkerInfo::WORKER_ACTIVE);
@@ -19,6 +19,9 @@
 
 #include "realm/threads.h"
 
+#include <deque>
+#include <stdint.h>
+
 namespace Realm {
 
   class ThreadPool {
@@ -32,11 +35,67 @@ namespace Realm {
     // entry point for workers - does not return until thread pool is shut down
     void worker_entry(void);
 
+    // an explicit ("omp task") task, or the implicit task of a thread in a
+    //  team once it has created children
+    struct Task {
+      void (*fnptr)(void *data);
+      void *data;
+      void *alloc;  // malloc'd storage freed with the task (may be 0)
+      Task *parent;
+      int refcount;  // 1 while running, plus 1 for each unfinished child
+    };
+
+    // hands out the iterations of a static, dynamic or guided loop to the
+    //  threads of a team - iterations are numbered from 0 to total_iters-1
+    struct LoopDispenser {
+      enum Schedule {
+	SCHED_DYNAMIC,
+	SCHED_GUIDED,
+	SCHED_STATIC,  // chunk k always goes to thread k % num_threads
+      };
+      int loop_index;  // which of the team's loops uses this slot (-1 = none)
+      int users;       // threads that have not yet exhausted the loop
+      int schedule;
+      int num_threads;
+      int64_t start, incr;  // caller's loop bounds, for its convenience
+      int64_t total_iters, chunk_size;
+      int64_t next_iter;  // updated atomically
+
+      // claims the next chunk of iterations, returning false if there are
+      //  none left - static loops use the thread's id and its count of
+      //  chunks already claimed instead of 'next_iter'
+      bool next_chunk(int thread_id, int64_t& static_chunks,
+		      int64_t& first, int64_t& count);
+    };
+
+    // a thread's worksharing/tasking state within its current team - saved
+    //  in the work item when the thread starts a nested team
+    struct TeamContext {
+      int loop_index;  // dynamic/guided loops started by this thread
+      int single_index;  // single constructs encountered by this thread
+      LoopDispenser *loop;  // loop being dispensed to this thread, if any
+      int64_t static_chunks;  // chunks of a static 'loop' claimed so far
+      Task *task;  // task being executed (0 = implicit task w/o children)
+    };
+
     struct WorkItem {
+      WorkItem(void);
+
       int prev_thread_id;
       int prev_num_threads;
+      TeamContext prev_context;
       WorkItem *parent_work_item;
       int remaining_workers;
+
+      // state shared by the team - a few dynamic loops can be in flight at
+      //  once when threads run ahead past 'nowait' loops
+      static const int MAX_ACTIVE_LOOPS = 4;
+      LoopDispenser loops[MAX_ACTIVE_LOOPS];
+      int single_count;
+      int barrier_count, barrier_gen;
+      int team_lock;  // spinlock protecting loop slots and the task queue
+      std::deque<Task *> task_queue;
+      int outstanding_tasks;  // queued or running
     };
 
     struct WorkerInfo {
@@ -55,9 +114,40 @@ namespace Realm {
       void (*fnptr)(void *data);
       void *data;
       WorkItem *work_item;
+      TeamContext context;
 
       void push_work_item(WorkItem *new_work);
       WorkItem *pop_work_item(void);
+
+      // worksharing constructs for the current team - like their OpenMP
+      //  counterparts, these must be encountered by every thread of the team
+      //  in the same order
+      void barrier(void);
+      void start_loop(int schedule, int64_t start, int64_t incr,
+		      int64_t total_iters, int64_t chunk_size);
+      // returns false (and ends the loop for this thread) once the current
+      //  loop is exhausted
+      bool next_loop_chunk(int64_t& first, int64_t& count);
+      LoopDispenser *current_loop(void) const { return context.loop; }
+      bool single(void);
+
+      // creates a child of the current task - a deferred task may be
+      //  executed by any thread of the team, others are executed immediately
+      void spawn_task(void (*fnptr)(void *data), void *data, void *alloc,
+		      bool deferred);
+      // a child task whose body the caller executes itself
+      void begin_inline_task(void *alloc);
+      void end_inline_task(void);
+      // waits for (and helps execute) the children of the current task
+      void wait_for_children(void);
+      // waits for (and helps execute) all of the team's tasks - must be
+      //  called by each thread at the end of a parallel region
+      void finish_tasks(void);
+
+    protected:
+      Task *current_task(void);
+      void execute_task(Task *task);
+      bool run_queued_task(void);
     };
       
     // returns the WorkerInfo (if any) associated with the caller (which
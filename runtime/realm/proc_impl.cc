@@ -645,7 +645,10 @@ namespace Realm {
 
       size_t datalen = dbs.bytes_used();
       void *data = dbs.detach_buffer(-1);  // don't trim - this buffer has a short life
-      Message::request(target, r_args, data, datalen, PAYLOAD_FREE);
+      // we own this buffer, so send straight from it rather than copying it
+      //  into the srcdatapool, and free it once the network is done with it
+      Message::request(target, r_args, data, datalen,
+		       new FreePayloadCompletion(data));
     }
   }
 
@@ -51,6 +51,8 @@ namespace Realm {
     PMID_PCTRS_IPC,  // instructions/clocks performance counters
     PMID_PCTRS_TLB,  // TLB miss counters
     PMID_PCTRS_BP,   // branch predictor performance counters
+    PMID_OP_IO_USAGE,  // file I/O performed by a copy
+    PMID_INST_NUMA_LOCALITY,  // NUMA placement of an instance's pages
 
     // as the name suggests, this should always be last, allowing apps/runtimes
     // sitting on top of Realm to use some of the ID space
@@ -150,6 +152,18 @@ namespace Realm {
       size_t size;
     };
 
+    // I/O performed by a copy to/from a file-backed memory (e.g. HDF5) -
+    //  'io_time' is the time spent in the I/O library summed over all
+    //  requests, so with multiple I/O threads the achieved throughput can be
+    //  higher than bytes / io_time
+    struct OperationIOUsage {
+      static const ProfilingMeasurementID ID = PMID_OP_IO_USAGE;
+      Memory memory;
+      size_t bytes;
+      long long io_time;  // in nanoseconds
+      int requests;
+    };
+
     // Track the status of an instance
     struct InstanceStatus {
       static const ProfilingMeasurementID ID = PMID_INST_STATUS;
@@ -207,6 +221,23 @@ namespace Realm {
       size_t bytes;
     };
 
+    // where an instance's pages physically resided (sampled when the instance
+    //  is destroyed, so first-touch placement is reflected) - pages that were
+    //  never touched or whose placement could not be determined are reported
+    //  with a NUMA node of -1
+    struct InstanceNumaLocality {
+      static const ProfilingMeasurementID ID = PMID_INST_NUMA_LOCALITY;
+
+      struct NodeBytes {
+	int numa_node;
+	size_t bytes;
+      };
+
+      RegionInstance instance;
+      Memory memory;
+      std::vector<NodeBytes> nodes;
+    };
+
     // Processor cache stats
     template <ProfilingMeasurementID _ID>
     struct CachePerfCounters {
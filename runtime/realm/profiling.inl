@@ -20,13 +20,16 @@
 #include "realm/serialize.h"
 
 TYPE_IS_SERIALIZABLE(Realm::ProfilingMeasurementID);
+TYPE_IS_SERIALIZABLE(Realm::Memory);
 TYPE_IS_SERIALIZABLE(Realm::ProfilingMeasurements::OperationTimeline);
 TYPE_IS_SERIALIZABLE(Realm::ProfilingMeasurements::OperationEventWaits::WaitInterval);
 TYPE_IS_SERIALIZABLE(Realm::ProfilingMeasurements::OperationMemoryUsage);
 TYPE_IS_SERIALIZABLE(Realm::ProfilingMeasurements::OperationProcessorUsage);
+TYPE_IS_SERIALIZABLE(Realm::ProfilingMeasurements::OperationIOUsage);
 TYPE_IS_SERIALIZABLE(Realm::ProfilingMeasurements::InstanceAllocResult);
 TYPE_IS_SERIALIZABLE(Realm::ProfilingMeasurements::InstanceMemoryUsage);
 TYPE_IS_SERIALIZABLE(Realm::ProfilingMeasurements::InstanceTimeline);
+TYPE_IS_SERIALIZABLE(Realm::ProfilingMeasurements::InstanceNumaLocality::NodeBytes);
 template <Realm::ProfilingMeasurementID _ID>
 TYPE_IS_SERIALIZABLE(Realm::ProfilingMeasurements::CachePerfCounters<_ID>);
 TYPE_IS_SERIALIZABLE(Realm::ProfilingMeasurements::IPCPerfCounters);
@@ -165,6 +168,20 @@ namespace Realm {
       delete_time = Clock::current_time_in_nanoseconds();
     }
 
+
+    ////////////////////////////////////////////////////////////////////////
+    //
+    // struct InstanceNumaLocality
+    //
+
+    template <typename S>
+    bool serdez(S& serdez, const InstanceNumaLocality& l)
+    {
+      return ((serdez & l.instance) &&
+	      (serdez & l.memory) &&
+	      (serdez & l.nodes));
+    }
+
   }; // namespace ProfilingMeasurements
 
   ////////////////////////////////////////////////////////////////////////
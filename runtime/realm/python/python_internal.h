@@ -35,6 +35,23 @@ namespace Realm {
   };
   typedef ssize_t Py_ssize_t;
 
+  // sub-interpreter configuration (python >= 3.12 only)
+  struct PyInterpreterConfig {
+    int use_main_obmalloc;
+    int allow_fork;
+    int allow_exec;
+    int allow_threads;
+    int allow_daemon_threads;
+    int check_multi_interp_extensions;
+    int gil;
+  };
+  struct PyStatus {
+    int _type;  // 0 == ok
+    const char *func;
+    const char *err_msg;
+    int exitcode;
+  };
+
   // This class contains interpreter-specific instances of Python API calls.
   class PythonAPI {
   public:
@@ -52,6 +69,10 @@ namespace Realm {
     void (*Py_DecRef)(PyObject *); // non-macro version of PyDECREF
     void (*Py_Finalize)(void);
     void (*Py_InitializeEx)(int);
+    PyThreadState *(*Py_NewInterpreter)(void);
+    void (*Py_EndInterpreter)(PyThreadState *);
+    // only present in python >= 3.12
+    PyStatus (*Py_NewInterpreterFromConfig)(PyThreadState **, const PyInterpreterConfig *);
 
     PyObject *(*PyByteArray_FromStringAndSize)(const char *, Py_ssize_t);
 
@@ -85,9 +106,21 @@ namespace Realm {
     int (*PyTuple_SetItem)(PyObject *p, Py_ssize_t pos, PyObject *o);
   };
 
+  // how a python processor's interpreter is provided
+  enum PythonInterpreterMode {
+    // a private copy of libpython - more than one requires dlmopen
+    PYINTERP_LIBRARY,
+    // a sub-interpreter of a single libpython shared by all processors - all
+    //  processors share one GIL
+    PYINTERP_SHARED_GIL,
+    // as above, but each sub-interpreter has its own GIL (python >= 3.12,
+    //  falls back to PYINTERP_SHARED_GIL otherwise)
+    PYINTERP_OWN_GIL,
+  };
+
   class PythonInterpreter {
   public:
-    PythonInterpreter();
+    PythonInterpreter(PythonInterpreterMode _mode = PYINTERP_LIBRARY);
     ~PythonInterpreter();
 
     PyObject *find_or_import_function(const PythonSourceImplementation *psi);
@@ -96,12 +129,16 @@ namespace Realm {
     void run_string(const std::string& script_text);
 
   protected:
+    void load_library(void);
+    void unload_library(void);
+
     void *handle;
 #ifdef REALM_USE_DLMOPEN
     void *dlmproxy_handle;
 #endif
     
   public:
+    PythonInterpreterMode mode;
     PythonAPI *api;
   };
 
@@ -114,7 +151,8 @@ namespace Realm {
     LocalPythonProcessor(Processor _me, int _numa_node,
                          CoreReservationSet& crs, size_t _stack_size,
 			 const std::vector<std::string>& _import_modules,
-			 const std::vector<std::string>& _init_scripts);
+			 const std::vector<std::string>& _init_scripts,
+			 PythonInterpreterMode _interp_mode);
     virtual ~LocalPythonProcessor(void);
 
     virtual void enqueue_task(Task *task);
@@ -154,10 +192,16 @@ namespace Realm {
     void destroy_interpreter(void);
     bool perform_task_registration(TaskRegistration *treg);
 
+    // take/give up the GIL with the given thread state, accounting for the
+    //  time spent waiting for and holding it
+    void acquire_gil(PyThreadState *state);
+    PyThreadState *release_gil(void);
+
     int numa_node;
     CoreReservation *core_rsrv;
     const std::vector<std::string>& import_modules;
     const std::vector<std::string>& init_scripts;
+    PythonInterpreterMode interp_mode;
 
     PythonThreadTaskScheduler *sched;
     PythonInterpreter *interpreter;
@@ -172,6 +216,11 @@ namespace Realm {
 
     PriorityQueue<Task *, GASNetHSL> task_queue;
     ProfilingGauges::AbsoluteRangeGauge<int> ready_task_count;
+
+    // GIL usage (times in nanoseconds) - only updated while holding the GIL
+    long long gil_acquire_time;
+    ProfilingGauges::AbsoluteGauge<long long> gil_hold_time, gil_wait_time;
+    ProfilingGauges::EventCounter<int> gil_acquires;
   };
 
   // based on KernelThreadTaskScheduler, deals with the python GIL and thread
@@ -43,6 +43,10 @@ namespace Realm {
     get_symbol(this->Py_DecRef, "Py_DecRef");
     get_symbol(this->Py_Finalize, "Py_Finalize");
     get_symbol(this->Py_InitializeEx, "Py_InitializeEx");
+    get_symbol(this->Py_NewInterpreter, "Py_NewInterpreter");
+    get_symbol(this->Py_EndInterpreter, "Py_EndInterpreter");
+    get_symbol(this->Py_NewInterpreterFromConfig, "Py_NewInterpreterFromConfig",
+	       true /*missing_ok*/);
 
     get_symbol(this->PyByteArray_FromStringAndSize, "PyByteArray_FromStringAndSize");
 
@@ -109,7 +113,110 @@ namespace Realm {
   }
 #endif
 
-  PythonInterpreter::PythonInterpreter() 
+  // sub-interpreters all live in a single copy of libpython, which is loaded
+  //  and initialized by the first processor to need it and finalized by the
+  //  last one
+  namespace {
+    GASNetHSL shared_python_mutex;
+    PythonInterpreter *shared_python = 0;  // owns the library
+    PyThreadState *shared_python_main_thread = 0;
+    int shared_python_users = 0;
+  };
+
+  PythonInterpreter::PythonInterpreter(PythonInterpreterMode _mode /*= PYINTERP_LIBRARY*/)
+    : handle(0)
+#ifdef REALM_USE_DLMOPEN
+    , dlmproxy_handle(0)
+#endif
+    , mode(_mode)
+    , api(0)
+  {
+    if(mode == PYINTERP_LIBRARY) {
+      load_library();
+      return;
+    }
+
+    AutoHSLLock al(shared_python_mutex);
+
+    if(!shared_python) {
+      shared_python = new PythonInterpreter(PYINTERP_LIBRARY);
+      // the main interpreter is never used to run tasks - park it without
+      //  the GIL
+      shared_python_main_thread = (shared_python->api->PyEval_SaveThread)();
+    }
+    shared_python_users++;
+    handle = shared_python->handle;
+    api = shared_python->api;
+
+    // creating a sub-interpreter requires the GIL of the main interpreter
+    (api->PyEval_RestoreThread)(shared_python_main_thread);
+
+    PyThreadState *tstate = 0;
+    if(mode == PYINTERP_OWN_GIL) {
+      if(api->Py_NewInterpreterFromConfig) {
+	PyInterpreterConfig config;
+	config.use_main_obmalloc = 0;
+	config.allow_fork = 0;
+	config.allow_exec = 0;
+	config.allow_threads = 1;
+	config.allow_daemon_threads = 0;
+	config.check_multi_interp_extensions = 1;
+	config.gil = 2;  // PyInterpreterConfig_OWN_GIL
+	PyStatus status = (api->Py_NewInterpreterFromConfig)(&tstate, &config);
+	if(status._type != 0) {
+	  log_py.fatal() << "failed to create python sub-interpreter: "
+			 << (status.err_msg ? status.err_msg : "(unknown error)");
+	  assert(false);
+	}
+      } else {
+	log_py.warning() << "python library does not support a GIL per interpreter - sub-interpreters will share the GIL";
+	mode = PYINTERP_SHARED_GIL;
+      }
+    }
+    if(mode == PYINTERP_SHARED_GIL) {
+      tstate = (api->Py_NewInterpreter)();
+      if(!tstate) {
+	log_py.fatal() << "failed to create python sub-interpreter";
+	assert(false);
+      }
+    }
+
+    // the new interpreter's thread state is current and holds its GIL, just
+    //  like after initialization of a private library
+    log_py.info() << "created python sub-interpreter: mode=" << mode << " thread=" << tstate;
+  }
+
+  PythonInterpreter::~PythonInterpreter()
+  {
+    if(mode == PYINTERP_LIBRARY) {
+      unload_library();
+      return;
+    }
+
+    // caller holds our GIL with the interpreter's (only) thread state
+    PyThreadState *tstate = (api->PyThreadState_Get)();
+    (api->Py_EndInterpreter)(tstate);
+
+    if(mode == PYINTERP_SHARED_GIL) {
+      // we still hold the shared GIL, but no thread state - give the GIL back
+      //  by way of the (parked) main thread state, and do so before taking
+      //  the mutex, as its holder may be waiting for the GIL
+      (api->PyThreadState_Swap)(shared_python_main_thread);
+      (api->PyEval_SaveThread)();
+    }
+
+    AutoHSLLock al(shared_python_mutex);
+
+    assert(shared_python_users > 0);
+    if(--shared_python_users == 0) {
+      (api->PyEval_RestoreThread)(shared_python_main_thread);
+      shared_python_main_thread = 0;
+      delete shared_python;
+      shared_python = 0;
+    }
+  }
+
+  void PythonInterpreter::load_library(void)
   {
 #ifdef REALM_PYTHON_LIB
     const char *python_lib = REALM_PYTHON_LIB;
@@ -164,19 +271,9 @@ namespace Realm {
 
     (api->Py_InitializeEx)(0 /*!initsigs*/);
     (api->PyEval_InitThreads)();
-    //(api->Py_Finalize)();
-
-    //PyThreadState *state;
-    //state = (api->PyEval_SaveThread)();
-    //(api->PyEval_RestoreThread)(state);
-
-    //(api->PyRun_SimpleString)("print 'hello Python world!'");
-
-    //PythonSourceImplementation psi("taskreg_helper", "task1");
-    //find_or_import_function(&psi);
   }
 
-  PythonInterpreter::~PythonInterpreter()
+  void PythonInterpreter::unload_library(void)
   {
     (api->Py_Finalize)();
 
@@ -394,8 +491,7 @@ namespace Realm {
 
 	// make our python thread state active, acquiring the GIL
 	assert((pyproc->interpreter->api->PyThreadState_Swap)(0) == 0);
-	log_py.debug() << "RestoreThread <- " << pythread;
-	(pyproc->interpreter->api->PyEval_RestoreThread)(pythread);
+	pyproc->acquire_gil(pythread);
 
 #ifndef NDEBUG
 	bool ok =
@@ -404,8 +500,10 @@ namespace Realm {
 	assert(ok);  // no fault recovery yet
 
 	// release the GIL
-	PyThreadState *saved = (pyproc->interpreter->api->PyEval_SaveThread)();
-	log_py.debug() << "SaveThread -> " << saved;
+#ifndef NDEBUG
+	PyThreadState *saved =
+#endif
+	  pyproc->release_gil();
 	assert(saved == pythread);
 
 	lock.lock();
@@ -536,8 +634,7 @@ namespace Realm {
       (pyproc->interpreter->api->PyThreadState_Swap)(saved);
       // would like to sanity-check that this returns the expected thread state,
       //  but that would require taking the PythonThreadTaskScheduler's lock
-      (pyproc->interpreter->api->PyEval_SaveThread)();
-      log_py.debug() << "SaveThread -> " << saved;
+      pyproc->release_gil();
     } else
       log_py.info() << "python worker sleeping - GIL already released";
     
@@ -545,8 +642,7 @@ namespace Realm {
 
     if(saved) {
       log_py.info() << "python worker awake - acquiring GIL";
-      log_py.debug() << "RestoreThread <- " << saved;
-      (pyproc->interpreter->api->PyEval_RestoreThread)(saved);
+      pyproc->acquire_gil(saved);
     } else
       log_py.info() << "python worker awake - not acquiring GIL";
   }
@@ -576,16 +672,17 @@ namespace Realm {
     assert((pyproc->interpreter->api->PyThreadState_Swap)(0) == 0);
 
     // switch to the master thread, retaining the GIL
-    log_py.debug() << "RestoreThread <- " << pyproc->master_thread;
-    (pyproc->interpreter->api->PyEval_RestoreThread)(pyproc->master_thread);
+    pyproc->acquire_gil(pyproc->master_thread);
 
     // clear and delete the worker thread
     (pyproc->interpreter->api->PyThreadState_Clear)(pythread);
     (pyproc->interpreter->api->PyThreadState_Delete)(pythread);
 
     // release the GIL
-    PyThreadState *saved = (pyproc->interpreter->api->PyEval_SaveThread)();
-    log_py.debug() << "SaveThread -> " << saved;
+#ifndef NDEBUG
+    PyThreadState *saved =
+#endif
+      pyproc->release_gil();
     assert(saved == pyproc->master_thread);
 
     // TODO: tear down interpreter if last thread
@@ -604,13 +701,19 @@ namespace Realm {
                                              CoreReservationSet& crs,
                                              size_t _stack_size,
 					     const std::vector<std::string>& _import_modules,
-					     const std::vector<std::string>& _init_scripts)
+					     const std::vector<std::string>& _init_scripts,
+					     PythonInterpreterMode _interp_mode)
     : ProcessorImpl(_me, Processor::PY_PROC)
     , numa_node(_numa_node)
     , import_modules(_import_modules)
     , init_scripts(_init_scripts)
+    , interp_mode(_interp_mode)
     , interpreter(0)
     , ready_task_count(stringbuilder() << "realm/proc " << me << "/ready tasks")
+    , gil_acquire_time(0)
+    , gil_hold_time(stringbuilder() << "realm/proc " << me << "/gil hold time")
+    , gil_wait_time(stringbuilder() << "realm/proc " << me << "/gil wait time")
+    , gil_acquires(stringbuilder() << "realm/proc " << me << "/gil acquires")
   {
     task_queue.set_gauge(&ready_task_count);
 
@@ -655,8 +758,10 @@ namespace Realm {
     assert(interpreter == 0);
   
     // create a python interpreter that stays entirely within this thread
-    interpreter = new PythonInterpreter;
+    interpreter = new PythonInterpreter(interp_mode);
     master_thread = (interpreter->api->PyThreadState_Get)();
+    // the new interpreter starts out holding the GIL
+    gil_acquire_time = Clock::current_time_in_nanoseconds();
 
     // always need the python threading module
     interpreter->import_module("threading");
@@ -673,8 +778,10 @@ namespace Realm {
       interpreter->run_string(*it);
 
     // default state is GIL _released_
-    PyThreadState *saved = (interpreter->api->PyEval_SaveThread)();
-    log_py.debug() << "SaveThread -> " << saved;
+#ifndef NDEBUG
+    PyThreadState *saved =
+#endif
+      release_gil();
     assert(saved == master_thread);
   }
 
@@ -684,8 +791,7 @@ namespace Realm {
 
     // take GIL with master thread
     assert((interpreter->api->PyThreadState_Swap)(0) == 0);
-    log_py.debug() << "RestoreThread <- " << master_thread;
-    (interpreter->api->PyEval_RestoreThread)(master_thread);
+    acquire_gil(master_thread);
 
     // during shutdown, the threading module tries to remove the Thread object
     //  associated with this kernel thread - if that doesn't exist (because we're
@@ -696,11 +802,35 @@ namespace Realm {
     //  to deal with the case where 'import threading' never got called
     (interpreter->api->PyRun_SimpleString)("__import__('threading').current_thread()");
 
+    gil_hold_time += (Clock::current_time_in_nanoseconds() - gil_acquire_time);
+    log_py.info() << "GIL usage: proc=" << me
+		  << " held=" << (long long)gil_hold_time << " ns"
+		  << " waited=" << (long long)gil_wait_time << " ns";
+
     delete interpreter;
     interpreter = 0;
     master_thread = 0;
   }
   
+  void LocalPythonProcessor::acquire_gil(PyThreadState *state)
+  {
+    long long t_start = Clock::current_time_in_nanoseconds();
+    log_py.debug() << "RestoreThread <- " << state;
+    (interpreter->api->PyEval_RestoreThread)(state);
+    // everything below is protected by the GIL itself
+    gil_acquire_time = Clock::current_time_in_nanoseconds();
+    gil_wait_time += (gil_acquire_time - t_start);
+    gil_acquires += 1;
+  }
+
+  PyThreadState *LocalPythonProcessor::release_gil(void)
+  {
+    gil_hold_time += (Clock::current_time_in_nanoseconds() - gil_acquire_time);
+    PyThreadState *saved = (interpreter->api->PyEval_SaveThread)();
+    log_py.debug() << "SaveThread -> " << saved;
+    return saved;
+  }
+
   bool LocalPythonProcessor::perform_task_registration(LocalPythonProcessor::TaskRegistration *treg)
   {
     // first, make sure we haven't seen this task id before
@@ -718,14 +848,15 @@ namespace Realm {
 
     // perform import/compile on master thread
     assert((interpreter->api->PyThreadState_Swap)(0) == 0);
-    log_py.debug() << "RestoreThread <- " << master_thread;
-    (interpreter->api->PyEval_RestoreThread)(master_thread);
+    acquire_gil(master_thread);
     
     PyObject *fnptr = interpreter->find_or_import_function(psi);
     assert(fnptr != 0);
 
-    PyThreadState *saved = (interpreter->api->PyEval_SaveThread)();
-    log_py.debug() << "SaveThread -> " << saved;
+#ifndef NDEBUG
+    PyThreadState *saved =
+#endif
+      release_gil();
     assert(saved == master_thread);
 
     log_py.info() << "task " << treg->func_id << " registered on " << me << ": " << *(treg->codedesc);
@@ -883,6 +1014,8 @@ namespace Realm {
       , cfg_num_python_cpus(0)
       , cfg_use_numa(false)
       , cfg_stack_size_in_mb(2)
+      , cfg_interpreter_mode("library")
+      , interpreter_mode(PYINTERP_LIBRARY)
     {
     }
 
@@ -909,7 +1042,8 @@ namespace Realm {
 	  .add_option_int("-ll:pynuma", m->cfg_use_numa)
 	  .add_option_int("-ll:pystack", m->cfg_stack_size_in_mb)
 	  .add_option_stringlist("-ll:pyimport", m->cfg_import_modules)
-	  .add_option_stringlist("-ll:pyinit", m->cfg_init_scripts);
+	  .add_option_stringlist("-ll:pyinit", m->cfg_init_scripts)
+	  .add_option_string("-ll:pyinterp", m->cfg_interpreter_mode);
 
         bool ok = cp.parse_command_line(cmdline);
         if(!ok) {
@@ -930,10 +1064,24 @@ namespace Realm {
         return 0;
       }
 
+      // how does each processor get its interpreter?
+      if(m->cfg_interpreter_mode == "library") {
+	m->interpreter_mode = PYINTERP_LIBRARY;
+      } else if(m->cfg_interpreter_mode == "shared-gil") {
+	m->interpreter_mode = PYINTERP_SHARED_GIL;
+      } else if(m->cfg_interpreter_mode == "own-gil") {
+	m->interpreter_mode = PYINTERP_OWN_GIL;
+      } else {
+        log_py.fatal() << "unknown python interpreter mode '" << m->cfg_interpreter_mode << "' (expected 'library', 'shared-gil' or 'own-gil')";
+        assert(false);
+      }
+
 #ifndef REALM_USE_DLMOPEN
-      // Multiple CPUs are only allowed if we're using dlmopen.
-      if(m->cfg_num_python_cpus > 1) {
-        log_py.fatal() << "support for multiple Python CPUs is not available: recompile with USE_DLMOPEN";
+      // Multiple CPUs with their own copy of libpython are only allowed if
+      //  we're using dlmopen.
+      if((m->cfg_num_python_cpus > 1) &&
+	 (m->interpreter_mode == PYINTERP_LIBRARY)) {
+        log_py.fatal() << "support for multiple Python CPUs is not available: recompile with USE_DLMOPEN or use sub-interpreters (-ll:pyinterp own-gil)";
         assert(false);
       }
 #endif
@@ -996,7 +1144,8 @@ namespace Realm {
                                                        runtime->core_reservation_set(),
                                                        cfg_stack_size_in_mb << 20,
 						       cfg_import_modules,
-						       cfg_init_scripts);
+						       cfg_init_scripts,
+						       PythonInterpreterMode(interpreter_mode));
           runtime->add_processor(pi);
 
           // create affinities between this processor and system/reg memories
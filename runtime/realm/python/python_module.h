@@ -70,8 +70,12 @@ namespace Realm {
       size_t cfg_stack_size_in_mb;
       std::vector<std::string> cfg_import_modules;
       std::vector<std::string> cfg_init_scripts;
+      // "library" (a private libpython per processor), "shared-gil" or
+      //  "own-gil" (sub-interpreters of one libpython)
+      std::string cfg_interpreter_mode;
 
       std::set<int> active_numa_domains;
+      int interpreter_mode;  // parsed PythonInterpreterMode
     };
 
     REGISTER_REALM_MODULE(PythonModule);
@@ -22,6 +22,7 @@
 #include "realm/inst_impl.h"
 
 #include "realm/activemsg.h"
+#include "realm/shm_transport.h"
 #include "realm/deppart/preimage.h"
 
 #include "realm/cmdline.h"
@@ -59,6 +60,7 @@ static const void *ignore_gasnet_warning2 __attribute__((unused)) = (void *)_gas
 #include "realm/transfer/channel.h"
 
 #include <unistd.h>
+#include <pthread.h>
 #include <signal.h>
 
 #include <fstream>
@@ -670,6 +672,7 @@ namespace Realm {
     , num_cpu_procs(1), num_util_procs(1), num_io_procs(0)
     , concurrent_io_threads(1)  // Legion does not support values > 1 right now
     , sysmem_size_in_mb(512), stack_size_in_mb(2)
+    , zeropage_threshold_in_kb(0)
     , pin_util_procs(false)
   {}
 
@@ -689,6 +692,7 @@ namespace Realm {
       .add_option_int("-ll:concurrent_io", m->concurrent_io_threads)
       .add_option_int("-ll:csize", m->sysmem_size_in_mb)
       .add_option_int("-ll:stacksize", m->stack_size_in_mb, true /*keep*/)
+      .add_option_int("-ll:zeropage", m->zeropage_threshold_in_kb)
       .add_option_bool("-ll:pin_util", m->pin_util_procs)
       .parse_command_line(cmdline);
 
@@ -703,8 +707,17 @@ namespace Realm {
 
     if(sysmem_size_in_mb > 0) {
       Memory m = runtime->next_local_memory_id();
-      MemoryImpl *mi = new LocalCPUMemory(m, sysmem_size_in_mb << 20, 
-          -1/*don't care numa domain*/, Memory::SYSTEM_MEM);
+      // with shared memory messaging, co-located processes copy directly
+      //  into each other's system memory
+      void *shared_base = 0;
+      if(get_shm_transport())
+	shared_base = get_shm_transport()->create_shared_memory(m.id,
+								sysmem_size_in_mb << 20);
+      LocalCPUMemory *mi = new LocalCPUMemory(m, sysmem_size_in_mb << 20, 
+          -1/*don't care numa domain*/, Memory::SYSTEM_MEM,
+	  shared_base, false /*!registered*/, (shared_base != 0));
+      // freed instances at least this large get fresh zero pages
+      mi->zero_page_threshold = zeropage_threshold_in_kb << 10;
       runtime->add_memory(mi);
     }
   }
@@ -770,6 +783,64 @@ namespace Realm {
   }
 
 
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class StartupTimer
+  //
+
+  StartupTimer::StartupTimer(void)
+    : enabled(false)
+  {
+    start_time = last_time = Clock::current_time_in_nanoseconds(true /*absolute*/);
+  }
+
+  void StartupTimer::phase_done(const char *name)
+  {
+    long long now = Clock::current_time_in_nanoseconds(true /*absolute*/);
+    Entry e;
+    e.name = name;
+    e.duration = now - last_time;
+    e.is_detail = false;
+    entries.push_back(e);
+    last_time = now;
+  }
+
+  void StartupTimer::add_detail(const std::string& name, long long duration_ns)
+  {
+    Entry e;
+    e.name = name;
+    e.duration = duration_ns;
+    e.is_detail = true;
+    entries.push_back(e);
+  }
+
+  void StartupTimer::report(void) const
+  {
+    if(!enabled) return;
+
+    log_runtime.print("startup timing on node %d: %.3f ms total",
+		      my_node_id, 1e-6 * (last_time - start_time));
+    // details are recorded before the phase they belong to, but read better
+    //  after it
+    std::vector<const Entry *> details;
+    for(std::vector<Entry>::const_iterator it = entries.begin();
+	it != entries.end();
+	++it) {
+      if(it->is_detail) {
+	details.push_back(&*it);
+	continue;
+      }
+      log_runtime.print("  %-32s %10.3f ms", it->name.c_str(), 1e-6 * it->duration);
+      for(std::vector<const Entry *>::const_iterator it2 = details.begin();
+	  it2 != details.end();
+	  ++it2)
+	log_runtime.print("    %-30s %10.3f ms", (*it2)->name.c_str(),
+			  1e-6 * (*it2)->duration);
+      details.clear();
+    }
+  }
+
+
   ////////////////////////////////////////////////////////////////////////
   //
   // class RuntimeImpl
@@ -1094,6 +1165,8 @@ namespace Realm {
 	}
       }
 
+      startup_timer.phase_done("network init");
+
       return true;
     }
 
@@ -1108,6 +1181,7 @@ namespace Realm {
       // now load modules
       module_registrar.create_static_modules(cmdline, modules);
       module_registrar.create_dynamic_modules(cmdline, modules);
+      startup_timer.phase_done("module discovery");
 
       PartitioningOpQueue::configure_from_cmdline(cmdline);
 
@@ -1173,6 +1247,13 @@ namespace Realm {
       cp.add_option_bool("-ll:force_kthreads", Config::force_kernel_threads);
       cp.add_option_bool("-ll:frsrv_fallback", Config::use_fast_reservation_fallback);
       cp.add_option_int("-ll:machine_query_cache", Config::use_machine_query_cache);
+      cp.add_option_bool("-ll:machine_snapshot", Config::use_machine_snapshot);
+      cp.add_option_bool("-ll:lazy_announce", Config::lazy_machine_announce);
+
+      // startup options
+      bool parallel_init = false;
+      cp.add_option_bool("-ll:parallel_init", parallel_init);
+      cp.add_option_bool("-ll:startup_timing", startup_timer.enabled);
 
       bool cmdline_ok = cp.parse_command_line(cmdline);
 
@@ -1227,8 +1308,11 @@ namespace Realm {
       }
 #endif
 
+      startup_timer.phase_done("command line parsing");
+
       core_map = CoreMap::discover_core_map(hyperthread_sharing);
       core_reservations = new CoreReservationSet(core_map);
+      startup_timer.phase_done("core map discovery");
 
       sampling_profiler.configure_from_cmdline(cmdline, *core_reservations);
 
@@ -1321,6 +1405,7 @@ namespace Realm {
       init_endpoints(gasnet_mem_size_in_mb, reg_mem_size_in_mb, reg_ib_mem_size_in_mb,
 		     *core_reservations,
 		     cmdline);
+      startup_timer.phase_done("endpoint setup");
 
       // now that we've done all of our argument parsing, scan through what's
       //  left and see if anything starts with -ll: - probably a misspelled
@@ -1401,6 +1486,7 @@ namespace Realm {
 			       *core_reservations);
 
       PartitioningOpQueue::start_worker_threads(*core_reservations);
+      startup_timer.phase_done("background threads");
 
 #ifdef EVENT_TRACING
       // Always initialize even if we won't dump to file, otherwise segfaults happen
@@ -1415,10 +1501,8 @@ namespace Realm {
                                         lock_trace_exp_arrv_rate);
 #endif
 	
-      for(std::vector<Module *>::const_iterator it = modules.begin();
-	  it != modules.end();
-	  it++)
-	(*it)->initialize(this);
+      initialize_modules(parallel_init);
+      startup_timer.phase_done("module initialization");
 
       //gasnet_seginfo_t seginfos = new gasnet_seginfo_t[num_nodes];
       //CHECK_GASNET( gasnet_getSegmentInfo(seginfos, num_nodes) );
@@ -1460,11 +1544,13 @@ namespace Realm {
 	get_runtime()->add_memory(regmem);
       } else
 	regmem = 0;
+      startup_timer.phase_done("memory creation");
 
       for(std::vector<Module *>::const_iterator it = modules.begin();
 	  it != modules.end();
 	  it++)
 	(*it)->create_processors(this);
+      startup_timer.phase_done("processor creation");
 
       LocalCPUMemory *reg_ib_mem;
       if(reg_ib_mem_size_in_mb > 0) {
@@ -1507,6 +1593,11 @@ namespace Realm {
       filemem = new FileMemory(get_runtime()->next_local_memory_id());
       get_runtime()->add_memory(filemem);
 
+      // co-located processes map each other's shared memories before any
+      //  dma channels that copy to them are created
+      if(get_shm_transport())
+	get_shm_transport()->map_shared_memories();
+
       for(std::vector<Module *>::const_iterator it = modules.begin();
 	  it != modules.end();
 	  it++)
@@ -1516,12 +1607,14 @@ namespace Realm {
 	  it != modules.end();
 	  it++)
 	(*it)->create_code_translators(this);
+      startup_timer.phase_done("channel/translator creation");
       
       // start dma system at the very ending of initialization
       // since we need list of local gpus to create channels
       start_dma_system(dma_worker_threads,
 		       pin_dma_threads, 100
 		       ,*core_reservations);
+      startup_timer.phase_done("dma system start");
 
       // now that we've created all the processors/etc., we can try to come up with core
       //  allocations that satisfy everybody's requirements - this will also start up any
@@ -1536,6 +1629,7 @@ namespace Realm {
 	printf("HELP!  Could not satisfy all core reservations!\n");
 	exit(1);
       }
+      startup_timer.phase_done("core reservations");
 
       {
         // iterate over all local processors and add affinities for them
@@ -1655,6 +1749,7 @@ namespace Realm {
 				  );
 	}
       }
+      startup_timer.phase_done("local affinities");
       {
 	Serialization::DynamicBufferSerializer dbs(4096);
 
@@ -1795,6 +1890,7 @@ namespace Realm {
 					      PAYLOAD_COPY);
 
 	NodeAnnounceMessage::await_all_announcements();
+	startup_timer.phase_done("announcements");
 
 #ifdef DEBUG_REALM_STARTUP
 	if(my_node_id == 0) {
@@ -1815,6 +1911,63 @@ namespace Realm {
 	  it != nodes[my_node_id].processors.end();
 	  ++it)
 	(*it)->start_threads();
+      startup_timer.phase_done("processor thread startup");
+
+      startup_timer.report();
+    }
+
+    struct ModuleInitArgs {
+      Module *module;
+      RuntimeImpl *runtime;
+      long long duration;
+    };
+
+    static void *module_init_thread(void *data)
+    {
+      ModuleInitArgs *args = static_cast<ModuleInitArgs *>(data);
+      long long t_start = Clock::current_time_in_nanoseconds(true /*absolute*/);
+      args->module->initialize(args->runtime);
+      args->duration = Clock::current_time_in_nanoseconds(true /*absolute*/) - t_start;
+      return 0;
+    }
+
+    void RuntimeImpl::initialize_modules(bool parallel)
+    {
+      // modules are independent of each other at this point (each one only
+      //  allocates its own resources and makes its own core reservations), so
+      //  the expensive ones (e.g. GPU context creation, pinning of NUMA
+      //  memory) can overlap - the order of creation of memories and
+      //  processors below is unchanged, so ids are the same either way
+      std::vector<ModuleInitArgs> args(modules.size());
+      std::vector<pthread_t> threads(modules.size());
+      std::vector<bool> launched(modules.size(), false);
+
+      for(size_t i = 0; i < modules.size(); i++) {
+	args[i].module = modules[i];
+	args[i].runtime = this;
+	args[i].duration = 0;
+	// the last module is done by this thread in any case
+	if(parallel && ((i + 1) < modules.size())) {
+	  int ret = pthread_create(&threads[i], 0, module_init_thread, &args[i]);
+	  if(ret == 0) {
+	    launched[i] = true;
+	    continue;
+	  }
+	  log_runtime.warning() << "could not create thread to initialize module "
+				<< modules[i]->get_name() << " - initializing serially";
+	}
+	module_init_thread(&args[i]);
+      }
+
+      for(size_t i = 0; i < modules.size(); i++) {
+	if(launched[i]) {
+	  int ret = pthread_join(threads[i], 0);
+	  assert(ret == 0);
+	}
+	log_runtime.info() << "module " << modules[i]->get_name()
+			   << " initialized in " << (1e-6 * args[i].duration) << " ms";
+	startup_timer.add_detail(modules[i]->get_name(), args[i].duration);
+      }
     }
 
   template <typename T>
@@ -2208,8 +2361,7 @@ namespace Realm {
 
 #ifdef USE_GASNET
       // don't start tearing things down until all processes agree
-      gasnet_barrier_notify(0, GASNET_BARRIERFLAG_ANONYMOUS);
-      gasnet_barrier_wait(0, GASNET_BARRIERFLAG_ANONYMOUS);
+      polling_barrier();
 #endif
 
       // Shutdown all the threads
@@ -180,11 +180,39 @@ namespace Realm {
       int num_cpu_procs, num_util_procs, num_io_procs;
       int concurrent_io_threads;
       size_t sysmem_size_in_mb, stack_size_in_mb;
+      size_t zeropage_threshold_in_kb;
       bool pin_util_procs;
     };
 
     REGISTER_REALM_MODULE(CoreModule);
 
+    // records how long each phase of runtime startup took - the report is
+    //  only printed if requested (-ll:startup_timing)
+    class StartupTimer {
+    public:
+      StartupTimer(void);
+
+      // ends the current phase, which started when the previous one ended
+      void phase_done(const char *name);
+
+      // records a duration measured elsewhere (e.g. a single module's part of
+      //  a phase that ran in parallel) - shown indented under the next phase
+      void add_detail(const std::string& name, long long duration_ns);
+
+      void report(void) const;
+
+      bool enabled;
+
+    protected:
+      struct Entry {
+	std::string name;
+	long long duration;
+	bool is_detail;
+      };
+      long long start_time, last_time;
+      std::vector<Entry> entries;
+    };
+
     class RuntimeImpl {
     public:
       RuntimeImpl(void);
@@ -300,7 +328,11 @@ namespace Realm {
       const std::vector<CodeTranslator *>& get_code_translators(void) const;
 
     protected:
+      // calls every module's initialize(), in parallel if requested
+      void initialize_modules(bool parallel);
+
       ID::IDType num_local_memories, num_local_ib_memories, num_local_processors;
+      StartupTimer startup_timer;
 
 #ifndef USE_GASNET
       // without gasnet, we fake registered memory with a normal malloc
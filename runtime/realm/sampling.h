@@ -198,6 +198,7 @@ namespace Realm {
 	PACKET_EMPTY = 0,
 	PACKET_NEWGAUGE = 1,
 	PACKET_SAMPLES = 2,
+	PACKET_SAMPLES_VARINT = 3,
       };
       unsigned packet_type;
       unsigned packet_size;  // individual packets <= 4GB
@@ -221,6 +222,36 @@ namespace Realm {
       // unsigned short run_lengths[compressed_len]
     };
 
+    // a PACKET_SAMPLES_VARINT packet starts with the same PacketSamples, but
+    //  each of the compressed_len entries is then encoded as every field of the
+    //  Sample stored as a zigzag varint delta from the same field of the
+    //  previous entry (or from 0 for the first), followed by the run length as
+    //  a varint - the packet_size gives the total encoded length
+    // integral fields are sign-extended to 64 bits before taking deltas, while
+    //  float and double fields are encoded through their (zero-extended) bit
+    //  patterns
+
+    // with -realm:prof_mmap, the output is instead a preallocated file that is
+    //  mapped into memory - the gauge definitions are packets appended to a
+    //  fixed area, and sample packets go into a ring that overwrites the oldest
+    //  packets when it fills up
+    // when fewer than sizeof(PacketHeader) bytes remain before the end of
+    //  the ring, the next packet starts at the beginning
+    struct RingFileHeader {
+      char magic[8];  // "RLMPRING"
+      unsigned version;
+      unsigned header_size;
+      unsigned long long gauge_area_offset;
+      unsigned long long gauge_area_size;
+      unsigned long long gauge_area_used;
+      unsigned long long ring_offset;
+      unsigned long long ring_size;
+      unsigned long long ring_head;  // offset (in ring) of oldest packet
+      unsigned long long ring_used;  // bytes used, starting from ring_head
+      unsigned long long bytes_overwritten;
+      unsigned long long gauges_dropped;
+    };
+
   }; // namespace SampleFile
 
 }; // namespace Realm
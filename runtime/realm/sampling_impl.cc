@@ -24,12 +24,204 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
 
 namespace Realm {
 
   Logger log_realmprof("realmprof");
 
 
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class SampleFileWriter
+  //
+
+  SampleFileWriter::~SampleFileWriter(void)
+  {}
+
+
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class SampleFileStreamWriter
+  //
+
+  SampleFileStreamWriter::SampleFileStreamWriter(int _fd)
+    : fd(_fd)
+  {}
+
+  SampleFileStreamWriter::~SampleFileStreamWriter(void)
+  {
+    close(fd);
+  }
+
+  void SampleFileStreamWriter::write_packet(unsigned packet_type,
+					    const struct iovec *pieces, int count)
+  {
+    // header and pieces all go out in a single writev
+    static const int MAX_PIECES = 8;
+    assert(count < MAX_PIECES);
+    SampleFile::PacketHeader hdr;
+    hdr.packet_type = packet_type;
+    hdr.packet_size = 0;
+    struct iovec iov[MAX_PIECES];
+    iov[0].iov_base = &hdr;
+    iov[0].iov_len = sizeof(hdr);
+    for(int i = 0; i < count; i++) {
+      iov[i + 1] = pieces[i];
+      hdr.packet_size += pieces[i].iov_len;
+    }
+    size_t total = sizeof(hdr) + hdr.packet_size;
+    ssize_t amt = writev(fd, iov, count + 1);
+#ifdef NDEBUG
+    (void)amt;
+    (void)total;
+#else
+    assert(amt == (ssize_t)total);
+#endif
+  }
+
+  void SampleFileStreamWriter::flush(void)
+  {
+    // nothing buffered
+  }
+
+
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class SampleFileRingWriter
+  //
+
+  SampleFileRingWriter::SampleFileRingWriter(int _fd, size_t _file_size)
+    : fd(_fd)
+    , file_size(_file_size)
+    , base(0)
+  {
+    // allocate the whole file up front so that we never fault on a full disk
+    //  while sampling
+    int ret = posix_fallocate(fd, 0, file_size);
+    if(ret != 0) {
+      log_realmprof.fatal() << "could not allocate " << file_size << " bytes for profiling data: " << strerror(ret);
+      assert(0);
+    }
+    void *p = mmap(0, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(p == MAP_FAILED) {
+      log_realmprof.fatal() << "could not map profiling data file: " << strerror(errno);
+      assert(0);
+    }
+    base = static_cast<char *>(p);
+
+    // gauge definitions get 1/16th of the space after the header - the rest
+    //  is the sample ring
+    header = reinterpret_cast<SampleFile::RingFileHeader *>(base);
+    memset(header, 0, sizeof(SampleFile::RingFileHeader));
+    header->version = 1;
+    header->header_size = sizeof(SampleFile::RingFileHeader);
+    size_t avail = file_size - sizeof(SampleFile::RingFileHeader);
+    header->gauge_area_offset = sizeof(SampleFile::RingFileHeader);
+    header->gauge_area_size = avail >> 4;
+    header->ring_offset = header->gauge_area_offset + header->gauge_area_size;
+    header->ring_size = avail - header->gauge_area_size;
+    ring = base + header->ring_offset;
+    // the magic goes in last so that a reader never sees a partial header
+    __sync_synchronize();
+    memcpy(header->magic, "RLMPRING", 8);
+  }
+
+  SampleFileRingWriter::~SampleFileRingWriter(void)
+  {
+    msync(base, file_size, MS_SYNC);
+    munmap(base, file_size);
+    close(fd);
+  }
+
+  void SampleFileRingWriter::copy_in(char *dst,
+				     const struct iovec *pieces, int count)
+  {
+    for(int i = 0; i < count; i++) {
+      memcpy(dst, pieces[i].iov_base, pieces[i].iov_len);
+      dst += pieces[i].iov_len;
+    }
+  }
+
+  void SampleFileRingWriter::make_room(size_t bytes)
+  {
+    // retire the oldest packets until there's enough free space
+    while((header->ring_size - header->ring_used) < bytes) {
+      size_t head = header->ring_head;
+      size_t pkt_size = header->ring_size - head;
+      if(pkt_size >= sizeof(SampleFile::PacketHeader)) {
+	SampleFile::PacketHeader hdr;
+	memcpy(&hdr, ring + head, sizeof(hdr));
+	pkt_size = sizeof(hdr) + hdr.packet_size;
+      }
+      header->ring_head = (head + pkt_size) % header->ring_size;
+      header->ring_used -= pkt_size;
+      header->bytes_overwritten += pkt_size;
+    }
+  }
+
+  void SampleFileRingWriter::write_packet(unsigned packet_type,
+					  const struct iovec *pieces, int count)
+  {
+    SampleFile::PacketHeader hdr;
+    hdr.packet_type = packet_type;
+    hdr.packet_size = 0;
+    for(int i = 0; i < count; i++)
+      hdr.packet_size += pieces[i].iov_len;
+    size_t total = sizeof(hdr) + hdr.packet_size;
+
+    // gauge definitions are never overwritten - if there's no more space for
+    //  them, the new gauge's samples will be ignored by readers
+    if(packet_type == SampleFile::PacketHeader::PACKET_NEWGAUGE) {
+      if((header->gauge_area_size - header->gauge_area_used) < total) {
+	if(header->gauges_dropped++ == 0)
+	  log_realmprof.warning() << "profiling data file has no room for more gauge definitions";
+	return;
+      }
+      char *dst = base + header->gauge_area_offset + header->gauge_area_used;
+      memcpy(dst, &hdr, sizeof(hdr));
+      copy_in(dst + sizeof(hdr), pieces, count);
+      __sync_synchronize();
+      header->gauge_area_used += total;
+      return;
+    }
+
+    if(total > header->ring_size) {
+      header->bytes_overwritten += total;
+      return;
+    }
+
+    size_t tail = (header->ring_head + header->ring_used) % header->ring_size;
+    // packets never wrap - pad out the end of the ring if needed
+    if((header->ring_size - tail) < total) {
+      size_t pad = header->ring_size - tail;
+      make_room(pad);
+      if(pad >= sizeof(SampleFile::PacketHeader)) {
+	SampleFile::PacketHeader padhdr;
+	padhdr.packet_type = SampleFile::PacketHeader::PACKET_EMPTY;
+	padhdr.packet_size = pad - sizeof(padhdr);
+	memcpy(ring + tail, &padhdr, sizeof(padhdr));
+      }
+      __sync_synchronize();
+      header->ring_used += pad;
+      tail = 0;
+    }
+
+    make_room(total);
+    memcpy(ring + tail, &hdr, sizeof(hdr));
+    copy_in(ring + tail + sizeof(hdr), pieces, count);
+    // packet contents must be in place before they're counted as used
+    __sync_synchronize();
+    header->ring_used += total;
+  }
+
+  void SampleFileRingWriter::flush(void)
+  {
+    msync(base, file_size, MS_ASYNC);
+  }
+
+
   ////////////////////////////////////////////////////////////////////////
   //
   // class GaugeSampleBuffer
@@ -59,43 +251,88 @@ namespace Realm {
     run_lengths.resize(_reserve);
   }
 
+  namespace {
+    // appends 'v' as a little-endian base-128 varint
+    inline void append_varint(std::vector<unsigned char>& out, unsigned long long v)
+    {
+      while(v >= 0x80) {
+	out.push_back((unsigned char)(v | 0x80));
+	v >>= 7;
+      }
+      out.push_back((unsigned char)v);
+    }
+
+    // the integer whose deltas are encoded for a Sample field - integral
+    //  fields are sign-extended, floating-point fields use their bit pattern
+    //  so that no precision is lost
+    template <typename DT>
+    inline unsigned long long varint_field(DT v)
+    {
+      return (unsigned long long)(long long)v;
+    }
+
+    inline unsigned long long varint_field(float v)
+    {
+      unsigned bits;
+      memcpy(&bits, &v, sizeof(bits));
+      return bits;
+    }
+
+    inline unsigned long long varint_field(double v)
+    {
+      unsigned long long bits;
+      memcpy(&bits, &v, sizeof(bits));
+      return bits;
+    }
+  };
+
   template <typename T>
-  void GaugeSampleBufferImpl<T>::write_data(int fd)
+  void GaugeSampleBufferImpl<T>::write_data(SampleFileWriter *writer,
+					    bool compress)
   {
-    size_t samples_size = compressed_len * sizeof(typename T::Sample);
-    size_t runlengths_size = compressed_len * sizeof(unsigned short);
-    SampleFile::PacketHeader hdr;
-    hdr.packet_type = SampleFile::PacketHeader::PACKET_SAMPLES;
-    hdr.packet_size = sizeof(SampleFile::PacketSamples) + samples_size + runlengths_size;
-    ssize_t amt = write(fd, &hdr, sizeof(hdr));
-#ifdef NDEBUG
-    (void)amt;
-#else
-    assert(amt == (ssize_t)sizeof(hdr));
-#endif
     SampleFile::PacketSamples pkt;
     pkt.gauge_id = sampler_id;
     pkt.compressed_len = compressed_len;
     pkt.first_sample = first_sample;
     pkt.last_sample = last_sample;
-    amt = write(fd, &pkt, sizeof(pkt));
-#ifdef NDEBUG
-    (void)amt;
-#else
-    assert(amt == (ssize_t)sizeof(pkt));
-#endif
-    amt = write(fd, &samples[0], samples_size);
-#ifdef NDEBUG
-    (void)amt;
-#else
-    assert(amt == (ssize_t)samples_size);
-#endif
-    amt = write(fd, &run_lengths[0], runlengths_size);
-#ifdef NDEBUG
-    (void)amt;
-#else
-    assert(amt == (ssize_t)runlengths_size);
-#endif
+
+    struct iovec pieces[3];
+    pieces[0].iov_base = &pkt;
+    pieces[0].iov_len = sizeof(pkt);
+
+    if(!compress) {
+      pieces[1].iov_base = &samples[0];
+      pieces[1].iov_len = compressed_len * sizeof(typename T::Sample);
+      pieces[2].iov_base = &run_lengths[0];
+      pieces[2].iov_len = compressed_len * sizeof(unsigned short);
+      writer->write_packet(SampleFile::PacketHeader::PACKET_SAMPLES,
+			   pieces, 3);
+      return;
+    }
+
+    // every Sample is a small array of DATA_TYPE fields - encode each field
+    //  as the zigzag'd difference from the previous entry
+    typedef typename T::DATA_TYPE DT;
+    static const size_t FIELDS = sizeof(typename T::Sample) / sizeof(DT);
+    std::vector<unsigned char> encoded;
+    encoded.reserve(compressed_len * (FIELDS + 1) * 2);
+    unsigned long long prev[FIELDS];
+    for(size_t f = 0; f < FIELDS; f++)
+      prev[f] = 0;
+    for(int i = 0; i < compressed_len; i++) {
+      const DT *fields = reinterpret_cast<const DT *>(&samples[i]);
+      for(size_t f = 0; f < FIELDS; f++) {
+	unsigned long long v = varint_field(fields[f]);
+	long long delta = (long long)(v - prev[f]);
+	append_varint(encoded, ((unsigned long long)delta << 1) ^ (unsigned long long)(delta >> 63));
+	prev[f] = v;
+      }
+      append_varint(encoded, run_lengths[i]);
+    }
+    pieces[1].iov_base = &encoded[0];
+    pieces[1].iov_len = encoded.size();
+    writer->write_packet(SampleFile::PacketHeader::PACKET_SAMPLES_VARINT,
+			 pieces, 2);
   }
 
 
@@ -356,6 +593,8 @@ namespace Realm {
     , cfg_enabled(true)
     , cfg_sample_interval(10000000) // 10 ms
     , cfg_buffer_size(1 << 20)
+    , cfg_mmap_size(0)
+    , cfg_compress(false)
     , next_sampler_id(0)
     , next_sample_index(0)
     , sampler_head(0)
@@ -363,7 +602,7 @@ namespace Realm {
     , delayed_additions(0)
     , core_rsrv(0)
     , sampling_thread(0)
-    , output_fd(-1)
+    , writer(0)
     , flush_requested(false)
     , sampling_start(0)
     , sampling_time(0)
@@ -397,7 +636,7 @@ namespace Realm {
       assert(sampling_thread == 0);
       assert(core_rsrv == 0);
       assert(sampler_head == 0);
-      assert(output_fd == -1);
+      assert(writer == 0);
       return;
     }
 
@@ -411,27 +650,7 @@ namespace Realm {
     //  buffers and destroy all samplers
     AutoHSLLock al(mutex);
 
-    for(std::vector<SampleFile::PacketNewGauge *>::iterator it = new_sampler_infos.begin();
-	it != new_sampler_infos.end();
-	++it) {
-      SampleFile::PacketHeader hdr;
-      hdr.packet_type = SampleFile::PacketHeader::PACKET_NEWGAUGE;
-      hdr.packet_size = sizeof(SampleFile::PacketNewGauge);
-      ssize_t amt = write(output_fd, &hdr, sizeof(hdr));
-#ifdef NDEBUG
-      (void)amt;
-#else
-      assert(amt == (ssize_t)sizeof(hdr));
-#endif
-      amt = write(output_fd, *it, sizeof(SampleFile::PacketNewGauge));
-#ifdef NDEBUG
-      (void)amt;
-#else
-      assert(amt == (ssize_t)sizeof(SampleFile::PacketNewGauge));
-#endif
-      delete *it;
-    }
-    new_sampler_infos.clear();
+    write_gauge_infos(new_sampler_infos);
 
     GaugeSampler *sampler = sampler_head;
     sampler_head = 0;
@@ -440,7 +659,7 @@ namespace Realm {
     while(sampler) {
       GaugeSampleBuffer *buffer = sampler->buffer_swap(0);
       if(buffer) {
-	if(buffer->compressed_len > 0) buffer->write_data(output_fd);
+	if(buffer->compressed_len > 0) buffer->write_data(writer, cfg_compress);
 	delete buffer;
       }
       GaugeSampler *next = sampler->next;
@@ -448,7 +667,8 @@ namespace Realm {
       sampler = next;
     }
 
-    close(output_fd);
+    delete writer;
+    writer = 0;
 
     log_realmprof.info() << "realm profiler shut down: samples=" << next_sample_index;
   }
@@ -467,6 +687,21 @@ namespace Realm {
     return true;
   }
 
+  void SamplingProfilerImpl::write_gauge_infos(std::vector<SampleFile::PacketNewGauge *>& infos)
+  {
+    for(std::vector<SampleFile::PacketNewGauge *>::iterator it = infos.begin();
+	it != infos.end();
+	++it) {
+      struct iovec piece;
+      piece.iov_base = *it;
+      piece.iov_len = sizeof(SampleFile::PacketNewGauge);
+      writer->write_packet(SampleFile::PacketHeader::PACKET_NEWGAUGE,
+			   &piece, 1);
+      delete *it;
+    }
+    infos.clear();
+  }
+
   void SamplingProfilerImpl::configure_from_cmdline(std::vector<std::string>& cmdline,
 						    CoreReservationSet& crs)
   {
@@ -481,6 +716,8 @@ namespace Realm {
       .add_option_string("-realm:prof_file", logfile)
       .add_option_int("-realm:prof_buffer_size", cfg_buffer_size)
       .add_option_int("-realm:prof_sample_interval", cfg_sample_interval)
+      .add_option_int("-realm:prof_mmap", cfg_mmap_size)
+      .add_option_bool("-realm:prof_compress", cfg_compress)
       .add_option_method("-realm:prof_pattern", this, &SamplingProfilerImpl::parse_profile_pattern)
       .parse_command_line(cmdline);
 
@@ -553,13 +790,23 @@ namespace Realm {
 	logfile = filename;
       }
 
-      output_fd = open(logfile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
-      if(output_fd < 0) {
+      // -realm:prof_mmap gives the size (in MB) of a preallocated ring file,
+      //  which always uses the compressed sample encoding
+      int fd = open(logfile.c_str(),
+		    ((cfg_mmap_size > 0) ? O_RDWR : O_WRONLY) | O_CREAT | O_TRUNC,
+		    0666);
+      if(fd < 0) {
 	log_realmprof.fatal() << "could not create/write '" << logfile << "': " << strerror(errno);
 	assert(0);
       }
-
-      log_realmprof.info() << "realm profiler enabled: logfile='" << logfile << "' interval=" << cfg_sample_interval << " ns";
+      if(cfg_mmap_size > 0) {
+	writer = new SampleFileRingWriter(fd, cfg_mmap_size << 20);
+	cfg_compress = true;
+      } else
+	writer = new SampleFileStreamWriter(fd);
+
+      log_realmprof.info() << "realm profiler enabled: logfile='" << logfile << "' interval=" << cfg_sample_interval << " ns"
+			   << " mmap=" << cfg_mmap_size << " MB compress=" << cfg_compress;
     }
   }
 
@@ -585,27 +832,7 @@ namespace Realm {
 	new_infos.swap(new_sampler_infos);
       }
       
-      for(std::vector<SampleFile::PacketNewGauge *>::iterator it = new_infos.begin();
-	  it != new_infos.end();
-	  ++it) {
-	SampleFile::PacketHeader hdr;
-	hdr.packet_type = SampleFile::PacketHeader::PACKET_NEWGAUGE;
-	hdr.packet_size = sizeof(SampleFile::PacketNewGauge);
-	ssize_t amt = write(output_fd, &hdr, sizeof(hdr));
-#ifdef NDEBUG
-	(void)amt;
-#else
-	assert(amt == (ssize_t)sizeof(hdr));
-#endif
-	amt = write(output_fd, *it, sizeof(SampleFile::PacketNewGauge));
-#ifdef NDEBUG
-	(void)amt;
-#else
-	assert(amt == (ssize_t)sizeof(SampleFile::PacketNewGauge));
-#endif
-	delete *it;
-      }
-      new_infos.clear();
+      write_gauge_infos(new_infos);
 
       // an empty list means nothing to do
       if(!head)
@@ -674,7 +901,7 @@ namespace Realm {
 	  it++) {
 	GaugeSampleBuffer *buffer = (*it)->buffer_swap(cfg_buffer_size);
 	assert((buffer != 0) && (buffer->compressed_len > 0));
-	buffer->write_data(output_fd);
+	buffer->write_data(writer, cfg_compress);
 	delete buffer;
       }
 
@@ -685,7 +912,7 @@ namespace Realm {
 	GaugeSampleBuffer *buffer = (*it)->buffer_swap(0);
 	if(buffer) {
 	  if(buffer->compressed_len > 0) 
-	    buffer->write_data(output_fd);
+	    buffer->write_data(writer, cfg_compress);
 	  delete buffer;
 	}
 	delete (*it);
@@ -710,12 +937,13 @@ namespace Realm {
 							   true /*non-empty only*/);
 	  if(buffer) {
 	    assert(buffer->compressed_len > 0);
-	    buffer->write_data(output_fd);
+	    buffer->write_data(writer, cfg_compress);
 	    delete buffer;
 	  }
 
 	  sampler = sampler->next;
 	}
+	writer->flush();
       }
     }
   }
@@ -820,6 +1048,8 @@ namespace Realm {
     template void Gauge::add_gauge<AbsoluteGauge<unsigned long> >(AbsoluteGauge<unsigned long>*, SamplingProfiler*);
     template void Gauge::add_gauge<AbsoluteGauge<unsigned> >(AbsoluteGauge<unsigned>*, SamplingProfiler*);
     template void Gauge::add_gauge<AbsoluteRangeGauge<int> >(AbsoluteRangeGauge<int>*, SamplingProfiler*);
+    template void Gauge::add_gauge<AbsoluteGauge<float> >(AbsoluteGauge<float>*, SamplingProfiler*);
+    template void Gauge::add_gauge<AbsoluteGauge<double> >(AbsoluteGauge<double>*, SamplingProfiler*);
 
   };
 
@@ -21,16 +21,68 @@
 #include "realm/sampling.h"
 #include "realm/threads.h"
 
+#include <sys/uio.h>
+
 namespace Realm {
 
   class SamplingProfilerImpl;
 
+  // destination for the packets of a sample file - each packet is handed over
+  //  in one call so that it can be written with a single system call (or copy)
+  class SampleFileWriter {
+  public:
+    virtual ~SampleFileWriter(void);
+
+    // writes a packet of the given type whose body is the concatenation of
+    //  the 'count' pieces
+    virtual void write_packet(unsigned packet_type,
+			      const struct iovec *pieces, int count) = 0;
+    virtual void flush(void) = 0;
+  };
+
+  class SampleFileStreamWriter : public SampleFileWriter {
+  public:
+    SampleFileStreamWriter(int _fd);
+    virtual ~SampleFileStreamWriter(void);
+
+    virtual void write_packet(unsigned packet_type,
+			      const struct iovec *pieces, int count);
+    virtual void flush(void);
+
+  protected:
+    int fd;
+  };
+
+  // writes into a preallocated, memory-mapped file - see
+  //  SampleFile::RingFileHeader for the layout
+  class SampleFileRingWriter : public SampleFileWriter {
+  public:
+    SampleFileRingWriter(int _fd, size_t _file_size);
+    virtual ~SampleFileRingWriter(void);
+
+    virtual void write_packet(unsigned packet_type,
+			      const struct iovec *pieces, int count);
+    virtual void flush(void);
+
+  protected:
+    void copy_in(char *dst, const struct iovec *pieces, int count);
+    void make_room(size_t bytes);
+
+    int fd;
+    size_t file_size;
+    char *base;
+    SampleFile::RingFileHeader *header;
+    char *ring;
+  };
+
   class GaugeSampleBuffer {
   public:
     GaugeSampleBuffer(int _sampler_id);
     virtual ~GaugeSampleBuffer(void);
     
-    virtual void write_data(int fd) = 0;
+    // writes the buffered samples as a single packet, using the delta+varint
+    //  encoding if 'compress' is set
+    virtual void write_data(SampleFileWriter *writer, bool compress) = 0;
     
     int sampler_id;
     int compressed_len;
@@ -43,7 +95,7 @@ namespace Realm {
   public:
     GaugeSampleBufferImpl(int _sampler_id, size_t _reserve);
     
-    virtual void write_data(int fd);
+    virtual void write_data(SampleFileWriter *writer, bool compress);
 
     std::vector<typename T::Sample> samples;
     std::vector<unsigned short> run_lengths;
@@ -143,6 +195,7 @@ namespace Realm {
 
   protected:
     bool parse_profile_pattern(const std::string& s);
+    void write_gauge_infos(std::vector<SampleFile::PacketNewGauge *>& infos);
 
     bool is_default;
     GASNetHSL mutex;
@@ -150,6 +203,8 @@ namespace Realm {
     bool cfg_enabled;
     size_t cfg_sample_interval;
     size_t cfg_buffer_size;
+    size_t cfg_mmap_size;
+    bool cfg_compress;
     std::vector<std::string> cfg_patterns;
     int next_sampler_id;
     int next_sample_index;
@@ -167,7 +222,7 @@ namespace Realm {
 
     CoreReservation *core_rsrv;
     Thread *sampling_thread;
-    int output_fd;
+    SampleFileWriter *writer;
     bool flush_requested;
     ProfilingGauges::AbsoluteGauge<long long> *sampling_start;
     ProfilingGauges::EventCounter<long long> *sampling_time;
@@ -0,0 +1,788 @@
+/* Copyright 2018 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// shared-memory transport for active messages between processes on the
+//  same host
+
+#include "realm/shm_transport.h"
+#include "realm/logging.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <signal.h>
+#include <string.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <assert.h>
+
+#include <algorithm>
+#include <sstream>
+
+namespace Realm {
+
+  Logger log_shm("shm");
+
+  static const char SEGMENT_MAGIC[8] = { 'R', 'L', 'M', 'S', 'H', 'M', 'T', '2' };
+
+  static const uint32_t SEGMENT_READY = 1;
+  static const uint32_t SEGMENT_FAILED = 2;
+
+  static const uint32_t RECORD_FIRST = 1;
+  static const uint32_t RECORD_LAST = 2;
+
+  // producer and consumer positions live on separate cache lines - both are
+  //  byte counts that only ever increase, so (tail - head) is the amount of
+  //  the ring in use
+  struct SharedMemoryTransport::RingHeader {
+    volatile uint64_t head;  // written only by the receiver
+    char pad0[56];
+    volatile uint64_t tail;  // written only by the sender
+    char pad1[56];
+  };
+
+  // a record_size of 0 marks the rest of the ring as unused - the next
+  //  record starts back at offset 0
+  struct SharedMemoryTransport::RecordHeader {
+    uint32_t record_size;   // header + body + padding, multiple of 8
+    uint32_t flags;
+    int32_t msgid;
+    uint32_t arg_size;      // FIRST records only
+    uint64_t payload_size;  // FIRST records only - total over all fragments
+    uint64_t dstptr;        // FIRST records only
+  };
+
+  // followed by the table of shared memories, 'num_rings' sender ranks, and
+  //  then the rings themselves
+  struct SharedMemoryTransport::SegmentHeader {
+    char magic[8];
+    volatile uint32_t ready;  // SEGMENT_READY or SEGMENT_FAILED once known
+    int32_t rank;
+    int32_t num_ranks;
+    uint32_t num_rings;
+    uint64_t ring_size;
+    int32_t pid;              // creator, to recognize leftovers from crashes
+    volatile uint32_t num_exports;
+  };
+
+  struct SharedMemoryTransport::ExportEntry {
+    uint64_t mem_id;
+    uint64_t size;
+  };
+
+  static inline size_t align_up(size_t v, size_t a)
+  {
+    return ((v + a - 1) / a) * a;
+  }
+
+  // the table of shared memories starts on the second cache line of the
+  //  segment, and the sender list follows it
+  static const size_t EXPORT_TABLE_OFFSET = 64;
+  static const size_t MAX_EXPORTS = 8;
+  static const size_t SENDER_LIST_OFFSET = (EXPORT_TABLE_OFFSET +
+					    MAX_EXPORTS * 2 * sizeof(uint64_t));
+
+  // creates a new shared memory object, removing one with the same name
+  //  left behind by a crashed run with the same key first
+  static int create_exclusive(const std::string& name)
+  {
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if((fd < 0) && (errno == EEXIST)) {
+      log_shm.info() << "removing stale shared memory object " << name;
+      shm_unlink(name.c_str());
+      fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    }
+    return fd;
+  }
+
+  // sizes a shared memory object and makes sure it is actually backed -
+  //  ftruncate alone succeeds on tmpfs even when /dev/shm is too small, and
+  //  the first touch of a page that can't be backed then raises SIGBUS
+  // returns 0 or an errno value
+  static int allocate_backing(int fd, size_t size)
+  {
+    if(ftruncate(fd, size) != 0)
+      return errno;
+    return posix_fallocate(fd, 0, size);
+  }
+
+  static bool process_exists(pid_t pid)
+  {
+    return ((kill(pid, 0) == 0) || (errno == EPERM));
+  }
+
+  static size_t segment_header_bytes(size_t num_rings)
+  {
+    return align_up(SENDER_LIST_OFFSET + num_rings * sizeof(int32_t), 64);
+  }
+
+
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class SharedMemoryTransport
+  //
+
+  SharedMemoryTransport::SharedMemoryTransport(void)
+    : my_rank(-1), num_ranks(0), ring_size(0), max_record(0), deliver(0)
+    , barrier(0), segment_size(0)
+  {
+    memset(&stats, 0, sizeof(stats));
+  }
+
+  SharedMemoryTransport::~SharedMemoryTransport(void)
+  {
+    shutdown();
+  }
+
+  /*static*/ std::string SharedMemoryTransport::default_key(void)
+  {
+    std::ostringstream oss;
+    oss << 'u' << getuid() << '.';
+    const char *e;
+    if((e = getenv("REALM_SHM_KEY")) != 0)
+      oss << e;
+    else if((e = getenv("SLURM_JOB_ID")) != 0) {
+      oss << "slurm" << e;
+      if((e = getenv("SLURM_STEP_ID")) != 0)
+	oss << '.' << e;
+    } else if((e = getenv("PBS_JOBID")) != 0)
+      oss << "pbs" << e;
+    else if((e = getenv("LSB_JOBID")) != 0)
+      oss << "lsf" << e;
+    else
+      // processes launched together on a host usually share a parent
+      oss << 'p' << getppid();
+
+    // shared memory object names can't contain slashes (or much else)
+    std::string key = oss.str();
+    for(size_t i = 0; i < key.size(); i++)
+      if(!(isalnum(key[i]) || (key[i] == '.') || (key[i] == '_') || (key[i] == '-')))
+	key[i] = '_';
+    return key;
+  }
+
+  std::string SharedMemoryTransport::segment_name(NodeID rank) const
+  {
+    std::ostringstream oss;
+    oss << "/realm." << key << '.' << rank;
+    return oss.str();
+  }
+
+  std::string SharedMemoryTransport::shared_memory_name(uint64_t mem_id) const
+  {
+    std::ostringstream oss;
+    oss << "/realm." << key << ".mem" << std::hex << mem_id;
+    return oss.str();
+  }
+
+  // opens the segment of a rank that is running on this host, or returns -1
+  int SharedMemoryTransport::open_peer_segment(NodeID rank) const
+  {
+    std::string name = segment_name(rank);
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if(fd < 0)
+      return -1;
+
+    bool ok = false;
+    bool stale = false;
+    struct stat st;
+    if((fstat(fd, &st) == 0) && ((size_t)st.st_size >= sizeof(SegmentHeader))) {
+      void *p = mmap(0, sizeof(SegmentHeader), PROT_READ, MAP_SHARED, fd, 0);
+      if(p != MAP_FAILED) {
+	const SegmentHeader *h = static_cast<const SegmentHeader *>(p);
+	if(memcmp(h->magic, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC)) == 0) {
+	  // a rank on another host can collide with a segment left behind
+	  //  here by a crashed run with the same key
+	  stale = !process_exists(h->pid);
+	  ok = (!stale && (h->rank == rank) && (h->num_ranks == num_ranks) &&
+		(h->ring_size == ring_size));
+	}
+	munmap(p, sizeof(SegmentHeader));
+      }
+    }
+    if(ok)
+      return fd;
+
+    close(fd);
+    if(stale) {
+      // nobody will ever use it, so remove it and look again
+      log_shm.info() << "removing stale shared memory segment " << name;
+      shm_unlink(name.c_str());
+      return open_peer_segment(rank);
+    }
+    log_shm.warning() << "ignoring unexpected shared memory segment " << name;
+    return -1;
+  }
+
+  bool SharedMemoryTransport::init(const std::string& _key, NodeID _my_rank,
+				   int _num_ranks, size_t _ring_size,
+				   DeliveryFn _deliver, BarrierFn _barrier)
+  {
+    key = _key;
+    my_rank = _my_rank;
+    num_ranks = _num_ranks;
+    // records are 8-byte aligned and no record may exceed a quarter of the
+    //  ring, so there is always room for one after a wrap
+    ring_size = align_up(std::max(_ring_size, (size_t)4096), 64);
+    max_record = ring_size / 4;
+    deliver = _deliver;
+    barrier = _barrier;
+    local_index.assign(num_ranks, -1);
+
+    // phase 1: advertise ourselves with a header-only segment
+    std::string my_name = segment_name(my_rank);
+    int my_fd = create_exclusive(my_name);
+    int err = ((my_fd >= 0) ? 0 : errno);
+    SegmentHeader *my_hdr = 0;
+    if(my_fd >= 0) {
+      err = allocate_backing(my_fd, sizeof(SegmentHeader));
+      if(err == 0) {
+	void *p = mmap(0, sizeof(SegmentHeader), PROT_READ | PROT_WRITE,
+		       MAP_SHARED, my_fd, 0);
+	if(p != MAP_FAILED) {
+	  my_hdr = static_cast<SegmentHeader *>(p);
+	  memcpy(my_hdr->magic, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC));
+	  my_hdr->ready = 0;
+	  my_hdr->rank = my_rank;
+	  my_hdr->num_ranks = num_ranks;
+	  my_hdr->num_rings = 0;
+	  my_hdr->ring_size = ring_size;
+	  my_hdr->pid = getpid();
+	  my_hdr->num_exports = 0;
+	} else
+	  err = errno;
+      }
+      if(!my_hdr) {
+	close(my_fd);
+	shm_unlink(my_name.c_str());
+	my_fd = -1;
+      }
+    }
+    if(my_fd < 0)
+      log_shm.warning() << "could not create shared memory segment " << my_name
+			<< " (" << strerror(err) << ") - intra-node messages will use the network";
+
+    (*barrier)();
+
+    // phase 2: every process that can see our segment (and whose segment we
+    //  can see) is on this host - if we failed to create ours, nobody can
+    //  see us, so we must not look at anybody else either
+    std::vector<int> peer_fds(num_ranks, -1);
+    bool my_failed = false;
+    if(my_fd >= 0) {
+      for(NodeID r = 0; r < num_ranks; r++) {
+	if(r == my_rank) {
+	  local_ranks.push_back(r);
+	  continue;
+	}
+	int fd = open_peer_segment(r);
+	if(fd < 0) continue;
+	peer_fds[r] = fd;
+	local_ranks.push_back(r);
+      }
+
+      // size our segment for a ring per local rank and initialize it
+      size_t num_rings = local_ranks.size();
+      size_t hdr_bytes = segment_header_bytes(num_rings);
+      segment_size = hdr_bytes + num_rings * (sizeof(RingHeader) + ring_size);
+      munmap(my_hdr, sizeof(SegmentHeader));
+      my_hdr = 0;
+      void *base = MAP_FAILED;
+      int ret = allocate_backing(my_fd, segment_size);
+      if(ret == 0) {
+	base = mmap(0, segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, my_fd, 0);
+	if(base == MAP_FAILED)
+	  ret = errno;
+      }
+      if(base != MAP_FAILED) {
+	my_hdr = static_cast<SegmentHeader *>(base);
+	int32_t *senders = reinterpret_cast<int32_t *>(static_cast<char *>(base) + SENDER_LIST_OFFSET);
+	for(size_t i = 0; i < num_rings; i++) {
+	  senders[i] = local_ranks[i];
+	  RingHeader *rh = reinterpret_cast<RingHeader *>(static_cast<char *>(base) + hdr_bytes +
+							  i * (sizeof(RingHeader) + ring_size));
+	  rh->head = 0;
+	  rh->tail = 0;
+	}
+	my_hdr->num_rings = num_rings;
+	__sync_synchronize();
+	my_hdr->ready = SEGMENT_READY;
+      } else {
+	// peers have already counted us as local - shrink back to the header
+	//  (which is backed) and tell them to leave us out instead
+	log_shm.warning() << "could not grow shared memory segment " << my_name
+			  << " to " << segment_size << " bytes (" << strerror(ret)
+			  << ") - intra-node messages will use the network";
+	my_failed = true;
+	if(ftruncate(my_fd, sizeof(SegmentHeader)) == 0) {
+	  void *p = mmap(0, sizeof(SegmentHeader), PROT_READ | PROT_WRITE,
+			 MAP_SHARED, my_fd, 0);
+	  if(p != MAP_FAILED) {
+	    static_cast<SegmentHeader *>(p)->ready = SEGMENT_FAILED;
+	    munmap(p, sizeof(SegmentHeader));
+	  }
+	}
+	local_ranks.clear();
+      }
+    }
+
+    (*barrier)();
+
+    // phase 3: map everybody else's rings
+    if((my_fd >= 0) && !my_failed) {
+      size_t num_rings = local_ranks.size();
+      size_t hdr_bytes = segment_header_bytes(num_rings);
+      mappings.resize(num_rings, 0);
+      out_rings.resize(num_rings, 0);
+      int my_index = -1;
+      for(size_t i = 0; i < num_rings; i++) {
+	local_index[local_ranks[i]] = i;
+	if(local_ranks[i] == my_rank)
+	  my_index = i;
+      }
+
+      for(size_t i = 0; i < num_rings; i++) {
+	NodeID r = local_ranks[i];
+	char *base;
+	if(r == my_rank) {
+	  base = reinterpret_cast<char *>(my_hdr);
+	} else {
+	  void *p = mmap(0, segment_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+			 peer_fds[r], 0);
+	  if(p == MAP_FAILED) {
+	    log_shm.fatal() << "could not map shared memory segment of rank " << r
+			    << ": " << strerror(errno);
+	    assert(0);
+	  }
+	  base = static_cast<char *>(p);
+	  const SegmentHeader *h = reinterpret_cast<const SegmentHeader *>(base);
+	  if(h->ready == SEGMENT_FAILED) {
+	    // only the header is left - its ring in our segment goes unused
+	    munmap(p, segment_size);
+	    continue;
+	  }
+	  const int32_t *senders = reinterpret_cast<const int32_t *>(base + SENDER_LIST_OFFSET);
+	  bool ok = ((h->ready == SEGMENT_READY) && (h->num_rings == num_rings));
+	  for(size_t j = 0; ok && (j < num_rings); j++)
+	    ok = (senders[j] == local_ranks[j]);
+	  if(!ok) {
+	    log_shm.fatal() << "rank " << r << " disagrees about which ranks are on this host";
+	    assert(0);
+	  }
+	}
+	mappings[i] = base;
+
+	// outgoing: the ring in rank r's segment that belongs to us
+	if(r != my_rank) {
+	  OutRing *o = new OutRing;
+	  o->hdr = reinterpret_cast<RingHeader *>(base + hdr_bytes +
+						  my_index * (sizeof(RingHeader) + ring_size));
+	  o->data = reinterpret_cast<char *>(o->hdr + 1);
+	  out_rings[i] = o;
+
+	  // incoming: the ring in our segment that belongs to rank r
+	  InRing in;
+	  in.sender = r;
+	  in.hdr = reinterpret_cast<RingHeader *>(reinterpret_cast<char *>(my_hdr) + hdr_bytes +
+						  i * (sizeof(RingHeader) + ring_size));
+	  in.data = reinterpret_cast<char *>(in.hdr + 1);
+	  in.msgid = 0;
+	  in.payload = 0;
+	  in.payload_size = 0;
+	  in.payload_received = 0;
+	  in.dstptr_used = false;
+	  in.in_progress = false;
+	  in_rings.push_back(in);
+	}
+      }
+
+      // drop the peers that couldn't grow their segments
+      size_t kept = 0;
+      for(size_t i = 0; i < num_rings; i++) {
+	local_index[local_ranks[i]] = -1;
+	if(!mappings[i])
+	  continue;
+	local_ranks[kept] = local_ranks[i];
+	mappings[kept] = mappings[i];
+	out_rings[kept] = out_rings[i];
+	local_index[local_ranks[kept]] = kept;
+	kept++;
+      }
+      local_ranks.resize(kept);
+      mappings.resize(kept);
+      out_rings.resize(kept);
+    }
+
+    (*barrier)();
+
+    // everybody has everything mapped - remove the names so nothing is left
+    //  behind even if we crash
+    if(my_fd >= 0) {
+      shm_unlink(my_name.c_str());
+      close(my_fd);
+    }
+    for(int r = 0; r < num_ranks; r++)
+      if(peer_fds[r] >= 0)
+	close(peer_fds[r]);
+
+    log_shm.info() << "rank " << my_rank << ": " << (local_ranks.empty() ? 0 : (local_ranks.size() - 1))
+		   << " co-located peers, ring size = " << ring_size;
+
+    return ((my_fd >= 0) && !my_failed);
+  }
+
+  void SharedMemoryTransport::shutdown(void)
+  {
+    // our own shared memories stay mapped - their storage belongs to the
+    //  memories using it
+    for(std::map<uint64_t, SharedRegion>::iterator it = shared_regions.begin();
+	it != shared_regions.end();
+	++it)
+      if(it->second.owner != my_rank)
+	munmap(it->second.base, it->second.size);
+    shared_regions.clear();
+    for(size_t i = 0; i < out_rings.size(); i++)
+      delete out_rings[i];
+    out_rings.clear();
+    for(size_t i = 0; i < in_rings.size(); i++)
+      if(in_rings[i].in_progress && !in_rings[i].dstptr_used)
+	free(in_rings[i].payload);
+    in_rings.clear();
+    for(size_t i = 0; i < mappings.size(); i++)
+      if(mappings[i])
+	munmap(mappings[i], segment_size);
+    mappings.clear();
+    local_ranks.clear();
+    local_index.assign(local_index.size(), -1);
+  }
+
+  bool SharedMemoryTransport::is_local_peer(NodeID rank) const
+  {
+    if((rank < 0) || (rank >= (NodeID)local_index.size()) || (rank == my_rank))
+      return false;
+    return (local_index[rank] >= 0);
+  }
+
+  int SharedMemoryTransport::num_local_peers(void) const
+  {
+    return (local_ranks.empty() ? 0 : (local_ranks.size() - 1));
+  }
+
+  void *SharedMemoryTransport::create_shared_memory(uint64_t mem_id, size_t size)
+  {
+    if(num_local_peers() == 0)
+      return 0;
+
+    SegmentHeader *my_hdr = static_cast<SegmentHeader *>(mappings[local_index[my_rank]]);
+    if(my_hdr->num_exports >= MAX_EXPORTS) {
+      log_shm.warning() << "too many shared memories - memory " << std::hex << mem_id
+			<< std::dec << " will not be shared";
+      return 0;
+    }
+
+    std::string name = shared_memory_name(mem_id);
+    int fd = create_exclusive(name);
+    void *base = MAP_FAILED;
+    int ret = ((fd >= 0) ? 0 : errno);
+    if(fd >= 0) {
+      ret = allocate_backing(fd, size);
+      if(ret == 0) {
+	base = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if(base == MAP_FAILED)
+	  ret = errno;
+      }
+      close(fd);
+    }
+    if(base == MAP_FAILED) {
+      log_shm.warning() << "could not create shared memory " << name << " of "
+			<< size << " bytes (" << strerror(ret) << ") - memory will not be shared";
+      if(fd >= 0)
+	shm_unlink(name.c_str());
+      return 0;
+    }
+
+    // peers find it in our segment once they get to map_shared_memories
+    ExportEntry *exports = reinterpret_cast<ExportEntry *>(reinterpret_cast<char *>(my_hdr) +
+							   EXPORT_TABLE_OFFSET);
+    exports[my_hdr->num_exports].mem_id = mem_id;
+    exports[my_hdr->num_exports].size = size;
+    my_hdr->num_exports++;
+
+    SharedRegion& sr = shared_regions[mem_id];
+    sr.owner = my_rank;
+    sr.base = base;
+    sr.size = size;
+    return base;
+  }
+
+  void SharedMemoryTransport::map_shared_memories(void)
+  {
+    // everybody has created their shared memories
+    (*barrier)();
+
+    for(size_t i = 0; i < local_ranks.size(); i++) {
+      NodeID r = local_ranks[i];
+      if(r == my_rank) continue;
+      const char *base = static_cast<const char *>(mappings[i]);
+      const SegmentHeader *h = reinterpret_cast<const SegmentHeader *>(base);
+      const ExportEntry *exports = reinterpret_cast<const ExportEntry *>(base + EXPORT_TABLE_OFFSET);
+      for(uint32_t j = 0; j < h->num_exports; j++) {
+	// a memory we can't map is simply not accessed directly
+	std::string name = shared_memory_name(exports[j].mem_id);
+	int fd = shm_open(name.c_str(), O_RDWR, 0);
+	void *p = MAP_FAILED;
+	if(fd >= 0) {
+	  p = mmap(0, exports[j].size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	  close(fd);
+	}
+	if(p == MAP_FAILED) {
+	  log_shm.warning() << "could not map shared memory " << name << " of rank " << r
+			    << ": " << strerror(errno);
+	  continue;
+	}
+	SharedRegion& sr = shared_regions[exports[j].mem_id];
+	sr.owner = r;
+	sr.base = p;
+	sr.size = exports[j].size;
+	log_shm.info() << "rank " << my_rank << ": mapped shared memory " << std::hex
+		       << exports[j].mem_id << std::dec << " of rank " << r << " at " << p;
+      }
+    }
+
+    // everybody has mapped everything - as with the rings, remove the names
+    (*barrier)();
+
+    for(std::map<uint64_t, SharedRegion>::const_iterator it = shared_regions.begin();
+	it != shared_regions.end();
+	++it)
+      if(it->second.owner == my_rank)
+	shm_unlink(shared_memory_name(it->first).c_str());
+  }
+
+  void *SharedMemoryTransport::get_shared_memory(uint64_t mem_id, size_t *size /*= 0*/) const
+  {
+    std::map<uint64_t, SharedRegion>::const_iterator it = shared_regions.find(mem_id);
+    if((it == shared_regions.end()) || (it->second.owner == my_rank))
+      return 0;
+    if(size)
+      *size = it->second.size;
+    return it->second.base;
+  }
+
+  void SharedMemoryTransport::get_shared_memory_ids(std::vector<uint64_t>& mem_ids) const
+  {
+    for(std::map<uint64_t, SharedRegion>::const_iterator it = shared_regions.begin();
+	it != shared_regions.end();
+	++it)
+      if(it->second.owner != my_rank)
+	mem_ids.push_back(it->first);
+  }
+
+  void SharedMemoryTransport::write_record(OutRing& ring, const RecordHeader& rh,
+					   const void *args, size_t arg_size,
+					   const struct iovec *payload, int payload_pieces,
+					   size_t& piece_idx, size_t& piece_ofs,
+					   size_t chunk)
+  {
+    size_t need = rh.record_size;
+    uint64_t pos = ring.hdr->tail;
+    size_t offset = pos % ring_size;
+    uint64_t start = pos;
+    bool wrap = (offset + need) > ring_size;
+    if(wrap)
+      start = pos + (ring_size - offset);
+    uint64_t new_tail = start + need;
+
+    // wait for the receiver to make room
+    if((new_tail - ring.hdr->head) > ring_size) {
+      __sync_fetch_and_add(&stats.full_waits, 1);
+      while((new_tail - ring.hdr->head) > ring_size) {
+	// the receiver may be waiting on us in the same way
+	poll();
+	sched_yield();
+      }
+    }
+    // don't let any of our writes below be done before the head read above
+    __sync_synchronize();
+
+    if(wrap)
+      *reinterpret_cast<uint32_t *>(ring.data + offset) = 0;
+
+    char *dst = ring.data + (start % ring_size);
+    memcpy(dst, &rh, sizeof(RecordHeader));
+    dst += sizeof(RecordHeader);
+    if(arg_size > 0) {
+      memcpy(dst, args, arg_size);
+      dst += arg_size;
+    }
+    while(chunk > 0) {
+      assert(piece_idx < (size_t)payload_pieces);
+      size_t avail = payload[piece_idx].iov_len - piece_ofs;
+      size_t bytes = std::min(avail, chunk);
+      memcpy(dst, static_cast<const char *>(payload[piece_idx].iov_base) + piece_ofs, bytes);
+      dst += bytes;
+      chunk -= bytes;
+      piece_ofs += bytes;
+      if(piece_ofs == payload[piece_idx].iov_len) {
+	piece_idx++;
+	piece_ofs = 0;
+      }
+    }
+
+    // publish the record only once its contents are visible
+    __sync_synchronize();
+    ring.hdr->tail = new_tail;
+  }
+
+  bool SharedMemoryTransport::send(NodeID target, int msgid,
+				   const void *args, size_t arg_size,
+				   const struct iovec *payload, int payload_pieces,
+				   size_t payload_size, void *dstptr)
+  {
+    if(!is_local_peer(target))
+      return false;
+
+    OutRing& ring = *out_rings[local_index[target]];
+
+    // skip over any empty pieces up front
+    size_t piece_idx = 0;
+    size_t piece_ofs = 0;
+    while((piece_idx < (size_t)payload_pieces) && (payload[piece_idx].iov_len == 0))
+      piece_idx++;
+
+    AutoHSLLock al(ring.mutex);
+
+    size_t sent = 0;
+    bool first = true;
+    do {
+      size_t overhead = sizeof(RecordHeader) + (first ? arg_size : 0);
+      assert(overhead < max_record);
+      size_t chunk = std::min(payload_size - sent, max_record - overhead);
+
+      RecordHeader rh;
+      rh.record_size = align_up(overhead + chunk, 8);
+      rh.flags = (first ? RECORD_FIRST : 0) | (((sent + chunk) == payload_size) ? RECORD_LAST : 0);
+      rh.msgid = msgid;
+      rh.arg_size = (first ? arg_size : 0);
+      rh.payload_size = payload_size;
+      rh.dstptr = reinterpret_cast<uintptr_t>(dstptr);
+
+      write_record(ring, rh, (first ? args : 0), (first ? arg_size : 0),
+		   payload, payload_pieces, piece_idx, piece_ofs, chunk);
+      __sync_fetch_and_add(&stats.fragments_sent, 1);
+
+      sent += chunk;
+      first = false;
+    } while(sent < payload_size);
+
+    __sync_fetch_and_add(&stats.msgs_sent, 1);
+    __sync_fetch_and_add(&stats.bytes_sent, payload_size);
+    return true;
+  }
+
+  void SharedMemoryTransport::handle_record(InRing& ring, const RecordHeader& rh,
+					    const char *body)
+  {
+    size_t chunk = rh.record_size - sizeof(RecordHeader);
+    if(rh.flags & RECORD_FIRST) {
+      assert(!ring.in_progress);
+      ring.in_progress = true;
+      ring.msgid = rh.msgid;
+      ring.args.assign(body, body + rh.arg_size);
+      body += rh.arg_size;
+      chunk -= rh.arg_size;
+      ring.payload_size = rh.payload_size;
+      ring.payload_received = 0;
+      if(rh.dstptr) {
+	ring.payload = reinterpret_cast<char *>(rh.dstptr);
+	ring.dstptr_used = true;
+      } else {
+	ring.payload = ((ring.payload_size > 0) ?
+			  static_cast<char *>(malloc(ring.payload_size)) :
+			  0);
+	assert((ring.payload != 0) || (ring.payload_size == 0));
+	ring.dstptr_used = false;
+      }
+    } else
+      assert(ring.in_progress && (rh.msgid == ring.msgid));
+
+    // the padding at the end of the record isn't part of the payload
+    chunk = std::min(chunk, ring.payload_size - ring.payload_received);
+    if(chunk > 0) {
+      memcpy(ring.payload + ring.payload_received, body, chunk);
+      ring.payload_received += chunk;
+    }
+
+    if(rh.flags & RECORD_LAST) {
+      assert(ring.payload_received == ring.payload_size);
+      ring.in_progress = false;
+      __sync_fetch_and_add(&stats.msgs_rcvd, 1);
+      __sync_fetch_and_add(&stats.bytes_rcvd, ring.payload_size);
+      (*deliver)(ring.sender, ring.msgid,
+		 (ring.args.empty() ? 0 : &ring.args[0]), ring.args.size(),
+		 ring.payload, ring.payload_size, ring.dstptr_used);
+      ring.payload = 0;
+    }
+  }
+
+  int SharedMemoryTransport::poll(void)
+  {
+    if(in_rings.empty())
+      return 0;
+
+    int delivered = 0;
+    AutoHSLLock al(poll_mutex);
+    for(std::vector<InRing>::iterator it = in_rings.begin();
+	it != in_rings.end();
+	++it) {
+      InRing& ring = *it;
+      uint64_t head = ring.hdr->head;
+      uint64_t tail = ring.hdr->tail;
+      if(head == tail) continue;
+      // don't read any record contents before the tail read above
+      __sync_synchronize();
+      while(head != tail) {
+	size_t offset = head % ring_size;
+	const char *rec = ring.data + offset;
+	uint32_t record_size = *reinterpret_cast<const uint32_t *>(rec);
+	if(record_size == 0) {
+	  // skip to the start of the ring
+	  head += ring_size - offset;
+	  continue;
+	}
+	RecordHeader rh;
+	memcpy(&rh, rec, sizeof(RecordHeader));
+	bool last = ((rh.flags & RECORD_LAST) != 0);
+	handle_record(ring, rh, rec + sizeof(RecordHeader));
+	head += record_size;
+	if(last) delivered++;
+	// give the space back right away so a blocked sender can continue
+	__sync_synchronize();
+	ring.hdr->head = head;
+      }
+      ring.hdr->head = head;
+    }
+    return delivered;
+  }
+
+  void SharedMemoryTransport::get_stats(Stats& _stats) const
+  {
+    _stats = stats;
+  }
+
+}; // namespace Realm
@@ -0,0 +1,177 @@
+/* Copyright 2018 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// shared-memory transport for active messages between processes on the
+//  same host
+
+#ifndef REALM_SHM_TRANSPORT_H
+#define REALM_SHM_TRANSPORT_H
+
+#include "realm/activemsg.h"
+
+#include <sys/uio.h>
+#include <stdint.h>
+
+#include <vector>
+#include <string>
+#include <map>
+
+namespace Realm {
+
+  // each process creates a POSIX shared memory segment holding one
+  //  single-producer/single-consumer ring for every co-located process
+  //  (including itself, for simplicity of indexing) - a sender writes
+  //  directly into its ring in the receiver's segment, and the receiver
+  //  drains its rings from its polling thread(s)
+  //
+  // messages between any pair of processes are delivered in the order they
+  //  were sent - payloads larger than a ring can hold are sent as a sequence
+  //  of fragments rather than falling back to the network, which would
+  //  allow reordering
+  class SharedMemoryTransport {
+  public:
+    // called with a complete message - if 'dstptr_used' is false, 'payload'
+    //  was allocated with malloc and ownership passes to the callee,
+    //  otherwise the payload has already been copied to the requested
+    //  destination and 'payload' points there
+    typedef void (*DeliveryFn)(NodeID sender, int msgid,
+			       const void *args, size_t arg_size,
+			       void *payload, size_t payload_size,
+			       bool dstptr_used);
+
+    // performs a barrier across all processes (not just co-located ones)
+    typedef void (*BarrierFn)(void);
+
+    SharedMemoryTransport(void);
+    ~SharedMemoryTransport(void);
+
+    // collective - every process must call this, with the same 'key' and
+    //  'num_ranks' - returns false if shared memory could not be set up,
+    //  in which case no peer is considered local
+    bool init(const std::string& key, NodeID my_rank, int num_ranks,
+	      size_t ring_size, DeliveryFn deliver, BarrierFn barrier);
+
+    // releases all mappings - no messages may be sent after this
+    void shutdown(void);
+
+    bool is_local_peer(NodeID rank) const;
+    int num_local_peers(void) const;
+
+    // a process can back its memories with shared storage that co-located
+    //  peers map directly - returns zero-filled storage for the memory with
+    //  id 'mem_id', or 0 if it can't be shared (e.g. there are no local
+    //  peers), in which case the caller should allocate it privately
+    void *create_shared_memory(uint64_t mem_id, size_t size);
+
+    // collective - must be called by every process once all shared memories
+    //  have been created - maps the shared memories of co-located peers
+    void map_shared_memories(void);
+
+    // storage of a co-located peer's shared memory in our address space, or
+    //  0 if 'mem_id' is not one of them
+    void *get_shared_memory(uint64_t mem_id, size_t *size = 0) const;
+    void get_shared_memory_ids(std::vector<uint64_t>& mem_ids) const;
+
+    // sends a message to a co-located peer, waiting (and polling) if the ring
+    //  is full - returns false without sending if 'target' is not local
+    bool send(NodeID target, int msgid,
+	      const void *args, size_t arg_size,
+	      const struct iovec *payload, int payload_pieces,
+	      size_t payload_size, void *dstptr);
+
+    // drains incoming rings, calling the delivery function for each complete
+    //  message - returns the number of messages delivered
+    int poll(void);
+
+    // default key for this job - uses REALM_SHM_KEY if set, then a job id
+    //  from common launchers, then the parent process id
+    static std::string default_key(void);
+
+    struct Stats {
+      uint64_t msgs_sent, bytes_sent, fragments_sent;
+      uint64_t msgs_rcvd, bytes_rcvd;
+      uint64_t full_waits;
+    };
+    void get_stats(Stats& stats) const;
+
+  protected:
+    struct RingHeader;
+    struct RecordHeader;
+    struct SegmentHeader;
+    struct ExportEntry;
+
+    struct SharedRegion {
+      NodeID owner;
+      void *base;
+      size_t size;
+    };
+
+    // sender-side view of the ring we write in a peer's segment
+    struct OutRing {
+      RingHeader *hdr;
+      char *data;
+      GASNetHSL mutex;  // threads in this process share the single producer slot
+    };
+
+    // receiver-side view of a ring in our own segment, plus the message
+    //  being reassembled from fragments, if any
+    struct InRing {
+      NodeID sender;
+      RingHeader *hdr;
+      char *data;
+      int msgid;
+      std::vector<char> args;
+      char *payload;
+      size_t payload_size, payload_received;
+      bool dstptr_used;
+      bool in_progress;
+    };
+
+    // appends one record, waiting for space - caller holds ring's mutex
+    void write_record(OutRing& ring, const RecordHeader& rh,
+		      const void *args, size_t arg_size,
+		      const struct iovec *payload, int payload_pieces,
+		      size_t& piece_idx, size_t& piece_ofs, size_t chunk);
+
+    void handle_record(InRing& ring, const RecordHeader& rh, const char *body);
+
+    std::string segment_name(NodeID rank) const;
+    int open_peer_segment(NodeID rank) const;
+    std::string shared_memory_name(uint64_t mem_id) const;
+
+    std::string key;
+    NodeID my_rank;
+    int num_ranks;
+    size_t ring_size, max_record;
+    DeliveryFn deliver;
+    BarrierFn barrier;
+
+    std::vector<NodeID> local_ranks;   // sorted, includes us
+    std::vector<int> local_index;      // rank -> index in local_ranks, or -1
+    std::vector<void *> mappings;      // index in local_ranks -> segment base
+    size_t segment_size;
+
+    std::vector<OutRing *> out_rings;  // index in local_ranks
+    std::vector<InRing> in_rings;      // only peers, not us
+    GASNetHSL poll_mutex;              // one poller drains at a time
+
+    std::map<uint64_t, SharedRegion> shared_regions;  // ours and peers'
+
+    Stats stats;
+  };
+
+}; // namespace Realm
+
+#endif // REALM_SHM_TRANSPORT_H
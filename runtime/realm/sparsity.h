@@ -116,6 +116,9 @@ namespace Realm {
     bool entries_valid, approx_valid;
     std::vector<SparsityMapEntry<N,T> > entries;
     std::vector<Rect<N,T> > approx_rects;
+    // a finalized map whose contents match those of an earlier map shares that
+    //  map's (interned) entry list rather than keeping its own copy
+    const std::vector<SparsityMapEntry<N,T> > *shared_entries;
   };
 
 }; // namespace Realm
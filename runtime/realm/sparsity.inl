@@ -70,7 +70,7 @@ namespace Realm {
       // TODO: warn here?
       make_valid(true /*precise*/).wait();
     }
-    return entries;
+    return (shared_entries ? *shared_entries : entries);
   }
     
   template <int N, typename T>
@@ -0,0 +1,401 @@
+/* Copyright 2018 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "realm/stacksampler/stacksampler_module.h"
+
+#include "realm/logging.h"
+#include "realm/cmdline.h"
+#include "realm/timers.h"
+#include "realm/runtime_impl.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <execinfo.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+// older glibc headers don't provide the name for the thread id field
+#if defined(__linux__) && !defined(sigev_notify_thread_id)
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+namespace Realm {
+
+  Logger log_stacks("stacks");
+
+  namespace StackSampler {
+
+    // the classes of threads that can be sampled, identified by the name
+    //  of the core reservation the thread was created with
+    static const struct {
+      const char *class_name;
+      const char *rsrv_prefix;
+    } thread_classes[] = {
+      { "cpu",  "CPU proc" },
+      { "util", "utility proc" },
+      { "io",   "IO proc" },
+      { "dma",  "DMA" },
+      { "am",   "AM handlers" },
+    };
+    static const size_t NUM_THREAD_CLASSES = (sizeof(thread_classes) /
+					      sizeof(thread_classes[0]));
+
+    // frames for record_sample, the signal handler, and the trampoline the
+    //  kernel uses to return from the signal, which come before the
+    //  interrupted frame in each sample
+    static const int SAMPLER_FRAMES = 3;
+
+    static __thread ThreadSamples *local_samples = 0;
+#ifdef __linux__
+    static __thread timer_t local_timer;
+#endif
+
+    static void sample_handler(int signal, siginfo_t *info, void *context)
+    {
+      // don't let anything we do here be visible to the interrupted code
+      int saved_errno = errno;
+      ThreadSamples *samples = local_samples;
+      if(samples)
+	samples->record_sample();
+      errno = saved_errno;
+    }
+
+
+    ////////////////////////////////////////////////////////////////////////
+    //
+    // class ThreadSamples
+
+    ThreadSamples::ThreadSamples(const std::string& _rsrv_name,
+				 const std::string& _class_name,
+				 size_t _buffer_size, int _max_depth)
+      : rsrv_name(_rsrv_name)
+      , class_name(_class_name)
+      , thread_id(0)
+      , max_depth(_max_depth + SAMPLER_FRAMES)
+      , buffer_size(_buffer_size / sizeof(intptr_t))
+      , used(0)
+      , num_samples(0)
+      , dropped(0)
+    {
+      buffer = new intptr_t[buffer_size];
+    }
+
+    ThreadSamples::~ThreadSamples(void)
+    {
+      delete[] buffer;
+    }
+
+    // this runs in a signal handler, so it must stick to async-signal-safe
+    //  calls - backtrace() is safe once it has been called once on the thread
+    __attribute__((noinline))
+    void ThreadSamples::record_sample(void)
+    {
+      // make sure there's room for the deepest possible stack
+      if((used + 2 + max_depth) > buffer_size) {
+	dropped++;
+	return;
+      }
+      intptr_t *s = buffer + used;
+      s[0] = Clock::current_time_in_nanoseconds();
+      int depth = backtrace((void **)(s + 2), max_depth);
+      s[1] = depth;
+      used += 2 + depth;
+      num_samples++;
+    }
+
+    void ThreadSamples::write_samples(FILE *f) const
+    {
+      fprintf(f, "thread %ld %s %zu %zu %s\n",
+	      thread_id, class_name.c_str(), num_samples, dropped,
+	      rsrv_name.c_str());
+      size_t pos = 0;
+      while(pos < used) {
+	const intptr_t *s = buffer + pos;
+	fprintf(f, "sample %lld", (long long)s[0]);
+	for(intptr_t i = SAMPLER_FRAMES; i < s[1]; i++)
+	  fprintf(f, " %lx", (unsigned long)s[2 + i]);
+	fprintf(f, "\n");
+	pos += 2 + s[1];
+      }
+    }
+
+
+    ////////////////////////////////////////////////////////////////////////
+    //
+    // class StackSamplerModule
+
+    StackSamplerModule::StackSamplerModule(void)
+      : Module("stacksampler")
+      , cfg_interval_us(1000)
+      , cfg_max_depth(64)
+      , cfg_buffer_size_in_mb(16)
+      , cfg_wall_clock(false)
+      , cfg_logfile("stacks_%.txt")
+    {}
+
+    StackSamplerModule::~StackSamplerModule(void)
+    {}
+
+    /*static*/ Module *StackSamplerModule::create_module(RuntimeImpl *runtime,
+							 std::vector<std::string>& cmdline)
+    {
+      StackSamplerModule *m = new StackSamplerModule;
+
+      {
+	CommandLineParser cp;
+
+	cp.add_option_method("-stacks:classes", m, &StackSamplerModule::parse_classes)
+	  .add_option_int("-stacks:interval", m->cfg_interval_us)
+	  .add_option_int("-stacks:depth", m->cfg_max_depth)
+	  .add_option_int("-stacks:buffer", m->cfg_buffer_size_in_mb)
+	  .add_option_bool("-stacks:wall", m->cfg_wall_clock)
+	  .add_option_string("-stacks:file", m->cfg_logfile);
+
+	bool ok = cp.parse_command_line(cmdline);
+	if(!ok) {
+	  log_stacks.fatal() << "error reading stack sampler command line parameters";
+	  assert(false);
+	}
+      }
+
+      // nothing to do unless some threads were selected
+      if(m->cfg_classes.empty()) {
+	log_stacks.debug() << "no thread classes selected for stack sampling";
+	delete m;
+	return 0;
+      }
+
+#ifndef __linux__
+      // we need per-thread timers to deliver the signals
+      log_stacks.warning() << "stack sampling is only supported on Linux";
+      delete m;
+      return 0;
+#else
+      if((m->cfg_interval_us <= 0) || (m->cfg_max_depth <= 0)) {
+	log_stacks.fatal() << "stack sampling interval and depth must be positive";
+	assert(false);
+      }
+
+      // the signal handler has to be in place before any thread arms a timer
+      struct sigaction act;
+      memset(&act, 0, sizeof(act));
+      act.sa_sigaction = &sample_handler;
+      act.sa_flags = SA_SIGINFO | SA_RESTART;
+      sigemptyset(&act.sa_mask);
+      if(sigaction(SIGPROF, &act, 0) != 0) {
+	log_stacks.fatal() << "could not install SIGPROF handler: " << strerror(errno);
+	assert(false);
+      }
+
+      // threads start being created right after the modules, so we have to
+      //  start watching for them now rather than in initialize()
+      Thread::set_observer(m);
+
+      return m;
+#endif
+    }
+
+    bool StackSamplerModule::parse_classes(const std::string& s)
+    {
+      size_t start = 0;
+      while(start <= s.size()) {
+	size_t end = s.find(',', start);
+	if(end == std::string::npos)
+	  end = s.size();
+	std::string name = s.substr(start, end - start);
+	bool found = (name == "all");
+	for(size_t i = 0; !found && (i < NUM_THREAD_CLASSES); i++)
+	  if(name == thread_classes[i].class_name)
+	    found = true;
+	if(!found) {
+	  log_stacks.error() << "unknown thread class '" << name << "' - must be one of: all cpu util io dma am";
+	  return false;
+	}
+	cfg_classes.push_back(name);
+	start = end + 1;
+      }
+      return true;
+    }
+
+    const char *StackSamplerModule::match_class(const std::string& rsrv_name) const
+    {
+      const char *class_name = "other";
+      for(size_t i = 0; i < NUM_THREAD_CLASSES; i++)
+	if(rsrv_name.compare(0, strlen(thread_classes[i].rsrv_prefix),
+			     thread_classes[i].rsrv_prefix) == 0) {
+	  class_name = thread_classes[i].class_name;
+	  break;
+	}
+      for(std::vector<std::string>::const_iterator it = cfg_classes.begin();
+	  it != cfg_classes.end();
+	  ++it)
+	if((*it == "all") || (*it == class_name))
+	  return class_name;
+      return 0;
+    }
+
+    void StackSamplerModule::initialize(RuntimeImpl *runtime)
+    {
+      Module::initialize(runtime);
+
+      log_stacks.info() << "stack sampling enabled: interval=" << cfg_interval_us
+			<< " us depth=" << cfg_max_depth
+			<< " clock=" << (cfg_wall_clock ? "wall" : "cpu");
+    }
+
+    void StackSamplerModule::thread_started(Thread *thread,
+					    const std::string& rsrv_name)
+    {
+#ifdef __linux__
+      const char *class_name = match_class(rsrv_name);
+      if(!class_name)
+	return;
+
+      ThreadSamples *samples = new ThreadSamples(rsrv_name, class_name,
+						 cfg_buffer_size_in_mb << 20,
+						 cfg_max_depth);
+      samples->thread_id = syscall(SYS_gettid);
+      {
+	AutoHSLLock al(mutex);
+	threads.push_back(samples);
+      }
+
+      // the first call to backtrace() can allocate memory while it loads the
+      //  unwinder, which must not happen in the signal handler
+      void *dummy[4];
+      backtrace(dummy, 4);
+
+      local_samples = samples;
+
+      // per-thread timer that delivers SIGPROF to just this thread
+      struct sigevent sev;
+      memset(&sev, 0, sizeof(sev));
+      sev.sigev_notify = SIGEV_THREAD_ID;
+      sev.sigev_signo = SIGPROF;
+      sev.sigev_notify_thread_id = samples->thread_id;
+      if(timer_create(cfg_wall_clock ? CLOCK_MONOTONIC : CLOCK_THREAD_CPUTIME_ID,
+		      &sev, &local_timer) != 0) {
+	log_stacks.warning() << "could not create sampling timer for thread '"
+			     << rsrv_name << "': " << strerror(errno);
+	local_samples = 0;
+	return;
+      }
+      struct itimerspec its;
+      its.it_interval.tv_sec = cfg_interval_us / 1000000;
+      its.it_interval.tv_nsec = (cfg_interval_us % 1000000) * 1000;
+      its.it_value = its.it_interval;
+      if(timer_settime(local_timer, 0, &its, 0) != 0) {
+	log_stacks.warning() << "could not start sampling timer for thread '"
+			     << rsrv_name << "': " << strerror(errno);
+	timer_delete(local_timer);
+	local_samples = 0;
+	return;
+      }
+
+      log_stacks.debug() << "sampling thread " << samples->thread_id
+			 << " (" << rsrv_name << ") as " << class_name;
+#endif
+    }
+
+    void StackSamplerModule::thread_finished(Thread *thread)
+    {
+#ifdef __linux__
+      if(!local_samples)
+	return;
+      // stop the timer before we stop recording in case a signal is in flight
+      timer_delete(local_timer);
+      local_samples = 0;
+#endif
+    }
+
+    void StackSamplerModule::write_samples(void)
+    {
+      std::string logfile = cfg_logfile;
+      size_t pct = logfile.find('%');
+      if(pct != std::string::npos) {
+	// replace % with node number
+	char filename[256];
+	snprintf(filename, sizeof(filename), "%.*s%d%s",
+		 (int)pct, logfile.c_str(), my_node_id, logfile.c_str() + pct + 1);
+	logfile = filename;
+      } else if(max_node_id > 0) {
+	log_stacks.fatal() << "cannot write stack samples from multiple nodes to common file '" << logfile << "'";
+	assert(0);
+      }
+
+      FILE *f = fopen(logfile.c_str(), "w");
+      if(!f) {
+	log_stacks.error() << "could not create/write '" << logfile << "': " << strerror(errno);
+	return;
+      }
+
+      fprintf(f, "StackSamples v1\n");
+      fprintf(f, "node %d\n", my_node_id);
+      fprintf(f, "interval %d %s\n", cfg_interval_us, (cfg_wall_clock ? "wall" : "cpu"));
+
+      // include the executable mappings so pcs can be symbolized offline
+      FILE *maps = fopen("/proc/self/maps", "r");
+      if(maps) {
+	char line[4096];
+	while(fgets(line, sizeof(line), maps)) {
+	  // fields are: range perms offset dev inode path
+	  char perms[8];
+	  if((sscanf(line, "%*s %7s", perms) == 1) && (perms[2] == 'x'))
+	    fprintf(f, "map %s", line);
+	}
+	fclose(maps);
+      }
+
+      size_t total_samples = 0;
+      size_t total_dropped = 0;
+      for(std::vector<ThreadSamples *>::const_iterator it = threads.begin();
+	  it != threads.end();
+	  ++it) {
+	(*it)->write_samples(f);
+	total_samples += (*it)->num_samples;
+	total_dropped += (*it)->dropped;
+      }
+      fclose(f);
+
+      log_stacks.info() << "wrote " << total_samples << " stack samples from "
+			<< threads.size() << " threads to '" << logfile << "'";
+      if(total_dropped > 0)
+	log_stacks.warning() << total_dropped << " stack samples were dropped - increase -stacks:buffer";
+    }
+
+    void StackSamplerModule::cleanup(void)
+    {
+      // all of our threads are finished by now
+      Thread::set_observer(0);
+
+      write_samples();
+
+      for(std::vector<ThreadSamples *>::iterator it = threads.begin();
+	  it != threads.end();
+	  ++it)
+	delete *it;
+      threads.clear();
+
+      Module::cleanup();
+    }
+
+  }; // namespace StackSampler
+
+}; // namespace Realm
@@ -0,0 +1,106 @@
+/* Copyright 2018 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// sampling stack profiler for Realm's internal threads
+
+#ifndef REALM_STACKSAMPLER_MODULE_H
+#define REALM_STACKSAMPLER_MODULE_H
+
+#include "realm/module.h"
+#include "realm/threads.h"
+#include "realm/activemsg.h"
+
+#include <vector>
+#include <string>
+#include <stdio.h>
+#include <stdint.h>
+
+namespace Realm {
+
+  namespace StackSampler {
+
+    // samples for a single thread are appended to a fixed-size buffer by the
+    //  thread's own signal handler, so no locks are needed - the buffer is
+    //  only read once the thread has finished
+    class ThreadSamples {
+    public:
+      ThreadSamples(const std::string& _rsrv_name, const std::string& _class_name,
+		    size_t _buffer_size, int _max_depth);
+      ~ThreadSamples(void);
+
+      // called from the signal handler
+      void record_sample(void);
+
+      void write_samples(FILE *f) const;
+
+      std::string rsrv_name;
+      std::string class_name;
+      long thread_id;
+      int max_depth;
+      // each sample is a timestamp, a depth, and then 'depth' pcs
+      intptr_t *buffer;
+      size_t buffer_size, used;
+      size_t num_samples, dropped;
+    };
+
+    // our interface to the rest of the runtime
+    class StackSamplerModule : public Module, public Thread::Observer {
+    protected:
+      StackSamplerModule(void);
+
+    public:
+      virtual ~StackSamplerModule(void);
+
+      static Module *create_module(RuntimeImpl *runtime, std::vector<std::string>& cmdline);
+
+      // do any general initialization - this is called after all configuration is
+      //  complete
+      virtual void initialize(RuntimeImpl *runtime);
+
+      // clean up any common resources created by the module - this will be called
+      //  after all memories/processors/etc. have been shut down and destroyed
+      virtual void cleanup(void);
+
+      // Thread::Observer methods
+      virtual void thread_started(Thread *thread, const std::string& rsrv_name);
+      virtual void thread_finished(Thread *thread);
+
+    protected:
+      bool parse_classes(const std::string& s);
+      // returns the name of the class of the reservation if it should be
+      //  sampled, or 0 if not
+      const char *match_class(const std::string& rsrv_name) const;
+      void write_samples(void);
+
+    public:
+      std::vector<std::string> cfg_classes;
+      int cfg_interval_us;
+      int cfg_max_depth;
+      size_t cfg_buffer_size_in_mb;
+      bool cfg_wall_clock;
+      std::string cfg_logfile;
+
+    protected:
+      GASNetHSL mutex;
+      std::vector<ThreadSamples *> threads;
+    };
+
+    REGISTER_REALM_MODULE(StackSamplerModule);
+
+  }; // namespace StackSampler
+
+}; // namespace Realm
+
+#endif
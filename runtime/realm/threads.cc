@@ -72,6 +72,13 @@ inline void makecontext_wrap(ucontext_t *u, void (*fn)(), int args, ...) { makec
 #endif
 #endif
 
+#ifdef REALM_USE_PERF_EVENTS
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
 #ifndef CHECK_LIBC
 #define CHECK_LIBC(cmd) do { \
   errno = 0; \
@@ -104,6 +111,15 @@ namespace Realm {
   };
 #endif
 
+#ifdef REALM_USE_PERF_EVENTS
+  Logger log_perfev("perfevents");
+  namespace PerfEvents {
+    // set once we find out the kernel won't give us any counters at all so
+    //  we stop asking on every task
+    bool perf_events_unavailable = false;
+  };
+#endif
+
   namespace ThreadLocal {
     /*extern*/ __thread Thread *current_thread = 0;
   };
@@ -182,6 +198,8 @@ namespace Realm {
 
   void CoreReservationSet::add_reservation(CoreReservation& rsrv)
   {
+    // modules may be initialized in parallel, each making reservations
+    AutoHSLLock al(mutex);
     assert(allocations.count(&rsrv) == 0);
     allocations[&rsrv] = 0;
   }
@@ -535,6 +553,7 @@ namespace Realm {
   // class Thread
 
   static bool handler_registered = false;
+  static Thread::Observer *thread_observer = 0;
   // Valgrind uses SIGUSR2 on Darwin
   static int handler_signal = SIGUSR1;
 
@@ -668,6 +687,7 @@ namespace Realm {
     void (*entry_wrapper)(void *);
     pthread_t thread;
     bool ok_to_delete;
+    std::string rsrv_name;
   };
 
   KernelThread::KernelThread(void *_target, void (*_entry_wrapper)(void *),
@@ -695,10 +715,16 @@ namespace Realm {
 
     if(thread->scheduler)
       thread->scheduler->thread_starting(thread);
+
+    if(thread_observer)
+      thread_observer->thread_started(thread, thread->rsrv_name);
     
     // call the actual thread body
     (*thread->entry_wrapper)(thread->target);
 
+    if(thread_observer)
+      thread_observer->thread_finished(thread);
+
     // on return, we update our status and terminate
     log_thread.info() << "thread " << thread << " finished";
     thread->update_state(STATE_FINISHED);
@@ -763,6 +789,9 @@ namespace Realm {
 
     update_state(STATE_STARTUP);
 
+    // remember who we belong to in case anybody is observing threads
+    rsrv_name = rsrv.name;
+
     // time to actually create the thread
     CHECK_PTHREAD( pthread_create(&thread, &attr, pthread_entry, this) );
 
@@ -1157,6 +1186,12 @@ namespace Realm {
     return t;
   }
 
+  /*static*/ void Thread::set_observer(Observer *observer)
+  {
+    assert((thread_observer == 0) || (observer == 0));
+    thread_observer = observer;
+  }
+
   /*static*/ void Thread::yield(void)
   {
 #ifdef __MACH__
@@ -1871,6 +1906,254 @@ namespace Realm {
 #endif
 
 
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class PerfEventCounters
+
+#ifdef REALM_USE_PERF_EVENTS
+  // shorthand for the generic cache events
+  static inline unsigned long long perf_cache_event(unsigned long long cache,
+						    unsigned long long op,
+						    unsigned long long result)
+  {
+    return (cache | (op << 8) | (result << 16));
+  }
+
+#define PERF_HW(cfg) PERF_TYPE_HARDWARE, PERF_COUNT_HW_##cfg
+#define PERF_CACHE(cache, op, result) \
+  PERF_TYPE_HW_CACHE, perf_cache_event(PERF_COUNT_HW_CACHE_##cache, \
+				       PERF_COUNT_HW_CACHE_OP_##op, \
+				       PERF_COUNT_HW_CACHE_RESULT_##result)
+
+  PerfEventCounters::PerfEventCounters(void)
+  {}
+
+  PerfEventCounters::~PerfEventCounters(void)
+  {
+    for(std::vector<int>::const_iterator it = event_fds.begin();
+	it != event_fds.end();
+	++it)
+      close(*it);
+  }
+
+  bool PerfEventCounters::add_event(unsigned type, unsigned long long config)
+  {
+    unsigned long long key = ((unsigned long long)type << 32) | config;
+    // event might already have been added?
+    if(event_codes.count(key) > 0)
+      return true;
+
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    // only count the task's own (user-level) work - this also keeps us
+    //  within what an unprivileged process is normally allowed to do
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // if the kernel has to multiplex the counters, the times let us scale
+    //  the counts back up
+    attr.read_format = (PERF_FORMAT_TOTAL_TIME_ENABLED |
+			PERF_FORMAT_TOTAL_TIME_RUNNING);
+
+    // pid == 0 and cpu == -1 means the calling thread on any cpu
+    int fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    if(fd < 0) {
+      log_perfev.debug() << "event " << type << ":" << std::hex << config << std::dec
+			 << " not available - skipping (" << strerror(errno) << ")";
+      return false;
+    }
+
+    event_codes[key] = event_fds.size();
+    event_fds.push_back(fd);
+    return true;
+  }
+
+  /*static*/ PerfEventCounters *PerfEventCounters::setup_counters(const ProfilingMeasurementCollection& pmc)
+  {
+    if(PerfEvents::perf_events_unavailable)
+      return 0;
+
+    bool wants_ipc = pmc.wants_measurement<ProfilingMeasurements::IPCPerfCounters>();
+    bool wants_l1i = pmc.wants_measurement<ProfilingMeasurements::L1ICachePerfCounters>();
+    bool wants_l1d = pmc.wants_measurement<ProfilingMeasurements::L1DCachePerfCounters>();
+    bool wants_l3 = pmc.wants_measurement<ProfilingMeasurements::L3CachePerfCounters>();
+    bool wants_tlb = pmc.wants_measurement<ProfilingMeasurements::TLBPerfCounters>();
+    bool wants_br = pmc.wants_measurement<ProfilingMeasurements::BranchPredictionPerfCounters>();
+
+    // the kernel has no generic events for floating point instructions,
+    //  taken branches, or the L2 cache, so those are always reported as
+    //  missing - loads and stores are counted as L1D read/write accesses
+
+    // exit early if none present
+    if(!(wants_ipc || wants_l1i || wants_l1d || wants_l3 || wants_tlb || wants_br))
+      return 0;
+
+    PerfEventCounters *ctrs = new PerfEventCounters;
+
+    if(wants_ipc) {
+      ctrs->add_event(PERF_HW(INSTRUCTIONS));
+      ctrs->add_event(PERF_HW(CPU_CYCLES));
+      ctrs->add_event(PERF_CACHE(L1D, READ, ACCESS));
+      ctrs->add_event(PERF_CACHE(L1D, WRITE, ACCESS));
+      ctrs->add_event(PERF_HW(BRANCH_INSTRUCTIONS));
+    }
+    if(wants_l1i) {
+      ctrs->add_event(PERF_CACHE(L1I, READ, ACCESS));
+      ctrs->add_event(PERF_CACHE(L1I, READ, MISS));
+    }
+    if(wants_l1d) {
+      ctrs->add_event(PERF_CACHE(L1D, READ, ACCESS));
+      ctrs->add_event(PERF_CACHE(L1D, READ, MISS));
+    }
+    if(wants_l3) {
+      ctrs->add_event(PERF_HW(CACHE_REFERENCES));
+      ctrs->add_event(PERF_HW(CACHE_MISSES));
+    }
+    if(wants_tlb) {
+      ctrs->add_event(PERF_CACHE(ITLB, READ, MISS));
+      ctrs->add_event(PERF_CACHE(DTLB, READ, MISS));
+    }
+    if(wants_br) {
+      ctrs->add_event(PERF_HW(BRANCH_INSTRUCTIONS));
+      ctrs->add_event(PERF_HW(BRANCH_MISSES));
+    }
+
+    if(ctrs->event_fds.empty()) {
+      // most likely perf_event_paranoid or a virtual machine without a
+      //  PMU - say so once and then stop trying
+      log_perfev.warning() << "no hardware performance counters available - counter measurements will not be reported";
+      PerfEvents::perf_events_unavailable = true;
+      delete ctrs;
+      return 0;
+    }
+
+    return ctrs;
+  }
+
+  void PerfEventCounters::cleanup(void)
+  {
+    delete this;
+  }
+
+  void PerfEventCounters::start(void)
+  {
+    // the counters are freshly opened for each task, so there's nothing
+    //  to reset
+    for(std::vector<int>::const_iterator it = event_fds.begin();
+	it != event_fds.end();
+	++it)
+      ioctl(*it, PERF_EVENT_IOC_ENABLE, 0);
+  }
+
+  void PerfEventCounters::stop(void)
+  {
+    for(std::vector<int>::const_iterator it = event_fds.begin();
+	it != event_fds.end();
+	++it)
+      ioctl(*it, PERF_EVENT_IOC_DISABLE, 0);
+  }
+
+  void PerfEventCounters::resume(void)
+  {
+    // same as start - counts accumulate while disabled
+    start();
+  }
+
+  void PerfEventCounters::suspend(void)
+  {
+    // same as stop
+    stop();
+  }
+
+  // returns the counter's value, or -1 if not present
+  long long PerfEventCounters::get_counter_val(unsigned type,
+					       unsigned long long config,
+					       int& found_count) const
+  {
+    unsigned long long key = ((unsigned long long)type << 32) | config;
+    std::map<unsigned long long, size_t>::const_iterator it = event_codes.find(key);
+    if(it == event_codes.end())
+      return -1;
+
+    // value, time enabled, time running
+    unsigned long long vals[3];
+    ssize_t amt = read(event_fds[it->second], vals, sizeof(vals));
+    if(amt != sizeof(vals))
+      return -1;
+
+    found_count++;
+    if((vals[2] == 0) || (vals[2] >= vals[1]))
+      return vals[0];
+    // counter was multiplexed with others - scale up the count
+    return (long long)((double)vals[0] * vals[1] / vals[2]);
+  }
+
+  void PerfEventCounters::record(ProfilingMeasurementCollection& pmc)
+  {
+    if(pmc.wants_measurement<ProfilingMeasurements::IPCPerfCounters>()) {
+      ProfilingMeasurements::IPCPerfCounters ctrs;
+      int found_count = 0;
+      ctrs.total_insts  = get_counter_val(PERF_HW(INSTRUCTIONS), found_count);
+      ctrs.total_cycles = get_counter_val(PERF_HW(CPU_CYCLES), found_count);
+      ctrs.fp_insts     = -1;
+      ctrs.ld_insts     = get_counter_val(PERF_CACHE(L1D, READ, ACCESS), found_count);
+      ctrs.st_insts     = get_counter_val(PERF_CACHE(L1D, WRITE, ACCESS), found_count);
+      ctrs.br_insts     = get_counter_val(PERF_HW(BRANCH_INSTRUCTIONS), found_count);
+      if(found_count > 0)
+	pmc.add_measurement(ctrs);
+    }
+    if(pmc.wants_measurement<ProfilingMeasurements::L1ICachePerfCounters>()) {
+      ProfilingMeasurements::L1ICachePerfCounters ctrs;
+      int found_count = 0;
+      ctrs.accesses = get_counter_val(PERF_CACHE(L1I, READ, ACCESS), found_count);
+      ctrs.misses   = get_counter_val(PERF_CACHE(L1I, READ, MISS), found_count);
+      if(found_count > 0)
+	pmc.add_measurement(ctrs);
+    }
+    if(pmc.wants_measurement<ProfilingMeasurements::L1DCachePerfCounters>()) {
+      ProfilingMeasurements::L1DCachePerfCounters ctrs;
+      int found_count = 0;
+      ctrs.accesses = get_counter_val(PERF_CACHE(L1D, READ, ACCESS), found_count);
+      ctrs.misses   = get_counter_val(PERF_CACHE(L1D, READ, MISS), found_count);
+      if(found_count > 0)
+	pmc.add_measurement(ctrs);
+    }
+    // the generic cache references/misses events count the last level cache
+    if(pmc.wants_measurement<ProfilingMeasurements::L3CachePerfCounters>()) {
+      ProfilingMeasurements::L3CachePerfCounters ctrs;
+      int found_count = 0;
+      ctrs.accesses = get_counter_val(PERF_HW(CACHE_REFERENCES), found_count);
+      ctrs.misses   = get_counter_val(PERF_HW(CACHE_MISSES), found_count);
+      if(found_count > 0)
+	pmc.add_measurement(ctrs);
+    }
+    if(pmc.wants_measurement<ProfilingMeasurements::TLBPerfCounters>()) {
+      ProfilingMeasurements::TLBPerfCounters ctrs;
+      int found_count = 0;
+      ctrs.inst_misses = get_counter_val(PERF_CACHE(ITLB, READ, MISS), found_count);
+      ctrs.data_misses = get_counter_val(PERF_CACHE(DTLB, READ, MISS), found_count);
+      if(found_count > 0)
+	pmc.add_measurement(ctrs);
+    }
+    if(pmc.wants_measurement<ProfilingMeasurements::BranchPredictionPerfCounters>()) {
+      ProfilingMeasurements::BranchPredictionPerfCounters ctrs;
+      int found_count = 0;
+      ctrs.total_branches = get_counter_val(PERF_HW(BRANCH_INSTRUCTIONS), found_count);
+      ctrs.taken_branches = -1;
+      ctrs.mispredictions = get_counter_val(PERF_HW(BRANCH_MISSES), found_count);
+      if(found_count > 0)
+	pmc.add_measurement(ctrs);
+    }
+  }
+
+#undef PERF_HW
+#undef PERF_CACHE
+#endif
+
+
   ////////////////////////////////////////////////////////////////////////
   //
   // initialize/cleanup
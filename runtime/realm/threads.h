@@ -31,6 +31,7 @@
 
 #include <string>
 #include <list>
+#include <vector>
 #include <set>
 #include <map>
 #include <deque>
@@ -43,6 +44,12 @@
 #include <papi.h>
 #endif
 
+// without PAPI, Linux builds can still collect the hardware performance
+//  counter measurements through the kernel's perf_event interface
+#if defined(__linux__) && !defined(REALM_USE_PAPI) && !defined(REALM_NO_PERF_EVENTS)
+#define REALM_USE_PERF_EVENTS
+#endif
+
 namespace Realm {
 
   namespace Threading {
@@ -77,6 +84,9 @@ namespace Realm {
 #ifdef REALM_USE_PAPI
   class PAPICounters;
 #endif
+#ifdef REALM_USE_PERF_EVENTS
+  class PerfEventCounters;
+#endif
 
   //template <class CONDTYPE> class ThreadWaker;
 
@@ -199,6 +209,20 @@ namespace Realm {
     void stop_perf_counters(void);
     void record_perf_counters(ProfilingMeasurementCollection& pmc);
 
+    // tools (e.g. the stack sampler) can observe every kernel thread as it
+    //  starts and finishes - the callbacks are made on the thread itself and
+    //  are given the name of the core reservation the thread was created with
+    class Observer {
+    public:
+      virtual ~Observer(void) {}
+      virtual void thread_started(Thread *thread, const std::string& rsrv_name) = 0;
+      virtual void thread_finished(Thread *thread) = 0;
+    };
+
+    // only one observer is supported, and it must be set before any threads
+    //  are created
+    static void set_observer(Observer *observer);
+
   protected:
     friend class ThreadScheduler;
 
@@ -225,6 +249,9 @@ namespace Realm {
 
 #ifdef REALM_USE_PAPI
     PAPICounters *papi_counters;
+#endif
+#ifdef REALM_USE_PERF_EVENTS
+    PerfEventCounters *perf_counters;
 #endif
   };
 
@@ -440,6 +467,7 @@ namespace Realm {
   protected:
     bool owns_coremap;
     const CoreMap *cm;
+    GASNetHSL mutex;  // protects additions to 'allocations'
     std::map<CoreReservation *, CoreReservation::Allocation *> allocations;
   };
 
@@ -551,6 +579,38 @@ namespace Realm {
   };
 #endif
 
+#ifdef REALM_USE_PERF_EVENTS
+  // counts the same events as PAPICounters using perf_event_open - the
+  //  counters are attached to the calling kernel thread, so setup_counters
+  //  must be called by the thread that will run the task (as with PAPI, a
+  //  user thread that moves to a different kernel thread won't be counted
+  //  accurately)
+  class PerfEventCounters {
+  protected:
+    PerfEventCounters(void);
+    ~PerfEventCounters(void);
+
+  public:
+    static PerfEventCounters *setup_counters(const ProfilingMeasurementCollection& pmc);
+    void cleanup(void);
+
+    void start(void);
+    void suspend(void);
+    void resume(void);
+    void stop(void);
+    void record(ProfilingMeasurementCollection& pmc);
+
+  protected:
+    bool add_event(unsigned type, unsigned long long config);
+    long long get_counter_val(unsigned type, unsigned long long config,
+			      int& found_count) const;
+
+    // events are keyed by (type << 32 | config)
+    std::map<unsigned long long, size_t> event_codes;
+    std::vector<int> event_fds;
+  };
+#endif
+
   // move this somewhere else
 
   class DummyLock {
@@ -17,6 +17,7 @@
 #include "realm/transfer/channel.h"
 #include "realm/transfer/channel_disk.h"
 #include "realm/transfer/transfer.h"
+#include "realm/shm_transport.h"
 
 TYPE_IS_SERIALIZABLE(Realm::XferOrder::Type);
 TYPE_IS_SERIALIZABLE(Realm::XferDes::XferKind);
@@ -30,6 +31,9 @@ namespace Realm {
       // TODO: currently we use dma_all_gpus to track the set of GPU* created
 #ifdef USE_CUDA
       std::vector<Cuda::GPU*> dma_all_gpus;
+#endif
+#ifdef USE_HDF
+      static int hdf5_io_threads = 0;
 #endif
       // we use a single queue for all xferDes
       static XferDesQueue *xferDes_queue = 0;
@@ -318,7 +322,8 @@ namespace Realm {
                || (kind == XferDes::XFER_GPU_IN_FB)
                || (kind == XferDes::XFER_GPU_PEER_FB)
                || (kind == XferDes::XFER_REMOTE_WRITE)
-               || (kind == XferDes::XFER_MEM_CPY);
+               || (kind == XferDes::XFER_MEM_CPY)
+               || (kind == XferDes::XFER_SHM_MEMCPY);
       }
       void print_request_info(Request* req)
       {
@@ -1510,6 +1515,76 @@ namespace Realm {
 	seq_write.add_span(offset, size);
       }
 
+      ShmMemcpyXferDes::ShmMemcpyXferDes(DmaRequest* _dma_request,
+					 NodeID _launch_node,
+					 XferDesID _guid,
+					 XferDesID _pre_xd_guid,
+					 XferDesID _next_xd_guid,
+					 uint64_t _next_max_rw_gap,
+					 size_t src_ib_offset,
+					 size_t src_ib_size,
+					 bool mark_started,
+					 Memory _src_mem, Memory _dst_mem,
+					 TransferIterator *_src_iter, TransferIterator *_dst_iter,
+					 CustomSerdezID _src_serdez_id, CustomSerdezID _dst_serdez_id,
+					 uint64_t _max_req_size,
+					 long max_nr,
+					 int _priority,
+					 XferOrder::Type _order,
+					 XferDesFence* _complete_fence)
+        : XferDes(_dma_request, _launch_node, _guid, _pre_xd_guid,
+                  _next_xd_guid, _next_max_rw_gap, src_ib_offset, src_ib_size,
+		  mark_started,
+		  _src_mem, _dst_mem, _src_iter, _dst_iter,
+		  _src_serdez_id, _dst_serdez_id,
+		  _max_req_size, _priority, _order,
+                  XferDes::XFER_SHM_MEMCPY, _complete_fence)
+      {
+	// no serdez support
+	assert((_src_serdez_id == 0) && (_dst_serdez_id == 0));
+        channel = channel_manager->get_shm_memcpy_channel();
+        // as with remote writes, get_direct_ptr can't be used on the
+        //  destination, but its storage is mapped here
+        dst_buf_base = (char *)(get_shm_transport()->get_shared_memory(_dst_mem.id));
+        assert(dst_buf_base != 0);
+        memcpy_reqs = (MemcpyRequest*) calloc(max_nr, sizeof(MemcpyRequest));
+        for (int i = 0; i < max_nr; i++) {
+          memcpy_reqs[i].xd = this;
+          enqueue_request(&memcpy_reqs[i]);
+        }
+      }
+
+      long ShmMemcpyXferDes::get_requests(Request** requests, long nr)
+      {
+        MemcpyRequest** reqs = (MemcpyRequest**) requests;
+	// allow 2D and 3D copies
+	unsigned flags = (TransferIterator::LINES_OK |
+			  TransferIterator::PLANES_OK);
+        long new_nr = default_get_requests(requests, nr, flags);
+        for (long i = 0; i < new_nr; i++)
+        {
+	  reqs[i]->src_base = src_mem->get_direct_ptr(reqs[i]->src_off,
+						      reqs[i]->nbytes);
+	  assert(reqs[i]->src_base != 0);
+          reqs[i]->dst_base = dst_buf_base + reqs[i]->dst_off;
+        }
+        return new_nr;
+      }
+
+      void ShmMemcpyXferDes::notify_request_read_done(Request* req)
+      {
+        default_notify_request_read_done(req);
+      }
+
+      void ShmMemcpyXferDes::notify_request_write_done(Request* req)
+      {
+        default_notify_request_write_done(req);
+      }
+
+      void ShmMemcpyXferDes::flush()
+      {
+      }
+
 #ifdef USE_CUDA
       GPUXferDes::GPUXferDes(DmaRequest* _dma_request,
 			     NodeID _launch_node,
@@ -1684,6 +1759,10 @@ namespace Realm {
 		  _src_serdez_id, _dst_serdez_id,
 		  _max_req_size, _priority,
                   _order, _kind, _complete_fence)
+	, hdf_inst(inst)
+	, io_bytes(0)
+	, io_time(0)
+	, io_requests(0)
       {
 #ifdef USE_HDF_OLD
         HDF5Memory* hdf_mem;
@@ -1823,6 +1902,33 @@ namespace Realm {
             // not enough space for even a single element - try again later
             break;
           }
+
+	  // file and dataset handles come from the memory's cache, so they
+	  //  stay open across requests and transfers
+	  HDF5::HDF5Memory *hdf5mem = (HDF5::HDF5Memory *)((kind == XferDes::XFER_HDF_READ) ?
+							     src_mem :
+							     dst_mem);
+	  HDF5::HDF5Memory::OpenDataset *dset = hdf5mem->acquire_dataset(hdf_inst,
+									 *hdf5_info.filename,
+									 *hdf5_info.dsetname,
+									 (kind == XferDes::XFER_HDF_WRITE));
+
+	  // for a chunked dataset, don't let a request run past the chunk
+	  //  boundary in the outermost dimension - each request then touches
+	  //  a single row of chunks, and requests for different chunks can
+	  //  be performed by different I/O threads
+	  if(!dset->chunk_dims.empty() && (hdf5_info.extent[0] > 1)) {
+	    hsize_t chunk_rows = dset->chunk_dims[0];
+	    hsize_t rows_left = chunk_rows - (hdf5_info.offset[0] % chunk_rows);
+	    if(hdf5_info.extent[0] > rows_left) {
+	      size_t row_bytes = hdf5_bytes / hdf5_info.extent[0];
+	      hdf5_iter->cancel_step();
+	      hdf5_bytes = hdf5_iter->step(rows_left * row_bytes, hdf5_info,
+					   true /*tentative*/);
+	      assert(hdf5_bytes == rows_left * row_bytes);
+	    }
+	  }
+
 	  // TODO: support 2D/3D for memory side of an HDF transfer?
 	  size_t mem_bytes = mem_iter->step(hdf5_bytes, mem_info, 0);
 	  if(mem_bytes == hdf5_bytes) {
@@ -1856,42 +1962,11 @@ namespace Realm {
 	  CHECK_HDF5( new_req->file_space_id = H5Screate_simple(hdf5_info.dset_bounds.size(), hdf5_info.dset_bounds.data(), 0) );
 	  CHECK_HDF5( H5Sselect_hyperslab(new_req->file_space_id, H5S_SELECT_SET, hdf5_info.offset.data(), 0, hdf5_info.extent.data(), 0) );
 #else
-	  HDFFileInfo *info;
-	  {
-	    std::map<std::string, HDFFileInfo *>::const_iterator it = file_infos.find(*hdf5_info.filename);
-	    if(it != file_infos.end()) {
-	      info = it->second;
-	    } else {
-	      info = new HDFFileInfo;
-	      // have to open the file
-	      CHECK_HDF5( info->file_id = H5Fopen(hdf5_info.filename->c_str(),
-						  ((kind == XferDes::XFER_HDF_READ) ?
-					             H5F_ACC_RDONLY :
-					             H5F_ACC_RDWR),
-						  H5P_DEFAULT) );
-	      log_hdf5.info() << "H5Fopen(\"" << *hdf5_info.filename << "\") = " << info->file_id;
-	      file_infos[*hdf5_info.filename] = info;
-	    }
-	  }
-	  hid_t dset_id;
-	  {
-	    std::map<std::string, hid_t>::const_iterator it = info->dset_ids.find(*hdf5_info.dsetname);
-	    if(it != info->dset_ids.end()) {
-	      dset_id = it->second;
-	    } else {
-	      // have to open the dataset
-	      CHECK_HDF5( dset_id = H5Dopen2(info->file_id,
-					     hdf5_info.dsetname->c_str(),
-					     H5P_DEFAULT) );
-	      log_hdf5.info() << "H5Dopen2(" << info->file_id << ", \"" << *hdf5_info.dsetname << "\") = " << dset_id;
-	      info->dset_ids[*hdf5_info.dsetname] = dset_id;
-	    }
-	  }
-	  hid_t dtype_id;
-	  CHECK_HDF5( dtype_id = H5Dget_type(dset_id) );
-
-	  new_req->dataset_id = dset_id;
-	  new_req->datatype_id = dtype_id;
+	  new_req->dset = dset;
+	  new_req->dataset_id = dset->dset_id;
+	  new_req->datatype_id = dset->dtype_id;
+	  if(kind == XferDes::XFER_HDF_WRITE)
+	    written_files.insert(dset->file->file_id);
 
 	  std::vector<hsize_t> mem_dims = hdf5_info.extent;
 	  CHECK_HDF5( new_req->mem_space_id = H5Screate_simple(mem_dims.size(), mem_dims.data(), NULL) );
@@ -1903,6 +1978,7 @@ namespace Realm {
 #endif
 
 	  new_req->nbytes = hdf5_bytes;
+	  new_req->io_time = 0;
 
 	  new_req->read_seq_pos = read_bytes_total;
 	  new_req->read_seq_count = hdf5_bytes;
@@ -2035,16 +2111,42 @@ namespace Realm {
         CHECK_HDF5( H5Sclose(hdf_req->mem_space_id) );
         CHECK_HDF5( H5Sclose(hdf_req->file_space_id) );
         //pthread_rwlock_unlock(&hdf_metadata->hdf_memory->rwlock);
+	((HDF5::HDF5Memory *)((kind == XferDes::XFER_HDF_READ) ?
+			        src_mem :
+			        dst_mem))->release_dataset(hdf_req->dset);
+
+	io_bytes += hdf_req->nbytes;
+	io_time += hdf_req->io_time;
+	io_requests++;
 
 	default_notify_request_write_done(req);
       }
 
       void HDFXferDes::flush()
       {
+	if(io_requests > 0) {
+	  Memory hdf5_mem = ((kind == XferDes::XFER_HDF_READ) ?
+			       src_mem :
+			       dst_mem)->me;
+	  log_hdf5.info() << "xd " << std::hex << guid << std::dec
+			  << ": " << io_bytes << " bytes in " << io_requests
+			  << " requests, " << io_time << " ns of I/O ("
+			  << (io_time ? (1e3 * io_bytes / io_time) : 0.0) << " MB/s)";
+	  // the dma request only lives on the launching node
+	  if(launch_node == my_node_id)
+	    dma_request->add_io_usage(hdf5_mem, io_bytes, io_time, io_requests);
+	}
+
         if (kind == XferDes::XFER_HDF_READ) {
         } else {
           assert(kind == XferDes::XFER_HDF_WRITE);
-	  //CHECK_HDF5( H5Fflush(hdf_metadata->file_id, H5F_SCOPE_LOCAL) );
+	  // cached files stay open after the transfer, so make sure what we
+	  //  wrote reaches the file
+	  for(std::set<hid_t>::const_iterator it = written_files.begin();
+	      it != written_files.end();
+	      ++it)
+	    CHECK_HDF5( H5Fflush(*it, H5F_SCOPE_LOCAL) );
+	  written_files.clear();
           // for (fit = oas_vec.begin(); fit != oas_vec.end(); fit++) {
           //   off_t hdf_idx = fit->dst_offset;
           //   hid_t dataset_id = hdf_metadata->dataset_ids[hdf_idx];
@@ -2052,20 +2154,6 @@ namespace Realm {
           //   H5Fflush(dataset_id, H5F_SCOPE_LOCAL);
           // }
         }
-
-	for(std::map<std::string, HDFFileInfo *>::const_iterator it = file_infos.begin();
-	    it != file_infos.end();
-	    ++it) {
-	  for(std::map<std::string, hid_t>::const_iterator it2 = it->second->dset_ids.begin();
-	      it2 != it->second->dset_ids.end();
-	      ++it2) {
-	    log_hdf5.info() << "H5Dclose(" << it2->second << " /* \"" << it2->first << "\" */)";
-	    CHECK_HDF5( H5Dclose(it2->second) );
-	  }
-	  log_hdf5.info() << "H5Fclose(" << it->second->file_id << " /* \"" << it->first << "\" */)";
-	  CHECK_HDF5( H5Fclose(it->second->file_id) );
-	  delete it->second;
-	}
       }
 #endif
 
@@ -2288,8 +2376,9 @@ namespace Realm {
                                                     Memory::SOCKET_MEM };
       static const size_t num_cpu_mem_kinds = sizeof(cpu_mem_kinds) / sizeof(cpu_mem_kinds[0]);
 
-      MemcpyChannel::MemcpyChannel(long max_nr)
-	: Channel(XferDes::XFER_MEM_CPY)
+      MemcpyChannel::MemcpyChannel(long max_nr,
+				   XferDes::XferKind _kind /*= XFER_MEM_CPY*/)
+	: Channel(_kind)
       {
         capacity = max_nr;
         is_stopped = false;
@@ -2298,6 +2387,8 @@ namespace Realm {
         pthread_mutex_init(&finished_lock, NULL);
         pthread_cond_init(&pending_cond, NULL);
         //cbs = (MemcpyRequest**) calloc(max_nr, sizeof(MemcpyRequest*));
+	if(_kind != XferDes::XFER_MEM_CPY)
+	  return;
 	unsigned bw = 0; // TODO
 	unsigned latency = 0;
 	// any combination of SYSTEM/REGDMA/Z_COPY/SOCKET_MEM
@@ -2851,6 +2942,35 @@ namespace Realm {
         return capacity;
       }
 
+      ShmMemcpyChannel::ShmMemcpyChannel(long max_nr)
+	: MemcpyChannel(max_nr, XferDes::XFER_SHM_MEMCPY)
+      {
+	// the set of shared memories of co-located processes is fixed by now,
+	//  so the paths can name them specifically
+	std::vector<uint64_t> shared_ids;
+	get_shm_transport()->get_shared_memory_ids(shared_ids);
+
+	std::vector<MemoryImpl *> local_mems(get_runtime()->nodes[my_node_id].memories);
+	local_mems.insert(local_mems.end(),
+			  get_runtime()->nodes[my_node_id].ib_memories.begin(),
+			  get_runtime()->nodes[my_node_id].ib_memories.end());
+
+	unsigned bw = 0; // TODO
+	unsigned latency = 0;
+	for(std::vector<MemoryImpl *>::const_iterator it = local_mems.begin();
+	    it != local_mems.end();
+	    ++it) {
+	  bool cpu_mem = false;
+	  for(size_t i = 0; i < num_cpu_mem_kinds; i++)
+	    if((*it)->lowlevel_kind == cpu_mem_kinds[i])
+	      cpu_mem = true;
+	  if(!cpu_mem) continue;
+	  for(size_t i = 0; i < shared_ids.size(); i++)
+	    add_path((*it)->me, ID((ID::IDType)shared_ids[i]).convert<Memory>(),
+		     bw, latency, false, false);
+	}
+      }
+
       GASNetChannel::GASNetChannel(long max_nr, XferDes::XferKind _kind)
 	: Channel(_kind)
       {
@@ -3155,6 +3275,9 @@ namespace Realm {
 #ifdef USE_HDF
       HDFChannel::HDFChannel(long max_nr, XferDes::XferKind _kind)
 	: Channel(_kind)
+	, io_condvar(io_mutex)
+	, in_flight(0)
+	, io_shutdown(false)
       {
         capacity = max_nr;
 
@@ -3172,35 +3295,131 @@ namespace Realm {
 		     bw, latency, false, false);
       }
 
-      HDFChannel::~HDFChannel() {}
+      HDFChannel::~HDFChannel()
+      {
+	assert(io_threads.empty());
+      }
+
+      void HDFChannel::start_io_threads(int count, CoreReservation& rsrv)
+      {
+	ThreadLaunchParameters tlp;
+	for(int i = 0; i < count; i++) {
+	  Thread *t = Thread::create_kernel_thread<HDFChannel,
+						   &HDFChannel::io_thread_loop>(this,
+										tlp,
+										rsrv,
+										0 /*default scheduler*/);
+	  io_threads.push_back(t);
+	}
+      }
+
+      void HDFChannel::stop_io_threads(void)
+      {
+	{
+	  AutoHSLLock al(io_mutex);
+	  io_shutdown = true;
+	  io_condvar.broadcast();
+	}
+	for(std::vector<Thread *>::iterator it = io_threads.begin();
+	    it != io_threads.end();
+	    ++it) {
+	  (*it)->join();
+	  delete (*it);
+	}
+	io_threads.clear();
+	assert(pending_reqs.empty() && completed_reqs.empty());
+      }
+
+      void HDFChannel::perform_request(HDFRequest *req)
+      {
+	long long t_start = Clock::current_time_in_nanoseconds();
+	if (kind == XferDes::XFER_HDF_READ)
+	  CHECK_HDF5( H5Dread(req->dataset_id, req->datatype_id,
+			      req->mem_space_id, req->file_space_id,
+			      H5P_DEFAULT, req->mem_base) );
+	else
+	  CHECK_HDF5( H5Dwrite(req->dataset_id, req->datatype_id,
+			       req->mem_space_id, req->file_space_id,
+			       H5P_DEFAULT, req->mem_base) );
+	req->io_time = Clock::current_time_in_nanoseconds() - t_start;
+      }
 
       long HDFChannel::submit(Request** requests, long nr)
       {
         HDFRequest** hdf_reqs = (HDFRequest**) requests;
+	if(!io_threads.empty()) {
+	  // hand the requests to the I/O threads - completions are noticed
+	  //  by pull()
+	  AutoHSLLock al(io_mutex);
+	  for (long i = 0; i < nr; i++) {
+	    assert(!hdf_reqs[i]->xd->src_serdez_op && !hdf_reqs[i]->xd->dst_serdez_op); // no serdez support
+	    pending_reqs.push_back(hdf_reqs[i]);
+	  }
+	  in_flight += nr;
+	  if(nr > 0)
+	    io_condvar.broadcast();
+	  return nr;
+	}
+
         for (long i = 0; i < nr; i++) {
           HDFRequest* req = hdf_reqs[i];
 	  assert(!req->xd->src_serdez_op && !req->xd->dst_serdez_op); // no serdez support
-          //pthread_rwlock_rdlock(req->rwlock);
-          if (kind == XferDes::XFER_HDF_READ)
-            CHECK_HDF5( H5Dread(req->dataset_id, req->datatype_id,
-				req->mem_space_id, req->file_space_id,
-				H5P_DEFAULT, req->mem_base) );
-	  else
-            CHECK_HDF5( H5Dwrite(req->dataset_id, req->datatype_id,
-				 req->mem_space_id, req->file_space_id,
-				 H5P_DEFAULT, req->mem_base) );
-          //pthread_rwlock_unlock(req->rwlock);
+	  perform_request(req);
           req->xd->notify_request_read_done(req);
           req->xd->notify_request_write_done(req);
         }
         return nr;
       }
 
-      void HDFChannel::pull() {}
+      void HDFChannel::pull()
+      {
+	if(io_threads.empty())
+	  return;
+
+	// grab the completed requests and notify their xds from the DMA
+	//  thread, which owns the xd's request bookkeeping
+	std::deque<HDFRequest *> done;
+	{
+	  AutoHSLLock al(io_mutex);
+	  done.swap(completed_reqs);
+	  in_flight -= done.size();
+	}
+	for(std::deque<HDFRequest *>::iterator it = done.begin();
+	    it != done.end();
+	    ++it) {
+	  (*it)->xd->notify_request_read_done(*it);
+	  (*it)->xd->notify_request_write_done(*it);
+	}
+      }
 
       long HDFChannel::available()
       {
-        return capacity;
+	if(io_threads.empty())
+	  return capacity;
+
+	AutoHSLLock al(io_mutex);
+	return capacity - in_flight;
+      }
+
+      void HDFChannel::io_thread_loop(void)
+      {
+	while(true) {
+	  HDFRequest *req;
+	  {
+	    AutoHSLLock al(io_mutex);
+	    while(pending_reqs.empty() && !io_shutdown)
+	      io_condvar.wait();
+	    if(pending_reqs.empty())
+	      break;
+	    req = pending_reqs.front();
+	    pending_reqs.pop_front();
+	  }
+
+	  perform_request(req);
+
+	  AutoHSLLock al(io_mutex);
+	  completed_reqs.push_back(req);
+	}
       }
 #endif
 
@@ -3546,6 +3765,12 @@ namespace Realm {
         memcpy_channel = new MemcpyChannel(max_nr);
         return memcpy_channel;
       }
+      ShmMemcpyChannel* ChannelManager::create_shm_memcpy_channel(long max_nr)
+      {
+        assert(shm_memcpy_channel == NULL);
+        shm_memcpy_channel = new ShmMemcpyChannel(max_nr);
+        return shm_memcpy_channel;
+      }
       GASNetChannel* ChannelManager::create_gasnet_read_channel(long max_nr) {
         assert(gasnet_read_channel == NULL);
         gasnet_read_channel = new GASNetChannel(max_nr, XferDes::XFER_GASNET_READ);
@@ -3597,6 +3822,12 @@ namespace Realm {
       {
         dma_all_gpus.push_back(gpu);
       }
+#endif
+#ifdef USE_HDF
+      void set_hdf5_io_threads(int count)
+      {
+        hdf5_io_threads = count;
+      }
 #endif
       void start_channel_manager(int count, bool pinned, int max_nr,
                                  Realm::CoreReservationSet& crs)
@@ -3651,6 +3882,17 @@ namespace Realm {
 	r->add_dma_channel(memcpy_channel);
 	r->add_dma_channel(gasnet_read_channel);
 	r->add_dma_channel(gasnet_write_channel);
+	// direct copies to co-located processes, if any shared their memories
+	{
+	  std::vector<uint64_t> shared_ids;
+	  if(get_shm_transport())
+	    get_shm_transport()->get_shared_memory_ids(shared_ids);
+	  if(!shared_ids.empty()) {
+	    ShmMemcpyChannel *shm_memcpy_channel = channel_manager->create_shm_memcpy_channel(max_nr);
+	    channels.push_back(shm_memcpy_channel);
+	    r->add_dma_channel(shm_memcpy_channel);
+	  }
+	}
 
         if (count > 1) {
           dma_threads[idx++] = new DMAThread(max_nr, xferDes_queue, channels);
@@ -3680,6 +3922,11 @@ namespace Realm {
         channels.push_back(hdf_write_channel);
 	r->add_dma_channel(hdf_read_channel);
 	r->add_dma_channel(hdf_write_channel);
+	if(hdf5_io_threads > 0) {
+	  log_new_dma.info() << "HDF5 channels using " << hdf5_io_threads << " I/O threads each";
+	  hdf_read_channel->start_io_threads(hdf5_io_threads, *core_rsrv);
+	  hdf_write_channel->start_io_threads(hdf5_io_threads, *core_rsrv);
+	}
 #endif
         if (count > 1) {
           dma_threads[idx++] = new DMAThread(max_nr, xferDes_queue, channels);
@@ -3759,6 +4006,11 @@ namespace Realm {
           delete (*it);
         }
         worker_threads.clear();
+#ifdef USE_HDF
+        // the DMA threads are gone, so nothing more can be submitted
+        channel_manager->get_hdf_read_channel()->stop_io_threads();
+        channel_manager->get_hdf_write_channel()->stop_io_threads();
+#endif
         for (int i = 0; i < num_threads; i++)
           delete dma_threads[i];
         for (int i = 0; i < num_memcpy_threads; i++)
@@ -3846,6 +4098,17 @@ namespace Realm {
 				   _max_req_size, max_nr, _priority,
 				   _order, _complete_fence);
             break;
+          case XferDes::XFER_SHM_MEMCPY:
+            xd = new ShmMemcpyXferDes(_dma_request, _launch_node,
+				      _guid, _pre_xd_guid, _next_xd_guid,
+				      _next_max_rw_gap,
+				      src_ib_offset, src_ib_size,
+				      mark_started,
+				      _src_mem, _dst_mem, _src_iter, _dst_iter,
+				      _src_serdez_id, _dst_serdez_id,
+				      _max_req_size, max_nr, _priority,
+				      _order, _complete_fence);
+            break;
           case XferDes::XFER_GASNET_READ:
           case XferDes::XFER_GASNET_WRITE:
             xd = new GASNetXferDes(_dma_request, _launch_node,
@@ -22,6 +22,7 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <map>
+#include <set>
 #include <vector>
 #include <deque>
 #include <queue>
@@ -256,6 +257,8 @@ namespace Realm {
       void *mem_base; // could be source or dest
       hid_t dataset_id, datatype_id;
       hid_t mem_space_id, file_space_id;
+      HDF5::HDF5Memory::OpenDataset *dset;  // released once the request is done
+      long long io_time;  // nanoseconds spent in H5Dread/H5Dwrite
     };
 #endif
 
@@ -296,7 +299,8 @@ namespace Realm {
         XFER_HDF_READ,
         XFER_HDF_WRITE,
         XFER_FILE_READ,
-        XFER_FILE_WRITE
+        XFER_FILE_WRITE,
+        XFER_SHM_MEMCPY
       };
     public:
       // a pointer to the DmaRequest that contains this XferDes
@@ -502,6 +506,35 @@ namespace Realm {
       char *dst_buf_base;
     };
 
+    // copies into the shared memory of a co-located process (see
+    //  SharedMemoryTransport) with memcpy
+    class ShmMemcpyXferDes : public XferDes {
+    public:
+      ShmMemcpyXferDes(DmaRequest* _dma_request, NodeID _launch_node,
+                       XferDesID _guid, XferDesID _pre_xd_guid, XferDesID _next_xd_guid,
+		       uint64_t _next_max_rw_gap, size_t src_ib_offset, size_t src_ib_size,
+                       bool mark_started,
+		       Memory _src_mem, Memory _dst_mem,
+		       TransferIterator *_src_iter, TransferIterator *_dst_iter,
+		       CustomSerdezID _src_serdez_id, CustomSerdezID _dst_serdez_id,
+                       uint64_t max_req_size, long max_nr, int _priority,
+                       XferOrder::Type _order, XferDesFence* _complete_fence);
+
+      ~ShmMemcpyXferDes()
+      {
+        free(memcpy_reqs);
+      }
+
+      long get_requests(Request** requests, long nr);
+      void notify_request_read_done(Request* req);
+      void notify_request_write_done(Request* req);
+      void flush();
+
+    private:
+      MemcpyRequest* memcpy_reqs;
+      char *dst_buf_base;
+    };
+
 #ifdef USE_CUDA
     class GPUXferDes : public XferDes {
     public:
@@ -560,14 +593,14 @@ namespace Realm {
       void notify_request_write_done(Request* req);
       void flush();
 
-      struct HDFFileInfo {
-	hid_t file_id;
-	std::map<std::string, hid_t> dset_ids;
-      };
-
     private:
       HDFRequest* hdf_reqs;
-      std::map<std::string, HDFFileInfo *> file_infos;
+      RegionInstance hdf_inst;
+      std::set<hid_t> written_files;  // flushed when the transfer is done
+      // I/O statistics, reported to the DMA request's profiling when done
+      size_t io_bytes;
+      long long io_time;
+      int io_requests;
       //char *buf_base;
       //const HDF5Memory::HDFMetadata *hdf_metadata;
       //std::vector<OffsetsAndSize>::iterator fit;
@@ -733,7 +766,9 @@ namespace Realm {
 
     class MemcpyChannel : public Channel {
     public:
-      MemcpyChannel(long max_nr);
+      // channels of other kinds that also copy with memcpy supply their own
+      //  paths
+      MemcpyChannel(long max_nr, XferDes::XferKind _kind = XferDes::XFER_MEM_CPY);
       ~MemcpyChannel();
       void stop();
       void get_request(std::deque<MemcpyRequest*>& thread_queue);
@@ -760,6 +795,13 @@ namespace Realm {
       //MemcpyRequest** cbs;
     };
 
+    // copies from local cpu memories into the shared memories of co-located
+    //  processes
+    class ShmMemcpyChannel : public MemcpyChannel {
+    public:
+      ShmMemcpyChannel(long max_nr);
+    };
+
     class GASNetChannel : public Channel {
     public:
       GASNetChannel(long max_nr, XferDes::XferKind _kind);
@@ -808,11 +850,30 @@ namespace Realm {
     public:
       HDFChannel(long max_nr, XferDes::XferKind _kind);
       ~HDFChannel();
+
+      // starts 'count' threads that perform the H5Dread/H5Dwrite calls for
+      //  submitted requests, allowing several requests (e.g. different chunks
+      //  of a dataset) to be in flight without blocking the DMA thread - with
+      //  no I/O threads, requests are performed synchronously in submit()
+      void start_io_threads(int count, CoreReservation& rsrv);
+      void stop_io_threads(void);
+
       long submit(Request** requests, long nr);
       void pull();
       long available();
+
+      void io_thread_loop(void);
+
     private:
+      void perform_request(HDFRequest *req);
+
       long capacity;
+      GASNetHSL io_mutex;
+      GASNetCondVar io_condvar;
+      std::deque<HDFRequest *> pending_reqs, completed_reqs;
+      long in_flight;
+      bool io_shutdown;
+      std::vector<Thread *> io_threads;
     };
 #endif
 
@@ -823,6 +884,7 @@ namespace Realm {
     public:
       ChannelManager(void) {
         memcpy_channel = NULL;
+        shm_memcpy_channel = NULL;
         gasnet_read_channel = gasnet_write_channel = NULL;
         remote_write_channel = NULL;
         disk_read_channel = NULL;
@@ -836,6 +898,7 @@ namespace Realm {
       }
       ~ChannelManager(void);
       MemcpyChannel* create_memcpy_channel(long max_nr);
+      ShmMemcpyChannel* create_shm_memcpy_channel(long max_nr);
       GASNetChannel* create_gasnet_read_channel(long max_nr);
       GASNetChannel* create_gasnet_write_channel(long max_nr);
       RemoteWriteChannel* create_remote_write_channel(long max_nr);
@@ -857,6 +920,9 @@ namespace Realm {
       MemcpyChannel* get_memcpy_channel() {
         return memcpy_channel;
       }
+      ShmMemcpyChannel* get_shm_memcpy_channel() {
+        return shm_memcpy_channel;
+      }
       GASNetChannel* get_gasnet_read_channel() {
         return gasnet_read_channel;
       }
@@ -914,6 +980,7 @@ namespace Realm {
 #endif
     public:
       MemcpyChannel* memcpy_channel;
+      ShmMemcpyChannel* shm_memcpy_channel;
       GASNetChannel *gasnet_read_channel, *gasnet_write_channel;
       RemoteWriteChannel* remote_write_channel;
       DiskChannel *disk_read_channel, *disk_write_channel;
@@ -1438,6 +1505,11 @@ namespace Realm {
     ChannelManager* get_channel_manager();
 #ifdef USE_CUDA
     void register_gpu_in_dma_systems(Cuda::GPU* gpu);
+#endif
+#ifdef USE_HDF
+    // number of I/O threads each HDF5 channel should start (0 = perform I/O
+    //  on the DMA thread) - must be set before the DMA workers are started
+    void set_hdf5_io_threads(int count);
 #endif
     void start_channel_manager(int count, bool pinned, int max_nr, CoreReservationSet& crs);
     void stop_channel_manager();
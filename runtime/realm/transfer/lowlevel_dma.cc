@@ -19,6 +19,7 @@
 #include "realm/transfer/channel.h"
 #include "realm/threads.h"
 #include "realm/transfer/transfer.h"
+#include "realm/shm_transport.h"
 
 #include <errno.h>
 // included for file memory data transfer
@@ -137,6 +138,10 @@ namespace Realm {
 	state(STATE_INIT), priority(_priority)
     {
       tgt_fetch_completion = Event::NO_EVENT;
+      io_usage.memory = Memory::NO_MEMORY;
+      io_usage.bytes = 0;
+      io_usage.io_time = 0;
+      io_usage.requests = 0;
       pthread_mutex_init(&request_lock, NULL);
     }
 
@@ -146,6 +151,10 @@ namespace Realm {
 	priority(_priority)
     {
       tgt_fetch_completion = Event::NO_EVENT;
+      io_usage.memory = Memory::NO_MEMORY;
+      io_usage.bytes = 0;
+      io_usage.io_time = 0;
+      io_usage.requests = 0;
       pthread_mutex_init(&request_lock, NULL);
     }
 
@@ -159,6 +168,27 @@ namespace Realm {
       os << "DmaRequest";
     }
 
+    void DmaRequest::add_io_usage(Memory memory, size_t bytes,
+				  long long io_time, int requests)
+    {
+      pthread_mutex_lock(&request_lock);
+      io_usage.memory = memory;
+      io_usage.bytes += bytes;
+      io_usage.io_time += io_time;
+      io_usage.requests += requests;
+      pthread_mutex_unlock(&request_lock);
+    }
+
+    void DmaRequest::mark_completed(void)
+    {
+      // all transfers are done, so the I/O totals are final
+      if((io_usage.requests > 0) &&
+	 measurements.wants_measurement<ProfilingMeasurements::OperationIOUsage>())
+	measurements.add_measurement(io_usage, false /*!send_complete_responses*/);
+
+      Operation::mark_completed();
+    }
+
 
   ////////////////////////////////////////////////////////////////////////
   //
@@ -1439,6 +1469,10 @@ namespace Realm {
           assert(0);
         }
       } else {
+        // co-located processes copy straight into shared memories
+        if (is_cpu_mem(src_ll_kind) && (src_serdez_id == 0) && (dst_serdez_id == 0) &&
+            get_shm_transport() && get_shm_transport()->get_shared_memory(dst_mem.id))
+          return XferDes::XFER_SHM_MEMCPY;
         if (is_cpu_mem(src_ll_kind) && dst_ll_kind == Memory::REGDMA_MEM) {
 	  // destination serdez ok, source not
 	  if(src_serdez_id != 0)
@@ -2267,6 +2301,7 @@ namespace Realm {
     FillRequest::FillRequest(const void *data, size_t datalen,
                              RegionInstance inst,
                              FieldID field_id, unsigned size,
+                             ReductionOpID redop_id, bool red_fold,
                              Event _before_fill, Event _after_fill,
                              int _priority)
       : DmaRequest(_priority, _after_fill), before_fill(_before_fill)
@@ -2275,6 +2310,8 @@ namespace Realm {
       dst.field_id = field_id;
       dst.subfield_offset = 0;
       dst.size = size;
+      dst.redop_id = redop_id;
+      dst.red_fold = red_fold;
 
       Serialization::FixedBufferDeserializer deserializer(data, datalen);
 
@@ -2341,6 +2378,8 @@ namespace Realm {
       args.field_id = dst.field_id;
       assert(dst.subfield_offset == 0);
       args.size = fill_size; // redundant!
+      args.redop_id = dst.redop_id;
+      args.red_fold = dst.red_fold;
       args.before_fill = before_fill;
       args.after_fill = finish_event;
       //args.priority = 0;
@@ -2473,6 +2512,266 @@ namespace Realm {
 #define ASSIGN_2 ASSIGN_1; ASSIGN_1
 #define ASSIGN_4 ASSIGN_2; ASSIGN_2
 
+    // builds a block holding as many back-to-back copies of the fill value as
+    //  fit in 'max_size' bytes - the block is cache-line-aligned and, when the
+    //  fill value allows it, a whole number of cache lines long so that every
+    //  copy out of it starts on a line boundary
+    static void *build_fill_pattern(const void *fill_buffer, size_t fill_size,
+				    size_t max_size, size_t& rep_size)
+    {
+      const size_t CACHE_LINE = 64;
+      size_t unit = fill_size;
+      while((unit % CACHE_LINE) != 0) unit += fill_size;
+      if(unit > max_size)
+	unit = fill_size;
+      rep_size = (max_size / unit) * unit;
+
+      void *rep_buffer = 0;
+      int ret = posix_memalign(&rep_buffer, CACHE_LINE, rep_size);
+      assert((ret == 0) && (rep_buffer != 0));
+      switch (fill_size)
+      {
+        case sizeof(uint32_t):
+          {
+            SPECIALIZE_FILL(uint32_t, 1);
+            break;
+          }
+        case sizeof(uint64_t):
+          {
+            SPECIALIZE_FILL(uint64_t, 1);
+            break;
+          }
+        case 2 * sizeof(uint64_t):
+          {
+            SPECIALIZE_FILL(uint64_t, 2);
+            break;
+          }
+        case 4 * sizeof(uint64_t):
+          {
+            SPECIALIZE_FILL(uint64_t, 4);
+            break;
+          }
+        default:
+          {
+            for(size_t ofs = 0; ofs < rep_size; ofs += fill_size)
+              memcpy(((char *)rep_buffer)+ofs, fill_buffer, fill_size);
+            break;
+          }
+      }
+      return rep_buffer;
+    }
+
+    template <typename T>
+    static inline void fill_typed(char *dst, size_t bytes, const void *fill_buffer)
+    {
+      T fill_value;
+      memcpy(&fill_value, fill_buffer, sizeof(T));
+      T *ptr = reinterpret_cast<T *>(dst);
+      size_t count = bytes / sizeof(T);
+      for(size_t i = 0; i < count; i++)
+	ptr[i] = fill_value;
+    }
+
+    // fills directly-accessible memory with copies of the fill value - 'bytes'
+    //  must be a multiple of 'fill_size'
+    static void fill_direct(char *dst, size_t bytes,
+			    const void *fill_buffer, size_t fill_size,
+			    bool zero_fill,
+			    const void *rep_buffer, size_t rep_size)
+    {
+      if(zero_fill) {
+	memset(dst, 0, bytes);
+	return;
+      }
+
+      // small power-of-two values use stores the compiler can widen, as long
+      //  as the destination is naturally aligned
+      bool aligned = ((reinterpret_cast<uintptr_t>(dst) % fill_size) == 0);
+      switch(fill_size) {
+      case 1:
+	memset(dst, *static_cast<const unsigned char *>(fill_buffer), bytes);
+	return;
+      case sizeof(uint16_t):
+	if(aligned) { fill_typed<uint16_t>(dst, bytes, fill_buffer); return; }
+	break;
+      case sizeof(uint32_t):
+	if(aligned) { fill_typed<uint32_t>(dst, bytes, fill_buffer); return; }
+	break;
+      case sizeof(uint64_t):
+	if(aligned) { fill_typed<uint64_t>(dst, bytes, fill_buffer); return; }
+	break;
+      default:
+	break;
+      }
+
+      // everything else is copied out of the replicated pattern block
+      if(!rep_buffer) {
+	rep_buffer = fill_buffer;
+	rep_size = fill_size;
+      }
+      size_t ofs = 0;
+      while((ofs + rep_size) <= bytes) {
+	memcpy(dst + ofs, rep_buffer, rep_size);
+	ofs += rep_size;
+      }
+      if(ofs < bytes)
+	memcpy(dst + ofs, rep_buffer, bytes - ofs);
+    }
+
+#ifdef USE_HDF
+    // HDF5 can't fill a selection from a single value, so fills are written
+    //  from a buffer of replicated copies of the value - the hyperslabs of
+    //  consecutive iterator steps are accumulated into one file selection
+    //  (split so it never needs more elements than the buffer holds) and
+    //  written with a single H5Dwrite
+    class HDF5FillWriter {
+    public:
+      static const size_t MAX_BUFFER_BYTES = 8 << 20;
+
+      HDF5FillWriter(HDF5::HDF5Memory *_hdf5mem, RegionInstance _inst,
+		     const void *_fill_value, size_t _fill_size);
+      ~HDF5FillWriter(void);
+
+      void add_hyperslab(const TransferIterator::AddressInfoHDF5& info);
+
+      // writes any pending selection and releases the current dataset
+      void finish(void);
+
+    protected:
+      void flush(void);
+
+      HDF5::HDF5Memory *hdf5mem;
+      RegionInstance inst;
+      const void *fill_value;
+      size_t fill_size, max_elems;
+      char *buffer;
+      size_t buffer_elems;
+      const std::string *cur_filename, *cur_dsetname;
+      HDF5::HDF5Memory::OpenDataset *cur_dset;
+      hid_t file_space_id;
+      size_t pending_elems;
+    };
+
+    HDF5FillWriter::HDF5FillWriter(HDF5::HDF5Memory *_hdf5mem, RegionInstance _inst,
+				   const void *_fill_value, size_t _fill_size)
+      : hdf5mem(_hdf5mem), inst(_inst)
+      , fill_value(_fill_value), fill_size(_fill_size)
+      , max_elems(std::max(size_t(1), MAX_BUFFER_BYTES / _fill_size))
+      , buffer(0), buffer_elems(0)
+      , cur_filename(0), cur_dsetname(0), cur_dset(0)
+      , file_space_id(-1), pending_elems(0)
+    {}
+
+    HDF5FillWriter::~HDF5FillWriter(void)
+    {
+      assert(cur_dset == 0);
+      free(buffer);
+    }
+
+    void HDF5FillWriter::add_hyperslab(const TransferIterator::AddressInfoHDF5& info)
+    {
+      // compare the pointers, not the string contents...
+      if((info.filename != cur_filename) || (info.dsetname != cur_dsetname)) {
+	finish();
+	cur_dset = hdf5mem->acquire_dataset(inst, *info.filename, *info.dsetname,
+					    true /*need_write*/);
+	assert(cur_dset->dtype_size == fill_size);
+	CHECK_HDF5( file_space_id = H5Dget_space(cur_dset->dset_id) );
+	cur_filename = info.filename;
+	cur_dsetname = info.dsetname;
+      }
+
+      // find the outermost dimension 'd' such that everything inside it fits
+      //  in the buffer - dimensions outside 'd' are written a slice at a time
+      //  and 'd' itself in chunks of 'd_step'
+      int dims = info.extent.size();
+      size_t inner_elems = 1;
+      int d = dims - 1;
+      while((d >= 0) && ((inner_elems * info.extent[d]) <= max_elems)) {
+	inner_elems *= info.extent[d];
+	d--;
+      }
+      hsize_t d_step = ((d >= 0) ? (max_elems / inner_elems) : 0);
+
+      std::vector<hsize_t> start(info.offset);
+      std::vector<hsize_t> count(info.extent);
+      for(int i = 0; i < d; i++)
+	count[i] = 1;
+      while(true) {
+	size_t elems = inner_elems;
+	if(d >= 0) {
+	  count[d] = std::min(d_step, info.offset[d] + info.extent[d] - start[d]);
+	  elems *= count[d];
+	}
+
+	if((pending_elems + elems) > max_elems)
+	  flush();
+	CHECK_HDF5( H5Sselect_hyperslab(file_space_id,
+					((pending_elems == 0) ? H5S_SELECT_SET :
+					                        H5S_SELECT_OR),
+					start.data(), 0, count.data(), 0) );
+	pending_elems += elems;
+
+	// advance to the next block, innermost varying dimension first
+	if(d < 0) break;
+	start[d] += count[d];
+	if(start[d] < (info.offset[d] + info.extent[d]))
+	  continue;
+	start[d] = info.offset[d];
+	int d2 = d - 1;
+	while(d2 >= 0) {
+	  if(++start[d2] < (info.offset[d2] + info.extent[d2]))
+	    break;
+	  start[d2] = info.offset[d2];
+	  d2--;
+	}
+	if(d2 < 0) break;
+      }
+    }
+
+    void HDF5FillWriter::flush(void)
+    {
+      if(pending_elems == 0)
+	return;
+
+      // grow the replicated buffer if needed
+      if(buffer_elems < pending_elems) {
+	free(buffer);
+	buffer = (char *)malloc(pending_elems * fill_size);
+	assert(buffer != 0);
+	fill_direct(buffer, pending_elems * fill_size, fill_value, fill_size,
+		    false /*!zero_fill*/, 0, 0);
+	buffer_elems = pending_elems;
+      }
+
+      hsize_t mem_dims = pending_elems;
+      hid_t mem_space_id;
+      CHECK_HDF5( mem_space_id = H5Screate_simple(1, &mem_dims, NULL) );
+      CHECK_HDF5( H5Dwrite(cur_dset->dset_id, cur_dset->dtype_id,
+			   mem_space_id, file_space_id,
+			   H5P_DEFAULT, buffer) );
+      CHECK_HDF5( H5Sclose(mem_space_id) );
+      CHECK_HDF5( H5Sselect_none(file_space_id) );
+      pending_elems = 0;
+    }
+
+    void HDF5FillWriter::finish(void)
+    {
+      if(!cur_dset)
+	return;
+
+      flush();
+      // the file stays open in the cache, so push the data out now
+      CHECK_HDF5( H5Fflush(cur_dset->dset_id, H5F_SCOPE_LOCAL) );
+      CHECK_HDF5( H5Sclose(file_space_id) );
+      file_space_id = -1;
+      hdf5mem->release_dataset(cur_dset);
+      cur_dset = 0;
+      cur_filename = 0;
+      cur_dsetname = 0;
+    }
+#endif
+
     void FillRequest::perform_dma(void)
     {
       // if we are doing large chunks of data, we will build a buffer with
@@ -2487,9 +2786,46 @@ namespace Realm {
       TransferIterator *iter = domain->create_iterator(dst.inst,
 						       RegionInstance::NO_INST,
 						       dst_field);
+
+      // a reduction fill applies (or folds) the fill value into each element
+      //  rather than overwriting it - if the fill value is the identity, this
+      //  does nothing at all
+      // the fill value is a right-hand-side value for both apply and fold
+      //  fills, the elements being reduced into are left-hand-side values
+      //  for apply and right-hand-side values for fold
+      const ReductionOpUntyped *redop = 0;
+      size_t red_elem_size = 0;
+      bool elide_fill = false;
+      if(dst.redop_id != 0) {
+	redop = get_runtime()->reduce_op_table[dst.redop_id];
+	if(fill_size != redop->sizeof_rhs) {
+	  log_dma.fatal() << "reduction fill value size mismatch: redop=" << dst.redop_id
+			  << " rhs_size=" << redop->sizeof_rhs << " fill_size=" << fill_size;
+	  abort();
+	}
+	red_elem_size = (dst.red_fold ? redop->sizeof_rhs : redop->sizeof_lhs);
+	if(redop->has_identity) {
+	  void *identity = malloc(fill_size);
+	  redop->init(identity, 1);
+	  elide_fill = (memcmp(identity, fill_buffer, fill_size) == 0);
+	  free(identity);
+	}
+      }
+
+      // all-zero fill values are common enough (fresh instances, sum-reduction
+      //  identities) to merit their own path
+      bool zero_fill = true;
+      for(size_t i = 0; i < fill_size; i++)
+	if(static_cast<const char *>(fill_buffer)[i] != 0) {
+	  zero_fill = false;
+	  break;
+	}
+
 #ifdef USE_CUDA
       // fills to GPU FB memory are offloaded to the GPU itself
-      if (mem_impl->lowlevel_kind == Memory::GPU_FB_MEM) {
+      // (reduction fills use the generic read-modify-write path below)
+      if (!elide_fill && !redop &&
+	  (mem_impl->lowlevel_kind == Memory::GPU_FB_MEM)) {
 	Cuda::GPU *gpu = static_cast<Cuda::GPUFBMemory *>(mem_impl)->gpu;
 	size_t total_bytes = 0;
 	while(!iter->done()) {
@@ -2522,92 +2858,30 @@ namespace Realm {
 
 #ifdef USE_HDF
       // fills of an HDF5 instance are also handled specially
-      if (mem_impl->lowlevel_kind == Memory::HDF_MEM) {
-	hid_t file_id = -1;
-	hid_t dset_id = -1;
-	hid_t dtype_id = -1;
-	const std::string *prev_filename = 0;
-	const std::string *prev_dsetname = 0;
+      if (!elide_fill && (mem_impl->lowlevel_kind == Memory::HDF_MEM)) {
+	// reduction fills of HDF5 data are not supported
+	if(redop) {
+	  log_dma.fatal() << "reduction fills of HDF5 instances are not supported: dst="
+			  << dst.inst << " redop=" << dst.redop_id;
+	  abort();
+	}
+	HDF5FillWriter writer((HDF5::HDF5Memory *)mem_impl, dst.inst,
+			      fill_buffer, fill_size);
 	while(!iter->done()) {
 	  TransferIterator::AddressInfoHDF5 info;
 	  size_t act_bytes = iter->step(size_t(-1), // max_bytes
 					info);
 	  assert(act_bytes >= 0);
-
-	  // compare the pointers, not the string contents...
-	  if(info.filename != prev_filename) {
-	    // close dataset too
-	    if(dset_id != -1) {
-	      CHECK_HDF5( H5Tclose(dtype_id) );
-	      CHECK_HDF5( H5Dclose(dset_id) );
-	      prev_dsetname = 0;
-	    }
-	    if(file_id != -1)
-	      CHECK_HDF5( H5Fclose(file_id) );
-
-	    CHECK_HDF5( file_id = H5Fopen(info.filename->c_str(),
-					  H5F_ACC_RDWR, H5P_DEFAULT) );
-	    prev_filename = info.filename;
-	  }
-
-	  if(info.dsetname != prev_dsetname) {
-	    if(dset_id != -1) {
-	      CHECK_HDF5( H5Tclose(dtype_id) );
-	      CHECK_HDF5( H5Dclose(dset_id) );
-	    }
-	    CHECK_HDF5( dset_id = H5Dopen2(file_id, info.dsetname->c_str(),
-					   H5P_DEFAULT) );
-	    CHECK_HDF5( dtype_id = H5Dget_type(dset_id) );
-	    size_t dtype_size = H5Tget_size(dtype_id);
-	    assert(dtype_size == fill_size);
-	    prev_dsetname = info.dsetname;
-	  }
-
-	  // HDF5 doesn't seem to offer a way to fill a file without building
-	  //  an equivalently-sized memory buffer first, so just do point-wise
-	  //  iteration and hope that libhdf5 does some buffering
-	  int dims = info.extent.size();
-	  std::vector<hsize_t> mem_dims(dims, 1);
-	  hid_t mem_space_id, file_space_id;
-	  CHECK_HDF5( mem_space_id = H5Screate_simple(dims, mem_dims.data(),
-						      NULL) );
-	  CHECK_HDF5( file_space_id = H5Dget_space(dset_id) );
-
-	  std::vector<hsize_t> cur_pos(info.offset);
-	  std::vector<hsize_t> cur_size(dims, 1);
-	  while(true) {
-	    CHECK_HDF5( H5Sselect_hyperslab(file_space_id, H5S_SELECT_SET,
-					    cur_pos.data(), 0,
-					    cur_size.data(), 0) );
-	    CHECK_HDF5( H5Dwrite(dset_id, dtype_id,
-				 mem_space_id, file_space_id,
-				 H5P_DEFAULT, fill_buffer) );
-	    // advance to next position
-	    int d = 0;
-	    while(d < dims) {
-	      if(++cur_pos[d] < (info.offset[d] + info.extent[d]))
-		break;
-	      cur_pos[d] = info.offset[d];
-	      d++;
-	    }
-	    if(d >= dims) break;
-	  }
-
-	  CHECK_HDF5( H5Sclose(mem_space_id) );
-	  CHECK_HDF5( H5Sclose(file_space_id) );
-	}
-
-	// close the last dset and file we touched
-	if(dset_id != -1) {
-	  CHECK_HDF5( H5Tclose(dtype_id) );
-	  CHECK_HDF5( H5Dclose(dset_id) );
+	  writer.add_hyperslab(info);
 	}
-	if(file_id != -1)
-	  CHECK_HDF5( H5Fclose(file_id) );
+	writer.finish();
       }
 #endif
 
-      while(!iter->done()) {
+      void *red_scratch = 0;
+      size_t red_scratch_size = 0;
+
+      while(!elide_fill && !iter->done()) {
 	TransferIterator::AddressInfo info;
 
 	size_t max_bytes = (size_t)-1;
@@ -2617,48 +2891,73 @@ namespace Realm {
 	size_t act_bytes = iter->step(max_bytes, info, flags);
 	assert(act_bytes >= 0);
 
+	if(redop) {
+	  // elements within a chunk are contiguous, so each chunk is reduced
+	  //  with a single strided call that reuses the one fill value
+	  size_t num_elems = info.bytes_per_chunk / red_elem_size;
+	  for(size_t p = 0; p < info.num_planes; p++)
+	    for(size_t l = 0; l < info.num_lines; l++) {
+	      off_t ofs = (info.base_offset +
+			   (p * info.plane_stride) +
+			   (l * info.line_stride));
+	      // framebuffer pointers aren't usable from the CPU
+	      void *ptr = ((mem_impl->lowlevel_kind == Memory::GPU_FB_MEM) ?
+			   0 :
+			   mem_impl->get_direct_ptr(ofs, info.bytes_per_chunk));
+	      if(!ptr) {
+		// no direct access - read, modify, and write back
+		if(red_scratch_size < info.bytes_per_chunk) {
+		  free(red_scratch);
+		  red_scratch = malloc(info.bytes_per_chunk);
+		  assert(red_scratch != 0);
+		  red_scratch_size = info.bytes_per_chunk;
+		}
+		mem_impl->get_bytes(ofs, red_scratch, info.bytes_per_chunk);
+		ptr = red_scratch;
+	      }
+	      if(dst.red_fold)
+		redop->fold_strided(ptr, fill_buffer, red_elem_size, 0, num_elems,
+				    false /*!excl*/);
+	      else
+		redop->apply_strided(ptr, fill_buffer, red_elem_size, 0, num_elems,
+				     false /*!excl*/);
+	      if(ptr == red_scratch)
+		mem_impl->put_bytes(ofs, red_scratch, info.bytes_per_chunk);
+	    }
+	  continue;
+	}
+
+	// if the memory can be accessed directly, it is filled in place
+	size_t extent = (((info.num_planes - 1) * info.plane_stride) +
+			 ((info.num_lines - 1) * info.line_stride) +
+			 info.bytes_per_chunk);
+	char *direct = static_cast<char *>(mem_impl->get_direct_ptr(info.base_offset,
+								     extent));
+
+	// build a replicated copy of the fill value if the chunks are larger
+	//  than a single element (direct zero fills just use memset)
+	const size_t MAX_REP_SIZE = 32768;
+	if(!rep_buffer && !(direct && zero_fill) &&
+	   (info.bytes_per_chunk > fill_size) &&
+	   ((fill_size * 2) <= MAX_REP_SIZE))
+	  rep_buffer = build_fill_pattern(fill_buffer, fill_size,
+					  MAX_REP_SIZE, rep_size);
+
+	if(direct) {
+	  for(size_t p = 0; p < info.num_planes; p++)
+	    for(size_t l = 0; l < info.num_lines; l++)
+	      fill_direct(direct + (p * info.plane_stride) + (l * info.line_stride),
+			  info.bytes_per_chunk,
+			  fill_buffer, fill_size, zero_fill,
+			  rep_buffer, rep_size);
+	  continue;
+	}
+
 	// decide whether to use the original fill buffer or one that
 	//  repeats the data several times
 	const void *use_buffer = fill_buffer;
 	size_t use_size = fill_size;
-	const size_t MAX_REP_SIZE = 32768;
-	if((info.bytes_per_chunk > fill_size) &&
-	   ((fill_size * 2) <= MAX_REP_SIZE)) {
-	  if(!rep_buffer) {
-	    size_t rep_elems = MAX_REP_SIZE / fill_size;
-	    rep_size = rep_elems * fill_size;
-	    rep_buffer = malloc(rep_size);
-	    assert(rep_buffer != 0);
-            switch (fill_size)
-            {
-              case sizeof(uint32_t):
-                {
-                  SPECIALIZE_FILL(uint32_t, 1);
-                  break;
-                }
-              case sizeof(uint64_t):
-                {
-                  SPECIALIZE_FILL(uint64_t, 1);
-                  break;
-                }
-              case 2 * sizeof(uint64_t):
-                {
-                  SPECIALIZE_FILL(uint64_t, 2);
-                  break;
-                }
-              case 4 * sizeof(uint64_t):
-                {
-                  SPECIALIZE_FILL(uint64_t, 4);
-                  break;
-                }
-              default:
-                {
-                  for(size_t ofs = 0; ofs < rep_size; ofs += fill_size)
-                    memcpy(((char *)rep_buffer)+ofs, fill_buffer, fill_size);
-                  break;
-                }
-            }
-	  }
+	if((info.bytes_per_chunk > fill_size) && rep_buffer) {
 	  use_buffer = rep_buffer;
 	  use_size = rep_size;
 	}
@@ -2684,6 +2983,8 @@ namespace Realm {
 
       if(rep_buffer)
 	free(rep_buffer);
+      if(red_scratch)
+	free(red_scratch);
       delete iter;
 
       if(measurements.wants_measurement<ProfilingMeasurements::OperationMemoryUsage>()) {
@@ -2835,6 +3136,8 @@ namespace Realm {
                                        args.inst,
                                        args.field_id,
                                        args.size,
+                                       args.redop_id,
+                                       args.red_fold,
                                        args.before_fill,
                                        args.after_fill,
                                        0 /* no room for args.priority */);
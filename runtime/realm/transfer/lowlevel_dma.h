@@ -98,6 +98,8 @@ namespace Realm {
       RegionInstance inst;
       FieldID field_id;
       unsigned size;
+      ReductionOpID redop_id;
+      bool red_fold;
       Event before_fill, after_fill;
       //int priority;
     };
@@ -162,6 +164,8 @@ namespace Realm {
       // deletion performed when reference count goes to zero
       virtual ~DmaRequest(void);
 
+      virtual void mark_completed(void);
+
     public:
       virtual void print(std::ostream& os) const;
 
@@ -203,6 +207,12 @@ namespace Realm {
         return all_completed;
       }
       Event tgt_fetch_completion;
+
+      // records I/O performed by one of this request's transfers - may be
+      //  called from any DMA thread before the transfer is marked completed
+      void add_io_usage(Memory memory, size_t bytes, long long io_time,
+			int requests);
+      ProfilingMeasurements::OperationIOUsage io_usage;
       // </NEWDMA>
 
       class Waiter : public EventWaiter {
@@ -387,6 +397,7 @@ namespace Realm {
       FillRequest(const void *data, size_t msglen,
                   RegionInstance inst,
                   FieldID field_id, unsigned size,
+                  ReductionOpID redop_id, bool red_fold,
                   Event _before_fill, 
                   Event _after_fill,
                   int priority);
@@ -2064,7 +2064,8 @@ namespace Realm {
   class TransferPlanFill : public TransferPlan {
   public:
     TransferPlanFill(const void *_data, size_t _size,
-		     RegionInstance _inst, FieldID _field_id);
+		     RegionInstance _inst, FieldID _field_id,
+		     ReductionOpID _redop_id = 0, bool _red_fold = false);
 
     virtual Event execute_plan(const TransferDomain *td,
 			       const ProfilingRequestSet& requests,
@@ -2074,13 +2075,19 @@ namespace Realm {
     ByteArray data;
     RegionInstance inst;
     FieldID field_id;
+    ReductionOpID redop_id;
+    bool red_fold;
   };
 
   TransferPlanFill::TransferPlanFill(const void *_data, size_t _size,
-				     RegionInstance _inst, FieldID _field_id)
+				     RegionInstance _inst, FieldID _field_id,
+				     ReductionOpID _redop_id /*= 0*/,
+				     bool _red_fold /*= false*/)
     : data(_data, _size)
     , inst(_inst)
     , field_id(_field_id)
+    , redop_id(_redop_id)
+    , red_fold(_red_fold)
   {}
 
   Event TransferPlanFill::execute_plan(const TransferDomain *td,
@@ -2092,6 +2099,8 @@ namespace Realm {
     f.field_id = field_id;
     f.subfield_offset = 0;
     f.size = data.size();
+    f.redop_id = redop_id;
+    f.red_fold = red_fold;
 
     Event ev = GenEventImpl::create_genevent()->current_event();
     FillRequest *r = new FillRequest(td, f, data.base(), data.size(),
@@ -2140,20 +2149,24 @@ namespace Realm {
     std::vector<TransferPlan *> plans;
     assert(srcs.size() == dsts.size());
     for(size_t i = 0; i < srcs.size(); i++) {
-      assert(srcs[i].size == dsts[i].size);
+      // reduction fills carry a right-hand-side value, which may differ in
+      //  size from the left-hand-side elements of an apply
+      assert((srcs[i].size == dsts[i].size) ||
+	     ((srcs[i].field_id == FieldID(-1)) && (dsts[i].redop_id != 0)));
       assert(srcs[i].indirect_index == -1);
       assert(dsts[i].indirect_index == -1);
 
-      // if the source field id is -1 and dst has no redop, we can use old fill
+      // if the source field id is -1, it's a fill - a dst redop turns it into
+      //  a reduction of the fill value into each element
       if(srcs[i].field_id == FieldID(-1)) {
-	// no support for reduction fill yet
-	assert(dsts[i].redop_id == 0);
 	TransferPlan *p = new TransferPlanFill(((srcs[i].size <= srcs[i].MAX_DIRECT_SIZE) ?
 						  &(srcs[i].fill_data.direct) :
 						  srcs[i].fill_data.indirect),
 					       srcs[i].size,
 					       dsts[i].inst,
-					       dsts[i].field_id);
+					       dsts[i].field_id,
+					       dsts[i].redop_id,
+					       dsts[i].red_fold);
 	plans.push_back(p);
 	continue;
       }
@@ -504,6 +504,7 @@ REALM_SRC 	+= $(LG_RT_DIR)/realm/openmp/openmp_module.cc \
 		   $(LG_RT_DIR)/realm/openmp/openmp_api.cc
 endif
 REALM_SRC 	+= $(LG_RT_DIR)/realm/procset/procset_module.cc
+REALM_SRC 	+= $(LG_RT_DIR)/realm/stacksampler/stacksampler_module.cc
 ifeq ($(strip $(USE_PYTHON)),1)
 REALM_SRC 	+= $(LG_RT_DIR)/realm/python/python_module.cc \
 		   $(LG_RT_DIR)/realm/python/python_source.cc
@@ -521,7 +522,8 @@ REALM_SRC 	+= $(LG_RT_DIR)/realm/hdf5/hdf5_module.cc \
 		   $(LG_RT_DIR)/realm/hdf5/hdf5_internal.cc \
 		   $(LG_RT_DIR)/realm/hdf5/hdf5_access.cc
 endif
-REALM_SRC 	+= $(LG_RT_DIR)/realm/activemsg.cc
+REALM_SRC 	+= $(LG_RT_DIR)/realm/activemsg.cc \
+		   $(LG_RT_DIR)/realm/shm_transport.cc
 GPU_RUNTIME_SRC +=
 
 REALM_SRC 	+= $(LG_RT_DIR)/realm/logging.cc \
@@ -536,6 +538,7 @@ MAPPER_SRC	+= $(LG_RT_DIR)/mappers/default_mapper.cc \
 		   $(LG_RT_DIR)/mappers/test_mapper.cc \
 		   $(LG_RT_DIR)/mappers/replay_mapper.cc \
 		   $(LG_RT_DIR)/mappers/debug_mapper.cc \
+		   $(LG_RT_DIR)/mappers/schedule_mapper.cc \
 		   $(LG_RT_DIR)/mappers/wrapper_mapper.cc
 
 LEGION_SRC 	+= $(LG_RT_DIR)/legion/legion.cc \
@@ -61,6 +61,8 @@ legion_cxx_tests = [
     # Tests
     ['test/rendering/rendering', ['-i', '2', '-n', '64', '-ll:cpu', '4']],
     ['test/legion_stl/test_stl', []],
+    ['test/prof_format/prof_format', []],
+    ['test/runtime_stats/runtime_stats', []],
 ]
 
 if platform.system() != 'Darwin':
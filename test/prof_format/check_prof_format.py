@@ -0,0 +1,199 @@
+#!/usr/bin/env python
+
+# Copyright 2018 Stanford University, NVIDIA Corporation
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Checks a log written by prof_format.cc: every record must come back,
+# time windows must only skip timed chunks, and readers must fall back
+# to walking the chunk headers when the index is missing. Hardware counter
+# records must keep their values, both here and in legion_prof_analyze's
+# statistics when a path to it is given.
+
+from __future__ import print_function
+
+import os, re, struct, subprocess, sys
+
+scriptPath = os.path.dirname(os.path.realpath(__file__)) + "/"
+sys.path.append(scriptPath + '../../tools')
+from legion_serializer import LegionProfBinaryDeserializer, perf_counter_names
+
+class Records(object):
+    def __init__(self):
+        self.counts = {}
+        self.task_starts = set()
+        self.perf_counters = {}
+
+    def record(self, name):
+        def callback(**kwargs):
+            self.counts[name] = self.counts.get(name, 0) + 1
+            if name == "TaskInfo":
+                self.task_starts.add(kwargs['start'])
+            elif name == "TaskPerfCounters":
+                self.perf_counters[kwargs['op_id']] = kwargs
+        return callback
+
+def record_names(filename):
+    names = []
+    with open(filename, 'rb') as log:
+        log.readline()
+        for line in iter(log.readline, b'\n'):
+            names.append(line.split()[0].decode())
+    return names
+
+def parse(filename, start_time=None, stop_time=None):
+    records = Records()
+    callbacks = dict((name, records.record(name))
+                     for name in record_names(filename))
+    deserializer = LegionProfBinaryDeserializer(None, callbacks,
+                                                start_time, stop_time)
+    deserializer.parse(filename, False)
+    return records
+
+def read_index(filename):
+    cls = LegionProfBinaryDeserializer
+    with open(filename, 'rb') as log:
+        for line in iter(log.readline, b'\n'):
+            pass
+        data_offset = log.tell()
+        return cls(None, {}).read_chunk_index(log, data_offset), data_offset
+
+def check(condition, message):
+    if not condition:
+        print("FAILED: " + message)
+        sys.exit(1)
+
+def check_window(records, num_tasks, start_time, stop_time, label):
+    # Times in the callbacks are in us, tasks start every 1us
+    check(records.counts.get("OperationInstance", 0) == num_tasks,
+          label + ": untimed records must always be loaded")
+    check(records.counts.get("TaskKind", 0) == 1,
+          label + ": descriptions must always be loaded")
+    for start in range(start_time, stop_time):
+        check(start in records.task_starts,
+              label + ": task starting at %dus is missing" % start)
+    check(records.counts["TaskInfo"] < num_tasks,
+          label + ": chunks outside the window were not skipped")
+
+# The value prof_format.cc gives the idx'th counter of a task, or -1 for
+# counters it marks as unavailable
+def expected_counter(op_id, idx):
+    if perf_counter_names[idx].startswith("l3_"):
+        return -1
+    return (idx + 1) * (op_id + 1)
+
+def check_perf_counters(records, num_counter_tasks):
+    check(len(records.perf_counters) == num_counter_tasks,
+          "expected %d TaskPerfCounters records" % num_counter_tasks)
+    for op_id, counters in records.perf_counters.items():
+        check(counters['task_id'] == 1 and counters['variant_id'] == 1,
+              "TaskPerfCounters for op %d has the wrong variant" % op_id)
+        for idx, name in enumerate(perf_counter_names):
+            check(counters[name] == expected_counter(op_id, idx),
+                  "TaskPerfCounters for op %d has %s = %d" %
+                  (op_id, name, counters[name]))
+
+def check_analyzer(analyzer, filename, num_counter_tasks):
+    output = subprocess.check_output([analyzer, "-s", "--no-visualization",
+                                      filename])
+    lines = output.decode().splitlines()
+    check("   HARDWARE COUNTERS" in lines,
+          "legion_prof_analyze printed no hardware counters")
+    stats = dict()
+    for line in lines[lines.index("   HARDWARE COUNTERS"):]:
+        match = re.match(r'\s+([^:]+): ([0-9.]+)', line)
+        if match:
+            stats[match.group(1)] = match.group(2)
+    check(stats.get("Tasks Measured") == str(num_counter_tasks),
+          "legion_prof_analyze measured %s tasks" % stats.get("Tasks Measured"))
+    for idx, name in enumerate(perf_counter_names):
+        total = sum(expected_counter(op_id, idx)
+                    for op_id in range(num_counter_tasks))
+        if total < 0:
+            check(name not in stats,
+                  "legion_prof_analyze reported unavailable counter " + name)
+        else:
+            check(stats.get(name) == str(total),
+                  "legion_prof_analyze reported %s = %s, expected %d" %
+                  (name, stats.get(name), total))
+    # instructions are counter 0 and cycles counter 1
+    check(stats.get("Instructions per Cycle") == "0.500",
+          "legion_prof_analyze reported IPC %s" %
+          stats.get("Instructions per Cycle"))
+    check("L3 Miss Rate" not in stats,
+          "legion_prof_analyze reported a rate for unavailable counters")
+
+def main():
+    filename = sys.argv[1]
+    num_tasks = int(sys.argv[2])
+    num_counter_tasks = int(sys.argv[3])
+    analyzer = sys.argv[4] if len(sys.argv) > 4 else None
+    cls = LegionProfBinaryDeserializer
+
+    # Every record round trips
+    records = parse(filename)
+    check(records.counts.get("TaskInfo", 0) == num_tasks,
+          "expected %d TaskInfo records" % num_tasks)
+    check(records.counts.get("OperationInstance", 0) == num_tasks,
+          "expected %d OperationInstance records" % num_tasks)
+    check(records.counts.get("TaskVariant", 0) == 1,
+          "expected one TaskVariant record")
+    check_perf_counters(records, num_counter_tasks)
+
+    # Timed and untimed records are kept in separate chunks
+    index, data_offset = read_index(filename)
+    check(index is not None, "chunk index is missing")
+    timed_chunks = 0
+    for offset, flags, start, stop in index:
+        if flags & cls.CHUNK_METADATA:
+            check(start > stop, "metadata chunk at %d has times" % offset)
+        else:
+            check(start <= stop, "timed chunk at %d has no times" % offset)
+            timed_chunks += 1
+    check(timed_chunks > 1, "expected several timed chunks")
+
+    # A window only loads the timed chunks that overlap it
+    start_time = num_tasks // 4
+    stop_time = start_time + 1000
+    records = parse(filename, start_time, stop_time)
+    check_window(records, num_tasks, start_time, stop_time, "indexed")
+
+    # Without the index the chunk headers are walked instead
+    with open(filename, 'rb') as log:
+        log.seek(-struct.calcsize(cls.index_trailer_fmt), os.SEEK_END)
+        index_offset, magic = struct.unpack(cls.index_trailer_fmt,
+                                            log.read())
+        check(magic == cls.index_magic, "bad index trailer")
+        log.seek(0)
+        truncated = log.read(index_offset)
+    truncated_name = filename + ".noindex"
+    with open(truncated_name, 'wb') as log:
+        log.write(truncated)
+    check(read_index(truncated_name)[0] is None,
+          "truncated log still has an index")
+    records = parse(truncated_name)
+    check(records.counts.get("TaskInfo", 0) == num_tasks,
+          "walking the chunk headers lost TaskInfo records")
+    records = parse(truncated_name, start_time, stop_time)
+    check_window(records, num_tasks, start_time, stop_time, "unindexed")
+    os.remove(truncated_name)
+
+    if analyzer:
+        check_analyzer(analyzer, filename, num_counter_tasks)
+    else:
+        print("legion_prof_analyze not built, skipping its checks")
+
+    print("prof format checks passed")
+
+if __name__ == "__main__":
+    main()
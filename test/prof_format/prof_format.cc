@@ -0,0 +1,124 @@
+/* Copyright 2018 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Writes a synthetic Legion Prof log with the binary serializer and has
+// check_prof_format.py read it back with the Python deserializer, both
+// with and without a time window and with and without the chunk index.
+// The first few tasks also get hardware counter records, which are checked
+// through legion_prof_analyze as well when the build provides it.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "legion/legion_profiling_serializer.h"
+
+using namespace Legion::Internal;
+
+#ifndef PROF_FORMAT_DIR
+#define PROF_FORMAT_DIR "."
+#endif
+#ifndef LEGION_PROF_ANALYZE
+#define LEGION_PROF_ANALYZE ""
+#endif
+
+// Enough task records to fill several chunks
+static const unsigned NUM_TASKS = 100000;
+// Tasks start every 1us and run for 0.5us
+static const timestamp_t TASK_PERIOD = 1000;
+// Tasks with TaskPerfCounters records, the k'th counter of the i'th task
+// is (k+1)*(i+1) except for the L3 counters, which are not available
+static const unsigned NUM_COUNTER_TASKS = 10;
+
+static void write_log(const char *filename)
+{
+  LegionProfBinarySerializer serializer(filename);
+
+  LegionProfDesc::ProcDesc proc;
+  proc.proc_id = 0x1d00000000000001ULL;
+  proc.kind = Realm::Processor::LOC_PROC;
+  serializer.serialize(proc);
+
+  LegionProfInstance::TaskKind kind;
+  kind.task_id = 1;
+  kind.name = "test_task";
+  kind.overwrite = false;
+  serializer.serialize(kind);
+
+  LegionProfInstance::TaskVariant variant;
+  variant.task_id = 1;
+  variant.variant_id = 1;
+  variant.name = "test_variant";
+  serializer.serialize(variant);
+
+  // Interleave untimed operation records with the timed task records
+  // the same way the profiler does
+  for (unsigned idx = 0; idx < NUM_TASKS; idx++)
+  {
+    LegionProfInstance::OperationInstance op;
+    op.op_id = idx;
+    op.kind = 0;
+    serializer.serialize(op);
+
+    LegionProfInstance::TaskInfo task;
+    task.op_id = idx;
+    task.task_id = 1;
+    task.variant_id = 1;
+    task.proc_id = proc.proc_id;
+    task.create = idx * TASK_PERIOD;
+    task.ready = task.create;
+    task.start = task.create;
+    task.stop = task.start + TASK_PERIOD / 2;
+    serializer.serialize(task);
+
+    if (idx < NUM_COUNTER_TASKS)
+    {
+      LegionProfInstance::TaskPerfCounters counters;
+      counters.op_id = idx;
+      counters.task_id = task.task_id;
+      counters.variant_id = task.variant_id;
+      counters.proc_id = task.proc_id;
+      counters.start = task.start;
+      counters.stop = task.stop;
+      long long counter = 0;
+#define SET_PERF_COUNTER(name) counters.name = ++counter * (idx + 1);
+      LEGION_PROF_PERF_COUNTERS(SET_PERF_COUNTER)
+#undef SET_PERF_COUNTER
+      counters.l3_accesses = -1;
+      counters.l3_misses = -1;
+      serializer.serialize(counters);
+    }
+  }
+}
+
+int main(int argc, char **argv)
+{
+  const char *filename = "prof_format.log";
+  write_log(filename);
+
+  char command[1024];
+  snprintf(command, sizeof(command), "python %s/check_prof_format.py %s %u %u %s",
+           PROF_FORMAT_DIR, filename, NUM_TASKS, NUM_COUNTER_TASKS,
+           LEGION_PROF_ANALYZE);
+  int result = system(command);
+  if (result != 0)
+  {
+    fprintf(stderr, "FAILED: %s\n", command);
+    return 1;
+  }
+  remove(filename);
+  printf("SUCCESS\n");
+  return 0;
+}
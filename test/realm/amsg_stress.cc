@@ -0,0 +1,202 @@
+#include "realm.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <vector>
+
+using namespace Realm;
+
+Logger log_app("app");
+
+// Task IDs, some IDs are reserved so start at first available number
+enum {
+  TOP_LEVEL_TASK = Processor::TASK_ID_FIRST_AVAILABLE+0,
+  SENDER_TASK,
+  RECEIVER_TASK,
+  CHECK_TASK,
+};
+
+// every CPU processor sends 'num_messages' tasks to every CPU processor
+//  (including itself) as fast as it can, so with more than one node each
+//  node's incoming message queue has several senders pushing at once
+int num_messages = 500;
+int max_payload = 2048;
+
+// indexed by the sender's position in the list of all CPU processors
+std::vector<Processor> all_cpus;
+int *received_counts = 0;
+int payload_errors = 0;
+
+struct SenderArgs {
+  int sender_idx;
+};
+
+struct ReceiverArgs {
+  int sender_idx;
+  int seq;
+  int payload_len;
+  // followed by 'payload_len' bytes of payload
+};
+
+static unsigned char payload_byte(int sender_idx, int seq, int i)
+{
+  return (unsigned char)(sender_idx * 31 + seq * 7 + i);
+}
+
+void receiver_task(const void *args, size_t arglen,
+		   const void *userdata, size_t userlen, Processor p)
+{
+  assert(arglen >= sizeof(ReceiverArgs));
+  const ReceiverArgs& r_args = *static_cast<const ReceiverArgs *>(args);
+  assert((r_args.sender_idx >= 0) && (r_args.sender_idx < (int)all_cpus.size()));
+
+  bool ok = (arglen == (sizeof(ReceiverArgs) + r_args.payload_len));
+  const unsigned char *payload = static_cast<const unsigned char *>(args) + sizeof(ReceiverArgs);
+  for(int i = 0; ok && (i < r_args.payload_len); i++)
+    if(payload[i] != payload_byte(r_args.sender_idx, r_args.seq, i))
+      ok = false;
+  if(!ok) {
+    log_app.error() << "corrupt message: sender=" << r_args.sender_idx << " seq=" << r_args.seq
+		    << " arglen=" << arglen << " payload=" << r_args.payload_len;
+    __sync_fetch_and_add(&payload_errors, 1);
+  }
+
+  __sync_fetch_and_add(&received_counts[r_args.sender_idx], 1);
+}
+
+void sender_task(const void *args, size_t arglen,
+		 const void *userdata, size_t userlen, Processor p)
+{
+  const SenderArgs& s_args = *static_cast<const SenderArgs *>(args);
+
+  std::vector<char> buffer(sizeof(ReceiverArgs) + max_payload);
+  std::vector<Event> events;
+  for(int seq = 0; seq < num_messages; seq++)
+    for(size_t t = 0; t < all_cpus.size(); t++) {
+      ReceiverArgs& r_args = *reinterpret_cast<ReceiverArgs *>(&buffer[0]);
+      r_args.sender_idx = s_args.sender_idx;
+      r_args.seq = seq;
+      // a mix of short and medium messages
+      r_args.payload_len = (max_payload > 0) ? ((seq * 37 + (int)t * 13) % (max_payload + 1)) : 0;
+      unsigned char *payload = reinterpret_cast<unsigned char *>(&buffer[sizeof(ReceiverArgs)]);
+      for(int i = 0; i < r_args.payload_len; i++)
+	payload[i] = payload_byte(s_args.sender_idx, seq, i);
+      events.push_back(all_cpus[t].spawn(RECEIVER_TASK, &buffer[0],
+					 sizeof(ReceiverArgs) + r_args.payload_len));
+    }
+
+  Event::merge_events(events).wait();
+  log_app.info() << "sender " << s_args.sender_idx << " on " << p << " done";
+}
+
+void check_task(const void *args, size_t arglen,
+		const void *userdata, size_t userlen, Processor p)
+{
+  // each local CPU processor received every sender's messages
+  int local_cpus = Machine::ProcessorQuery(Machine::get_machine())
+    .only_kind(Processor::LOC_PROC)
+    .local_address_space()
+    .count();
+  int expected = num_messages * local_cpus;
+
+  int errors = payload_errors;
+  for(size_t i = 0; i < all_cpus.size(); i++)
+    if(received_counts[i] != expected) {
+      log_app.error() << "sender " << i << " (" << all_cpus[i] << "): received "
+		      << received_counts[i] << " messages, expected " << expected;
+      errors++;
+    }
+
+  if(errors > 0) {
+    log_app.error() << errors << " errors on " << p;
+    exit(1);
+  }
+}
+
+void top_level_task(const void *args, size_t arglen,
+		    const void *userdata, size_t userlen, Processor p)
+{
+  log_app.print() << "active message stress test: senders=" << all_cpus.size()
+		  << " messages=" << num_messages << " max_payload=" << max_payload;
+
+  double t_start = Clock::current_time();
+  std::vector<Event> events;
+  for(size_t i = 0; i < all_cpus.size(); i++) {
+    SenderArgs s_args;
+    s_args.sender_idx = i;
+    events.push_back(all_cpus[i].spawn(SENDER_TASK, &s_args, sizeof(s_args)));
+  }
+  Event::merge_events(events).wait();
+  double t_end = Clock::current_time();
+
+  size_t total = all_cpus.size() * all_cpus.size() * num_messages;
+  log_app.print() << total << " messages in " << (t_end - t_start) << " s ("
+		  << (total / (t_end - t_start)) << "/s)";
+
+  // check the counts on every node
+  std::set<AddressSpace> checked;
+  events.clear();
+  for(size_t i = 0; i < all_cpus.size(); i++)
+    if(checked.insert(all_cpus[i].address_space()).second)
+      events.push_back(all_cpus[i].spawn(CHECK_TASK, 0, 0));
+  Event::merge_events(events).wait();
+
+  log_app.print() << "amsg_stress: all tests passed";
+}
+
+int main(int argc, char **argv)
+{
+  Runtime rt;
+
+  rt.init(&argc, &argv);
+
+  for(int i = 1; i < argc; i++) {
+    if(!strcmp(argv[i], "-n")) {
+      num_messages = atoi(argv[++i]);
+      continue;
+    }
+
+    if(!strcmp(argv[i], "-s")) {
+      max_payload = atoi(argv[++i]);
+      continue;
+    }
+  }
+
+  rt.register_task(TOP_LEVEL_TASK, top_level_task);
+  rt.register_task(SENDER_TASK, sender_task);
+  rt.register_task(RECEIVER_TASK, receiver_task);
+  rt.register_task(CHECK_TASK, check_task);
+
+  // every node builds the same list, ordered by processor id
+  {
+    std::set<Processor> cpus;
+    Machine::ProcessorQuery pq = Machine::ProcessorQuery(Machine::get_machine())
+      .only_kind(Processor::LOC_PROC);
+    for(Machine::ProcessorQuery::iterator it = pq.begin(); it != pq.end(); it++)
+      cpus.insert(*it);
+    all_cpus.assign(cpus.begin(), cpus.end());
+  }
+  received_counts = new int[all_cpus.size()];
+  for(size_t i = 0; i < all_cpus.size(); i++)
+    received_counts[i] = 0;
+
+  Processor p = Machine::ProcessorQuery(Machine::get_machine())
+    .only_kind(Processor::LOC_PROC)
+    .first();
+  assert(p.exists());
+
+  // collective launch of a single task - everybody gets the same finish event
+  Event e = rt.collective_spawn(p, TOP_LEVEL_TASK, 0, 0);
+
+  // request shutdown once that task is complete
+  rt.shutdown(e);
+
+  // now sleep this thread until that shutdown actually happens
+  rt.wait_for_shutdown();
+
+  delete[] received_counts;
+
+  return 0;
+}
@@ -0,0 +1,287 @@
+#include "realm.h"
+
+// needed to turn the machine snapshot on and off and to change the machine
+//  model underneath it
+#include "realm/machine_impl.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <vector>
+
+using namespace Realm;
+
+Logger log_app("app");
+
+// Task IDs, some IDs are reserved so start at first available number
+enum {
+  TOP_LEVEL_TASK = Processor::TASK_ID_FIRST_AVAILABLE+0,
+};
+
+// the forms of processor and memory queries that are checked - the last few
+//  in each list have more than one predicate and are never answered from the
+//  snapshot, but must still agree with it
+enum {
+  PQ_ALL,
+  PQ_KIND,
+  PQ_LOCAL,
+  PQ_SAME_SPACE_AS_MEM,
+  PQ_HAS_AFFINITY,
+  PQ_BEST_AFFINITY,
+  PQ_KIND_HAS_AFFINITY,
+  PQ_KIND_LOCAL_BEST_AFFINITY,
+  PQ_HAS_AND_BEST_AFFINITY,
+  NUM_PQ_FORMS,
+};
+
+enum {
+  MQ_ALL,
+  MQ_KIND,
+  MQ_LOCAL,
+  MQ_SAME_SPACE_AS_PROC,
+  MQ_HAS_PROC_AFFINITY,
+  MQ_BEST_PROC_AFFINITY,
+  MQ_HAS_MEM_AFFINITY,
+  MQ_BEST_MEM_AFFINITY,
+  MQ_KIND_HAS_PROC_AFFINITY,
+  MQ_PROC_AND_MEM_AFFINITY,
+  NUM_MQ_FORMS,
+};
+
+static Machine::ProcessorQuery proc_query(int form, Processor::Kind kind,
+					  Processor p, Memory m)
+{
+  Machine::ProcessorQuery q(Machine::get_machine());
+  switch(form) {
+  case PQ_ALL: break;
+  case PQ_KIND: q.only_kind(kind); break;
+  case PQ_LOCAL: q.local_address_space(); break;
+  case PQ_SAME_SPACE_AS_MEM: q.same_address_space_as(m); break;
+  case PQ_HAS_AFFINITY: q.has_affinity_to(m); break;
+  case PQ_BEST_AFFINITY: q.best_affinity_to(m); break;
+  case PQ_KIND_HAS_AFFINITY: q.only_kind(kind).has_affinity_to(m); break;
+  case PQ_KIND_LOCAL_BEST_AFFINITY: q.only_kind(kind).local_address_space().best_affinity_to(m); break;
+  case PQ_HAS_AND_BEST_AFFINITY: q.has_affinity_to(m).best_affinity_to(m); break;
+  default: assert(0);
+  }
+  return q;
+}
+
+static Machine::MemoryQuery mem_query(int form, Memory::Kind kind, Processor p, Memory m)
+{
+  Machine::MemoryQuery q(Machine::get_machine());
+  switch(form) {
+  case MQ_ALL: break;
+  case MQ_KIND: q.only_kind(kind); break;
+  case MQ_LOCAL: q.local_address_space(); break;
+  case MQ_SAME_SPACE_AS_PROC: q.same_address_space_as(p); break;
+  case MQ_HAS_PROC_AFFINITY: q.has_affinity_to(p); break;
+  case MQ_BEST_PROC_AFFINITY: q.best_affinity_to(p); break;
+  case MQ_HAS_MEM_AFFINITY: q.has_affinity_to(m); break;
+  case MQ_BEST_MEM_AFFINITY: q.best_affinity_to(m); break;
+  case MQ_KIND_HAS_PROC_AFFINITY: q.only_kind(kind).has_affinity_to(p); break;
+  case MQ_PROC_AND_MEM_AFFINITY: q.has_affinity_to(p).has_affinity_to(m); break;
+  default: assert(0);
+  }
+  return q;
+}
+
+// everything a query can report, in the order it reports it
+struct QueryResult {
+  size_t count;
+  ID::IDType first;
+  std::vector<ID::IDType> walk;
+  std::set<ID::IDType> randoms;
+
+  bool operator==(const QueryResult& other) const
+  {
+    return (count == other.count) && (first == other.first) && (walk == other.walk);
+  }
+};
+
+template <typename QT, typename T>
+static void run_query(const QT& q, QueryResult& result)
+{
+  result.count = q.count();
+  result.first = q.first().id;
+  result.walk.clear();
+  for(typename QT::iterator it = q.begin(); it != q.end(); it++)
+    result.walk.push_back((*it).id);
+  result.randoms.clear();
+  for(int i = 0; i < 10; i++) {
+    T r = q.random();
+    if(r.exists())
+      result.randoms.insert(r.id);
+  }
+}
+
+static std::ostream& operator<<(std::ostream& os, const QueryResult& r)
+{
+  os << "count=" << r.count << " first=" << std::hex << r.first << " walk=[";
+  for(size_t i = 0; i < r.walk.size(); i++)
+    os << (i ? " " : "") << r.walk[i];
+  return os << "]" << std::dec;
+}
+
+// runs a query with the snapshot and again with both the snapshot and the
+//  query cache turned off, which forces a scan of the machine model
+template <typename T, typename QT>
+static int compare_query(const char *phase, const char *what, int form,
+			 QT (*make_query)(int, T, Processor, Memory),
+			 T kind, Processor p, Memory m)
+{
+  typedef typename QT::iterator::value_type RT;
+
+  QueryResult snap, scan;
+  run_query<QT, RT>(make_query(form, kind, p, m), snap);
+
+  bool old_snapshot = Config::use_machine_snapshot;
+  bool old_cache = Config::use_machine_query_cache;
+  Config::use_machine_snapshot = false;
+  Config::use_machine_query_cache = false;
+  run_query<QT, RT>(make_query(form, kind, p, m), scan);
+  Config::use_machine_snapshot = old_snapshot;
+  Config::use_machine_query_cache = old_cache;
+
+  int errors = 0;
+  if(!(snap == scan)) {
+    log_app.error() << phase << ": " << what << " form " << form << " kind=" << kind
+		    << " proc=" << p << " mem=" << m << ": snapshot " << snap
+		    << " != scan " << scan;
+    errors++;
+  }
+  for(std::set<ID::IDType>::const_iterator it = snap.randoms.begin();
+      it != snap.randoms.end();
+      ++it)
+    if(std::find(scan.walk.begin(), scan.walk.end(), *it) == scan.walk.end()) {
+      log_app.error() << phase << ": " << what << " form " << form << " kind=" << kind
+		      << " proc=" << p << " mem=" << m << ": random() returned "
+		      << std::hex << *it << std::dec << " which does not match";
+      errors++;
+    }
+  return errors;
+}
+
+static bool query_contains(const Machine::MemoryQuery& q, Memory m)
+{
+  for(Machine::MemoryQuery::iterator it = q.begin(); it != q.end(); it++)
+    if(*it == m)
+      return true;
+  return false;
+}
+
+static int check_all_queries(const char *phase)
+{
+  Machine machine = Machine::get_machine();
+  std::set<Processor> all_procs;
+  std::set<Memory> all_mems;
+  machine.get_all_processors(all_procs);
+  machine.get_all_memories(all_mems);
+
+  std::set<Processor::Kind> proc_kinds;
+  for(std::set<Processor>::const_iterator it = all_procs.begin(); it != all_procs.end(); ++it)
+    proc_kinds.insert(it->kind());
+  std::set<Memory::Kind> mem_kinds;
+  for(std::set<Memory>::const_iterator it = all_mems.begin(); it != all_mems.end(); ++it)
+    mem_kinds.insert(it->kind());
+
+  int errors = 0;
+  size_t num_queries = 0;
+  for(int form = 0; form < NUM_PQ_FORMS; form++)
+    for(std::set<Processor::Kind>::const_iterator k = proc_kinds.begin(); k != proc_kinds.end(); ++k)
+      for(std::set<Memory>::const_iterator m = all_mems.begin(); m != all_mems.end(); ++m) {
+	errors += compare_query(phase, "processor query", form, proc_query,
+				*k, Processor::NO_PROC, *m);
+	num_queries++;
+      }
+
+  for(int form = 0; form < NUM_MQ_FORMS; form++)
+    for(std::set<Memory::Kind>::const_iterator k = mem_kinds.begin(); k != mem_kinds.end(); ++k)
+      for(std::set<Processor>::const_iterator p = all_procs.begin(); p != all_procs.end(); ++p)
+	for(std::set<Memory>::const_iterator m = all_mems.begin(); m != all_mems.end(); ++m) {
+	  errors += compare_query(phase, "memory query", form, mem_query,
+				  *k, *p, *m);
+	  num_queries++;
+	}
+
+  log_app.info() << phase << ": " << num_queries << " queries compared, "
+		 << all_procs.size() << " procs, " << all_mems.size() << " memories";
+  return errors;
+}
+
+void top_level_task(const void *args, size_t arglen,
+		    const void *userdata, size_t userlen, Processor p)
+{
+  log_app.print() << "testing machine query snapshot";
+
+  int errors = check_all_queries("initial");
+
+  // give this processor a better affinity to a memory than any other has - a
+  //  snapshot taken before this is now stale, and the next query must see this
+  //  processor as the memory's only best processor
+  Machine machine = Machine::get_machine();
+  Memory target = Machine::MemoryQuery(machine).has_affinity_to(p).first();
+  assert(target.exists());
+  std::vector<Machine::ProcessorMemoryAffinity> pmas;
+  machine.get_proc_mem_affinity(pmas, Processor::NO_PROC, target);
+  unsigned best_bandwidth = 0;
+  for(size_t i = 0; i < pmas.size(); i++)
+    if(pmas[i].bandwidth > best_bandwidth)
+      best_bandwidth = pmas[i].bandwidth;
+  size_t best_before = 0;
+  for(size_t i = 0; i < pmas.size(); i++)
+    if(query_contains(Machine::MemoryQuery(machine).best_affinity_to(pmas[i].p), target))
+      best_before++;
+
+  Machine::ProcessorMemoryAffinity pma;
+  pma.p = p;
+  pma.m = target;
+  pma.bandwidth = best_bandwidth + 1;
+  pma.latency = 1;
+  Realm::get_machine()->add_proc_mem_affinity(pma);
+
+  for(size_t i = 0; i < pmas.size(); i++) {
+    bool expected = (pmas[i].p == p);
+    if(query_contains(Machine::MemoryQuery(machine).best_affinity_to(pmas[i].p), target) != expected) {
+      log_app.error() << "stale snapshot: best processor for " << target << " is "
+		      << (expected ? "not " : "still ") << pmas[i].p;
+      errors++;
+    }
+  }
+  log_app.info() << target << " had " << best_before << " best processors, now only " << p;
+
+  errors += check_all_queries("after invalidation");
+
+  if(errors > 0) {
+    log_app.error() << errors << " errors";
+    exit(1);
+  }
+  log_app.print() << "machine_snapshot: all tests passed";
+}
+
+int main(int argc, char **argv)
+{
+  Runtime rt;
+
+  rt.init(&argc, &argv);
+
+  rt.register_task(TOP_LEVEL_TASK, top_level_task);
+
+  Processor p = Machine::ProcessorQuery(Machine::get_machine())
+    .only_kind(Processor::LOC_PROC)
+    .first();
+  assert(p.exists());
+
+  // collective launch of a single task - everybody gets the same finish event
+  Event e = rt.collective_spawn(p, TOP_LEVEL_TASK, 0, 0);
+
+  // request shutdown once that task is complete
+  rt.shutdown(e);
+
+  // now sleep this thread until that shutdown actually happens
+  rt.wait_for_shutdown();
+
+  return 0;
+}
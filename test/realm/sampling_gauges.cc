@@ -0,0 +1,222 @@
+#include "realm.h"
+#include "realm/sampling.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+using namespace Realm;
+
+Logger log_app("app");
+
+// Task IDs, some IDs are reserved so start at first available number
+enum {
+  TOP_LEVEL_TASK = Processor::TASK_ID_FIRST_AVAILABLE+0,
+};
+
+// steps a float, a double and a signed integer gauge through a sequence of
+//  values with the sampling profiler running, then converts the samples with
+//  rprof_to_csv.py and checks that every sampled value is one that was set -
+//  run with -realm:prof_mmap or -realm:prof_compress to check the delta+varint
+//  encoding, or without either for the raw one
+
+int num_steps = 16;
+int hold_ms = 5;
+const char *samples_file = "sampling_gauges_%.dat";
+const char *csv_file = "sampling_gauges.csv";
+
+// none of the floating-point values are integers, so any truncation shows up
+static double float_value(int step) { return -2.4375 + 0.375 * step; }
+static double double_value(int step) { return 4096.25 * step + 0.0625; }
+static double integer_value(int step) { return -1000000007.0 * step; }
+
+static const char *gauge_names[] = { "sampling_gauges/float",
+				     "sampling_gauges/double",
+				     "sampling_gauges/long_long" };
+static double (*gauge_values[])(int) = { float_value, double_value, integer_value };
+static const int NUM_GAUGES = sizeof(gauge_names) / sizeof(gauge_names[0]);
+
+void top_level_task(const void *args, size_t arglen,
+		    const void *userdata, size_t userlen, Processor p)
+{
+  log_app.print() << "stepping gauges: steps=" << num_steps << " hold=" << hold_ms << " ms";
+
+  ProfilingGauges::AbsoluteGauge<float> *g_float =
+    new ProfilingGauges::AbsoluteGauge<float>(gauge_names[0], float_value(0));
+  ProfilingGauges::AbsoluteGauge<double> *g_double =
+    new ProfilingGauges::AbsoluteGauge<double>(gauge_names[1], double_value(0));
+  ProfilingGauges::AbsoluteGauge<long long> *g_integer =
+    new ProfilingGauges::AbsoluteGauge<long long>(gauge_names[2], (long long)integer_value(0));
+
+  for(int step = 0; step < num_steps; step++) {
+    *g_float = float_value(step);
+    *g_double = double_value(step);
+    *g_integer = (long long)integer_value(step);
+    usleep(hold_ms * 1000);
+  }
+
+  // the samplers flush what they have once they notice the gauges are gone
+  delete g_float;
+  delete g_double;
+  delete g_integer;
+}
+
+static std::string tools_dir(void)
+{
+  const char *rt_dir = getenv("LG_RT_DIR");
+  return std::string(rt_dir ? rt_dir : "../../runtime") + "/../tools";
+}
+
+static std::vector<std::string> split_csv(const char *line)
+{
+  std::vector<std::string> fields;
+  const char *start = line;
+  while(true) {
+    const char *end = start + strcspn(start, ",\n");
+    fields.push_back(std::string(start, end - start));
+    if(*end != ',')
+      break;
+    start = end + 1;
+  }
+  return fields;
+}
+
+// the runtime has shut down by the time this runs, so it reports with printf
+static int check_csv(const char *filename)
+{
+  FILE *f = fopen(filename, "r");
+  if(!f) {
+    fprintf(stderr, "could not open '%s'\n", filename);
+    return 1;
+  }
+
+  // the first header line has each gauge's name over its first column
+  int errors = 0;
+  char line[4096];
+  int columns[NUM_GAUGES];
+  if(!fgets(line, sizeof(line), f)) {
+    fprintf(stderr, "'%s' is empty\n", filename);
+    fclose(f);
+    return 1;
+  }
+  std::vector<std::string> header = split_csv(line);
+  for(int g = 0; g < NUM_GAUGES; g++) {
+    columns[g] = -1;
+    for(size_t c = 0; c < header.size(); c++)
+      if(header[c] == gauge_names[g])
+	columns[g] = c;
+    if(columns[g] < 0) {
+      fprintf(stderr, "no column for gauge '%s'\n", gauge_names[g]);
+      errors++;
+    }
+  }
+  if(errors > 0) {
+    fclose(f);
+    return errors;
+  }
+  // skip the line of column names
+  if(!fgets(line, sizeof(line), f))
+    line[0] = 0;
+
+  std::set<double> seen[NUM_GAUGES];
+  int rows = 0;
+  while(fgets(line, sizeof(line), f)) {
+    std::vector<std::string> fields = split_csv(line);
+    rows++;
+    for(int g = 0; g < NUM_GAUGES; g++) {
+      if((columns[g] >= (int)fields.size()) || fields[columns[g]].empty())
+	continue;
+      double v = strtod(fields[columns[g]].c_str(), 0);
+      bool valid = false;
+      for(int step = 0; step < num_steps; step++)
+	if(v == gauge_values[g](step))
+	  valid = true;
+      if(!valid) {
+	fprintf(stderr, "%s: sampled value %s was never set\n",
+		gauge_names[g], fields[columns[g]].c_str());
+	errors++;
+      }
+      seen[g].insert(v);
+    }
+  }
+  fclose(f);
+
+  for(int g = 0; g < NUM_GAUGES; g++) {
+    printf("%s: %d distinct values in %d samples\n",
+	   gauge_names[g], (int)seen[g].size(), rows);
+    if(seen[g].size() < 2) {
+      fprintf(stderr, "%s: the gauge's changes were not sampled\n", gauge_names[g]);
+      errors++;
+    }
+  }
+  return errors;
+}
+
+int main(int argc, char **argv)
+{
+  Runtime rt;
+
+  // sample every ms
+  std::vector<char *> args(argv, argv + argc);
+  const char *extra_args[] = { "-realm:prof", "1",
+			       "-realm:prof_file", samples_file,
+			       "-realm:prof_sample_interval", "1000000" };
+  for(size_t i = 0; i < sizeof(extra_args) / sizeof(extra_args[0]); i++)
+    args.push_back(const_cast<char *>(extra_args[i]));
+  int new_argc = args.size();
+  args.push_back(0);
+  char **new_argv = &args[0];
+
+  rt.init(&new_argc, &new_argv);
+
+  for(int i = 1; i < new_argc; i++) {
+    if(!strcmp(new_argv[i], "-s")) {
+      num_steps = atoi(new_argv[++i]);
+      continue;
+    }
+
+    if(!strcmp(new_argv[i], "-h")) {
+      hold_ms = atoi(new_argv[++i]);
+      continue;
+    }
+  }
+
+  rt.register_task(TOP_LEVEL_TASK, top_level_task);
+
+  Processor p = Machine::ProcessorQuery(Machine::get_machine())
+    .only_kind(Processor::LOC_PROC)
+    .first();
+  assert(p.exists());
+
+  // collective launch of a single task - everybody gets the same finish event
+  Event e = rt.collective_spawn(p, TOP_LEVEL_TASK, 0, 0);
+
+  // request shutdown once that task is complete
+  rt.shutdown(e);
+
+  // now sleep this thread until that shutdown actually happens - the last
+  //  samples are written as the runtime shuts down
+  rt.wait_for_shutdown();
+
+  std::string samples = samples_file;
+  samples.replace(samples.find('%'), 1, "0");
+  std::string command = ("python " + tools_dir() + "/rprof_to_csv.py -i ^sampling_gauges/ " +
+			 samples + " " + csv_file);
+  if(system(command.c_str()) != 0) {
+    fprintf(stderr, "FAILED: %s\n", command.c_str());
+    return 1;
+  }
+
+  if(check_csv(csv_file) > 0) {
+    fprintf(stderr, "FAILED: sampled gauge values in '%s' are wrong\n", csv_file);
+    return 1;
+  }
+  remove(samples.c_str());
+  remove(csv_file);
+  printf("SUCCESS\n");
+  return 0;
+}
@@ -0,0 +1,306 @@
+#include "realm.h"
+
+// needed to look at the shared memory transport's statistics and mappings
+#include "realm/activemsg.h"
+#include "realm/shm_transport.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <vector>
+
+using namespace Realm;
+
+Logger log_app("app");
+
+// Task IDs, some IDs are reserved so start at first available number
+enum {
+  TOP_LEVEL_TASK = Processor::TASK_ID_FIRST_AVAILABLE+0,
+  PING_TASK,
+  PONG_TASK,
+  CHECK_COPY_TASK,
+};
+
+// runs with two or more processes on one host and -ll:shm - every other
+//  process gets tasks with payloads both smaller and larger than a ring
+//  record (which are sent as fragments), and a copy into its SYSTEM_MEM,
+//  which should be done directly through the shared mapping rather than
+//  by sending the data in messages
+
+int num_pings = 20;
+int copy_elements = 1 << 20;
+
+struct PingArgs {
+  Processor reply_to;
+  int seq;
+  int payload_len;
+  // followed by 'payload_len' bytes of payload
+};
+
+struct CheckCopyArgs {
+  RegionInstance inst;
+  int elements;
+};
+
+static const int payload_sizes[] = { 0, 8, 1000, 8000, 20000, 60000 };
+static const int NUM_PAYLOAD_SIZES = sizeof(payload_sizes) / sizeof(payload_sizes[0]);
+
+int pongs_received = 0;
+int payload_errors = 0;
+
+static unsigned char payload_byte(int seq, int i)
+{
+  return (unsigned char)(seq * 13 + i * 7 + (i >> 8));
+}
+
+static bool check_payload(const void *args, size_t arglen)
+{
+  const PingArgs& p_args = *static_cast<const PingArgs *>(args);
+  if(arglen != (sizeof(PingArgs) + p_args.payload_len))
+    return false;
+  const unsigned char *payload = static_cast<const unsigned char *>(args) + sizeof(PingArgs);
+  for(int i = 0; i < p_args.payload_len; i++)
+    if(payload[i] != payload_byte(p_args.seq, i))
+      return false;
+  return true;
+}
+
+void pong_task(const void *args, size_t arglen,
+	       const void *userdata, size_t userlen, Processor p)
+{
+  if(!check_payload(args, arglen)) {
+    log_app.error() << "corrupt pong: seq=" << static_cast<const PingArgs *>(args)->seq
+		    << " arglen=" << arglen;
+    __sync_fetch_and_add(&payload_errors, 1);
+  }
+  __sync_fetch_and_add(&pongs_received, 1);
+}
+
+// sends the same payload straight back
+void ping_task(const void *args, size_t arglen,
+	       const void *userdata, size_t userlen, Processor p)
+{
+  const PingArgs& p_args = *static_cast<const PingArgs *>(args);
+  if(!check_payload(args, arglen)) {
+    log_app.error() << "corrupt ping on " << p << ": seq=" << p_args.seq
+		    << " arglen=" << arglen;
+    exit(1);
+  }
+  p_args.reply_to.spawn(PONG_TASK, args, arglen).wait();
+}
+
+void check_copy_task(const void *args, size_t arglen,
+		     const void *userdata, size_t userlen, Processor p)
+{
+  const CheckCopyArgs& c_args = *static_cast<const CheckCopyArgs *>(args);
+  AffineAccessor<int,1> acc(c_args.inst, 0 /* offset */);
+  int errors = 0;
+  for(int i = 0; i < c_args.elements; i++)
+    if(acc[i] != (i ^ 0x5a5a5a)) {
+      if(errors++ < 10)
+	log_app.error() << "copy into " << c_args.inst << ": element " << i
+			<< " = " << acc[i];
+    }
+  if(errors > 0) {
+    log_app.error() << errors << " wrong elements on " << p;
+    exit(1);
+  }
+}
+
+static int test_messages(Processor p, Processor peer_proc)
+{
+  SharedMemoryTransport::Stats before, after;
+  get_shm_transport()->get_stats(before);
+
+  int old_pongs = pongs_received;
+  std::vector<Event> events;
+  int max_len = payload_sizes[NUM_PAYLOAD_SIZES - 1];
+  std::vector<char> buffer(sizeof(PingArgs) + max_len);
+  for(int seq = 0; seq < num_pings; seq++) {
+    PingArgs& p_args = *reinterpret_cast<PingArgs *>(&buffer[0]);
+    p_args.reply_to = p;
+    p_args.seq = seq;
+    p_args.payload_len = payload_sizes[seq % NUM_PAYLOAD_SIZES];
+    unsigned char *payload = reinterpret_cast<unsigned char *>(&buffer[sizeof(PingArgs)]);
+    for(int i = 0; i < p_args.payload_len; i++)
+      payload[i] = payload_byte(seq, i);
+    events.push_back(peer_proc.spawn(PING_TASK, &buffer[0],
+				     sizeof(PingArgs) + p_args.payload_len));
+  }
+  Event::merge_events(events).wait();
+
+  get_shm_transport()->get_stats(after);
+  log_app.info() << "pings to " << peer_proc << ": " << (after.msgs_sent - before.msgs_sent)
+		 << " messages (" << (after.fragments_sent - before.fragments_sent)
+		 << " fragments) sent, " << (after.msgs_rcvd - before.msgs_rcvd) << " received";
+
+  int errors = 0;
+  if((pongs_received - old_pongs) != num_pings) {
+    log_app.error() << "received " << (pongs_received - old_pongs) << " pongs from "
+		    << peer_proc << ", expected " << num_pings;
+    errors++;
+  }
+  if((after.msgs_sent - before.msgs_sent) < (uint64_t)num_pings) {
+    log_app.error() << "pings to " << peer_proc << " did not go through shared memory";
+    errors++;
+  }
+  if(after.fragments_sent == before.fragments_sent) {
+    log_app.error() << "large pings to " << peer_proc << " were not sent as fragments";
+    errors++;
+  }
+  if((after.msgs_rcvd - before.msgs_rcvd) < (uint64_t)num_pings) {
+    log_app.error() << "pongs from " << peer_proc << " did not come through shared memory";
+    errors++;
+  }
+  return errors;
+}
+
+static int test_copy(Memory src_mem, Memory peer_mem, Processor peer_proc)
+{
+  int errors = 0;
+  if(!get_shm_transport()->get_shared_memory(peer_mem.id)) {
+    log_app.error() << peer_mem << " is not mapped here";
+    return 1;
+  }
+
+  IndexSpace<1> is(Rect<1>(0, copy_elements - 1));
+  std::vector<size_t> field_sizes(1, sizeof(int));
+  RegionInstance src_inst, dst_inst;
+  RegionInstance::create_instance(src_inst, src_mem, is, field_sizes,
+				  0 /*SOA*/, ProfilingRequestSet()).wait();
+  RegionInstance::create_instance(dst_inst, peer_mem, is, field_sizes,
+				  0 /*SOA*/, ProfilingRequestSet()).wait();
+  {
+    AffineAccessor<int,1> acc(src_inst, 0 /* offset */);
+    for(int i = 0; i < copy_elements; i++)
+      acc[i] = (i ^ 0x5a5a5a);
+  }
+
+  SharedMemoryTransport::Stats before, after;
+  get_shm_transport()->get_stats(before);
+  std::vector<CopySrcDstField> srcs(1), dsts(1);
+  srcs[0].set_field(src_inst, 0, sizeof(int));
+  dsts[0].set_field(dst_inst, 0, sizeof(int));
+  is.copy(srcs, dsts, ProfilingRequestSet()).wait();
+  get_shm_transport()->get_stats(after);
+
+  // a copy that went out in messages would have sent at least the data
+  size_t copy_bytes = copy_elements * sizeof(int);
+  uint64_t sent = after.bytes_sent - before.bytes_sent;
+  log_app.info() << "copy to " << peer_mem << ": " << copy_bytes << " bytes, "
+		 << sent << " bytes of messages";
+  if(sent >= copy_bytes) {
+    log_app.error() << "copy to " << peer_mem << " sent " << sent
+		    << " bytes of messages instead of copying directly";
+    errors++;
+  }
+
+  CheckCopyArgs c_args;
+  c_args.inst = dst_inst;
+  c_args.elements = copy_elements;
+  peer_proc.spawn(CHECK_COPY_TASK, &c_args, sizeof(c_args)).wait();
+
+  src_inst.destroy();
+  dst_inst.destroy();
+  return errors;
+}
+
+void top_level_task(const void *args, size_t arglen,
+		    const void *userdata, size_t userlen, Processor p)
+{
+  Machine machine = Machine::get_machine();
+  std::set<AddressSpace> spaces;
+  Machine::ProcessorQuery pq = Machine::ProcessorQuery(machine).only_kind(Processor::LOC_PROC);
+  for(Machine::ProcessorQuery::iterator it = pq.begin(); it != pq.end(); it++)
+    spaces.insert((*it).address_space());
+  if(spaces.size() < 2) {
+    log_app.print() << "shm_transport: needs more than one process - skipping";
+    return;
+  }
+
+  SharedMemoryTransport *shm = get_shm_transport();
+  if(!shm || (shm->num_local_peers() == 0)) {
+    log_app.error() << "shared memory transport is not in use - run with -ll:shm";
+    exit(1);
+  }
+  log_app.print() << "testing shared memory transport: processes=" << spaces.size()
+		  << " local peers=" << shm->num_local_peers();
+
+  Memory src_mem = Machine::MemoryQuery(machine).only_kind(Memory::SYSTEM_MEM)
+    .local_address_space().first();
+  assert(src_mem.exists());
+
+  int errors = 0;
+  for(std::set<AddressSpace>::const_iterator it = spaces.begin(); it != spaces.end(); ++it) {
+    if((*it == p.address_space()) || !shm->is_local_peer(*it))
+      continue;
+
+    Processor peer_proc = Processor::NO_PROC;
+    for(Machine::ProcessorQuery::iterator it2 = pq.begin(); it2 != pq.end(); it2++)
+      if((*it2).address_space() == *it) {
+	peer_proc = *it2;
+	break;
+      }
+    Memory peer_mem = Memory::NO_MEMORY;
+    Machine::MemoryQuery mq = Machine::MemoryQuery(machine).only_kind(Memory::SYSTEM_MEM);
+    for(Machine::MemoryQuery::iterator it2 = mq.begin(); it2 != mq.end(); it2++)
+      if((*it2).address_space() == *it) {
+	peer_mem = *it2;
+	break;
+      }
+    assert(peer_proc.exists() && peer_mem.exists());
+
+    errors += test_messages(p, peer_proc);
+    errors += test_copy(src_mem, peer_mem, peer_proc);
+  }
+
+  if(payload_errors > 0)
+    errors += payload_errors;
+  if(errors > 0) {
+    log_app.error() << errors << " errors";
+    exit(1);
+  }
+  log_app.print() << "shm_transport: all tests passed";
+}
+
+int main(int argc, char **argv)
+{
+  Runtime rt;
+
+  rt.init(&argc, &argv);
+
+  for(int i = 1; i < argc; i++) {
+    if(!strcmp(argv[i], "-p")) {
+      num_pings = atoi(argv[++i]);
+      continue;
+    }
+
+    if(!strcmp(argv[i], "-n")) {
+      copy_elements = atoi(argv[++i]);
+      continue;
+    }
+  }
+
+  rt.register_task(TOP_LEVEL_TASK, top_level_task);
+  rt.register_task(PING_TASK, ping_task);
+  rt.register_task(PONG_TASK, pong_task);
+  rt.register_task(CHECK_COPY_TASK, check_copy_task);
+
+  // the first processor in the whole machine runs the test
+  Processor p = Machine::ProcessorQuery(Machine::get_machine())
+    .only_kind(Processor::LOC_PROC)
+    .first();
+  assert(p.exists());
+
+  // collective launch of a single task - everybody gets the same finish event
+  Event e = rt.collective_spawn(p, TOP_LEVEL_TASK, 0, 0);
+
+  // request shutdown once that task is complete
+  rt.shutdown(e);
+
+  // now sleep this thread until that shutdown actually happens
+  rt.wait_for_shutdown();
+
+  return 0;
+}
@@ -0,0 +1,242 @@
+#include "realm.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace Realm;
+
+Logger log_app("app");
+
+// Task IDs, some IDs are reserved so start at first available number
+enum {
+  TOP_LEVEL_TASK = Processor::TASK_ID_FIRST_AVAILABLE+0,
+};
+
+int width = 37;
+int height = 11;
+int num_chunks = 3;
+
+// every element of an instance holds its own index, so a span iterator's
+//  visits can be counted per element
+template <int N>
+static RegionInstance create_numbered_instance(Memory m, const Rect<N>& bounds)
+{
+  std::vector<size_t> field_sizes(1, sizeof(int));
+  RegionInstance inst;
+  RegionInstance::create_instance(inst, m, IndexSpace<N>(bounds), field_sizes,
+				  0 /*SOA*/, ProfilingRequestSet()).wait();
+  AffineAccessor<int,N> acc(inst, 0 /* offset */);
+  int idx = 0;
+  for(PointInRectIterator<N,int> pir(bounds); pir.valid; pir.step())
+    acc[pir.p] = idx++;
+  return inst;
+}
+
+// walks 'is' (restricted to each of 'chunks' in turn) with an
+//  AffineSpanIterator and checks that every point is visited exactly once, that
+//  spans follow 'inner_dim' and that is_dense matches 'expect_dense'
+template <int N>
+static int check_spans(const char *what, const IndexSpace<N>& is,
+		       const AffineAccessor<int,N>& acc, size_t num_elements,
+		       const std::vector<Rect<N> >& chunks,
+		       int inner_dim, bool expect_dense)
+{
+  int errors = 0;
+  std::vector<int> expected(num_elements, 0), visited(num_elements, 0);
+  // the chunks are meant to be disjoint, so each point of the space that lies
+  //  in any chunk should be visited once
+  for(IndexSpaceIterator<N,int> isi(is); isi.valid; isi.step())
+    for(PointInRectIterator<N,int> pir(isi.rect); pir.valid; pir.step())
+      for(size_t c = 0; c < chunks.size(); c++)
+	if(chunks[c].contains(pir.p)) {
+	  expected[acc[pir.p]] = 1;
+	  break;
+	}
+
+  size_t num_spans = 0;
+  for(size_t c = 0; c < chunks.size(); c++)
+    for(AffineSpanIterator<int,N> it(is, acc, chunks[c]); it.valid; it.step()) {
+      num_spans++;
+      if(!chunks[c].contains(it.start) || !is.contains(it.start)) {
+	log_app.error() << what << ": span starts outside space: " << it.start;
+	errors++;
+      }
+      if(it.base != acc.ptr(it.start)) {
+	log_app.error() << what << ": span base does not match start " << it.start;
+	errors++;
+      }
+      if(it.stride != acc.strides[inner_dim]) {
+	log_app.error() << what << ": span stride " << it.stride << " != " << acc.strides[inner_dim];
+	errors++;
+      }
+      if((it.extent > 1) && (it.is_dense() != expect_dense)) {
+	log_app.error() << what << ": span at " << it.start << " dense=" << it.is_dense();
+	errors++;
+      }
+      Point<N> p = it.start;
+      for(size_t i = 0; i < it.extent; i++) {
+	if(&it.element(i) != acc.ptr(p)) {
+	  log_app.error() << what << ": element " << i << " of span at " << it.start
+			  << " is not point " << p;
+	  errors++;
+	}
+	visited[it.element(i)]++;
+	p[inner_dim]++;
+      }
+    }
+
+  for(size_t i = 0; i < num_elements; i++)
+    if(visited[i] != expected[i]) {
+      log_app.error() << what << ": element " << i << " visited " << visited[i]
+		      << " times, expected " << expected[i];
+      errors++;
+    }
+  log_app.info() << what << ": " << num_spans << " spans";
+  return errors;
+}
+
+template <int N>
+static std::vector<Rect<N> > whole(const Rect<N>& bounds)
+{
+  return std::vector<Rect<N> >(1, bounds);
+}
+
+template <int N>
+static std::vector<Rect<N> > chunked(const Rect<N>& bounds,
+				     const AffineAccessor<int,N>& acc)
+{
+  std::vector<Rect<N> > chunks;
+  for(int i = 0; i < num_chunks; i++)
+    chunks.push_back(AffineSpanIterator<int,N>::chunk_bounds(bounds, acc, num_chunks, i));
+  return chunks;
+}
+
+static int test_1d(Memory m)
+{
+  int errors = 0;
+  Rect<1> bounds(0, width * height - 1);
+  RegionInstance inst = create_numbered_instance(m, bounds);
+  AffineAccessor<int,1> acc(inst, 0 /* offset */);
+  size_t count = bounds.volume();
+
+  IndexSpace<1> dense(bounds);
+  errors += check_spans("1d dense", dense, acc, count, whole(bounds), 0, true);
+  errors += check_spans("1d chunked", dense, acc, count, chunked(bounds, acc), 0, true);
+
+  // every third run of 'width' points
+  std::vector<Rect<1> > rects;
+  for(int i = 0; i < height; i += 3)
+    rects.push_back(Rect<1>(i * width, i * width + width - 1));
+  IndexSpace<1> sparse(rects);
+  sparse.make_valid().wait();
+  errors += check_spans("1d sparse", sparse, acc, count, whole(bounds), 0, true);
+  errors += check_spans("1d sparse chunked", sparse, acc, count, chunked(bounds, acc), 0, true);
+
+  inst.destroy();
+  return errors;
+}
+
+static int test_2d(Memory m)
+{
+  int errors = 0;
+  Rect<2> bounds(Point<2>(0, 0), Point<2>(width - 1, height - 1));
+  RegionInstance inst = create_numbered_instance(m, bounds);
+  AffineAccessor<int,2> acc(inst, 0 /* offset */);
+  size_t count = bounds.volume();
+
+  IndexSpace<2> dense(bounds);
+  errors += check_spans("2d dense", dense, acc, count, whole(bounds), 0, true);
+  errors += check_spans("2d chunked", dense, acc, count, chunked(bounds, acc), 0, true);
+
+  // a restriction that cuts through the middle of the space
+  Rect<2> middle(Point<2>(3, 2), Point<2>(width - 4, height - 3));
+  errors += check_spans("2d restricted", dense, acc, count, whole(middle), 0, true);
+
+  // a staircase of single-row rectangles
+  std::vector<Rect<2> > rects;
+  for(int i = 0; i < height; i += 2)
+    rects.push_back(Rect<2>(Point<2>(i, i), Point<2>(i + width / 2, i)));
+  IndexSpace<2> sparse(rects);
+  sparse.make_valid().wait();
+  errors += check_spans("2d sparse", sparse, acc, count, whole(bounds), 0, true);
+  errors += check_spans("2d sparse chunked", sparse, acc, count, chunked(bounds, acc), 0, true);
+
+  // a transposed view of the same instance has its smallest stride in the
+  //  second dimension, so spans must run along that one instead
+  Matrix<2,2,int> transpose;
+  transpose.rows[0] = Point<2>(0, 1);
+  transpose.rows[1] = Point<2>(1, 0);
+  AffineAccessor<int,2> tacc(inst, transpose, Point<2>(0, 0), 0 /* offset */);
+  Rect<2> tbounds(Point<2>(0, 0), Point<2>(height - 1, width - 1));
+  IndexSpace<2> tdense(tbounds);
+  errors += check_spans("2d transposed", tdense, tacc, count, whole(tbounds), 1, true);
+  errors += check_spans("2d transposed chunked", tdense, tacc, count,
+			chunked(tbounds, tacc), 1, true);
+
+  inst.destroy();
+  return errors;
+}
+
+void top_level_task(const void *args, size_t arglen,
+		    const void *userdata, size_t userlen, Processor p)
+{
+  log_app.print() << "testing AffineSpanIterator: width=" << width << " height=" << height
+		  << " chunks=" << num_chunks;
+
+  Memory m = Machine::MemoryQuery(Machine::get_machine()).only_kind(Memory::SYSTEM_MEM).best_affinity_to(p).first();
+  assert(m.exists());
+
+  int errors = 0;
+  errors += test_1d(m);
+  errors += test_2d(m);
+
+  if(errors > 0) {
+    log_app.error() << errors << " errors";
+    exit(1);
+  }
+  log_app.print() << "span_iterator: all tests passed";
+}
+
+int main(int argc, char **argv)
+{
+  Runtime rt;
+
+  rt.init(&argc, &argv);
+
+  for(int i = 1; i < argc; i++) {
+    if(!strcmp(argv[i], "-x")) {
+      width = atoi(argv[++i]);
+      continue;
+    }
+
+    if(!strcmp(argv[i], "-y")) {
+      height = atoi(argv[++i]);
+      continue;
+    }
+
+    if(!strcmp(argv[i], "-c")) {
+      num_chunks = atoi(argv[++i]);
+      continue;
+    }
+  }
+
+  rt.register_task(TOP_LEVEL_TASK, top_level_task);
+
+  Processor p = Machine::ProcessorQuery(Machine::get_machine())
+    .only_kind(Processor::LOC_PROC)
+    .first();
+  assert(p.exists());
+
+  // collective launch of a single task - everybody gets the same finish event
+  Event e = rt.collective_spawn(p, TOP_LEVEL_TASK, 0, 0);
+
+  // request shutdown once that task is complete
+  rt.shutdown(e);
+
+  // now sleep this thread until that shutdown actually happens
+  rt.wait_for_shutdown();
+
+  return 0;
+}
@@ -0,0 +1,188 @@
+#include "realm.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace Realm;
+
+Logger log_app("app");
+
+// Task IDs, some IDs are reserved so start at first available number
+enum {
+  TOP_LEVEL_TASK = Processor::TASK_ID_FIRST_AVAILABLE+0,
+};
+
+int num_pieces = 8;
+int piece_size = 10;
+
+template <int N, typename T>
+static const std::vector<SparsityMapEntry<N,T> > *entry_list(IndexSpace<N,T>& is)
+{
+  assert(is.sparsity.exists());
+  is.make_valid().wait();
+  return &(is.sparsity.impl()->get_entries());
+}
+
+template <int N, typename T>
+static int check_same_points(const IndexSpace<N,T>& a, const IndexSpace<N,T>& b,
+			     const char *what)
+{
+  int errors = 0;
+  for(PointInRectIterator<N,T> pir(a.bounds.union_bbox(b.bounds)); pir.valid; pir.step())
+    if(a.contains(pir.p) != b.contains(pir.p)) {
+      log_app.error() << what << ": mismatch at " << pir.p;
+      errors++;
+    }
+  return errors;
+}
+
+// two maps with equal contents must share one entry list, and a map with
+//  different contents must not
+static int test_1d(Memory m)
+{
+  int errors = 0;
+
+  // every other piece of the range is present
+  std::vector<Point<1> > points;
+  for(int i = 0; i < num_pieces; i += 2)
+    for(int j = 0; j < piece_size; j++)
+      points.push_back(Point<1>(i * piece_size + j));
+
+  IndexSpace<1> a(points);
+  IndexSpace<1> b(points);
+  if(a.sparsity == b.sparsity) {
+    log_app.error() << "1d: separately constructed spaces have the same sparsity map";
+    errors++;
+  }
+  if(entry_list(a) != entry_list(b)) {
+    log_app.error() << "1d: equal contents not interned: " << a << " " << b;
+    errors++;
+  }
+  errors += check_same_points(a, b, "1d");
+
+  // the same points computed by a dependent partitioning operation
+  IndexSpace<1> is(Rect<1>(0, num_pieces * piece_size - 1));
+  std::vector<size_t> field_sizes(1, sizeof(int));
+  RegionInstance inst;
+  RegionInstance::create_instance(inst, m, is, field_sizes,
+				  0 /*SOA*/, ProfilingRequestSet()).wait();
+  AffineAccessor<int,1> acc(inst, 0 /* offset */);
+  for(int i = 0; i < num_pieces * piece_size; i++)
+    acc[i] = (i / piece_size) % 2;
+
+  std::vector<FieldDataDescriptor<IndexSpace<1>, int> > field_data(1);
+  field_data[0].index_space = is;
+  field_data[0].inst = inst;
+  field_data[0].field_offset = 0;
+  std::vector<int> colors;
+  colors.push_back(0);
+  colors.push_back(1);
+  std::vector<IndexSpace<1> > subspaces;
+  is.create_subspaces_by_field(field_data, colors, subspaces,
+			       ProfilingRequestSet()).wait();
+  if(entry_list(subspaces[0]) != entry_list(a)) {
+    log_app.error() << "1d: by-field result not interned with equal constructed space: "
+		    << subspaces[0] << " " << a;
+    errors++;
+  }
+  errors += check_same_points(subspaces[0], a, "1d by-field");
+
+  // the other color has different contents
+  if(entry_list(subspaces[1]) == entry_list(a)) {
+    log_app.error() << "1d: different contents share an entry list: "
+		    << subspaces[1] << " " << a;
+    errors++;
+  }
+
+  inst.destroy();
+  return errors;
+}
+
+// N>1 entries are sorted before interning, so the order in which rectangles
+//  are supplied must not matter
+static int test_2d(void)
+{
+  int errors = 0;
+
+  std::vector<Rect<2> > rects;
+  for(int i = 0; i < num_pieces; i++)
+    rects.push_back(Rect<2>(Point<2>(i * piece_size, (i % 3) * piece_size),
+			    Point<2>(i * piece_size + 3, (i % 3) * piece_size + 5)));
+  std::vector<Rect<2> > reversed(rects.rbegin(), rects.rend());
+
+  IndexSpace<2> a(rects);
+  IndexSpace<2> b(reversed);
+  if(entry_list(a) != entry_list(b)) {
+    log_app.error() << "2d: equal contents in different order not interned: " << a << " " << b;
+    errors++;
+  }
+  errors += check_same_points(a, b, "2d");
+
+  // dropping one rectangle changes the contents
+  rects.pop_back();
+  IndexSpace<2> c(rects);
+  if(entry_list(c) == entry_list(a)) {
+    log_app.error() << "2d: different contents share an entry list: " << c << " " << a;
+    errors++;
+  }
+
+  return errors;
+}
+
+void top_level_task(const void *args, size_t arglen,
+		    const void *userdata, size_t userlen, Processor p)
+{
+  log_app.print() << "testing sparsity map interning: pieces=" << num_pieces << " size=" << piece_size;
+
+  Memory m = Machine::MemoryQuery(Machine::get_machine()).only_kind(Memory::SYSTEM_MEM).best_affinity_to(p).first();
+  assert(m.exists());
+
+  int errors = 0;
+  errors += test_1d(m);
+  errors += test_2d();
+
+  if(errors > 0) {
+    log_app.error() << errors << " errors";
+    exit(1);
+  }
+  log_app.print() << "sparsity_intern: all tests passed";
+}
+
+int main(int argc, char **argv)
+{
+  Runtime rt;
+
+  rt.init(&argc, &argv);
+
+  for(int i = 1; i < argc; i++) {
+    if(!strcmp(argv[i], "-n")) {
+      num_pieces = atoi(argv[++i]);
+      continue;
+    }
+
+    if(!strcmp(argv[i], "-s")) {
+      piece_size = atoi(argv[++i]);
+      continue;
+    }
+  }
+
+  rt.register_task(TOP_LEVEL_TASK, top_level_task);
+
+  Processor p = Machine::ProcessorQuery(Machine::get_machine())
+    .only_kind(Processor::LOC_PROC)
+    .first();
+  assert(p.exists());
+
+  // collective launch of a single task - everybody gets the same finish event
+  Event e = rt.collective_spawn(p, TOP_LEVEL_TASK, 0, 0);
+
+  // request shutdown once that task is complete
+  rt.shutdown(e);
+
+  // now sleep this thread until that shutdown actually happens
+  rt.wait_for_shutdown();
+
+  return 0;
+}
@@ -0,0 +1,154 @@
+#include "realm.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace Realm;
+
+Logger log_app("app");
+
+// Task IDs, some IDs are reserved so start at first available number
+enum {
+  TOP_LEVEL_TASK = Processor::TASK_ID_FIRST_AVAILABLE+0,
+};
+
+// runs a short, busy task with the stack sampler watching the CPU processors,
+//  then folds the samples with rstacks_to_folded.py and checks that the busy
+//  function shows up in the folded stacks
+
+int spin_ms = 300;
+const char *samples_file = "stack_sampler_%.txt";
+const char *folded_file = "stack_sampler.folded";
+
+// kept out of line so it has its own frame in the sampled stacks
+__attribute__((noinline))
+double stack_sampler_spin(double seconds)
+{
+  double stop = Clock::current_time() + seconds;
+  volatile double x = 1.0;
+  while(Clock::current_time() < stop)
+    for(int i = 0; i < 10000; i++)
+      x = x * 1.000001 + 0.000001;
+  return x;
+}
+
+void top_level_task(const void *args, size_t arglen,
+		    const void *userdata, size_t userlen, Processor p)
+{
+  log_app.print() << "spinning on " << p << " for " << spin_ms << " ms";
+  stack_sampler_spin(spin_ms * 1e-3);
+}
+
+static std::string tools_dir(void)
+{
+  const char *rt_dir = getenv("LG_RT_DIR");
+  return std::string(rt_dir ? rt_dir : "../../runtime") + "/../tools";
+}
+
+// the runtime has shut down by the time this runs, so it reports with printf
+static int check_folded(const char *filename)
+{
+  FILE *f = fopen(filename, "r");
+  if(!f) {
+    fprintf(stderr, "could not open '%s'\n", filename);
+    return 1;
+  }
+
+  // every line is "<class>;<outermost frame>;...;<innermost frame> <count>"
+  int errors = 0;
+  long total = 0, spinning = 0;
+  char line[65536];
+  while(fgets(line, sizeof(line), f)) {
+    char *space = strrchr(line, ' ');
+    long count = space ? atol(space + 1) : 0;
+    if(!space || (count <= 0)) {
+      fprintf(stderr, "malformed folded stack: %s", line);
+      errors++;
+      continue;
+    }
+    if(strncmp(line, "cpu;", 4) != 0) {
+      fprintf(stderr, "stack from unexpected thread class: %s", line);
+      errors++;
+    }
+    total += count;
+    *space = 0;
+    if(strstr(line, "stack_sampler_spin") && strstr(line, "top_level_task"))
+      spinning += count;
+  }
+  fclose(f);
+
+  printf("%ld samples, %ld in stack_sampler_spin\n", total, spinning);
+  if(spinning == 0) {
+    fprintf(stderr, "no samples of top_level_task -> stack_sampler_spin\n");
+    errors++;
+  }
+  return errors;
+}
+
+int main(int argc, char **argv)
+{
+#ifndef __linux__
+  printf("stack sampling is only supported on Linux - skipping\n");
+  return 0;
+#endif
+
+  Runtime rt;
+
+  // sample the CPU processors every ms of CPU time
+  std::vector<char *> args(argv, argv + argc);
+  const char *extra_args[] = { "-stacks:classes", "cpu",
+			       "-stacks:interval", "1000",
+			       "-stacks:file", samples_file };
+  for(size_t i = 0; i < sizeof(extra_args) / sizeof(extra_args[0]); i++)
+    args.push_back(const_cast<char *>(extra_args[i]));
+  int new_argc = args.size();
+  args.push_back(0);
+  char **new_argv = &args[0];
+
+  rt.init(&new_argc, &new_argv);
+
+  for(int i = 1; i < new_argc; i++) {
+    if(!strcmp(new_argv[i], "-t")) {
+      spin_ms = atoi(new_argv[++i]);
+      continue;
+    }
+  }
+
+  rt.register_task(TOP_LEVEL_TASK, top_level_task);
+
+  Processor p = Machine::ProcessorQuery(Machine::get_machine())
+    .only_kind(Processor::LOC_PROC)
+    .first();
+  assert(p.exists());
+
+  // collective launch of a single task - everybody gets the same finish event
+  Event e = rt.collective_spawn(p, TOP_LEVEL_TASK, 0, 0);
+
+  // request shutdown once that task is complete
+  rt.shutdown(e);
+
+  // now sleep this thread until that shutdown actually happens - the samples
+  //  are written as the runtime shuts down
+  rt.wait_for_shutdown();
+
+  std::string samples = samples_file;
+  samples.replace(samples.find('%'), 1, "0");
+  std::string command = ("python " + tools_dir() + "/rstacks_to_folded.py -o " +
+			 folded_file + " " + samples);
+  if(system(command.c_str()) != 0) {
+    fprintf(stderr, "FAILED: %s\n", command.c_str());
+    return 1;
+  }
+
+  if(check_folded(folded_file) > 0) {
+    fprintf(stderr, "FAILED: folded stacks in '%s' are wrong\n", folded_file);
+    return 1;
+  }
+  remove(samples.c_str());
+  remove(folded_file);
+  printf("SUCCESS\n");
+  return 0;
+}
@@ -0,0 +1,186 @@
+#include "realm.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace Realm;
+
+Logger log_app("app");
+
+// Task IDs, some IDs are reserved so start at first available number
+enum {
+  TOP_LEVEL_TASK = Processor::TASK_ID_FIRST_AVAILABLE+0,
+  RESPONSE_TASK,
+};
+
+int num_points = 1000;
+int num_colors = 10;
+
+// each color starts out with a contiguous block of points
+static int initial_color(int i)
+{
+  return i / (num_points / num_colors);
+}
+
+static bool same_space(const IndexSpace<1>& a, const IndexSpace<1>& b)
+{
+  return (a.bounds == b.bounds) && (a.sparsity == b.sparsity);
+}
+
+static int check_contents(const IndexSpace<1>& is,
+			  const std::vector<IndexSpace<1> >& actual,
+			  const std::vector<IndexSpace<1> >& expected)
+{
+  int errors = 0;
+  for(size_t i = 0; i < actual.size(); i++)
+    for(PointInRectIterator<1,int> pir(is.bounds); pir.valid; pir.step())
+      if(actual[i].contains(pir.p) != expected[i].contains(pir.p)) {
+	log_app.error() << "mismatch: color=" << i << " point=" << pir.p
+			<< " actual=" << actual[i] << " expected=" << expected[i];
+	errors++;
+      }
+  return errors;
+}
+
+void response_task(const void *args, size_t arglen,
+		   const void *userdata, size_t userlen, Processor p)
+{
+  ProfilingResponse pr(args, arglen);
+  assert(pr.user_data_size() == sizeof(UserEvent));
+  UserEvent done = *static_cast<const UserEvent *>(pr.user_data());
+  log_app.info() << "profiling response received";
+  done.trigger();
+}
+
+void top_level_task(const void *args, size_t arglen,
+		    const void *userdata, size_t userlen, Processor p)
+{
+  log_app.print() << "testing update_subspaces_by_field: points=" << num_points << " colors=" << num_colors;
+
+  Memory m = Machine::MemoryQuery(Machine::get_machine()).only_kind(Memory::SYSTEM_MEM).best_affinity_to(p).first();
+  assert(m.exists());
+
+  IndexSpace<1> is(Rect<1>(0, num_points - 1));
+  std::vector<size_t> field_sizes(1, sizeof(int));
+  RegionInstance inst;
+  RegionInstance::create_instance(inst, m, is, field_sizes,
+				  0 /*SOA*/, ProfilingRequestSet()).wait();
+
+  AffineAccessor<int,1> acc(inst, 0 /* offset */);
+  for(int i = 0; i < num_points; i++)
+    acc[i] = initial_color(i);
+
+  std::vector<FieldDataDescriptor<IndexSpace<1>, int> > field_data(1);
+  field_data[0].index_space = is;
+  field_data[0].inst = inst;
+  field_data[0].field_offset = 0;
+
+  std::vector<int> colors;
+  for(int i = 0; i < num_colors; i++)
+    colors.push_back(i);
+
+  std::vector<IndexSpace<1> > prev;
+  is.create_subspaces_by_field(field_data, colors, prev,
+			       ProfilingRequestSet()).wait();
+
+  int errors = 0;
+
+  // an update with nothing dirty returns the previous subspaces and must
+  //  still answer any profiling requests
+  {
+    UserEvent response = UserEvent::create_user_event();
+    ProfilingRequestSet prs;
+    prs.add_request(p, RESPONSE_TASK, &response, sizeof(response))
+      .add_measurement<ProfilingMeasurements::OperationTimeline>();
+    std::vector<IndexSpace<1> > updated;
+    is.update_subspaces_by_field(field_data, colors, prev,
+				 IndexSpace<1>::make_empty(), colors,
+				 updated, prs).wait();
+    for(int i = 0; i < num_colors; i++)
+      if(!same_space(updated[i], prev[i])) {
+	log_app.error() << "empty update changed color " << i << ": " << updated[i] << " != " << prev[i];
+	errors++;
+      }
+    response.wait();
+  }
+
+  // move a few points from the second block to the third - every other color
+  //  must come back as the exact same index space
+  int first_moved = num_points / num_colors + 5;
+  int last_moved = first_moved + 9;
+  for(int i = first_moved; i <= last_moved; i++)
+    acc[i] = 2;
+  IndexSpace<1> dirty(Rect<1>(first_moved, last_moved));
+  std::vector<int> changed_colors;
+  changed_colors.push_back(1);
+  changed_colors.push_back(2);
+
+  std::vector<IndexSpace<1> > updated;
+  is.update_subspaces_by_field(field_data, colors, prev, dirty, changed_colors,
+			       updated, ProfilingRequestSet()).wait();
+
+  for(int i = 0; i < num_colors; i++) {
+    bool changed = ((i == 1) || (i == 2));
+    if(!changed && !same_space(updated[i], prev[i])) {
+      log_app.error() << "unchanged color " << i << " was recomputed: " << updated[i] << " != " << prev[i];
+      errors++;
+    }
+    updated[i].make_valid().wait();
+  }
+
+  // the updated partition must match one computed from scratch
+  std::vector<IndexSpace<1> > expected;
+  is.create_subspaces_by_field(field_data, colors, expected,
+			       ProfilingRequestSet()).wait();
+  for(int i = 0; i < num_colors; i++)
+    expected[i].make_valid().wait();
+  errors += check_contents(is, updated, expected);
+
+  inst.destroy();
+
+  if(errors > 0) {
+    log_app.error() << errors << " errors";
+    exit(1);
+  }
+  log_app.print() << "update_subspaces_by_field: all tests passed";
+}
+
+int main(int argc, char **argv)
+{
+  Runtime rt;
+
+  rt.init(&argc, &argv);
+
+  for(int i = 1; i < argc; i++) {
+    if(!strcmp(argv[i], "-p")) {
+      num_points = atoi(argv[++i]);
+      continue;
+    }
+
+    if(!strcmp(argv[i], "-c")) {
+      num_colors = atoi(argv[++i]);
+      continue;
+    }
+  }
+
+  rt.register_task(TOP_LEVEL_TASK, top_level_task);
+  rt.register_task(RESPONSE_TASK, response_task);
+
+  Processor p = Machine::ProcessorQuery(Machine::get_machine())
+    .only_kind(Processor::LOC_PROC)
+    .first();
+  assert(p.exists());
+
+  // collective launch of a single task - everybody gets the same finish event
+  Event e = rt.collective_spawn(p, TOP_LEVEL_TASK, 0, 0);
+
+  // request shutdown once that task is complete
+  rt.shutdown(e);
+
+  // now sleep this thread until that shutdown actually happens
+  rt.wait_for_shutdown();
+
+  return 0;
+}
@@ -0,0 +1,160 @@
+/* Copyright 2018 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checks that Runtime::get_runtime_statistics counts the operations,
+// mapper calls and meta-tasks of a small program
+
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+
+#include "legion.h"
+
+using namespace Legion;
+
+enum TaskIDs {
+  TOP_LEVEL_TASK_ID,
+  CHILD_TASK_ID,
+};
+
+static const unsigned NUM_CHILDREN = 16;
+
+static unsigned long long get_stat(
+                      const std::map<std::string,unsigned long long> &stats,
+                      const std::string &name)
+{
+  std::map<std::string,unsigned long long>::const_iterator finder =
+    stats.find(name);
+  return (finder == stats.end()) ? 0 : finder->second;
+}
+
+int child_task(const Task *task,
+               const std::vector<PhysicalRegion> &regions,
+               Context ctx, Runtime *runtime)
+{
+  return *(const int*)task->args;
+}
+
+void top_level_task(const Task *task,
+                    const std::vector<PhysicalRegion> &regions,
+                    Context ctx, Runtime *runtime)
+{
+  std::map<std::string,unsigned long long> before;
+  runtime->get_runtime_statistics(before);
+
+  std::vector<Future> futures;
+  for (unsigned idx = 0; idx < NUM_CHILDREN; idx++)
+  {
+    int arg = idx;
+    TaskLauncher launcher(CHILD_TASK_ID, TaskArgument(&arg, sizeof(arg)));
+    futures.push_back(runtime->execute_task(ctx, launcher));
+  }
+  int sum = 0;
+  for (unsigned idx = 0; idx < NUM_CHILDREN; idx++)
+    sum += futures[idx].get_result<int>();
+  assert(sum == (int)(NUM_CHILDREN * (NUM_CHILDREN - 1) / 2));
+
+  std::map<std::string,unsigned long long> after;
+  runtime->get_runtime_statistics(after);
+
+  unsigned errors = 0;
+  // Every child went through dependence analysis and was mapped
+  const char *counted[] = {
+    "dependence_analysis.Task.count",
+    "mapper_call.select_task_options.count",
+    "mapper_call.map_task.count",
+  };
+  for (unsigned idx = 0; idx < (sizeof(counted)/sizeof(counted[0])); idx++)
+  {
+    const unsigned long long delta = 
+      get_stat(after, counted[idx]) - get_stat(before, counted[idx]);
+    if (delta < NUM_CHILDREN)
+    {
+      fprintf(stderr, "ERROR: %s grew by %llu, expected at least %u\n",
+              counted[idx], delta, NUM_CHILDREN);
+      errors++;
+    }
+  }
+  // Counters never go backwards and latency summaries are consistent,
+  // percentiles and queue depths are free to move either way
+  for (std::map<std::string,unsigned long long>::const_iterator it = 
+        after.begin(); it != after.end(); it++)
+  {
+    const std::string &name = it->first;
+    const size_t dot = name.rfind('.');
+    const std::string prefix = name.substr(0, dot + 1);
+    const std::string metric = name.substr(dot + 1);
+    if (((metric == "count") || (metric == "total_ns") || 
+         (metric == "max_ns") || (metric == "issued") || 
+         (metric == "started")) && (it->second < get_stat(before, name)))
+    {
+      fprintf(stderr, "ERROR: %s went from %llu to %llu\n", name.c_str(),
+              get_stat(before, name), it->second);
+      errors++;
+    }
+    if (metric == "count")
+    {
+      const unsigned long long total = get_stat(after, prefix + "total_ns");
+      const unsigned long long maximum = get_stat(after, prefix + "max_ns");
+      if ((after.find(prefix + "total_ns") != after.end()) &&
+          ((maximum > total) || 
+           (get_stat(after, prefix + "p50_ns") > 
+            get_stat(after, prefix + "p99_ns"))))
+      {
+        fprintf(stderr, "ERROR: inconsistent latencies for %s\n",
+                prefix.c_str());
+        errors++;
+      }
+    }
+    else if (metric == "started")
+    {
+      if (it->second > get_stat(after, prefix + "issued"))
+      {
+        fprintf(stderr, "ERROR: %s started more meta-tasks than issued\n",
+                prefix.c_str());
+        errors++;
+      }
+    }
+  }
+  if (errors > 0)
+  {
+    for (std::map<std::string,unsigned long long>::const_iterator it = 
+          after.begin(); it != after.end(); it++)
+      fprintf(stderr, "  %s = %llu\n", it->first.c_str(), it->second);
+    exit(1);
+  }
+  printf("SUCCESS: %zd runtime statistics checked\n", after.size());
+}
+
+int main(int argc, char **argv)
+{
+  Runtime::set_top_level_task_id(TOP_LEVEL_TASK_ID);
+
+  {
+    TaskVariantRegistrar registrar(TOP_LEVEL_TASK_ID, "top_level");
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    Runtime::preregister_task_variant<top_level_task>(registrar, "top_level");
+  }
+
+  {
+    TaskVariantRegistrar registrar(CHILD_TASK_ID, "child");
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    registrar.set_leaf();
+    Runtime::preregister_task_variant<int, child_task>(registrar, "child");
+  }
+
+  return Runtime::start(argc, argv);
+}
@@ -26,7 +26,7 @@ from math import sqrt, log
 from cgi import escape
 from operator import itemgetter
 from os.path import dirname, exists, basename
-from legion_serializer import LegionProfASCIIDeserializer, LegionProfBinaryDeserializer, GetFileTypeInfo
+from legion_serializer import LegionProfASCIIDeserializer, LegionProfBinaryDeserializer, GetFileTypeInfo, perf_counter_names
 
 # Make sure this is up to date with lowlevel.h
 processor_kinds = {
@@ -814,6 +814,49 @@ class Variant(StatObject):
             title = self.name
         return title
 
+# Ratios of hardware counters to print along with the totals, must match
+# derived_counters in legion_prof_analyze.cc
+derived_counters = [
+    ("Instructions per Cycle", "instructions", "cycles", False),
+    ("L1I Miss Rate", "l1i_misses", "l1i_accesses", True),
+    ("L1D Miss Rate", "l1d_misses", "l1d_accesses", True),
+    ("L2 Miss Rate", "l2_misses", "l2_accesses", True),
+    ("L3 Miss Rate", "l3_misses", "l3_accesses", True),
+    ("Branch Misprediction Rate", "branch_mispredictions", "branches", True),
+]
+
+class PerfCounters(object):
+    """Hardware counter totals for one task variant on one kind of processor"""
+    def __init__(self):
+        self.tasks = 0
+        self.totals = defaultdict(long)
+        self.measured = defaultdict(int)
+
+    def add(self, counters):
+        self.tasks += 1
+        for name, value in counters.iteritems():
+            # counters the hardware couldn't provide are -1
+            if value >= 0:
+                self.totals[name] += value
+                self.measured[name] += 1
+
+    def print_stats(self, title):
+        print('  '+title)
+        print('       Tasks Measured: %d' % self.tasks)
+        for name in perf_counter_names:
+            if self.measured[name] > 0:
+                print('       %s: %d (%.2f per task)' %
+                      (name, self.totals[name],
+                       float(self.totals[name]) / self.measured[name]))
+        for title, num, denom, percent in derived_counters:
+            if self.measured[num] > 0 and self.totals[denom] > 0:
+                ratio = float(self.totals[num]) / self.totals[denom]
+                if percent:
+                    print('       %s: %.3f%%' % (title, 100.0 * ratio))
+                else:
+                    print('       %s: %.3f' % (title, ratio))
+        print()
+
 class Base(object):
     def __init__(self):
         self.prof_uid = get_prof_uid()
@@ -1378,10 +1421,18 @@ class MessageKind(StatObject):
         self.message_id = message_id
         self.name = name
         self.color = None
+        self.sent_count = 0
+        self.sent_bytes = 0
+        self.sent_wire_bytes = 0
 
     def __eq__(self, other):
         return self.message_id == other.message_id
 
+    def add_sizes(self, count, bytes, wire_bytes):
+        self.sent_count += count
+        self.sent_bytes += bytes
+        self.sent_wire_bytes += wire_bytes
+
     def assign_color(self, color):
         assert self.color is None
         self.color = color
@@ -1659,6 +1710,23 @@ class StatGatherer(object):
                            reverse=True):
             kind.print_stats(verbose)
 
+        sized = [k for k in self.state.message_kinds.itervalues()
+                 if k.sent_count > 0]
+        if len(sized) > 0:
+            print("  -------------------------")
+            print("  Message Size Statistics")
+            print("  -------------------------")
+            for kind in sorted(sized, key=lambda k: k.sent_bytes,
+                               reverse=True):
+                print("      " + repr(kind))
+                print("          Messages Sent:  %d" % kind.sent_count)
+                print("          Total Bytes:    %d" % kind.sent_bytes)
+                print("          Average Size:   %.2f bytes" %
+                      (float(kind.sent_bytes) / kind.sent_count))
+                print("          Bytes on Wire:  %d (%.2f%%)" %
+                      (kind.sent_wire_bytes, 100.0 * kind.sent_wire_bytes /
+                       max(kind.sent_bytes, 1)))
+
         if len(self.runtime_tasks) > 0:
             print("  -------------------------")
             print("  Runtime Statistics")
@@ -1691,6 +1759,7 @@ class State(object):
         self.runtime_call_kinds = {}
         self.runtime_calls = {}
         self.instances = {}
+        self.perf_counters = {}
         self.has_spy_data = False
         self.spy_state = None
         self.callbacks = {
@@ -1709,6 +1778,7 @@ class State(object):
             "TaskWaitInfo": self.log_task_wait_info,
             "MetaWaitInfo": self.log_meta_wait_info,
             "TaskInfo": self.log_task_info,
+            "TaskPerfCounters": self.log_task_perf_counters,
             "MetaInfo": self.log_meta_info,
             "CopyInfo": self.log_copy_info,
             "FillInfo": self.log_fill_info,
@@ -1719,6 +1789,7 @@ class State(object):
             "MessageInfo": self.log_message_info,
             "MapperCallInfo": self.log_mapper_call_info,
             "RuntimeCallInfo": self.log_runtime_call_info,
+            "MessageSizeInfo": self.log_message_size_info,
             "ProfTaskInfo": self.log_proftask_info
             #"UserInfo": self.log_user_info
         }
@@ -1732,6 +1803,16 @@ class State(object):
         proc = self.find_processor(proc_id)
         proc.add_task(task)
 
+    def log_task_perf_counters(self, op_id, task_id, variant_id, proc_id,
+                               start, stop, **counters):
+        # the processor kind might not be known yet so group by processor
+        # for now and by kind when printing
+        key = (self.find_variant(task_id, variant_id),
+               self.find_processor(proc_id))
+        if key not in self.perf_counters:
+            self.perf_counters[key] = PerfCounters()
+        self.perf_counters[key].add(counters)
+
     def log_meta_info(self, op_id, lg_id, proc_id, 
                       create, ready, start, stop):
         op = self.find_op(op_id)
@@ -1926,6 +2007,10 @@ class State(object):
         proc = self.find_processor(proc_id)
         proc.add_runtime_call(call)
 
+    def log_message_size_info(self, kind, count, bytes, wire_bytes, node):
+        assert kind in self.message_kinds
+        self.message_kinds[kind].add_sizes(count, bytes, wire_bytes)
+
     def log_proftask_info(self, proc_id, op_id, start, stop):
         # we don't have a unique op_id for the profiling task itself, so we don't 
         # add to self.operations
@@ -2085,11 +2170,33 @@ class State(object):
         stat.print_stats(verbose)
         print
 
+    def print_perf_counter_stats(self, verbose):
+        by_kind = {}
+        for (variant, proc), counters in self.perf_counters.iteritems():
+            kind = proc.kind if proc.kind is not None else 'Unknown'
+            key = (repr(variant), kind)
+            if key not in by_kind:
+                by_kind[key] = PerfCounters()
+            merged = by_kind[key]
+            merged.tasks += counters.tasks
+            for name in perf_counter_names:
+                merged.totals[name] += counters.totals[name]
+                merged.measured[name] += counters.measured[name]
+        if len(by_kind) == 0:
+            return
+        print('****************************************************')
+        print('   HARDWARE COUNTERS')
+        print('****************************************************')
+        for key in sorted(by_kind.iterkeys()):
+            by_kind[key].print_stats('%s on %s' % key)
+        print
+
     def print_stats(self, verbose):
         self.print_processor_stats(verbose)
         self.print_memory_stats(verbose)
         self.print_channel_stats(verbose)
         self.print_task_stats(verbose)
+        self.print_perf_counter_stats(verbose)
 
     def assign_colors(self):
         # Subtract out some colors for which we have special colors
@@ -2862,6 +2969,14 @@ def main():
     parser.add_argument(
         '-f', '--force', dest='force', action='store_true',
         help='overwrite output directory if it exists')
+    parser.add_argument(
+        '--start-time', dest='start_time', action='store',
+        type=int, default=None,
+        help='only load records ending after this time in us (binary logs only)')
+    parser.add_argument(
+        '--stop-time', dest='stop_time', action='store',
+        type=int, default=None,
+        help='only load records starting before this time in us (binary logs only)')
     parser.add_argument(
         dest='filenames', nargs='+',
         help='input Legion Prof log filenames')
@@ -2884,7 +2999,9 @@ def main():
     has_binary_files = False # true if any of the files are a binary file
 
     asciiDeserializer = LegionProfASCIIDeserializer(state, state.callbacks)
-    binaryDeserializer = LegionProfBinaryDeserializer(state, state.callbacks)
+    binaryDeserializer = LegionProfBinaryDeserializer(state, state.callbacks,
+                                                      args.start_time,
+                                                      args.stop_time)
 
     for file_name in file_names:
         file_type, version = GetFileTypeInfo(file_name)
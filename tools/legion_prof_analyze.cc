@@ -0,0 +1,1718 @@
+/* Copyright 2018 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Native analyzer for binary Legion Prof logs. It parses one log per
+// thread and produces the processor timelines and utilization graphs
+// consumed by the viewer in tools/legion_prof_files, as well as the
+// processor and task statistics of legion_prof.py -s. Like legion_prof.py
+// without Legion Spy data, it emits an empty critical path. The
+// record layouts come from legion/legion_profiling_format.h which is
+// shared with the serializer in the runtime.
+
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "legion/legion_profiling_format.h"
+
+using namespace Legion::Internal;
+
+typedef unsigned long long u64;
+
+static const u64 NO_TIME = ~0ULL;
+
+// Must match the processor kinds in legion_prof.py
+static const char *processor_kind_name(int kind)
+{
+  switch (kind) {
+  case 1: return "GPU";
+  case 2: return "CPU";
+  case 3: return "Utility";
+  case 4: return "IO";
+  case 5: return "Proc Group";
+  case 6: return "Proc Set";
+  case 7: return "OpenMP";
+  case 8: return "Python";
+  default: return "Unknown";
+  }
+}
+
+// The fields we use from each kind of record in the order we want them,
+// fields we don't use are skipped and missing fields read as zero
+static const char *const *wanted_fields(int id)
+{
+  static const char *const kind_name[] = { "kind", "name", 0 };
+  static const char *const proc_desc[] = { "proc_id", "kind", 0 };
+  static const char *const task_kind[] = { "task_id", "name", "overwrite", 0 };
+  static const char *const task_variant[] = { "task_id", "variant_id",
+                                              "name", 0 };
+  static const char *const op_instance[] = { "op_id", "kind", 0 };
+  static const char *const multi_task[] = { "op_id", "task_id", 0 };
+  static const char *const task_wait[] = { "op_id", "wait_start",
+                                           "wait_ready", "wait_end", 0 };
+  static const char *const meta_wait[] = { "op_id", "lg_id", "wait_start",
+                                           "wait_ready", "wait_end", 0 };
+  static const char *const task_info[] = { "op_id", "task_id", "variant_id",
+                                           "proc_id", "create", "ready",
+                                           "start", "stop", 0 };
+  static const char *const meta_info[] = { "op_id", "lg_id", "proc_id",
+                                           "create", "ready", "start",
+                                           "stop", 0 };
+  static const char *const message_info[] = { "kind", "proc_id", "start",
+                                              "stop", 0 };
+  static const char *const mapper_info[] = { "kind", "proc_id", "op_id",
+                                             "start", "stop", 0 };
+  static const char *const runtime_info[] = { "kind", "proc_id", "start",
+                                              "stop", 0 };
+  static const char *const proftask_info[] = { "proc_id", "op_id", "start",
+                                               "stop", 0 };
+#define PERF_COUNTER_NAME(name) #name,
+  static const char *const perf_counters[] = { "op_id", "task_id",
+                                               "variant_id", "proc_id",
+                                 LEGION_PROF_PERF_COUNTERS(PERF_COUNTER_NAME)
+                                               0 };
+#undef PERF_COUNTER_NAME
+  switch (id) {
+  case MESSAGE_DESC_ID:
+  case MAPPER_CALL_DESC_ID:
+  case RUNTIME_CALL_DESC_ID:
+  case META_DESC_ID:
+  case OP_DESC_ID:
+    return kind_name;
+  case PROC_DESC_ID: return proc_desc;
+  case TASK_KIND_ID: return task_kind;
+  case TASK_VARIANT_ID: return task_variant;
+  case OPERATION_INSTANCE_ID: return op_instance;
+  case MULTI_TASK_ID: return multi_task;
+  case TASK_WAIT_INFO_ID: return task_wait;
+  case META_WAIT_INFO_ID: return meta_wait;
+  case TASK_INFO_ID: return task_info;
+  case META_INFO_ID: return meta_info;
+  case MESSAGE_INFO_ID: return message_info;
+  case MAPPER_CALL_INFO_ID: return mapper_info;
+  case RUNTIME_CALL_INFO_ID: return runtime_info;
+  case PROFTASK_INFO_ID: return proftask_info;
+  case TASK_PERF_COUNTERS_ID: return perf_counters;
+  default: return 0;
+  }
+}
+
+// The names of the hardware counters in TaskPerfCounters records
+static const char *const perf_counter_names[] = {
+#define PERF_COUNTER_NAME(name) #name,
+  LEGION_PROF_PERF_COUNTERS(PERF_COUNTER_NAME)
+#undef PERF_COUNTER_NAME
+};
+static const unsigned NUM_PERF_COUNTERS =
+  sizeof(perf_counter_names) / sizeof(perf_counter_names[0]);
+// Fields of TaskPerfCounters records before the counters
+static const unsigned PERF_COUNTER_BASE = 4;
+
+static const unsigned MAX_WANTED_FIELDS = PERF_COUNTER_BASE + NUM_PERF_COUNTERS;
+
+struct WaitInterval {
+  u64 start, ready, end;
+};
+
+enum ItemKind {
+  TASK_ITEM,
+  META_ITEM,
+  MESSAGE_ITEM,
+  MAPPER_CALL_ITEM,
+  RUNTIME_CALL_ITEM,
+  PROF_TASK_ITEM
+};
+
+// Anything that shows up on a processor timeline
+struct Item {
+  ItemKind kind;
+  u64 op_id;
+  unsigned id1, id2; // task/variant, lg_id, or call/message kind
+  u64 create, ready, start, stop;
+  std::vector<WaitInterval> waits;
+  unsigned level;
+  u64 prof_uid;
+
+  u64 total_time(void) const { return stop - start; }
+  u64 active_time(void) const
+  {
+    u64 active = 0, cur = start;
+    for (std::vector<WaitInterval>::const_iterator it = waits.begin();
+          it != waits.end(); it++) {
+      active += (it->start - cur);
+      cur = std::max(cur, it->end);
+    }
+    if (cur < stop)
+      active += (stop - cur);
+    return active;
+  }
+};
+
+// Hardware counter totals for a task variant on a processor, counters
+// that weren't available on the processor are recorded as -1
+struct PerfCounters {
+  PerfCounters(void) : tasks(0)
+  {
+    for (unsigned idx = 0; idx < NUM_PERF_COUNTERS; idx++)
+      totals[idx] = measured[idx] = 0;
+  }
+  void add(const u64 *vals)
+  {
+    tasks++;
+    for (unsigned idx = 0; idx < NUM_PERF_COUNTERS; idx++) {
+      if ((long long)vals[idx] < 0)
+        continue;
+      totals[idx] += vals[idx];
+      measured[idx]++;
+    }
+  }
+  void merge(const PerfCounters &rhs)
+  {
+    tasks += rhs.tasks;
+    for (unsigned idx = 0; idx < NUM_PERF_COUNTERS; idx++) {
+      totals[idx] += rhs.totals[idx];
+      measured[idx] += rhs.measured[idx];
+    }
+  }
+  u64 tasks;
+  u64 totals[NUM_PERF_COUNTERS];
+  u64 measured[NUM_PERF_COUNTERS];
+};
+
+// (task_id, variant_id, proc_id)
+typedef std::pair<std::pair<unsigned,unsigned>,u64> PerfCounterKey;
+
+struct Processor {
+  Processor(void) : proc_id(0), kind(0), max_levels(0) { }
+  u64 proc_id;
+  int kind;
+  std::vector<Item> items;
+  unsigned max_levels;
+
+  unsigned node_id(void) const { return (proc_id >> 40) & ((1 << 16) - 1); }
+  unsigned proc_in_node(void) const { return proc_id & ((1 << 12) - 1); }
+};
+
+// Everything we learn from the logs, each file is parsed into its own
+// copy of this which are then merged together
+struct ProfData {
+  std::map<u64,Processor> procs;
+  std::map<unsigned,std::string> task_kinds;
+  std::map<std::pair<unsigned,unsigned>,std::string> variants;
+  std::map<unsigned,std::string> meta_descs, op_descs;
+  std::map<unsigned,std::string> message_descs, mapper_descs, runtime_descs;
+  std::map<u64,unsigned> op_kinds;     // op_id -> OpDesc kind
+  std::map<u64,unsigned> multi_tasks;  // op_id -> task_id
+  std::map<u64,std::vector<WaitInterval> > task_waits;
+  std::map<std::pair<unsigned,u64>,std::vector<WaitInterval> > meta_waits;
+  std::map<PerfCounterKey,PerfCounters> perf_counters;
+  u64 last_time;
+  size_t records;
+
+  ProfData(void) : last_time(0), records(0) { }
+  Processor& find_proc(u64 proc_id)
+  {
+    Processor &proc = procs[proc_id];
+    proc.proc_id = proc_id;
+    return proc;
+  }
+  void merge(ProfData &rhs);
+};
+
+void ProfData::merge(ProfData &rhs)
+{
+  for (std::map<u64,Processor>::iterator it = rhs.procs.begin();
+        it != rhs.procs.end(); it++) {
+    Processor &proc = find_proc(it->first);
+    if (it->second.kind != 0)
+      proc.kind = it->second.kind;
+    if (proc.items.empty())
+      proc.items.swap(it->second.items);
+    else
+      proc.items.insert(proc.items.end(), it->second.items.begin(),
+                        it->second.items.end());
+  }
+  task_kinds.insert(rhs.task_kinds.begin(), rhs.task_kinds.end());
+  variants.insert(rhs.variants.begin(), rhs.variants.end());
+  meta_descs.insert(rhs.meta_descs.begin(), rhs.meta_descs.end());
+  op_descs.insert(rhs.op_descs.begin(), rhs.op_descs.end());
+  message_descs.insert(rhs.message_descs.begin(), rhs.message_descs.end());
+  mapper_descs.insert(rhs.mapper_descs.begin(), rhs.mapper_descs.end());
+  runtime_descs.insert(rhs.runtime_descs.begin(), rhs.runtime_descs.end());
+  op_kinds.insert(rhs.op_kinds.begin(), rhs.op_kinds.end());
+  multi_tasks.insert(rhs.multi_tasks.begin(), rhs.multi_tasks.end());
+  for (std::map<PerfCounterKey,PerfCounters>::const_iterator it =
+        rhs.perf_counters.begin(); it != rhs.perf_counters.end(); it++)
+    perf_counters[it->first].merge(it->second);
+  last_time = std::max(last_time, rhs.last_time);
+  records += rhs.records;
+}
+
+//------------------------------------------------------------------------------
+// Log file parsing
+//------------------------------------------------------------------------------
+
+class LogParser {
+public:
+  LogParser(const char *filename, u64 window_start, u64 window_stop);
+  ~LogParser(void);
+  bool parse(ProfData &data);
+  const std::string& get_error(void) const { return error; }
+protected:
+  struct FieldFormat {
+    int size; // -1 for strings
+    int slot; // position in wanted_fields or -1 if unused
+  };
+  struct ChunkInfo {
+    u64 offset;
+    unsigned flags;
+    u64 start, stop;
+  };
+  bool fail(const char *msg);
+  bool parse_preamble(void);
+  bool parse_preamble_line(const std::string &line);
+  bool read_line(std::string &line);
+  bool read_index(u64 data_offset, std::vector<ChunkInfo> &chunks);
+  bool walk_chunks(u64 data_offset, std::vector<ChunkInfo> &chunks);
+  bool parse_chunks(ProfData &data);
+  bool parse_stream(ProfData &data);
+  bool parse_records(const char *ptr, size_t size, bool timed_only_meta,
+                     ProfData &data);
+  bool in_window(u64 start, u64 stop) const;
+  static bool is_timed(int id);
+  void handle_record(int id, const u64 *vals, const char *const *strs,
+                     ProfData &data);
+protected:
+  const std::string filename;
+  const u64 window_start, window_stop;
+  FILE *f;
+#ifdef USE_ZLIB
+  gzFile gz;
+#endif
+  bool chunked;
+  std::vector<std::vector<FieldFormat> > formats;
+  std::string error;
+};
+
+LogParser::LogParser(const char *name, u64 start, u64 stop)
+  : filename(name), window_start(start), window_stop(stop), f(0),
+#ifdef USE_ZLIB
+    gz(0),
+#endif
+    chunked(false)
+{
+}
+
+LogParser::~LogParser(void)
+{
+  if (f)
+    fclose(f);
+#ifdef USE_ZLIB
+  if (gz)
+    gzclose(gz);
+#endif
+}
+
+bool LogParser::fail(const char *msg)
+{
+  error = filename + ": " + msg;
+  return false;
+}
+
+bool LogParser::read_line(std::string &line)
+{
+  line.clear();
+  while (true) {
+    int c;
+#ifdef USE_ZLIB
+    if (gz)
+      c = gzgetc(gz);
+    else
+#endif
+      c = fgetc(f);
+    if (c == EOF)
+      return !line.empty();
+    if (c == '\n')
+      return true;
+    line.push_back((char)c);
+  }
+}
+
+bool LogParser::parse_preamble_line(const std::string &line)
+{
+  // <Name> {id:<id>(, <field>:<type>:<size>)*}
+  size_t brace = line.find(" {id:");
+  if ((brace == std::string::npos) || (line[line.size()-1] != '}'))
+    return fail(("malformed preamble line '" + line + "'").c_str());
+  const std::string name = line.substr(0, brace);
+  const int id = atoi(line.c_str() + brace + 5);
+  if ((id < 0) || (id >= LAST_LEGION_PROF_RECORD_ID) ||
+      (name != legion_prof_record_names[id]))
+    return fail(("unknown record '" + name + "' in preamble").c_str());
+  if (formats.size() <= (size_t)id)
+    formats.resize(id+1);
+  std::vector<FieldFormat> &fields = formats[id];
+  fields.clear();
+  const char *const *wanted = wanted_fields(id);
+  size_t pos = line.find(", ", brace);
+  while (pos != std::string::npos) {
+    pos += 2;
+    size_t next = line.find(", ", pos);
+    const std::string field = line.substr(pos,
+        ((next == std::string::npos) ? line.size() - 1 : next) - pos);
+    size_t first = field.find(':');
+    size_t last = field.rfind(':');
+    if ((first == std::string::npos) || (first == last))
+      return fail(("malformed field '" + field + "'").c_str());
+    FieldFormat format;
+    format.size = atoi(field.c_str() + last + 1);
+    format.slot = -1;
+    if ((format.size != -1) && (format.size != 1) && (format.size != 2) &&
+        (format.size != 4) && (format.size != 8))
+      return fail(("unsupported field size in '" + field + "'").c_str());
+    const std::string field_name = field.substr(0, first);
+    for (unsigned idx = 0; (wanted != 0) && (wanted[idx] != 0); idx++) {
+      if (field_name == wanted[idx]) {
+        format.slot = idx;
+        break;
+      }
+    }
+    fields.push_back(format);
+    pos = next;
+  }
+  return true;
+}
+
+bool LogParser::parse_preamble(void)
+{
+  std::string line;
+  if (!read_line(line))
+    return fail("empty file");
+  const std::string filetype = "FileType: BinaryLegionProf v: ";
+  if (line.compare(0, filetype.size(), filetype) != 0)
+    return fail("not a binary Legion Prof log");
+  const double version = atof(line.c_str() + filetype.size());
+  chunked = (version >= 2.0);
+  while (true) {
+    if (!read_line(line))
+      return fail("truncated preamble");
+    if (line.empty())
+      return true;
+    if (!parse_preamble_line(line))
+      return false;
+  }
+}
+
+bool LogParser::is_timed(int id)
+{
+  // These are the records that the serializer uses to bound chunk times
+  switch (id) {
+  case TASK_WAIT_INFO_ID:
+  case META_WAIT_INFO_ID:
+  case TASK_INFO_ID:
+  case META_INFO_ID:
+  case COPY_INFO_ID:
+  case FILL_INFO_ID:
+  case INST_TIMELINE_INFO_ID:
+  case PARTITION_INFO_ID:
+  case MESSAGE_INFO_ID:
+  case MAPPER_CALL_INFO_ID:
+  case RUNTIME_CALL_INFO_ID:
+  case PROFTASK_INFO_ID:
+  case TASK_PERF_COUNTERS_ID:
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool LogParser::in_window(u64 start, u64 stop) const
+{
+  if (start > stop)
+    return false;
+  if ((window_start != NO_TIME) && (stop < window_start))
+    return false;
+  if ((window_stop != NO_TIME) && (start > window_stop))
+    return false;
+  return true;
+}
+
+bool LogParser::parse_records(const char *ptr, size_t size,
+                              bool untimed_only, ProfData &data)
+{
+  const char *end = ptr + size;
+  u64 vals[MAX_WANTED_FIELDS];
+  const char *strs[MAX_WANTED_FIELDS];
+  while (ptr < end) {
+    int id;
+    if ((size_t)(end - ptr) < sizeof(id))
+      return fail("truncated record");
+    memcpy(&id, ptr, sizeof(id));
+    ptr += sizeof(id);
+    if ((id < 0) || ((size_t)id >= formats.size()) || formats[id].empty())
+      return fail("record with unknown ID");
+    memset(vals, 0, sizeof(vals));
+    memset(strs, 0, sizeof(strs));
+    const std::vector<FieldFormat> &fields = formats[id];
+    for (std::vector<FieldFormat>::const_iterator it = fields.begin();
+          it != fields.end(); it++) {
+      if (it->size < 0) {
+        const char *nul = (const char*)memchr(ptr, 0, end - ptr);
+        if (nul == 0)
+          return fail("unterminated string");
+        if (it->slot >= 0)
+          strs[it->slot] = ptr;
+        ptr = nul + 1;
+      } else {
+        if ((end - ptr) < it->size)
+          return fail("truncated record");
+        if (it->slot >= 0) {
+          // Logs are written in the native byte order of little endian
+          // machines so we can just copy the low bytes
+          u64 val = 0;
+          memcpy(&val, ptr, it->size);
+          vals[it->slot] = val;
+        }
+        ptr += it->size;
+      }
+    }
+    if (untimed_only && is_timed(id))
+      continue;
+    handle_record(id, vals, strs, data);
+    data.records++;
+  }
+  return true;
+}
+
+static inline u64 to_us(u64 ns) { return ns / 1000; }
+
+void LogParser::handle_record(int id, const u64 *vals, const char *const *strs,
+                              ProfData &data)
+{
+  const std::string name = (strs[1] != 0) ? strs[1] : "";
+  switch (id) {
+  case MESSAGE_DESC_ID:
+    data.message_descs[vals[0]] = name;
+    break;
+  case MAPPER_CALL_DESC_ID:
+    data.mapper_descs[vals[0]] = name;
+    break;
+  case RUNTIME_CALL_DESC_ID:
+    data.runtime_descs[vals[0]] = name;
+    break;
+  case META_DESC_ID:
+    data.meta_descs[vals[0]] = name;
+    break;
+  case OP_DESC_ID:
+    data.op_descs[vals[0]] = name;
+    break;
+  case PROC_DESC_ID:
+    data.find_proc(vals[0]).kind = (int)vals[1];
+    break;
+  case TASK_KIND_ID:
+    if ((vals[2] != 0) || (data.task_kinds.find(vals[0]) ==
+                            data.task_kinds.end()))
+      data.task_kinds[vals[0]] = name;
+    break;
+  case TASK_VARIANT_ID:
+    data.variants[std::make_pair((unsigned)vals[0], (unsigned)vals[1])] =
+      (strs[2] != 0) ? strs[2] : "";
+    break;
+  case OPERATION_INSTANCE_ID:
+    data.op_kinds[vals[0]] = vals[1];
+    break;
+  case MULTI_TASK_ID:
+    data.multi_tasks[vals[0]] = vals[1];
+    break;
+  case TASK_WAIT_INFO_ID:
+  case META_WAIT_INFO_ID:
+    {
+      const unsigned base = (id == TASK_WAIT_INFO_ID) ? 1 : 2;
+      WaitInterval wait;
+      wait.start = to_us(vals[base]);
+      wait.ready = to_us(vals[base+1]);
+      wait.end = to_us(vals[base+2]);
+      if (id == TASK_WAIT_INFO_ID)
+        data.task_waits[vals[0]].push_back(wait);
+      else
+        data.meta_waits[std::make_pair((unsigned)vals[1],
+                                       vals[0])].push_back(wait);
+      break;
+    }
+  case TASK_INFO_ID:
+  case META_INFO_ID:
+  case MESSAGE_INFO_ID:
+  case MAPPER_CALL_INFO_ID:
+  case RUNTIME_CALL_INFO_ID:
+  case PROFTASK_INFO_ID:
+    {
+      Item item;
+      item.op_id = 0;
+      item.id1 = item.id2 = 0;
+      item.level = 0;
+      item.prof_uid = 0;
+      u64 proc_id = 0;
+      switch (id) {
+      case TASK_INFO_ID:
+        item.kind = TASK_ITEM;
+        item.op_id = vals[0];
+        item.id1 = vals[1];
+        item.id2 = vals[2];
+        proc_id = vals[3];
+        item.create = to_us(vals[4]);
+        item.ready = to_us(vals[5]);
+        item.start = to_us(vals[6]);
+        item.stop = to_us(vals[7]);
+        break;
+      case META_INFO_ID:
+        item.kind = META_ITEM;
+        item.op_id = vals[0];
+        item.id1 = vals[1];
+        proc_id = vals[2];
+        item.create = to_us(vals[3]);
+        item.ready = to_us(vals[4]);
+        item.start = to_us(vals[5]);
+        item.stop = to_us(vals[6]);
+        break;
+      case MAPPER_CALL_INFO_ID:
+        item.kind = MAPPER_CALL_ITEM;
+        item.id1 = vals[0];
+        proc_id = vals[1];
+        item.op_id = vals[2];
+        item.start = to_us(vals[3]);
+        item.stop = to_us(vals[4]);
+        // Like legion_prof.py only show expensive mapper calls
+        if ((item.stop - item.start) < 100)
+          return;
+        break;
+      case PROFTASK_INFO_ID:
+        item.kind = PROF_TASK_ITEM;
+        proc_id = vals[0];
+        item.op_id = vals[1];
+        item.start = to_us(vals[2]);
+        item.stop = to_us(vals[3]);
+        break;
+      default:
+        item.kind = (id == MESSAGE_INFO_ID) ? MESSAGE_ITEM : RUNTIME_CALL_ITEM;
+        item.id1 = vals[0];
+        proc_id = vals[1];
+        item.start = to_us(vals[2]);
+        item.stop = to_us(vals[3]);
+        break;
+      }
+      if ((id != TASK_INFO_ID) && (id != META_INFO_ID))
+        item.create = item.ready = item.start;
+      if (item.stop > data.last_time)
+        data.last_time = item.stop;
+      data.find_proc(proc_id).items.push_back(item);
+      break;
+    }
+  case TASK_PERF_COUNTERS_ID:
+    {
+      const PerfCounterKey key(std::make_pair((unsigned)vals[1],
+                                              (unsigned)vals[2]), vals[3]);
+      data.perf_counters[key].add(vals + PERF_COUNTER_BASE);
+      break;
+    }
+  default:
+    // Copies, fills, instances, partitions and message sizes are not
+    // part of the processor analysis
+    break;
+  }
+}
+
+bool LogParser::read_index(u64 data_offset, std::vector<ChunkInfo> &chunks)
+{
+  u64 index_offset;
+  unsigned magic, count;
+  const long trailer = sizeof(index_offset) + sizeof(magic);
+  if (fseek(f, -trailer, SEEK_END) != 0)
+    return false;
+  if ((fread(&index_offset, sizeof(index_offset), 1, f) != 1) ||
+      (fread(&magic, sizeof(magic), 1, f) != 1) ||
+      (magic != LEGION_PROF_INDEX_MAGIC) || (index_offset < data_offset))
+    return false;
+  if ((fseek(f, index_offset, SEEK_SET) != 0) ||
+      (fread(&magic, sizeof(magic), 1, f) != 1) ||
+      (magic != LEGION_PROF_INDEX_MAGIC) ||
+      (fread(&count, sizeof(count), 1, f) != 1))
+    return false;
+  chunks.resize(count);
+  for (unsigned idx = 0; idx < count; idx++) {
+    ChunkInfo &info = chunks[idx];
+    if ((fread(&info.offset, sizeof(info.offset), 1, f) != 1) ||
+        (fread(&info.flags, sizeof(info.flags), 1, f) != 1) ||
+        (fread(&info.start, sizeof(info.start), 1, f) != 1) ||
+        (fread(&info.stop, sizeof(info.stop), 1, f) != 1)) {
+      chunks.clear();
+      return false;
+    }
+  }
+  return true;
+}
+
+bool LogParser::walk_chunks(u64 data_offset, std::vector<ChunkInfo> &chunks)
+{
+  // No index (e.g. the run died before finishing the log) so walk the
+  // chunk headers from the front of the file
+  u64 offset = data_offset;
+  while (fseek(f, offset, SEEK_SET) == 0) {
+    unsigned magic;
+    ChunkInfo info;
+    u64 raw_size, stored_size;
+    if ((fread(&magic, sizeof(magic), 1, f) != 1) ||
+        (magic != LEGION_PROF_CHUNK_MAGIC) ||
+        (fread(&info.flags, sizeof(info.flags), 1, f) != 1) ||
+        (fread(&raw_size, sizeof(raw_size), 1, f) != 1) ||
+        (fread(&stored_size, sizeof(stored_size), 1, f) != 1) ||
+        (fread(&info.start, sizeof(info.start), 1, f) != 1) ||
+        (fread(&info.stop, sizeof(info.stop), 1, f) != 1))
+      break;
+    info.offset = offset;
+    chunks.push_back(info);
+    offset += LEGION_PROF_CHUNK_HEADER_SIZE + stored_size;
+  }
+  return true;
+}
+
+bool LogParser::parse_chunks(ProfData &data)
+{
+  const u64 data_offset = ftell(f);
+  std::vector<ChunkInfo> chunks;
+  if (!read_index(data_offset, chunks))
+    walk_chunks(data_offset, chunks);
+  std::vector<char> stored, raw;
+  for (std::vector<ChunkInfo>::const_iterator it = chunks.begin();
+        it != chunks.end(); it++) {
+    // Only decompress chunks that overlap the window unless they have
+    // descriptions that we need regardless of time
+    bool untimed_only = false;
+    if (!in_window(it->start, it->stop)) {
+      if (!(it->flags & LEGION_PROF_CHUNK_METADATA))
+        continue;
+      untimed_only = true;
+    }
+    unsigned magic, flags;
+    u64 raw_size, stored_size, start, stop;
+    if ((fseek(f, it->offset, SEEK_SET) != 0) ||
+        (fread(&magic, sizeof(magic), 1, f) != 1) ||
+        (magic != LEGION_PROF_CHUNK_MAGIC) ||
+        (fread(&flags, sizeof(flags), 1, f) != 1) ||
+        (fread(&raw_size, sizeof(raw_size), 1, f) != 1) ||
+        (fread(&stored_size, sizeof(stored_size), 1, f) != 1) ||
+        (fread(&start, sizeof(start), 1, f) != 1) ||
+        (fread(&stop, sizeof(stop), 1, f) != 1))
+      return fail("corrupt chunk header");
+    stored.resize(stored_size);
+    if ((stored_size > 0) && (fread(&stored[0], stored_size, 1, f) != 1)) {
+      fprintf(stderr, "WARNING: %s: truncated chunk at offset %lld\n",
+              filename.c_str(), it->offset);
+      break;
+    }
+    const char *records = stored.empty() ? 0 : &stored[0];
+    if (flags & LEGION_PROF_CHUNK_COMPRESSED) {
+#ifdef USE_ZLIB
+      raw.resize(raw_size);
+      uLongf length = raw_size;
+      if ((uncompress((Bytef*)&raw[0], &length, (const Bytef*)&stored[0],
+                      stored_size) != Z_OK) || (length != raw_size))
+        return fail("corrupt compressed chunk");
+      records = &raw[0];
+#else
+      return fail("compressed logs need a build with USE_ZLIB");
+#endif
+    } else if (raw_size != stored_size)
+      return fail("corrupt chunk header");
+    if (!parse_records(records, raw_size, untimed_only, data))
+      return false;
+  }
+  return true;
+}
+
+bool LogParser::parse_stream(ProfData &data)
+{
+  // Version 1 logs are just one long stream of records, possibly gzipped
+  std::vector<char> buffer;
+  char block[1 << 16];
+  while (true) {
+    int bytes;
+#ifdef USE_ZLIB
+    if (gz)
+      bytes = gzread(gz, block, sizeof(block));
+    else
+#endif
+      bytes = fread(block, 1, sizeof(block), f);
+    if (bytes <= 0)
+      break;
+    buffer.insert(buffer.end(), block, block + bytes);
+  }
+  if (buffer.empty())
+    return true;
+  return parse_records(&buffer[0], buffer.size(), false/*untimed only*/, data);
+}
+
+bool LogParser::parse(ProfData &data)
+{
+  f = fopen(filename.c_str(), "rb");
+  if (f == 0)
+    return fail(strerror(errno));
+#ifdef USE_ZLIB
+  // Version 1 logs might be gzipped as a whole
+  unsigned char magic[2];
+  if ((fread(magic, 1, 2, f) == 2) && (magic[0] == 0x1f) &&
+      (magic[1] == 0x8b)) {
+    fclose(f);
+    f = 0;
+    gz = gzopen(filename.c_str(), "rb");
+    if (gz == 0)
+      return fail("unable to open gzipped log");
+  } else
+    rewind(f);
+#endif
+  if (!parse_preamble())
+    return false;
+  if (chunked) {
+    if (f == 0)
+      return fail("version 2 logs cannot be gzipped");
+    if (!parse_chunks(data))
+      return false;
+  } else if (!parse_stream(data))
+    return false;
+  // Wait records are not necessarily next to the tasks they go with
+  for (std::map<u64,Processor>::iterator pit = data.procs.begin();
+        pit != data.procs.end(); pit++) {
+    for (std::vector<Item>::iterator it = pit->second.items.begin();
+          it != pit->second.items.end(); it++) {
+      if (it->kind == TASK_ITEM) {
+        std::map<u64,std::vector<WaitInterval> >::iterator finder =
+          data.task_waits.find(it->op_id);
+        if (finder != data.task_waits.end())
+          it->waits.swap(finder->second);
+      } else if (it->kind == META_ITEM) {
+        std::map<std::pair<unsigned,u64>,std::vector<WaitInterval> >::iterator
+          finder = data.meta_waits.find(std::make_pair(it->id1, it->op_id));
+        if (finder != data.meta_waits.end())
+          it->waits.swap(finder->second);
+      }
+    }
+  }
+  data.task_waits.clear();
+  data.meta_waits.clear();
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Parallel parsing
+//------------------------------------------------------------------------------
+
+struct ParseWork {
+  const std::vector<const char*> *filenames;
+  std::vector<ProfData> *results;
+  std::vector<std::string> *errors;
+  u64 window_start, window_stop;
+  unsigned next;
+};
+
+static void *parse_worker(void *arg)
+{
+  ParseWork *work = (ParseWork*)arg;
+  while (true) {
+    const unsigned index = __sync_fetch_and_add(&work->next, 1);
+    if (index >= work->filenames->size())
+      break;
+    LogParser parser((*work->filenames)[index],
+                     work->window_start, work->window_stop);
+    if (!parser.parse((*work->results)[index]))
+      (*work->errors)[index] = parser.get_error();
+  }
+  return 0;
+}
+
+//------------------------------------------------------------------------------
+// Analysis
+//------------------------------------------------------------------------------
+
+class Analyzer {
+public:
+  Analyzer(ProfData &d) : data(d), next_prof_uid(0) { }
+  void analyze(void);
+  void print_stats(bool verbose) const;
+  void print_perf_counters(void) const;
+  bool emit_visualization(const std::string &dirname,
+                          const std::string &src_dirname) const;
+protected:
+  struct TimePoint {
+    u64 time;
+    bool first;
+    unsigned owner;
+    bool operator<(const TimePoint &rhs) const
+      { return time_key() < rhs.time_key(); }
+    u64 time_key(void) const { return 2 * time + (first ? 0 : 1); }
+  };
+  std::string item_title(const Item &item) const;
+  std::string variant_name(unsigned task_id, unsigned variant_id) const;
+  std::string item_color(const Item &item) const;
+  std::string proc_name(const Processor &proc) const;
+  std::string proc_short_text(const Processor &proc) const;
+  void assign_levels(Processor &proc);
+  void utilization_points(const Processor &proc, unsigned owner,
+                          std::vector<TimePoint> &points) const;
+  bool emit_utilization(const std::string &dirname) const;
+  bool emit_processor(const std::string &filename,
+                      const Processor &proc) const;
+protected:
+  ProfData &data;
+  u64 next_prof_uid;
+};
+
+// Same as color_helper in legion_prof.py
+static std::string color_helper(unsigned step, unsigned num_steps)
+{
+  const double h = double(step) / double(num_steps);
+  const int i = int(h * 6);
+  const double f = h * 6 - i;
+  const double q = 1 - f;
+  double r = 0, g = 0, b = 0;
+  switch (i % 6) {
+  case 0: r = 1; g = f; b = 0; break;
+  case 1: r = q; g = 1; b = 0; break;
+  case 2: r = 0; g = 1; b = f; break;
+  case 3: r = 0; g = q; b = 1; break;
+  case 4: r = f; g = 0; b = 1; break;
+  case 5: r = 1; g = 0; b = q; break;
+  }
+  char buffer[8];
+  snprintf(buffer, sizeof(buffer), "#%02x%02x%02x",
+           int(r * 255), int(g * 255), int(b * 255));
+  return buffer;
+}
+
+std::string Analyzer::variant_name(unsigned task_id, unsigned variant_id) const
+{
+  std::map<unsigned,std::string>::const_iterator kind =
+    data.task_kinds.find(task_id);
+  std::string title = (kind != data.task_kinds.end()) ? kind->second :
+                                                        "unnamed";
+  std::map<std::pair<unsigned,unsigned>,std::string>::const_iterator variant =
+    data.variants.find(std::make_pair(task_id, variant_id));
+  if ((variant != data.variants.end()) &&
+      (variant->second.find("unnamed") != std::string::npos) &&
+      (variant->second.find("unnamed") > 0))
+    title += " [" + variant->second + "]";
+  return title;
+}
+
+static std::string lookup_name(const std::map<unsigned,std::string> &names,
+                               unsigned kind)
+{
+  std::map<unsigned,std::string>::const_iterator finder = names.find(kind);
+  if (finder != names.end())
+    return finder->second;
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%u", kind);
+  return buffer;
+}
+
+std::string Analyzer::item_title(const Item &item) const
+{
+  char buffer[64];
+  switch (item.kind) {
+  case TASK_ITEM:
+    snprintf(buffer, sizeof(buffer), " <%llu>", item.op_id);
+    return variant_name(item.id1, item.id2) + buffer;
+  case META_ITEM:
+    return lookup_name(data.meta_descs, item.id1);
+  case MESSAGE_ITEM:
+    return "Message " + lookup_name(data.message_descs, item.id1);
+  case MAPPER_CALL_ITEM:
+    if (item.op_id > 0) {
+      snprintf(buffer, sizeof(buffer), " for %llu", item.op_id);
+      return "Mapper Call " + lookup_name(data.mapper_descs, item.id1) +
+              buffer;
+    }
+    return "Mapper Call " + lookup_name(data.mapper_descs, item.id1);
+  case RUNTIME_CALL_ITEM:
+    return "Runtime Call " + lookup_name(data.runtime_descs, item.id1);
+  case PROF_TASK_ITEM:
+    if (item.op_id > 0) {
+      snprintf(buffer, sizeof(buffer), "ProfTask <%llu>", item.op_id);
+      return buffer;
+    }
+    return "ProfTask";
+  }
+  return "";
+}
+
+std::string Analyzer::item_color(const Item &item) const
+{
+  // Spread the colors of each kind of thing over the color wheel using
+  // a stride that is coprime with the number of colors
+  const unsigned num_colors = data.variants.size() + data.meta_descs.size() +
+    data.message_descs.size() + data.mapper_descs.size() +
+    data.runtime_descs.size() + 1;
+  unsigned step = 0;
+  switch (item.kind) {
+  case TASK_ITEM:
+    {
+      const std::map<std::pair<unsigned,unsigned>,std::string> &variants =
+        data.variants;
+      step = std::distance(variants.begin(),
+                           variants.find(std::make_pair(item.id1, item.id2)));
+      break;
+    }
+  case META_ITEM:
+    switch (item.id1) {
+    case 1: return "#006600"; // Remote message
+    case 2: return "#333399"; // Post-Execution
+    case 6: return "#990000"; // Garbage Collection
+    case 7: return "#0000FF"; // Logical Dependence Analysis
+    case 8: // Operation Physical Analysis
+    case 9: return "#009900"; // Task Physical Analysis
+    default:
+      step = data.variants.size() + item.id1;
+    }
+    break;
+  case MESSAGE_ITEM:
+    step = data.variants.size() + data.meta_descs.size() + item.id1;
+    break;
+  case MAPPER_CALL_ITEM:
+    step = data.variants.size() + data.meta_descs.size() +
+      data.message_descs.size() + item.id1;
+    break;
+  case RUNTIME_CALL_ITEM:
+    step = data.variants.size() + data.meta_descs.size() +
+      data.message_descs.size() + data.mapper_descs.size() + item.id1;
+    break;
+  case PROF_TASK_ITEM:
+    return "#FFC0CB"; // Pink
+  }
+  return color_helper((step * 7919) % num_colors, num_colors);
+}
+
+std::string Analyzer::proc_name(const Processor &proc) const
+{
+  char buffer[64];
+  snprintf(buffer, sizeof(buffer), "%s Processor 0x%llx",
+           processor_kind_name(proc.kind), proc.proc_id);
+  return buffer;
+}
+
+std::string Analyzer::proc_short_text(const Processor &proc) const
+{
+  char buffer[64];
+  snprintf(buffer, sizeof(buffer), "%s Proc %u",
+           processor_kind_name(proc.kind), proc.proc_in_node());
+  return buffer;
+}
+
+static bool item_start_less(const Item &lhs, const Item &rhs)
+{
+  if (lhs.start != rhs.start)
+    return (lhs.start < rhs.start);
+  return (lhs.stop < rhs.stop);
+}
+
+void Analyzer::assign_levels(Processor &proc)
+{
+  // Same as Processor.sort_time_range in legion_prof.py: give each item
+  // the lowest level that is free when it starts
+  std::sort(proc.items.begin(), proc.items.end(), item_start_less);
+  std::vector<TimePoint> points;
+  points.reserve(2 * proc.items.size());
+  for (unsigned idx = 0; idx < proc.items.size(); idx++) {
+    TimePoint point;
+    point.owner = idx;
+    point.time = proc.items[idx].start;
+    point.first = true;
+    points.push_back(point);
+    point.time = proc.items[idx].stop;
+    point.first = false;
+    points.push_back(point);
+  }
+  std::stable_sort(points.begin(), points.end());
+  std::set<unsigned> free_levels;
+  proc.max_levels = 0;
+  for (std::vector<TimePoint>::const_iterator it = points.begin();
+        it != points.end(); it++) {
+    Item &item = proc.items[it->owner];
+    if (it->first) {
+      if (!free_levels.empty()) {
+        item.level = *(free_levels.begin());
+        free_levels.erase(free_levels.begin());
+      } else
+        item.level = ++proc.max_levels;
+    } else
+      free_levels.insert(item.level);
+  }
+  for (std::vector<Item>::iterator it = proc.items.begin();
+        it != proc.items.end(); it++)
+    it->prof_uid = ++next_prof_uid;
+}
+
+void Analyzer::analyze(void)
+{
+  for (std::map<u64,Processor>::iterator it = data.procs.begin();
+        it != data.procs.end(); it++)
+    assign_levels(it->second);
+}
+
+//------------------------------------------------------------------------------
+// Statistics
+//------------------------------------------------------------------------------
+
+struct CallStats {
+  CallStats(void) : calls(0), total(0), max_call(0), min_call(~0ULL) { }
+  void add(u64 time)
+  {
+    calls++;
+    total += time;
+    all.push_back(time);
+    max_call = std::max(max_call, time);
+    min_call = std::min(min_call, time);
+  }
+  void print(const std::string &name) const
+  {
+    // Matches StatObject.print_stats in legion_prof.py
+    const double avg = double(total) / double(calls);
+    double stddev = 0;
+    for (std::vector<u64>::const_iterator it = all.begin();
+          it != all.end(); it++)
+      stddev += fabs(double(*it) - avg);
+    stddev = sqrt(stddev / double(calls));
+    const double max_dev = (stddev != 0.0) ? (max_call - avg) / stddev : 0.0;
+    const double min_dev = (stddev != 0.0) ? (min_call - avg) / stddev : 0.0;
+    printf("  %s\n", name.c_str());
+    printf("       Total Invocations: %llu\n", calls);
+    printf("       Total Time: %llu us\n", total);
+    printf("       Average Time: %.2f us\n", avg);
+    printf("       Maximum Time: %llu us (%.3f sig)\n", max_call, max_dev);
+    printf("       Minimum Time: %llu us (%.3f sig)\n", min_call, min_dev);
+    printf("\n");
+  }
+  u64 calls, total, max_call, min_call;
+  std::vector<u64> all;
+};
+
+static bool stats_greater(const std::pair<std::string,const CallStats*> &lhs,
+                          const std::pair<std::string,const CallStats*> &rhs)
+{
+  return (lhs.second->total > rhs.second->total);
+}
+
+static void print_call_stats(const char *title,
+                             const std::map<std::string,CallStats> &stats)
+{
+  printf("  -------------------------\n");
+  printf("  %s\n", title);
+  printf("  -------------------------\n");
+  std::vector<std::pair<std::string,const CallStats*> > sorted;
+  for (std::map<std::string,CallStats>::const_iterator it = stats.begin();
+        it != stats.end(); it++)
+    sorted.push_back(std::make_pair(it->first, &(it->second)));
+  std::stable_sort(sorted.begin(), sorted.end(), stats_greater);
+  for (unsigned idx = 0; idx < sorted.size(); idx++)
+    sorted[idx].second->print(sorted[idx].first);
+}
+
+void Analyzer::print_stats(bool verbose) const
+{
+  printf("****************************************************\n");
+  printf("   PROCESSOR STATS\n");
+  printf("****************************************************\n");
+  std::map<std::string,CallStats> task_stats, meta_stats, mapper_stats,
+                                  runtime_stats, message_stats;
+  for (std::map<u64,Processor>::const_iterator pit = data.procs.begin();
+        pit != data.procs.end(); pit++) {
+    u64 total = 0, active = 0, application = 0, meta = 0, mapper = 0;
+    for (std::vector<Item>::const_iterator it = pit->second.items.begin();
+          it != pit->second.items.end(); it++) {
+      const u64 time = it->total_time();
+      total += time;
+      switch (it->kind) {
+      case TASK_ITEM:
+        active += it->active_time();
+        application += time;
+        task_stats[variant_name(it->id1, it->id2)].add(time);
+        break;
+      case META_ITEM:
+        active += it->active_time();
+        application += time;
+        meta_stats[item_title(*it)].add(time);
+        break;
+      case MESSAGE_ITEM:
+        active += time;
+        message_stats[lookup_name(data.message_descs, it->id1)].add(time);
+        break;
+      case MAPPER_CALL_ITEM:
+        active += time;
+        mapper += time;
+        mapper_stats[lookup_name(data.mapper_descs, it->id1)].add(time);
+        break;
+      case RUNTIME_CALL_ITEM:
+        active += time;
+        meta += time;
+        runtime_stats[lookup_name(data.runtime_descs, it->id1)].add(time);
+        break;
+      case PROF_TASK_ITEM:
+        active += time;
+        meta += time;
+        break;
+      }
+    }
+    if ((total == 0) && !verbose)
+      continue;
+    const double scale = (total != 0) ? 100.0 / double(total) : 0.0;
+    printf("%s\n", proc_name(pit->second).c_str());
+    printf("    Total time: %llu us\n", total);
+    printf("    Active time: %llu us (%.3f%%)\n", active, active * scale);
+    printf("    Application time: %llu us (%.3f%%)\n",
+           application, application * scale);
+    printf("    Meta time: %llu us (%.3f%%)\n", meta, meta * scale);
+    printf("    Mapper time: %llu us (%.3f%%)\n", mapper, mapper * scale);
+    printf("\n");
+  }
+  printf("\n");
+  printf("****************************************************\n");
+  printf("   TASK STATS\n");
+  printf("****************************************************\n");
+  print_call_stats("Task Statistics", task_stats);
+  print_call_stats("Meta-Task Statistics", meta_stats);
+  print_call_stats("Mapper Statistics", mapper_stats);
+  print_call_stats("Runtime Statistics", runtime_stats);
+  print_call_stats("Message Statistics", message_stats);
+  print_perf_counters();
+}
+
+// Ratios of hardware counters to print along with the totals, must match
+// derived_counters in legion_prof.py
+struct DerivedCounter {
+  const char *title, *num, *denom;
+  bool percent;
+};
+static const DerivedCounter derived_counters[] = {
+  { "Instructions per Cycle", "instructions", "cycles", false },
+  { "L1I Miss Rate", "l1i_misses", "l1i_accesses", true },
+  { "L1D Miss Rate", "l1d_misses", "l1d_accesses", true },
+  { "L2 Miss Rate", "l2_misses", "l2_accesses", true },
+  { "L3 Miss Rate", "l3_misses", "l3_accesses", true },
+  { "Branch Misprediction Rate", "branch_mispredictions", "branches", true },
+};
+
+static unsigned perf_counter_index(const char *name)
+{
+  for (unsigned idx = 0; idx < NUM_PERF_COUNTERS; idx++)
+    if (!strcmp(perf_counter_names[idx], name))
+      return idx;
+  assert(false);
+  return 0;
+}
+
+void Analyzer::print_perf_counters(void) const
+{
+  // Sum up the counters for each variant on each kind of processor
+  std::map<std::pair<std::string,std::string>,PerfCounters> by_kind;
+  for (std::map<PerfCounterKey,PerfCounters>::const_iterator it =
+        data.perf_counters.begin(); it != data.perf_counters.end(); it++) {
+    std::map<u64,Processor>::const_iterator proc =
+      data.procs.find(it->first.second);
+    const int kind = (proc != data.procs.end()) ? proc->second.kind : 0;
+    const std::pair<std::string,std::string> key(
+        variant_name(it->first.first.first, it->first.first.second),
+        processor_kind_name(kind));
+    by_kind[key].merge(it->second);
+  }
+  if (by_kind.empty())
+    return;
+  printf("****************************************************\n");
+  printf("   HARDWARE COUNTERS\n");
+  printf("****************************************************\n");
+  for (std::map<std::pair<std::string,std::string>,PerfCounters>::
+        const_iterator it = by_kind.begin(); it != by_kind.end(); it++) {
+    const PerfCounters &counters = it->second;
+    // Matches PerfCounters.print_stats in legion_prof.py
+    printf("  %s on %s\n", it->first.first.c_str(), it->first.second.c_str());
+    printf("       Tasks Measured: %llu\n", counters.tasks);
+    for (unsigned idx = 0; idx < NUM_PERF_COUNTERS; idx++) {
+      if (counters.measured[idx] == 0)
+        continue;
+      printf("       %s: %llu (%.2f per task)\n", perf_counter_names[idx],
+             counters.totals[idx],
+             double(counters.totals[idx]) / double(counters.measured[idx]));
+    }
+    for (unsigned idx = 0; idx < (sizeof(derived_counters) /
+                                  sizeof(derived_counters[0])); idx++) {
+      const DerivedCounter &derived = derived_counters[idx];
+      const unsigned num = perf_counter_index(derived.num);
+      const unsigned denom = perf_counter_index(derived.denom);
+      if ((counters.measured[num] == 0) || (counters.totals[denom] == 0))
+        continue;
+      const double ratio =
+        double(counters.totals[num]) / double(counters.totals[denom]);
+      if (derived.percent)
+        printf("       %s: %.3f%%\n", derived.title, 100.0 * ratio);
+      else
+        printf("       %s: %.3f\n", derived.title, ratio);
+    }
+    printf("\n");
+  }
+}
+
+//------------------------------------------------------------------------------
+// Visualization output
+//------------------------------------------------------------------------------
+
+static bool path_exists(const std::string &path)
+{
+  struct stat st;
+  return (stat(path.c_str(), &st) == 0);
+}
+
+static bool copy_tree(const std::string &src, const std::string &dst)
+{
+  if (mkdir(dst.c_str(), 0755) != 0)
+    return false;
+  DIR *dir = opendir(src.c_str());
+  if (dir == 0)
+    return false;
+  bool ok = true;
+  struct dirent *entry;
+  while (ok && ((entry = readdir(dir)) != 0)) {
+    if ((strcmp(entry->d_name, ".") == 0) || (strcmp(entry->d_name, "..") == 0))
+      continue;
+    const std::string from = src + "/" + entry->d_name;
+    const std::string to = dst + "/" + entry->d_name;
+    struct stat st;
+    if (stat(from.c_str(), &st) != 0) {
+      ok = false;
+    } else if (S_ISDIR(st.st_mode)) {
+      ok = copy_tree(from, to);
+    } else {
+      FILE *in = fopen(from.c_str(), "rb");
+      FILE *out = in ? fopen(to.c_str(), "wb") : 0;
+      char buffer[1 << 16];
+      size_t bytes;
+      while (out && ((bytes = fread(buffer, 1, sizeof(buffer), in)) > 0))
+        ok = ok && (fwrite(buffer, 1, bytes, out) == bytes);
+      ok = ok && (in != 0) && (out != 0);
+      if (in) fclose(in);
+      if (out) fclose(out);
+    }
+  }
+  closedir(dir);
+  return ok;
+}
+
+static void write_data_line(FILE *f, unsigned level, u64 start, u64 end,
+                            const std::string &color, const char *opacity,
+                            const std::string &title, u64 prof_uid)
+{
+  // level start end color opacity title initiation in out children
+  // parents prof_uid, the dependence columns stay empty without Spy data
+  fprintf(f, "%u\t%llu\t%llu\t%s\t%s\t%s\t\t\t\t\t\t%llu\n", level, start,
+          end, color.c_str(), opacity, title.c_str(), prof_uid);
+}
+
+bool Analyzer::emit_processor(const std::string &filename,
+                              const Processor &proc) const
+{
+  FILE *f = fopen(filename.c_str(), "w");
+  if (f == 0)
+    return false;
+  fprintf(f, "level\tstart\tend\tcolor\topacity\ttitle\tinitiation\tin\tout"
+             "\tchildren\tparents\tprof_uid\n");
+  for (std::vector<Item>::const_iterator it = proc.items.begin();
+        it != proc.items.end(); it++) {
+    const unsigned level = (proc.max_levels + 1) - it->level;
+    const std::string title = item_title(*it);
+    const std::string color = item_color(*it);
+    u64 start = it->start;
+    for (std::vector<WaitInterval>::const_iterator wit = it->waits.begin();
+          wit != it->waits.end(); wit++) {
+      write_data_line(f, level, start, wit->start, color, "1.0", title,
+                      it->prof_uid);
+      write_data_line(f, level, wit->start, wit->ready, color, "0.15",
+                      title + " (waiting)", it->prof_uid);
+      write_data_line(f, level, wit->ready, wit->end, color, "0.45",
+                      title + " (ready)", it->prof_uid);
+      start = std::max(start, wit->end);
+    }
+    if (it->waits.empty() || (start < it->stop))
+      write_data_line(f, level, start, it->stop, color, "1.0", title,
+                      it->prof_uid);
+  }
+  return (fclose(f) == 0);
+}
+
+void Analyzer::utilization_points(const Processor &proc, unsigned owner,
+                                  std::vector<TimePoint> &result) const
+{
+  // Busy when anything is running that isn't waiting, reduced to just
+  // the points where the processor goes from idle to busy or back
+  std::vector<TimePoint> points;
+  for (std::vector<Item>::const_iterator it = proc.items.begin();
+        it != proc.items.end(); it++) {
+    TimePoint point;
+    point.owner = owner;
+    point.time = it->start;
+    point.first = true;
+    points.push_back(point);
+    point.time = it->stop;
+    point.first = false;
+    points.push_back(point);
+    for (std::vector<WaitInterval>::const_iterator wit = it->waits.begin();
+          wit != it->waits.end(); wit++) {
+      point.time = wit->start;
+      point.first = false;
+      points.push_back(point);
+      point.time = wit->end;
+      point.first = true;
+      points.push_back(point);
+    }
+  }
+  std::stable_sort(points.begin(), points.end());
+  int count = 0;
+  for (std::vector<TimePoint>::const_iterator it = points.begin();
+        it != points.end(); it++) {
+    if (it->first) {
+      if (++count == 1)
+        result.push_back(*it);
+    } else {
+      if (--count == 0)
+        result.push_back(*it);
+    }
+  }
+}
+
+bool Analyzer::emit_utilization(const std::string &dirname) const
+{
+  // Group processors by kind, both per node and for all nodes
+  std::map<std::string,std::vector<const Processor*> > groups;
+  std::set<unsigned> nodes;
+  for (std::map<u64,Processor>::const_iterator it = data.procs.begin();
+        it != data.procs.end(); it++) {
+    if (it->second.items.empty())
+      continue;
+    char node[16];
+    snprintf(node, sizeof(node), "%u", it->second.node_id());
+    const std::string kind = processor_kind_name(it->second.kind);
+    groups[std::string(node) + " (" + kind + ")"].push_back(&(it->second));
+    groups["all (" + kind + ")"].push_back(&(it->second));
+    nodes.insert(it->second.node_id());
+  }
+  std::vector<std::string> node_names;
+  for (std::set<unsigned>::const_iterator it = nodes.begin();
+        it != nodes.end(); it++) {
+    char node[16];
+    snprintf(node, sizeof(node), "%u", *it);
+    node_names.push_back(node);
+  }
+  std::sort(node_names.begin(), node_names.end());
+  if (node_names.size() > 1)
+    node_names.insert(node_names.begin(), "all");
+  FILE *f = fopen((dirname + "/json/utils.json").c_str(), "w");
+  if (f == 0)
+    return false;
+  fprintf(f, "{");
+  for (unsigned idx = 0; idx < node_names.size(); idx++) {
+    fprintf(f, "%s\"%s\": [", (idx > 0) ? ", " : "", node_names[idx].c_str());
+    bool first = true;
+    for (int kind = 1; kind <= 8; kind++) {
+      const std::string group = node_names[idx] + " (" +
+                                processor_kind_name(kind) + ")";
+      if (groups.find(group) == groups.end())
+        continue;
+      fprintf(f, "%s\"%s\"", first ? "" : ", ", group.c_str());
+      first = false;
+    }
+    fprintf(f, "]");
+  }
+  fprintf(f, "}");
+  if (fclose(f) != 0)
+    return false;
+  for (std::map<std::string,std::vector<const Processor*> >::const_iterator
+        it = groups.begin(); it != groups.end(); it++) {
+    std::vector<TimePoint> points;
+    for (unsigned idx = 0; idx < it->second.size(); idx++)
+      utilization_points(*(it->second[idx]), idx, points);
+    std::stable_sort(points.begin(), points.end());
+    f = fopen((dirname + "/tsv/" + it->first + "_util.tsv").c_str(), "w");
+    if (f == 0)
+      return false;
+    fprintf(f, "time\tcount\n");
+    fprintf(f, "0.00\t0.00\n");
+    const double max_count = it->second.size();
+    int count = 0;
+    for (unsigned idx = 0; idx < points.size(); idx++) {
+      count += points[idx].first ? 1 : -1;
+      // Only the last point at any given time is kept
+      if (((idx + 1) < points.size()) &&
+          (points[idx+1].time == points[idx].time))
+        continue;
+      fprintf(f, "%.2f\t%.2f\n", double(points[idx].time),
+              double(count) / max_count);
+    }
+    if (fclose(f) != 0)
+      return false;
+  }
+  return true;
+}
+
+bool Analyzer::emit_visualization(const std::string &dirname,
+                                  const std::string &src_dirname) const
+{
+  printf("Generating interactive visualization files in directory %s\n",
+         dirname.c_str());
+  if (!copy_tree(src_dirname, dirname)) {
+    fprintf(stderr, "ERROR: unable to copy %s to %s\n", src_dirname.c_str(),
+            dirname.c_str());
+    return false;
+  }
+  mkdir((dirname + "/tsv").c_str(), 0755);
+  mkdir((dirname + "/json").c_str(), 0755);
+  // Operations
+  FILE *f = fopen((dirname + "/legion_prof_ops.tsv").c_str(), "w");
+  if (f == 0)
+    return false;
+  fprintf(f, "op_id\tdesc\tproc\tlevel\n");
+  std::set<u64> task_ops;
+  for (std::map<u64,Processor>::const_iterator pit = data.procs.begin();
+        pit != data.procs.end(); pit++) {
+    for (std::vector<Item>::const_iterator it = pit->second.items.begin();
+          it != pit->second.items.end(); it++) {
+      if (it->kind != TASK_ITEM)
+        continue;
+      fprintf(f, "%llu\t%s\t%s\t%u\n", it->op_id, item_title(*it).c_str(),
+              proc_name(pit->second).c_str(), it->level + 1);
+      task_ops.insert(it->op_id);
+    }
+  }
+  for (std::map<u64,unsigned>::const_iterator it = data.op_kinds.begin();
+        it != data.op_kinds.end(); it++) {
+    if (task_ops.find(it->first) != task_ops.end())
+      continue;
+    std::map<u64,unsigned>::const_iterator multi =
+      data.multi_tasks.find(it->first);
+    std::string desc;
+    if (multi != data.multi_tasks.end())
+      desc = lookup_name(data.task_kinds, multi->second);
+    else
+      desc = lookup_name(data.op_descs, it->second) + " Operation";
+    fprintf(f, "%llu\t%s <%llu>\t\t\n", it->first, desc.c_str(), it->first);
+  }
+  if (fclose(f) != 0)
+    return false;
+  // Processor timelines
+  f = fopen((dirname + "/legion_prof_processor.tsv").c_str(), "w");
+  if (f == 0)
+    return false;
+  fprintf(f, "full_text\ttext\ttsv\tlevels\n");
+  unsigned base_level = 0;
+  for (std::map<u64,Processor>::const_iterator it = data.procs.begin();
+        it != data.procs.end(); it++) {
+    if (it->second.items.empty())
+      continue;
+    char name[64];
+    snprintf(name, sizeof(name), "Proc_0x%llx", it->first);
+    const std::string tsv = std::string("tsv/") + name + ".tsv";
+    if (!emit_processor(dirname + "/" + tsv, it->second)) {
+      fclose(f);
+      return false;
+    }
+    const unsigned levels = std::max(it->second.max_levels, 1U);
+    base_level += levels + 1;
+    fprintf(f, "%s\t%s\t%s\t%u\n", proc_name(it->second).c_str(),
+            proc_short_text(it->second).c_str(), tsv.c_str(), levels);
+  }
+  if (fclose(f) != 0)
+    return false;
+  // The logs have no dependences between tasks (those come from Legion
+  // Spy) so the critical path is empty, the same as legion_prof.py
+  // writes when it has no Spy data
+  f = fopen((dirname + "/json/critical_path.json").c_str(), "w");
+  if (f == 0)
+    return false;
+  fprintf(f, "[]");
+  if (fclose(f) != 0)
+    return false;
+  if (!emit_utilization(dirname))
+    return false;
+  f = fopen((dirname + "/json/scale.json").c_str(), "w");
+  if (f == 0)
+    return false;
+  fprintf(f, "{\"start\": 0, \"end\": %.2f, \"stats_levels\": 4, "
+             "\"max_level\": %u}", data.last_time * 1.01, base_level + 1);
+  return (fclose(f) == 0);
+}
+
+//------------------------------------------------------------------------------
+// Driver
+//------------------------------------------------------------------------------
+
+static void usage(const char *argv0)
+{
+  fprintf(stderr,
+      "usage: %s [options] <logfile>...\n"
+      "  -s, --statistics     print statistics\n"
+      "  -v, --verbose        print verbose profiling information\n"
+      "  -o, --output <dir>   output directory pathname (default legion_prof)\n"
+      "  -f, --force          overwrite output directory if it exists\n"
+      "  -j <threads>         number of threads to parse with\n"
+      "  --start-time <us>    only load records ending after this time\n"
+      "  --stop-time <us>     only load records starting before this time\n"
+      "  --no-visualization   skip generating the visualization files\n"
+      "  --files <dir>        location of tools/legion_prof_files\n",
+      argv0);
+  exit(2);
+}
+
+static std::string default_files_dirname(const char *argv0)
+{
+#ifdef LEGION_PROF_FILES_DIR
+  if (path_exists(LEGION_PROF_FILES_DIR))
+    return LEGION_PROF_FILES_DIR;
+#endif
+  // Otherwise assume we're sitting next to legion_prof.py
+  const char *slash = strrchr(argv0, '/');
+  if (slash == 0)
+    return "legion_prof_files";
+  return std::string(argv0, slash - argv0) + "/legion_prof_files";
+}
+
+int main(int argc, char **argv)
+{
+  bool print_stats = false, verbose = false, force = false, visualize = true;
+  std::string output = "legion_prof";
+  std::string files_dirname;
+  long threads = sysconf(_SC_NPROCESSORS_ONLN);
+  u64 window_start = NO_TIME, window_stop = NO_TIME;
+  std::vector<const char*> filenames;
+  for (int idx = 1; idx < argc; idx++) {
+    const char *arg = argv[idx];
+    if (!strcmp(arg, "-s") || !strcmp(arg, "--statistics"))
+      print_stats = true;
+    else if (!strcmp(arg, "-v") || !strcmp(arg, "--verbose"))
+      verbose = true;
+    else if (!strcmp(arg, "-f") || !strcmp(arg, "--force"))
+      force = true;
+    else if (!strcmp(arg, "--no-visualization"))
+      visualize = false;
+    else if ((!strcmp(arg, "-o") || !strcmp(arg, "--output")) &&
+              (idx + 1) < argc)
+      output = argv[++idx];
+    else if (!strcmp(arg, "--files") && ((idx + 1) < argc))
+      files_dirname = argv[++idx];
+    else if (!strcmp(arg, "-j") && ((idx + 1) < argc))
+      threads = atol(argv[++idx]);
+    else if (!strcmp(arg, "--start-time") && ((idx + 1) < argc))
+      window_start = strtoull(argv[++idx], 0, 10) * 1000;
+    else if (!strcmp(arg, "--stop-time") && ((idx + 1) < argc))
+      window_stop = strtoull(argv[++idx], 0, 10) * 1000;
+    else if (arg[0] == '-')
+      usage(argv[0]);
+    else
+      filenames.push_back(arg);
+  }
+  if (filenames.empty())
+    usage(argv[0]);
+  if (threads < 1)
+    threads = 1;
+  if ((size_t)threads > filenames.size())
+    threads = filenames.size();
+
+  // Parse each file on its own thread
+  std::vector<ProfData> results(filenames.size());
+  std::vector<std::string> errors(filenames.size());
+  ParseWork work;
+  work.filenames = &filenames;
+  work.results = &results;
+  work.errors = &errors;
+  work.window_start = window_start;
+  work.window_stop = window_stop;
+  work.next = 0;
+  std::vector<pthread_t> workers(threads);
+  for (long idx = 0; idx < threads; idx++)
+    if (pthread_create(&workers[idx], 0, parse_worker, &work) != 0) {
+      fprintf(stderr, "ERROR: unable to create parsing thread\n");
+      return 1;
+    }
+  for (long idx = 0; idx < threads; idx++)
+    pthread_join(workers[idx], 0);
+  ProfData data;
+  for (unsigned idx = 0; idx < filenames.size(); idx++) {
+    if (!errors[idx].empty()) {
+      fprintf(stderr, "ERROR: %s\n", errors[idx].c_str());
+      return 1;
+    }
+    printf("Matched %zd objects in %s\n", results[idx].records,
+           filenames[idx]);
+    data.merge(results[idx]);
+    results[idx] = ProfData();
+  }
+  if (data.records == 0) {
+    printf("No matches found! Exiting...\n");
+    return 1;
+  }
+
+  Analyzer analyzer(data);
+  analyzer.analyze();
+  if (print_stats)
+    analyzer.print_stats(verbose);
+  if (visualize) {
+    if (path_exists(output)) {
+      if (force) {
+        printf("forcing removal of %s\n", output.c_str());
+        const std::string command = "rm -rf '" + output + "'";
+        if (system(command.c_str()) != 0) {
+          fprintf(stderr, "ERROR: unable to remove %s\n", output.c_str());
+          return 1;
+        }
+      } else {
+        for (unsigned idx = 1; ; idx++) {
+          char suffix[16];
+          snprintf(suffix, sizeof(suffix), ".%u", idx);
+          if (!path_exists(output + suffix)) {
+            output += suffix;
+            break;
+          }
+        }
+      }
+    }
+    if (files_dirname.empty())
+      files_dirname = default_files_dirname(argv[0]);
+    if (!analyzer.emit_visualization(output, files_dirname)) {
+      fprintf(stderr, "ERROR: failed writing visualization to %s\n",
+              output.c_str());
+      return 1;
+    }
+  }
+  return 0;
+}
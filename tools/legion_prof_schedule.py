@@ -0,0 +1,381 @@
+#!/usr/bin/env python
+
+# Copyright 2018 Stanford University, NVIDIA Corporation
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Computes a schedule for the schedule mapper (-lg:schedule <file>) from
+# the Legion Prof logs of one or more previous runs of an application.
+# The logs give the execution time of every task on every processor kind
+# it ran on and the size and duration of every copy. From those we pick
+# a processor kind and a priority for each task ID and a memory kind for
+# the instances of each processor kind:
+#
+#   - task IDs are assigned to processor kinds largest-first, each going
+#     to the kind that keeps the estimated makespan lowest, where a kind's
+#     load is the work assigned to it (execution time plus the time to
+#     copy the task's data at the bandwidth observed for that kind's
+#     memory) divided by its number of processors
+#   - tasks with longer executions get higher priorities
+#   - each processor kind uses the memory kind that its tasks' data was
+#     copied into at the highest bandwidth
+#
+# Only processor kinds a task actually ran on are considered for it, so
+# to let tasks move between kinds profile runs that use each of them
+# (e.g. one with -ll:gpu 0) and pass all of the logs. Each argument is
+# one run, give the per-node logs of a multi-node run as a comma-separated
+# list (operation and processor IDs are only meaningful within a run).
+# The makespan estimate ignores dependences between tasks.
+
+from __future__ import print_function
+
+import sys
+import argparse
+from collections import defaultdict
+from legion_serializer import LegionProfASCIIDeserializer, LegionProfBinaryDeserializer, GetFileTypeInfo
+
+# Make sure these are up to date with realm_c.h, they are the names the
+# schedule mapper expects
+processor_kinds = {
+    1 : 'TOC_PROC',
+    2 : 'LOC_PROC',
+    3 : 'UTIL_PROC',
+    4 : 'IO_PROC',
+    5 : 'PROC_GROUP',
+    6 : 'PROC_SET',
+    7 : 'OMP_PROC',
+    8 : 'PY_PROC',
+}
+
+memory_kinds = {
+    0 : 'GLOBAL_MEM',
+    1 : 'SYSTEM_MEM',
+    2 : 'REGDMA_MEM',
+    3 : 'SOCKET_MEM',
+    4 : 'Z_COPY_MEM',
+    5 : 'GPU_FB_MEM',
+    6 : 'DISK_MEM',
+    7 : 'HDF_MEM',
+    8 : 'FILE_MEM',
+    9 : 'LEVEL3_CACHE',
+    10 : 'LEVEL2_CACHE',
+    11 : 'LEVEL1_CACHE',
+}
+
+class CommaSplitAppend(argparse.Action):
+    def __init__(self, option_strings, dest, nargs=None, **kwargs):
+        if nargs is not None:
+            raise ValueError("nargs not allowed")
+        super(CommaSplitAppend, self).__init__(option_strings, dest, **kwargs)
+
+    def __call__(self, parser, namespace, values, option_string=None):
+        for s in values.split(','):
+            a = getattr(namespace, self.dest)
+            if a:
+                a.append(s)
+            else:
+                setattr(namespace, self.dest, [s])
+
+class CommaSplitRuns(argparse.Action):
+    def __call__(self, parser, namespace, values, option_string=None):
+        setattr(namespace, self.dest, [[f for f in v.split(',') if f]
+                                       for v in values])
+
+class TaskStats(object):
+    def __init__(self, task_id):
+        self.task_id = task_id
+        self.name = None
+        self.instances = 0
+        # execution time (us) and count per processor kind
+        self.time = defaultdict(float)
+        self.count = defaultdict(int)
+        self.copy_bytes = 0
+
+    def mean_time(self, kind):
+        return self.time[kind] / self.count[kind]
+
+    def kinds(self):
+        return [k for k in self.count if self.count[k] > 0]
+
+    def label(self):
+        if self.name is not None:
+            return self.name
+        return 'task %d' % self.task_id
+
+class Run(object):
+    # the records of one profiled run, whose operation and processor IDs
+    #  must not be mixed with those of other runs
+    def __init__(self, file_names):
+        self.file_names = file_names
+        self.has_spy_data = False
+        self.task_names = {}
+        self.procs = {}
+        self.mems = {}
+        self.task_infos = []
+        self.copy_infos = []
+        def ignore(**kwargs):
+            pass
+        self.callbacks = dict((name, ignore) for name in
+                              LegionProfASCIIDeserializer.patterns)
+        self.callbacks["ProcDesc"] = self.log_proc_desc
+        self.callbacks["MemDesc"] = self.log_mem_desc
+        self.callbacks["TaskKind"] = self.log_task_kind
+        self.callbacks["TaskInfo"] = self.log_task_info
+        self.callbacks["CopyInfo"] = self.log_copy_info
+
+    def log_proc_desc(self, proc_id, kind):
+        self.procs[proc_id] = processor_kinds.get(kind)
+
+    def log_mem_desc(self, mem_id, kind, capacity):
+        self.mems[mem_id] = memory_kinds.get(kind)
+
+    def log_task_kind(self, task_id, name, overwrite):
+        if overwrite == 1 or task_id not in self.task_names:
+            self.task_names[task_id] = name
+
+    def log_task_info(self, op_id, task_id, variant_id, proc_id,
+                      create, ready, start, stop):
+        self.task_infos.append((op_id, task_id, proc_id, start, stop))
+
+    def log_copy_info(self, op_id, src, dst, size, create, ready, start, stop):
+        self.copy_infos.append((op_id, dst, size, start, stop))
+
+    def parse(self, has_binary_files, verbose):
+        ascii_deserializer = LegionProfASCIIDeserializer(self, self.callbacks)
+        binary_deserializer = LegionProfBinaryDeserializer(self, self.callbacks)
+        for file_name in self.file_names:
+            if GetFileTypeInfo(file_name)[0] == 'binary':
+                binary_deserializer.parse(file_name, verbose)
+            elif not has_binary_files:
+                ascii_deserializer.parse(file_name, verbose)
+
+    def num_procs(self):
+        result = defaultdict(int)
+        for kind in self.procs.itervalues():
+            if kind is not None:
+                result[kind] += 1
+        return result
+
+class State(object):
+    def __init__(self, runs):
+        self.runs = runs
+
+    def learn(self, excluded):
+        tasks = {}
+        bandwidth = defaultdict(lambda: [0, 0])
+        placements = defaultdict(lambda: defaultdict(lambda: [0, 0]))
+        for run in self.runs:
+            if not run.task_infos:
+                continue
+            # op ids are only unique within a run
+            op_tasks = {}
+            # the top-level task runs for the whole program, it has the
+            #  lowest op id of its run and is skipped unless there are
+            #  several instances of it
+            first_op = min(info[0] for info in run.task_infos)
+            instances = defaultdict(int)
+            for op_id, task_id, proc_id, start, stop in run.task_infos:
+                instances[task_id] += 1
+            for op_id, task_id, proc_id, start, stop in run.task_infos:
+                if task_id in excluded:
+                    continue
+                if op_id == first_op and instances[task_id] == 1:
+                    continue
+                kind = run.procs.get(proc_id)
+                if kind is None:
+                    continue
+                if task_id not in tasks:
+                    tasks[task_id] = TaskStats(task_id)
+                task = tasks[task_id]
+                if task.name is None:
+                    task.name = run.task_names.get(task_id)
+                task.instances += 1
+                task.time[kind] += stop - start
+                task.count[kind] += 1
+                op_tasks[op_id] = (task, kind)
+
+            # copies are attributed to the task that needed them, if any
+            for op_id, dst, size, start, stop in run.copy_infos:
+                mem_kind = run.mems.get(dst)
+                if mem_kind is None:
+                    continue
+                bandwidth[mem_kind][0] += size
+                bandwidth[mem_kind][1] += max(stop - start, 1)
+                if op_id in op_tasks:
+                    task, proc_kind = op_tasks[op_id]
+                    task.copy_bytes += size
+                    placements[proc_kind][mem_kind][0] += size
+                    placements[proc_kind][mem_kind][1] += max(stop - start, 1)
+
+        # bytes per us for each memory kind copies went into
+        self.bandwidth = dict((k, float(b) / t) for k, (b, t) in
+                              bandwidth.iteritems())
+        self.memories = {}
+        for proc_kind, mems in placements.iteritems():
+            self.memories[proc_kind] = max(mems, key=lambda m:
+                float(mems[m][0]) / mems[m][1])
+        self.tasks = tasks
+
+class Schedule(object):
+    def __init__(self, state, num_procs):
+        self.state = state
+        self.num_procs = num_procs
+        self.assignment = {}
+        self.priority = {}
+
+    def copy_time(self, task, kind):
+        # time per instance to move the task's data into the memory its
+        #  processor kind places instances in
+        if task.copy_bytes == 0 or kind not in self.state.memories:
+            return 0.0
+        bandwidth = self.state.bandwidth[self.state.memories[kind]]
+        return float(task.copy_bytes) / task.instances / bandwidth
+
+    def work(self, task, kind):
+        return task.instances * (task.mean_time(kind) +
+                                 self.copy_time(task, kind))
+
+    def candidates(self, task):
+        return [k for k in task.kinds() if self.num_procs.get(k, 0) > 0]
+
+    def makespan(self, assignment):
+        load = defaultdict(float)
+        for task_id, kind in assignment.iteritems():
+            task = self.state.tasks[task_id]
+            load[kind] += self.work(task, kind) / self.num_procs[kind]
+        return max(load.values()) if load else 0.0
+
+    def observed_assignment(self):
+        # where the profiled runs put most instances of each task
+        result = {}
+        for task in self.state.tasks.itervalues():
+            kinds = self.candidates(task)
+            if kinds:
+                result[task.task_id] = max(kinds, key=lambda k: task.count[k])
+        return result
+
+    def compute(self):
+        tasks = [t for t in self.state.tasks.itervalues() if self.candidates(t)]
+        # largest task IDs first, as in longest processing time scheduling
+        tasks.sort(key=lambda t: (-min(self.work(t, k)
+                                       for k in self.candidates(t)),
+                                  t.task_id))
+        load = defaultdict(float)
+        for task in tasks:
+            best = None
+            for kind in self.candidates(task):
+                new_load = load[kind] + \
+                    self.work(task, kind) / self.num_procs[kind]
+                others = [l for k, l in load.iteritems() if k != kind]
+                key = (max([new_load] + others), new_load, kind)
+                if best is None or key < best[0]:
+                    best = (key, kind, new_load)
+            self.assignment[task.task_id] = best[1]
+            load[best[1]] = best[2]
+        # longer tasks get higher priorities so they start first
+        ranked = sorted(tasks, key=lambda t:
+                        (t.mean_time(self.assignment[t.task_id]), t.task_id))
+        for index, task in enumerate(ranked):
+            self.priority[task.task_id] = index
+
+    def write(self, out, file_names):
+        out.write('LegionSchedule v1\n')
+        out.write('# computed by legion_prof_schedule.py from %s\n' %
+                  ' '.join(file_names))
+        out.write('# estimated makespan ignoring dependences: %.3f us '
+                  '(%.3f us as profiled)\n' %
+                  (self.makespan(self.assignment),
+                   self.makespan(self.observed_assignment())))
+        for task_id in sorted(self.assignment):
+            task = self.state.tasks[task_id]
+            times = ', '.join('%s %.3f us' % (k, task.mean_time(k))
+                              for k in sorted(task.kinds()))
+            out.write('task %d %s %d # %s: %d instances, %s\n' %
+                      (task_id, self.assignment[task_id],
+                       self.priority[task_id], task.label(),
+                       task.instances, times))
+        used_kinds = set(self.assignment.itervalues())
+        for proc_kind in sorted(self.state.memories):
+            if proc_kind not in used_kinds:
+                continue
+            mem_kind = self.state.memories[proc_kind]
+            out.write('memory %s %s # %.3f bytes/us\n' %
+                      (proc_kind, mem_kind, self.state.bandwidth[mem_kind]))
+
+def parse_num_procs(state, overrides):
+    # by default schedule for the largest machine that was profiled
+    num_procs = defaultdict(int)
+    for run in state.runs:
+        for kind, count in run.num_procs().iteritems():
+            num_procs[kind] = max(num_procs[kind], count)
+    for override in overrides or []:
+        try:
+            kind, count = override.split('=')
+            if kind not in processor_kinds.values():
+                raise ValueError
+            num_procs[kind] = int(count)
+        except ValueError:
+            print('Invalid processor count %s, expected <kind>=<count> '
+                  'with a kind such as TOC_PROC or LOC_PROC' % override,
+                  file=sys.stderr)
+            sys.exit(1)
+    return num_procs
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Compute a schedule for -lg:schedule from Legion Prof logs')
+    parser.add_argument('-o', '--output', default='schedule.txt',
+                        help='schedule file to write')
+    parser.add_argument('-p', '--procs', action=CommaSplitAppend,
+                        metavar='KIND=COUNT',
+                        help='number of processors of each kind to schedule '
+                             'for (default is what the logs describe)')
+    parser.add_argument('-x', '--exclude', action=CommaSplitAppend,
+                        metavar='TASK_ID',
+                        help='task IDs to leave to the default mapper')
+    parser.add_argument('-v', '--verbose', action='store_true',
+                        help='print verbose profiling information')
+    parser.add_argument('runs', nargs='+', action=CommaSplitRuns,
+                        metavar='LOGS',
+                        help='Legion Prof log filenames of one run, '
+                             'separated by commas')
+    args = parser.parse_args()
+
+    try:
+        excluded = set(int(t) for t in args.exclude or [])
+    except ValueError:
+        print('Task IDs to exclude must be integers', file=sys.stderr)
+        sys.exit(1)
+
+    runs = [Run(file_names) for file_names in args.runs]
+    file_names = [f for run in runs for f in run.file_names]
+    # like legion_prof.py, only read the binary logs if there are any
+    has_binary_files = 'binary' in [GetFileTypeInfo(f)[0] for f in file_names]
+    for run in runs:
+        run.parse(has_binary_files, args.verbose)
+
+    if not any(run.task_infos for run in runs):
+        print('No tasks found in the logs', file=sys.stderr)
+        sys.exit(1)
+    state = State(runs)
+    state.learn(excluded)
+    schedule = Schedule(state, parse_num_procs(state, args.procs))
+    schedule.compute()
+
+    with open(args.output, 'w') as out:
+        schedule.write(out, file_names)
+    print('Wrote schedule for %d task IDs to %s' %
+          (len(schedule.assignment), args.output))
+
+if __name__ == '__main__':
+    main()
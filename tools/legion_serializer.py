@@ -21,9 +21,20 @@ import struct
 import legion_spy
 import gzip
 import io
+import zlib
 
 binary_filetype_pat = re.compile(r"FileType: BinaryLegionProf v: (?P<version>\d+(\.\d+)?)")
 
+# The hardware counters in TaskPerfCounters records, make sure this matches
+# LEGION_PROF_PERF_COUNTERS in runtime/legion/legion_profiling_format.h
+perf_counter_names = [
+    "instructions", "cycles", "fp_instructions", "load_instructions",
+    "store_instructions", "branch_instructions", "l1i_accesses", "l1i_misses",
+    "l1d_accesses", "l1d_misses", "l2_accesses", "l2_misses", "l3_accesses",
+    "l3_misses", "itlb_misses", "dtlb_misses", "branches", "taken_branches",
+    "branch_mispredictions",
+]
+
 def getFileObj(filename, compressed=False, buffer_size=32768):
     if compressed:
         return io.BufferedReader(gzip.open(filename, mode='rb'), buffer_size=buffer_size)
@@ -76,6 +87,7 @@ class LegionProfASCIIDeserializer(LegionDeserializer):
         "SliceOwner": re.compile(prefix + r'Prof Slice Owner (?P<parent_id>[0-9]+) (?P<op_id>[0-9]+)'),
         "TaskWaitInfo": re.compile(prefix + r'Prof Task Wait Info (?P<op_id>[0-9]+) (?P<task_id>[0-9]+) (?P<variant_id>[0-9]+) (?P<wait_start>[0-9]+) (?P<wait_ready>[0-9]+) (?P<wait_end>[0-9]+)'),
         "MetaWaitInfo": re.compile(prefix + r'Prof Meta Wait Info (?P<op_id>[0-9]+) (?P<lg_id>[0-9]+) (?P<wait_start>[0-9]+) (?P<wait_ready>[0-9]+) (?P<wait_end>[0-9]+)'),
+        "TaskPerfCounters": re.compile(prefix + r'Prof Task Perf Counters (?P<op_id>[0-9]+) (?P<task_id>[0-9]+) (?P<variant_id>[0-9]+) (?P<proc_id>[a-f0-9]+) (?P<start>[0-9]+) (?P<stop>[0-9]+) ' + ' '.join(r'(?P<%s>-?[0-9]+)' % name for name in perf_counter_names)),
         "TaskInfo": re.compile(prefix + r'Prof Task Info (?P<op_id>[0-9]+) (?P<task_id>[0-9]+) (?P<variant_id>[0-9]+) (?P<proc_id>[a-f0-9]+) (?P<create>[0-9]+) (?P<ready>[0-9]+) (?P<start>[0-9]+) (?P<stop>[0-9]+)'),
         "MetaInfo": re.compile(prefix + r'Prof Meta Info (?P<op_id>[0-9]+) (?P<lg_id>[0-9]+) (?P<proc_id>[a-f0-9]+) (?P<create>[0-9]+) (?P<ready>[0-9]+) (?P<start>[0-9]+) (?P<stop>[0-9]+)'),
         "CopyInfo": re.compile(prefix + r'Prof Copy Info (?P<op_id>[0-9]+) (?P<src>[a-f0-9]+) (?P<dst>[a-f0-9]+) (?P<size>[0-9]+) (?P<create>[0-9]+) (?P<ready>[0-9]+) (?P<start>[0-9]+) (?P<stop>[0-9]+)'),
@@ -87,6 +99,7 @@ class LegionProfASCIIDeserializer(LegionDeserializer):
         "MessageInfo": re.compile(prefix + r'Prof Message Info (?P<kind>[0-9]+) (?P<proc_id>[a-f0-9]+) (?P<start>[0-9]+) (?P<stop>[0-9]+)'),
         "MapperCallInfo": re.compile(prefix + r'Prof Mapper Call Info (?P<kind>[0-9]+) (?P<proc_id>[a-f0-9]+) (?P<op_id>[0-9]+) (?P<start>[0-9]+) (?P<stop>[0-9]+)'),
         "RuntimeCallInfo": re.compile(prefix + r'Prof Runtime Call Info (?P<kind>[0-9]+) (?P<proc_id>[a-f0-9]+) (?P<start>[0-9]+) (?P<stop>[0-9]+)'),
+        "MessageSizeInfo": re.compile(prefix + r'Prof Message Size Info (?P<kind>[0-9]+) (?P<count>[0-9]+) (?P<bytes>[0-9]+) (?P<wire_bytes>[0-9]+) (?P<node>[0-9]+)'),
         "ProfTaskInfo": re.compile(prefix + r'Prof ProfTask Info (?P<proc_id>[a-f0-9]+) (?P<op_id>[0-9]+) (?P<start>[0-9]+) (?P<stop>[0-9]+)')
         # "UserInfo": re.compile(prefix + r'Prof User Info (?P<proc_id>[a-f0-9]+) (?P<start>[0-9]+) (?P<stop>[0-9]+) (?P<name>[$()a-zA-Z0-9_]+)')
     }
@@ -95,6 +108,10 @@ class LegionProfASCIIDeserializer(LegionDeserializer):
         "parent_id": long,
         "size": long,
         "capacity": long,
+        "count": long,
+        "bytes": long,
+        "wire_bytes": long,
+        "node": int,
         "variant_id": int,
         "lg_id": int,
         "uid": int,
@@ -120,6 +137,7 @@ class LegionProfASCIIDeserializer(LegionDeserializer):
         "name": lambda x: x,
         "desc": lambda x: x
     }
+    parse_callbacks.update((name, long) for name in perf_counter_names)
 
     def __init__(self, state, callbacks):
         LegionDeserializer.__init__(self, state, callbacks)
@@ -200,6 +218,7 @@ class LegionProfBinaryDeserializer(LegionDeserializer):
         "unsigned":           "I", # unsigned int
         "timestamp_t":        "Q", # unsigned long long
         "unsigned long long": "Q", # unsigned long long
+        "long long":          "q", # long long
         "ProcKind":           "i", # int (really an enum so this depends)
         "MemKind":            "i", # int (really an enum so this depends)
         "MessageKind":        "i", # int (really an enum so this depends)
@@ -208,9 +227,33 @@ class LegionProfBinaryDeserializer(LegionDeserializer):
         "DepPartOpKind":      "i", # int (really an enum so this depends)
     }
 
-    def __init__(self, state, callbacks):
+    # Chunk headers and the trailing chunk index of version 2 files, make
+    # sure these match runtime/legion/legion_profiling_format.h
+    chunk_magic = 0x4b43504c
+    index_magic = 0x5849504c
+    chunk_header_fmt = '<IIQQQQ'
+    index_entry_fmt = '<QIQQ'
+    index_trailer_fmt = '<QI'
+    CHUNK_COMPRESSED = 0x1
+    CHUNK_METADATA = 0x2
+
+    # Records with times that version 2 files use to bound their chunks,
+    # make sure these match the note_time calls in the binary serializer
+    timed_records = set([
+        "TaskWaitInfo", "MetaWaitInfo", "TaskInfo", "MetaInfo", "CopyInfo",
+        "FillInfo", "InstTimelineInfo", "PartitionInfo", "MessageInfo",
+        "MapperCallInfo", "RuntimeCallInfo", "ProfTaskInfo",
+        "TaskPerfCounters",
+    ])
+
+    def __init__(self, state, callbacks, start_time=None, stop_time=None):
         LegionDeserializer.__init__(self, state, callbacks)
         self.callbacks_translated = False
+        # Optional window (in us) of timed records to load from version 2 
+        # files, records without times are always loaded
+        self.start_time = start_time
+        self.stop_time = stop_time
+        self.version = None
 
     @staticmethod
     def create_type_reader(num_bytes, param_type):
@@ -234,7 +277,8 @@ class LegionProfBinaryDeserializer(LegionDeserializer):
             return reader
 
     def parse_preamble(self, log):
-        log.readline() # filetype
+        m = binary_filetype_pat.match(log.readline())
+        self.version = float(m.group('version')) if m is not None else 1.0
         while(True):
             line = log.readline()
             if line == "\n":
@@ -280,23 +324,106 @@ class LegionProfBinaryDeserializer(LegionDeserializer):
         #     callbacks_valid = callbacks_valid and cur_valid
         # assert callbacks_valid
 
+    def parse_records(self, log, skip_ids=None):
+        matches = 0
+        _id_raw = log.read(4)
+        while _id_raw:
+            _id = int(struct.unpack('i', _id_raw)[0])
+            param_data = LegionProfBinaryDeserializer.preamble_data[_id]
+            kwargs = {}
+            for (param_name, reader) in param_data:
+                val = reader(log)
+                kwargs[param_name] = val
+            if skip_ids is None or _id not in skip_ids:
+                matches += 1
+                self.callbacks[_id](**kwargs)
+            _id_raw = log.read(4)
+        return matches
+
+    def in_window(self, start, stop):
+        # Chunk times are in ns, the window is in us
+        if start > stop:
+            return False
+        if self.start_time is not None and stop < self.start_time * 1000:
+            return False
+        if self.stop_time is not None and start > self.stop_time * 1000:
+            return False
+        return True
+
+    def read_chunk_index(self, log, data_offset):
+        trailer_size = struct.calcsize(self.index_trailer_fmt)
+        log.seek(0, io.SEEK_END)
+        end = log.tell()
+        if end - data_offset < trailer_size:
+            return None
+        log.seek(end - trailer_size)
+        index_offset, magic = struct.unpack(self.index_trailer_fmt,
+                                            log.read(trailer_size))
+        if magic != self.index_magic or index_offset < data_offset:
+            return None
+        log.seek(index_offset)
+        magic, count = struct.unpack('<II', log.read(8))
+        if magic != self.index_magic:
+            return None
+        entry_size = struct.calcsize(self.index_entry_fmt)
+        entries = []
+        for i in range(count):
+            entries.append(struct.unpack(self.index_entry_fmt,
+                                         log.read(entry_size)))
+        return entries
+
+    def parse_chunks(self, log):
+        # Records are stored in chunks annotated with the times they cover
+        # so we only need to decompress the ones that overlap the window
+        data_offset = log.tell()
+        index = self.read_chunk_index(log, data_offset)
+        if index is None:
+            # No index (e.g. the run died) so walk the chunk headers
+            index = []
+            header_size = struct.calcsize(self.chunk_header_fmt)
+            offset = data_offset
+            while True:
+                log.seek(offset)
+                raw = log.read(header_size)
+                if len(raw) < header_size:
+                    break
+                magic,flags,raw_size,stored_size,start,stop = \
+                    struct.unpack(self.chunk_header_fmt, raw)
+                if magic != self.chunk_magic:
+                    break
+                index.append((offset, flags, start, stop))
+                offset += header_size + stored_size
+        timed_ids = set(LegionProfBinaryDeserializer.name_to_id[name]
+                        for name in LegionProfBinaryDeserializer.timed_records
+                        if name in LegionProfBinaryDeserializer.name_to_id)
+        matches = 0
+        for offset,flags,start,stop in index:
+            skip_ids = None
+            if not self.in_window(start, stop):
+                if not (flags & self.CHUNK_METADATA):
+                    continue
+                # Still need the untimed records from this chunk
+                skip_ids = timed_ids
+            log.seek(offset)
+            header = log.read(struct.calcsize(self.chunk_header_fmt))
+            magic,flags,raw_size,stored_size,start,stop = \
+                struct.unpack(self.chunk_header_fmt, header)
+            data = log.read(stored_size)
+            if len(data) < stored_size:
+                print("Warning: truncated chunk at offset " + str(offset))
+                break
+            if flags & self.CHUNK_COMPRESSED:
+                data = zlib.decompress(data)
+            matches += self.parse_records(io.BytesIO(data), skip_ids)
+        return matches
+
     def parse(self, filename, verbose):
         print("parsing " + str(filename))
         def parse_file(log):
-            matches = 0
             self.parse_preamble(log)
-            _id_raw = log.read(4)
-            while _id_raw:
-                matches += 1
-                _id = int(struct.unpack('i', _id_raw)[0])
-                param_data = LegionProfBinaryDeserializer.preamble_data[_id]
-                kwargs = {}
-                for (param_name, reader) in param_data:
-                    val = reader(log)
-                    kwargs[param_name] = val
-                self.callbacks[_id](**kwargs)
-                _id_raw = log.read(4)
-            return matches
+            if self.version >= 2.0:
+                return self.parse_chunks(log)
+            return self.parse_records(log)
         try:
             # Try it as a gzip file first
             with getFileObj(filename,compressed=True) as log:
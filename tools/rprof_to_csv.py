@@ -32,6 +32,8 @@ parser.add_argument('-x', '--exclude', action=CommaSplitAppend,
                     help='regex(es) of gauges to NOT print')
 parser.add_argument('-c', '--compress', action='store_true', dest='compress_unchanged',
                     help='compress sequences of identical samples')
+parser.add_argument('-t', '--time', action='store_true',
+                    help='add a column with the time (in ns) of each sample')
 parser.add_argument('-d', '--debug', action='store_true',
                     help='produce debugging output')
 parser.add_argument('infile', help='name of input file (e.g. realmprof_0.dat)')
@@ -46,6 +48,7 @@ class PacketTypes:
     PACKET_EMPTY = 0
     PACKET_NEWGAUGE = 1
     PACKET_SAMPLES = 2
+    PACKET_SAMPLES_VARINT = 3
 
 class GaugeTypes:
     GTYPE_UNKNOWN = 0
@@ -54,6 +57,10 @@ class GaugeTypes:
     GTYPE_EVENTCOUNT = 3
 
 gauges = dict()
+time_gauge = None
+
+# the sampler records the start time of each sample in this gauge
+TIME_GAUGE_NAME = 'realm/sampling start'
 
 column_names = { GaugeTypes.GTYPE_ABSOLUTE: ('value',),
                  GaugeTypes.GTYPE_ABSOLUTERANGE: ('value', 'min', 'max'),
@@ -76,9 +83,18 @@ class Gauge(object):
             elif self.dtype == 'x':
                 self.sample_size = 8
                 self.sample_fmt = '<q'
-            elif self.dtype == 'm':   # size_t
+            elif self.dtype in ('m', 'y'):   # size_t, unsigned long long
                 self.sample_size = 8
                 self.sample_fmt = '<Q'
+            elif self.dtype == 'j':   # unsigned
+                self.sample_size = 4
+                self.sample_fmt = '<I'
+            elif self.dtype == 'f':   # float
+                self.sample_size = 4
+                self.sample_fmt = '<f'
+            elif self.dtype == 'd':   # double
+                self.sample_size = 8
+                self.sample_fmt = '<d'
             else:
                 print 'unknown data type:', self.dtype
                 assert False
@@ -89,9 +105,18 @@ class Gauge(object):
             elif self.dtype == 'x':
                 self.sample_size = 24
                 self.sample_fmt = '<qqq'
-            elif self.dtype == 'm':   # size_t
+            elif self.dtype in ('m', 'y'):   # size_t, unsigned long long
                 self.sample_size = 24
                 self.sample_fmt = '<QQQ'
+            elif self.dtype == 'j':   # unsigned
+                self.sample_size = 12
+                self.sample_fmt = '<III'
+            elif self.dtype == 'f':   # float
+                self.sample_size = 12
+                self.sample_fmt = '<fff'
+            elif self.dtype == 'd':   # double
+                self.sample_size = 24
+                self.sample_fmt = '<ddd'
             else:
                 print 'unknown data type:', self.dtype
                 assert False
@@ -130,59 +155,144 @@ class Gauge(object):
                 return s['samples'][sample_index - first_sample]
         return None
 
-with open(args.infile, 'rb') as f:
+def read_varint(data, pos):
+    v = 0
+    shift = 0
     while True:
-        hdr = f.read(8)
-        if len(hdr) < 8:
-            break
-        pkt_type, pkt_size = struct.unpack('<ii', hdr)
-
-        if args.debug:
-            print 'packet: type={:d} size={:d}'.format(pkt_type, pkt_size)
-
-        if pkt_type == PacketTypes.PACKET_NEWGAUGE:
-            pkt = f.read(64)
-            assert len(pkt) == 64
-            id, gtype, dtype, name = struct.unpack('<ii8s48s', pkt)
-
-            # check to see if we want to show this gauge
-            if args.include:
-                if not(any(re.search(p, name) for p in args.include)):
-                    continue
-            if args.exclude:
-                if any(re.search(p, name) for p in args.exclude):
-                    continue
-
-            g = Gauge(id, gtype, dtype, name)
-            gauges[id] = g
-            continue
+        b = ord(data[pos])
+        pos += 1
+        v |= (b & 0x7f) << shift
+        if b < 0x80:
+            return v, pos
+        shift += 7
 
-        if pkt_type == PacketTypes.PACKET_SAMPLES:
-            pkt = f.read(16)
-            assert len(pkt) == 16
-            id, comp_len, first_sample, last_sample = struct.unpack('<iiii', pkt)
-            if id in gauges:
-                g = gauges[id]
-                assert pkt_size == (16 + comp_len * (g.sample_size + 2))
-                if args.list:
-                    f.seek(pkt_size - 16, 1)
-                    g.add_samples(first_sample, last_sample, None, None)
-                else:
-                    sdata = f.read(comp_len * g.sample_size)
-                    assert len(sdata) == (comp_len * g.sample_size)
-                    rdata = f.read(comp_len * 2)
-                    assert len(rdata) == (comp_len * 2)
-                    samples = [ struct.unpack(g.sample_fmt, sdata[i * g.sample_size:(i + 1) * g.sample_size]) for i in xrange(comp_len) ]
-                    runlengths = struct.unpack('<{:d}H'.format(comp_len), rdata)
-                    g.add_samples(first_sample, last_sample, samples, runlengths)
-            else:
-                f.seek(pkt_size - 16, 1)
+# floating-point fields are encoded through their bit patterns, which are
+# converted back with these formats
+float_bit_fmts = { 'f': ('<I', '<f'),
+                   'd': ('<Q', '<d') }
+
+def decode_varint_samples(g, comp_len, data):
+    # fields are zigzag'd deltas from the previous entry, then a run length
+    nfields = len(g.sample_fmt) - 1
+    mask = (1 << 64) - 1
+    signed = g.dtype in ('i', 'l', 'x')
+    bit_fmts = float_bit_fmts.get(g.dtype)
+    prev = [ 0 ] * nfields
+    samples = []
+    runlengths = []
+    pos = 0
+    for _ in xrange(comp_len):
+        s = []
+        for f in xrange(nfields):
+            z, pos = read_varint(data, pos)
+            delta = (z >> 1) ^ -(z & 1)
+            prev[f] = (prev[f] + delta) & mask
+            v = prev[f]
+            if signed and v >= (1 << 63):
+                v -= (1 << 64)
+            elif bit_fmts:
+                v = struct.unpack(bit_fmts[1], struct.pack(bit_fmts[0], v))[0]
+            s.append(v)
+        samples.append(tuple(s))
+        l, pos = read_varint(data, pos)
+        runlengths.append(l)
+    return samples, runlengths
+
+def parse_packet(pkt_type, pkt):
+    global time_gauge
+    pkt_size = len(pkt)
+    if args.debug:
+        print 'packet: type={:d} size={:d}'.format(pkt_type, pkt_size)
+
+    if pkt_type == PacketTypes.PACKET_EMPTY:
+        return
+
+    if pkt_type == PacketTypes.PACKET_NEWGAUGE:
+        assert pkt_size == 64
+        id, gtype, dtype, name = struct.unpack('<ii8s48s', pkt)
+
+        if args.time and (name.rstrip('\0') == TIME_GAUGE_NAME):
+            time_gauge = Gauge(id, gtype, dtype, name)
+            gauges[id] = time_gauge
+            return
+
+        # check to see if we want to show this gauge
+        if args.include:
+            if not(any(re.search(p, name) for p in args.include)):
+                return
+        if args.exclude:
+            if any(re.search(p, name) for p in args.exclude):
+                return
+
+        g = Gauge(id, gtype, dtype, name)
+        gauges[id] = g
+        return
+
+    if pkt_type in (PacketTypes.PACKET_SAMPLES,
+                    PacketTypes.PACKET_SAMPLES_VARINT):
+        id, comp_len, first_sample, last_sample = struct.unpack('<iiii', pkt[0:16])
+        if id not in gauges:
+            return
+        g = gauges[id]
+        if args.list and not args.time:
+            g.add_samples(first_sample, last_sample, None, None)
+        elif pkt_type == PacketTypes.PACKET_SAMPLES:
+            assert pkt_size == (16 + comp_len * (g.sample_size + 2))
+            sdata = pkt[16:16 + comp_len * g.sample_size]
+            rdata = pkt[16 + comp_len * g.sample_size:]
+            samples = [ struct.unpack(g.sample_fmt, sdata[i * g.sample_size:(i + 1) * g.sample_size]) for i in xrange(comp_len) ]
+            runlengths = struct.unpack('<{:d}H'.format(comp_len), rdata)
+            g.add_samples(first_sample, last_sample, samples, runlengths)
+        else:
+            samples, runlengths = decode_varint_samples(g, comp_len, pkt[16:])
+            g.add_samples(first_sample, last_sample, samples, runlengths)
+        return
+
+    # unrecognized packet type
+    print 'unrecognized packet: type={:d} size={:d}'.format(pkt_type,
+                                                            pkt_size)
+
+def parse_packets(data, start, end):
+    pos = start
+    while (pos + 8) <= end:
+        pkt_type, pkt_size = struct.unpack('<II', data[pos:pos + 8])
+        parse_packet(pkt_type, data[pos + 8:pos + 8 + pkt_size])
+        pos += 8 + pkt_size
+
+def parse_ring_file(data):
+    # layout described by SampleFile::RingFileHeader in runtime/realm/sampling.h
+    (magic, version, header_size,
+     gauge_ofs, gauge_size, gauge_used,
+     ring_ofs, ring_size, ring_head, ring_used,
+     overwritten, gauges_dropped) = struct.unpack('<8sII9Q', data[0:88])
+    assert version == 1
+    if args.debug or overwritten or gauges_dropped:
+        print >>sys.stderr, 'ring file: {:d} bytes of samples overwritten, {:d} gauges dropped'.format(overwritten, gauges_dropped)
+    parse_packets(data, gauge_ofs, gauge_ofs + gauge_used)
+
+    ring = data[ring_ofs:ring_ofs + ring_size]
+    pos = ring_head
+    left = ring_used
+    while left > 0:
+        if (ring_size - pos) < 8:
+            # too short for a header - the next packet is at the start
+            left -= (ring_size - pos)
+            pos = 0
             continue
+        pkt_type, pkt_size = struct.unpack('<II', ring[pos:pos + 8])
+        parse_packet(pkt_type, ring[pos + 8:pos + 8 + pkt_size])
+        left -= 8 + pkt_size
+        pos = (pos + 8 + pkt_size) % ring_size
+
+with open(args.infile, 'rb') as f:
+    data = f.read()
+if data[0:8] == 'RLMPRING':
+    parse_ring_file(data)
+else:
+    parse_packets(data, 0, len(data))
 
-        # unrecognized packet type
-        print 'unrecognized packet: type={:d} size={:d}'.format(pkt_type,
-                                                                pkt_size)
-        f.seek(pkt_size, 1) # relative to current position
+if time_gauge:
+    del gauges[time_gauge.id]
 
 if args.list:
     for g in sorted(gauges.values(), key=attrgetter('name')):
@@ -198,6 +308,9 @@ else:
 # header lines
 hdr1 = [ 'sample' ]
 hdr2 = [ 'index' ]
+if time_gauge:
+    hdr1.append('time')
+    hdr2.append('ns')
 
 gs = sorted(gauges.values(), key=attrgetter('id'))
 for g in gs:
@@ -218,6 +331,9 @@ while True:
         break
 
     vs = []
+    if time_gauge:
+        s = time_gauge.get_sample(sample)
+        vs.append(str(s[0]) if s is not None else '')
     for g in gs:
         s = g.get_sample(sample)
         if s is not None:
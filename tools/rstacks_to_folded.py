@@ -0,0 +1,210 @@
+#!/usr/bin/env python
+
+# Converts the stack samples written by Realm's stack sampler
+# (-stacks:classes ...) into folded stacks, one line per unique stack:
+#
+#   <class>;<outermost frame>;...;<innermost frame> <count>
+#
+# which can be fed to flamegraph.pl or speedscope. Symbols are looked up
+# offline with addr2line using the executable mappings recorded in each
+# file. Sample times use the same clock as Legion Prof, so --start-time
+# and --stop-time (in microseconds, as shown in the Legion Prof timeline)
+# select the samples for a region of interest.
+
+from __future__ import print_function
+
+import os
+import sys
+import argparse
+import subprocess
+from collections import defaultdict
+
+class CommaSplitAppend(argparse.Action):
+    def __init__(self, option_strings, dest, nargs=None, **kwargs):
+        if nargs is not None:
+            raise ValueError("nargs not allowed")
+        super(CommaSplitAppend, self).__init__(option_strings, dest, **kwargs)
+
+    def __call__(self, parser, namespace, values, option_string=None):
+        for s in values.split(','):
+            a = getattr(namespace, self.dest)
+            if a:
+                a.append(s)
+            else:
+                setattr(namespace, self.dest, [s])
+
+parser = argparse.ArgumentParser()
+parser.add_argument('-c', '--classes', action=CommaSplitAppend,
+                    metavar='CLASS',
+                    help='thread classes to include (e.g. util,dma)')
+parser.add_argument('--start-time', type=float, default=None,
+                    help='ignore samples before this time (in microseconds)')
+parser.add_argument('--stop-time', type=float, default=None,
+                    help='ignore samples after this time (in microseconds)')
+parser.add_argument('-t', '--per-thread', action='store_true',
+                    help='keep the stacks of each thread separate')
+parser.add_argument('-n', '--node', action='store_true',
+                    help='prefix each stack with its node')
+parser.add_argument('-a', '--addresses', action='store_true',
+                    help='do not look up symbols, just print addresses')
+parser.add_argument('-o', '--output', default=None,
+                    help='output file (default is stdout)')
+parser.add_argument('infiles', nargs='+',
+                    help='stack sample files (e.g. stacks_0.txt)')
+args = parser.parse_args()
+
+class Mapping(object):
+    def __init__(self, line):
+        fields = line.split(None, 5)
+        start, stop = fields[0].split('-')
+        self.start = int(start, 16)
+        self.stop = int(stop, 16)
+        self.offset = int(fields[2], 16)
+        self.path = fields[5].strip() if len(fields) > 5 else ''
+
+def is_position_dependent(path, cache=dict()):
+    # non-PIE executables (ELF type ET_EXEC) are symbolized with absolute
+    #  addresses rather than offsets from where they were loaded
+    if path not in cache:
+        try:
+            with open(path, 'rb') as fd:
+                header = bytearray(fd.read(18))
+            cache[path] = (header[:4] == bytearray(b'\x7fELF') and
+                           header[16] == 2 and header[17] == 0)
+        except IOError:
+            cache[path] = False
+    return cache[path]
+
+def object_address(m, addr):
+    if is_position_dependent(m.path):
+        return addr
+    return addr - m.start + m.offset
+
+class SampleFile(object):
+    def __init__(self, filename):
+        self.filename = filename
+        self.node = 0
+        self.maps = []
+        self.threads = []
+
+    def find_mapping(self, pc):
+        for m in self.maps:
+            if m.start <= pc < m.stop:
+                return m
+        return None
+
+class ThreadInfo(object):
+    def __init__(self, tid, cls, name):
+        self.tid = tid
+        self.cls = cls
+        self.name = name
+        self.samples = []
+
+def read_file(filename):
+    f = SampleFile(filename)
+    thread = None
+    with open(filename, 'r') as fd:
+        header = fd.readline().strip()
+        if header != 'StackSamples v1':
+            print('%s: not a stack sample file' % filename, file=sys.stderr)
+            sys.exit(1)
+        for line in fd:
+            if line.startswith('sample '):
+                fields = line.split()
+                time_us = int(fields[1]) / 1000.0
+                if args.start_time is not None and time_us < args.start_time:
+                    continue
+                if args.stop_time is not None and time_us > args.stop_time:
+                    continue
+                thread.samples.append([int(x, 16) for x in fields[2:]])
+            elif line.startswith('thread '):
+                # thread <tid> <class> <samples> <dropped> <reservation name>
+                fields = line.rstrip('\n').split(' ', 5)
+                thread = ThreadInfo(int(fields[1]), fields[2], fields[5])
+                if int(fields[4]) > 0:
+                    print('%s: %s samples dropped for thread %s (%s)' %
+                          (filename, fields[4], fields[1], fields[5]),
+                          file=sys.stderr)
+                if not args.classes or thread.cls in args.classes:
+                    f.threads.append(thread)
+            elif line.startswith('map '):
+                f.maps.append(Mapping(line[4:]))
+            elif line.startswith('node '):
+                f.node = int(line.split()[1])
+    return f
+
+def lookup_symbols(files):
+    # group the addresses by object file so each one needs a single
+    #  addr2line run, addresses are relative to where the object was loaded
+    wanted = defaultdict(set)
+    for f in files:
+        for t in f.threads:
+            for pcs in t.samples:
+                for i, pc in enumerate(pcs):
+                    # all but the innermost frame are return addresses
+                    addr = pc if i == 0 else pc - 1
+                    m = f.find_mapping(addr)
+                    if m is not None and m.path.startswith('/'):
+                        wanted[m.path].add(object_address(m, addr))
+
+    symbols = dict()
+    for path, addrs in wanted.items():
+        addrs = sorted(addrs)
+        names = None
+        if not args.addresses:
+            try:
+                proc = subprocess.Popen(['addr2line', '-f', '-C', '-e', path],
+                                        stdin=subprocess.PIPE,
+                                        stdout=subprocess.PIPE,
+                                        universal_newlines=True)
+                out, _ = proc.communicate('\n'.join('%x' % a for a in addrs))
+                # two lines per address: function and then file:line
+                names = out.split('\n')[0::2]
+            except OSError:
+                print('addr2line not found, printing addresses instead',
+                      file=sys.stderr)
+                args.addresses = True
+        for i, a in enumerate(addrs):
+            if names is not None and i < len(names) and names[i] != '??':
+                symbols[(path, a)] = names[i]
+            else:
+                symbols[(path, a)] = '%s+0x%x' % (os.path.basename(path), a)
+    return symbols
+
+def frame_name(f, symbols, pc, innermost):
+    addr = pc if innermost else pc - 1
+    m = f.find_mapping(addr)
+    if m is None:
+        return '0x%x' % pc
+    if not m.path.startswith('/'):
+        # e.g. [vdso]
+        return m.path or ('0x%x' % pc)
+    # folded stacks use ';' as a separator
+    return symbols[(m.path, object_address(m, addr))].replace(';', ':')
+
+def main():
+    files = [read_file(name) for name in args.infiles]
+    symbols = lookup_symbols(files)
+
+    counts = defaultdict(int)
+    for f in files:
+        for t in f.threads:
+            prefix = [t.cls]
+            if args.per_thread:
+                prefix.append('%s (%d)' % (t.name, t.tid))
+            if args.node:
+                prefix.insert(0, 'node %d' % f.node)
+            for pcs in t.samples:
+                frames = [frame_name(f, symbols, pc, i == 0)
+                          for i, pc in enumerate(pcs)]
+                frames.reverse()
+                counts[';'.join(prefix + frames)] += 1
+
+    out = open(args.output, 'w') if args.output else sys.stdout
+    for stack in sorted(counts):
+        out.write('%s %d\n' % (stack, counts[stack]))
+    if args.output:
+        out.close()
+
+if __name__ == '__main__':
+    main()